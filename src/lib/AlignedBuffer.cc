@@ -0,0 +1,155 @@
+
+#include "AlignedBuffer.hh"
+
+#include <stdexcept>
+#include <string>
+
+namespace storage {
+
+AlignedBuffer::AlignedBuffer(const std::size_t capacity,
+                             const std::size_t alignment,
+                             std::pmr::memory_resource *resource)
+  : buffer(static_cast<char *>(resource->allocate(capacity, alignment)))
+  , maximumLength(capacity)
+  , alignment(alignment)
+  , resource(resource)
+{}
+
+AlignedBuffer::~AlignedBuffer()
+{
+  this->release();
+}
+
+AlignedBuffer::AlignedBuffer(AlignedBuffer &&other) noexcept
+  : buffer(other.buffer)
+  , length(other.length)
+  , maximumLength(other.maximumLength)
+  , alignment(other.alignment)
+  , resource(other.resource)
+  , pool(other.pool)
+{
+  other.buffer        = nullptr;
+  other.length        = 0;
+  other.maximumLength = 0;
+  other.pool          = nullptr;
+}
+
+AlignedBuffer &AlignedBuffer::operator=(AlignedBuffer &&other) noexcept
+{
+  if (this != &other)
+  {
+    this->release();
+
+    this->buffer        = other.buffer;
+    this->length        = other.length;
+    this->maximumLength = other.maximumLength;
+    this->alignment     = other.alignment;
+    this->resource      = other.resource;
+    this->pool          = other.pool;
+
+    other.buffer        = nullptr;
+    other.length        = 0;
+    other.maximumLength = 0;
+    other.pool          = nullptr;
+  }
+
+  return *this;
+}
+
+auto AlignedBuffer::data() -> char *
+{
+  return this->buffer;
+}
+
+auto AlignedBuffer::data() const -> const char *
+{
+  return this->buffer;
+}
+
+auto AlignedBuffer::size() const -> std::size_t
+{
+  return this->length;
+}
+
+auto AlignedBuffer::capacity() const -> std::size_t
+{
+  return this->maximumLength;
+}
+
+void AlignedBuffer::resize(const std::size_t size)
+{
+  if (size > this->maximumLength)
+  {
+    throw std::length_error("Cannot resize buffer to " + std::to_string(size)
+                            + " byte(s), capacity is " + std::to_string(this->maximumLength));
+  }
+
+  this->length = size;
+}
+
+void AlignedBuffer::release()
+{
+  if (this->buffer == nullptr)
+  {
+    return;
+  }
+
+  if (this->pool != nullptr)
+  {
+    this->pool->release(this->buffer);
+  }
+  else
+  {
+    this->resource->deallocate(this->buffer, this->maximumLength, this->alignment);
+  }
+
+  this->buffer = nullptr;
+}
+
+BufferPool::BufferPool(const std::size_t capacity,
+                       const std::size_t alignment,
+                       std::pmr::memory_resource *resource)
+  : capacity(capacity)
+  , alignment(alignment)
+  , resource(resource)
+{}
+
+BufferPool::~BufferPool()
+{
+  for (const auto buffer : this->buffers)
+  {
+    this->resource->deallocate(buffer, this->capacity, this->alignment);
+  }
+}
+
+auto BufferPool::acquire() -> AlignedBuffer
+{
+  AlignedBuffer out;
+  {
+    // The resource is only used under the lock: arenas are not thread safe.
+    const std::lock_guard lock(this->mutex);
+    if (this->buffers.empty())
+    {
+      out.buffer = static_cast<char *>(this->resource->allocate(this->capacity, this->alignment));
+    }
+    else
+    {
+      out.buffer = this->buffers.back();
+      this->buffers.pop_back();
+    }
+  }
+
+  out.maximumLength = this->capacity;
+  out.alignment     = this->alignment;
+  out.resource      = this->resource;
+  out.pool          = this;
+  return out;
+}
+
+void BufferPool::release(char *buffer)
+{
+  const std::lock_guard lock(this->mutex);
+  this->buffers.push_back(buffer);
+}
+
+} // namespace storage
@@ -0,0 +1,81 @@
+
+#pragma once
+
+#include <cstddef>
+#include <memory_resource>
+#include <mutex>
+#include <vector>
+
+namespace storage {
+
+class BufferPool;
+
+// Fixed capacity buffer aligned for direct I/O, allocated from `resource`.
+// Buffers acquired from a pool are given back to it when destroyed.
+class AlignedBuffer
+{
+  public:
+  AlignedBuffer() = default;
+  AlignedBuffer(const std::size_t capacity,
+                const std::size_t alignment,
+                std::pmr::memory_resource *resource = std::pmr::get_default_resource());
+  ~AlignedBuffer();
+
+  AlignedBuffer(AlignedBuffer &&other) noexcept;
+  AlignedBuffer &operator=(AlignedBuffer &&other) noexcept;
+
+  AlignedBuffer(const AlignedBuffer &) = delete;
+  AlignedBuffer &operator=(const AlignedBuffer &) = delete;
+
+  auto data() -> char *;
+  auto data() const -> const char *;
+  auto size() const -> std::size_t;
+  auto capacity() const -> std::size_t;
+
+  // Only changes the size: the content is kept and never initialized.
+  void resize(const std::size_t size);
+
+  private:
+  friend class BufferPool;
+
+  char *buffer{nullptr};
+  std::size_t length{};
+  std::size_t maximumLength{};
+  std::size_t alignment{};
+  std::pmr::memory_resource *resource{nullptr};
+  BufferPool *pool{nullptr};
+
+  void release();
+};
+
+// Recycles buffers of a single capacity, allocating new ones from `resource`
+// (e.g. an arena). Can be used from several threads, and must outlive the
+// buffers it hands out.
+class BufferPool
+{
+  public:
+  BufferPool(const std::size_t capacity,
+             const std::size_t alignment,
+             std::pmr::memory_resource *resource = std::pmr::get_default_resource());
+  ~BufferPool();
+
+  BufferPool(const BufferPool &) = delete;
+  BufferPool &operator=(const BufferPool &) = delete;
+
+  // Returns an empty buffer.
+  auto acquire() -> AlignedBuffer;
+
+  private:
+  friend class AlignedBuffer;
+
+  std::size_t capacity;
+  std::size_t alignment;
+  std::pmr::memory_resource *resource;
+
+  std::mutex mutex{};
+  std::vector<char *> buffers{};
+
+  void release(char *buffer);
+};
+
+} // namespace storage
@@ -0,0 +1,544 @@
+
+#include "AsyncIo.hh"
+
+#include <atomic>
+#include <cerrno>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <iostream>
+#include <linux/io_uring.h>
+#include <mutex>
+#include <stdexcept>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <thread>
+#include <unistd.h>
+#include <unordered_map>
+#include <vector>
+
+namespace storage {
+
+constexpr std::size_t DEFAULT_THREADS_COUNT = 16;
+
+enum class OperationType
+{
+  READ,
+  WRITE,
+  SYNC
+};
+
+struct AsyncIo::Operation
+{
+  OperationType type{};
+  int fd{-1};
+  iovec buffer{};
+  off_t offset{};
+  Completion done{};
+};
+
+class AsyncIo::Executor
+{
+  public:
+  virtual ~Executor() = default;
+
+  virtual void submit(Operation &&operation) = 0;
+  virtual auto pending() const -> std::size_t = 0;
+
+  // Returns the finished operations with their results.
+  virtual auto reap(const bool wait) -> std::vector<std::pair<Operation, std::int64_t>> = 0;
+};
+
+namespace {
+auto systemError(const std::string &message) -> std::runtime_error
+{
+  return std::runtime_error(message + ": " + std::strerror(errno));
+}
+
+// The ring is driven with the raw system calls, liburing is not needed.
+auto setupRing(const unsigned entries, io_uring_params &params) -> int
+{
+  return static_cast<int>(::syscall(__NR_io_uring_setup, entries, &params));
+}
+
+auto enterRing(const int fd, const unsigned toSubmit, const unsigned minComplete) -> int
+{
+  const unsigned flags = (minComplete > 0u ? IORING_ENTER_GETEVENTS : 0u);
+  return static_cast<int>(
+    ::syscall(__NR_io_uring_enter, fd, toSubmit, minComplete, flags, nullptr, 0));
+}
+
+auto registerEventFd(const int fd, int eventFd) -> int
+{
+  return static_cast<int>(
+    ::syscall(__NR_io_uring_register, fd, IORING_REGISTER_EVENTFD, &eventFd, 1));
+}
+
+auto loadAcquire(unsigned *value) -> unsigned
+{
+  return std::atomic_ref<unsigned>(*value).load(std::memory_order_acquire);
+}
+
+void storeRelease(unsigned *value, const unsigned newValue)
+{
+  std::atomic_ref<unsigned>(*value).store(newValue, std::memory_order_release);
+}
+
+auto execute(const OperationType type, const int fd, const iovec &buffer, const off_t offset)
+  -> std::int64_t
+{
+  while (true)
+  {
+    ssize_t result = 0;
+    switch (type)
+    {
+    case OperationType::READ:
+      result = ::pread(fd, buffer.iov_base, buffer.iov_len, offset);
+      break;
+    case OperationType::WRITE:
+      result = ::pwrite(fd, buffer.iov_base, buffer.iov_len, offset);
+      break;
+    case OperationType::SYNC:
+      result = ::fdatasync(fd);
+      break;
+    }
+
+    if (result >= 0)
+    {
+      return result;
+    }
+    if (errno != EINTR)
+    {
+      return -errno;
+    }
+  }
+}
+
+// Shared mapping of the queues of a ring.
+class RingMapping
+{
+  public:
+  RingMapping(const int fd, const std::size_t size, const off_t offset)
+    : data(::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, offset))
+    , size(size)
+  {
+    if (this->data == MAP_FAILED)
+    {
+      throw systemError("Failed to map the io_uring queues");
+    }
+  }
+
+  ~RingMapping()
+  {
+    ::munmap(this->data, this->size);
+  }
+
+  RingMapping(const RingMapping &) = delete;
+  RingMapping &operator=(const RingMapping &) = delete;
+
+  auto get() const -> char *
+  {
+    return static_cast<char *>(this->data);
+  }
+
+  private:
+  void *data;
+  std::size_t size;
+};
+
+void drainEventFd(const int fd)
+{
+  std::uint64_t value;
+  while (::read(fd, &value, sizeof(value)) > 0)
+  {}
+}
+} // namespace
+
+// Submission and completion queues shared with the kernel. Operations past
+// the size of the completion queue wait in `queued`.
+class AsyncIo::RingExecutor : public AsyncIo::Executor
+{
+  public:
+  RingExecutor(const std::size_t entries, const int eventFd);
+  ~RingExecutor() override;
+
+  void submit(Operation &&operation) override;
+  auto pending() const -> std::size_t override;
+  auto reap(const bool wait) -> std::vector<std::pair<Operation, std::int64_t>> override;
+
+  private:
+  FileDescriptor ring{};
+  std::unique_ptr<RingMapping> rings{};
+  std::unique_ptr<RingMapping> submissionEntries{};
+
+  unsigned *submissionTail{};
+  unsigned submissionMask{};
+  unsigned *submissionArray{};
+  unsigned *completionHead{};
+  unsigned *completionTail{};
+  unsigned completionMask{};
+  io_uring_cqe *completions{};
+  unsigned maxInFlight{};
+
+  std::unordered_map<std::uint64_t, Operation> operations{};
+  std::deque<std::uint64_t> queued{};
+  std::uint64_t nextId{};
+  std::size_t inFlight{};
+
+  void submitQueued();
+};
+
+AsyncIo::RingExecutor::RingExecutor(const std::size_t entries, const int eventFd)
+{
+  io_uring_params params{};
+  this->ring = FileDescriptor(setupRing(static_cast<unsigned>(entries), params));
+  if (!this->ring.valid())
+  {
+    throw systemError("Failed to set up an io_uring instance");
+  }
+  if ((params.features & IORING_FEAT_SINGLE_MMAP) == 0u)
+  {
+    throw std::runtime_error("io_uring instances without a single mapping are not supported");
+  }
+
+  const auto submissionSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+  const auto completionSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+  this->rings               = std::make_unique<RingMapping>(
+    this->ring.get(), std::max<std::size_t>(submissionSize, completionSize), IORING_OFF_SQ_RING);
+  this->submissionEntries = std::make_unique<RingMapping>(
+    this->ring.get(), params.sq_entries * sizeof(io_uring_sqe), IORING_OFF_SQES);
+
+  const auto base        = this->rings->get();
+  this->submissionTail   = reinterpret_cast<unsigned *>(base + params.sq_off.tail);
+  this->submissionMask   = *reinterpret_cast<unsigned *>(base + params.sq_off.ring_mask);
+  this->submissionArray  = reinterpret_cast<unsigned *>(base + params.sq_off.array);
+  this->completionHead   = reinterpret_cast<unsigned *>(base + params.cq_off.head);
+  this->completionTail   = reinterpret_cast<unsigned *>(base + params.cq_off.tail);
+  this->completionMask   = *reinterpret_cast<unsigned *>(base + params.cq_off.ring_mask);
+  this->completions      = reinterpret_cast<io_uring_cqe *>(base + params.cq_off.cqes);
+  this->maxInFlight      = std::min(params.sq_entries, params.cq_entries);
+
+  if (registerEventFd(this->ring.get(), eventFd) != 0)
+  {
+    throw systemError("Failed to register an eventfd with io_uring");
+  }
+}
+
+AsyncIo::RingExecutor::~RingExecutor()
+{
+  // The buffers of the operations in flight are used until they complete.
+  this->queued.clear();
+  while (this->inFlight > 0u)
+  {
+    this->reap(true);
+  }
+}
+
+void AsyncIo::RingExecutor::submit(Operation &&operation)
+{
+  const auto id = this->nextId++;
+  this->operations.emplace(id, std::move(operation));
+  this->queued.push_back(id);
+  this->submitQueued();
+}
+
+auto AsyncIo::RingExecutor::pending() const -> std::size_t
+{
+  return this->operations.size();
+}
+
+void AsyncIo::RingExecutor::submitQueued()
+{
+  // Only this thread produces entries: the tail is only read by the kernel.
+  auto tail         = *this->submissionTail;
+  unsigned toSubmit = 0;
+  while (!this->queued.empty() && this->inFlight < this->maxInFlight)
+  {
+    const auto id         = this->queued.front();
+    auto &operation       = this->operations.at(id);
+    const auto index      = tail & this->submissionMask;
+    auto &entry = reinterpret_cast<io_uring_sqe *>(this->submissionEntries->get())[index];
+
+    std::memset(&entry, 0, sizeof(entry));
+    entry.fd        = operation.fd;
+    entry.user_data = id;
+    switch (operation.type)
+    {
+    case OperationType::READ:
+      entry.opcode = IORING_OP_READV;
+      break;
+    case OperationType::WRITE:
+      entry.opcode = IORING_OP_WRITEV;
+      break;
+    case OperationType::SYNC:
+      entry.opcode      = IORING_OP_FSYNC;
+      entry.fsync_flags = IORING_FSYNC_DATASYNC;
+      break;
+    }
+    if (operation.type != OperationType::SYNC)
+    {
+      entry.addr = reinterpret_cast<std::uint64_t>(&operation.buffer);
+      entry.len  = 1;
+      entry.off  = static_cast<std::uint64_t>(operation.offset);
+    }
+
+    this->submissionArray[index] = index;
+    ++tail;
+    ++toSubmit;
+    ++this->inFlight;
+    this->queued.pop_front();
+  }
+
+  if (toSubmit == 0u)
+  {
+    return;
+  }
+
+  storeRelease(this->submissionTail, tail);
+  while (toSubmit > 0u)
+  {
+    const auto submitted = enterRing(this->ring.get(), toSubmit, 0);
+    if (submitted < 0 && (errno == EINTR || errno == EAGAIN || errno == EBUSY))
+    {
+      continue;
+    }
+    if (submitted < 0)
+    {
+      throw systemError("Failed to submit to io_uring");
+    }
+    toSubmit -= static_cast<unsigned>(submitted);
+  }
+}
+
+auto AsyncIo::RingExecutor::reap(const bool wait)
+  -> std::vector<std::pair<Operation, std::int64_t>>
+{
+  std::vector<std::pair<Operation, std::int64_t>> finished;
+  while (true)
+  {
+    auto head       = *this->completionHead;
+    const auto tail = loadAcquire(this->completionTail);
+    for (; head != tail; ++head)
+    {
+      const auto &completion = this->completions[head & this->completionMask];
+      const auto operation   = this->operations.find(completion.user_data);
+      finished.emplace_back(std::move(operation->second), completion.res);
+      this->operations.erase(operation);
+      --this->inFlight;
+    }
+    storeRelease(this->completionHead, head);
+
+    if (!finished.empty() || !wait || this->inFlight == 0u)
+    {
+      break;
+    }
+    if (enterRing(this->ring.get(), 0, 1) < 0 && errno != EINTR)
+    {
+      throw systemError("Failed to wait for io_uring completions");
+    }
+  }
+
+  this->submitQueued();
+  return finished;
+}
+
+// Workers running the blocking system calls, their results being handed
+// back to the thread reaping them.
+class AsyncIo::ThreadExecutor : public AsyncIo::Executor
+{
+  public:
+  ThreadExecutor(const std::size_t threads, const int eventFd);
+  ~ThreadExecutor() override;
+
+  void submit(Operation &&operation) override;
+  auto pending() const -> std::size_t override;
+  auto reap(const bool wait) -> std::vector<std::pair<Operation, std::int64_t>> override;
+
+  private:
+  int eventFd{-1};
+  mutable std::mutex mutex{};
+  std::condition_variable submitted{};
+  std::condition_variable completed{};
+  std::deque<Operation> queued{};
+  std::vector<std::pair<Operation, std::int64_t>> finished{};
+  std::size_t pendingCount{};
+  bool stopping{false};
+  std::vector<std::thread> workers{};
+
+  void run();
+};
+
+AsyncIo::ThreadExecutor::ThreadExecutor(const std::size_t threads, const int eventFd)
+  : eventFd(eventFd)
+{
+  for (std::size_t id = 0; id < threads; ++id)
+  {
+    this->workers.emplace_back([this]() { this->run(); });
+  }
+}
+
+AsyncIo::ThreadExecutor::~ThreadExecutor()
+{
+  {
+    const std::lock_guard lock(this->mutex);
+    this->stopping = true;
+  }
+  this->submitted.notify_all();
+
+  for (auto &worker : this->workers)
+  {
+    worker.join();
+  }
+}
+
+void AsyncIo::ThreadExecutor::submit(Operation &&operation)
+{
+  {
+    const std::lock_guard lock(this->mutex);
+    this->queued.push_back(std::move(operation));
+    ++this->pendingCount;
+  }
+  this->submitted.notify_one();
+}
+
+auto AsyncIo::ThreadExecutor::pending() const -> std::size_t
+{
+  const std::lock_guard lock(this->mutex);
+  return this->pendingCount;
+}
+
+auto AsyncIo::ThreadExecutor::reap(const bool wait)
+  -> std::vector<std::pair<Operation, std::int64_t>>
+{
+  std::unique_lock lock(this->mutex);
+  if (wait)
+  {
+    this->completed.wait(lock,
+                         [this]() { return !this->finished.empty() || this->pendingCount == 0u; });
+  }
+
+  auto out = std::move(this->finished);
+  this->finished.clear();
+  this->pendingCount -= out.size();
+  return out;
+}
+
+void AsyncIo::ThreadExecutor::run()
+{
+  std::unique_lock lock(this->mutex);
+  while (true)
+  {
+    // Queued operations are still run when stopping, their buffers being
+    // owned by their callers.
+    this->submitted.wait(lock, [this]() { return this->stopping || !this->queued.empty(); });
+    if (this->queued.empty())
+    {
+      return;
+    }
+
+    auto operation = std::move(this->queued.front());
+    this->queued.pop_front();
+
+    lock.unlock();
+    const auto result = execute(operation.type, operation.fd, operation.buffer, operation.offset);
+    lock.lock();
+
+    this->finished.emplace_back(std::move(operation), result);
+    this->completed.notify_all();
+
+    const std::uint64_t value = 1;
+    [[maybe_unused]] const auto written = ::write(this->eventFd, &value, sizeof(value));
+  }
+}
+
+AsyncIo::AsyncIo(const std::size_t entries, const std::size_t threads, const bool useIoUring)
+  : notifications(::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC))
+{
+  if (!this->notifications.valid())
+  {
+    throw systemError("Failed to create an eventfd");
+  }
+
+  if (useIoUring)
+  {
+    try
+    {
+      this->executor = std::make_unique<RingExecutor>(entries, this->notifications.get());
+      return;
+    }
+    catch (const std::runtime_error &error)
+    {
+      std::cout << "[INFO] " << error.what() << ", running I/O on threads instead\n";
+    }
+  }
+
+  this->executor = std::make_unique<ThreadExecutor>(
+    threads == 0u ? DEFAULT_THREADS_COUNT : threads, this->notifications.get());
+}
+
+AsyncIo::~AsyncIo() = default;
+
+auto AsyncIo::backend() const -> Backend
+{
+  return (dynamic_cast<const RingExecutor *>(this->executor.get()) != nullptr ? Backend::IO_URING
+                                                                               : Backend::THREADS);
+}
+
+void AsyncIo::read(const int fd,
+                   char *data,
+                   const std::size_t size,
+                   const off_t offset,
+                   Completion done)
+{
+  this->executor->submit({.type   = OperationType::READ,
+                          .fd     = fd,
+                          .buffer = {data, size},
+                          .offset = offset,
+                          .done   = std::move(done)});
+}
+
+void AsyncIo::write(const int fd,
+                    const char *data,
+                    const std::size_t size,
+                    const off_t offset,
+                    Completion done)
+{
+  this->executor->submit({.type   = OperationType::WRITE,
+                          .fd     = fd,
+                          .buffer = {const_cast<char *>(data), size},
+                          .offset = offset,
+                          .done   = std::move(done)});
+}
+
+void AsyncIo::sync(const int fd, Completion done)
+{
+  this->executor->submit(
+    {.type = OperationType::SYNC, .fd = fd, .buffer = {}, .offset = 0, .done = std::move(done)});
+}
+
+auto AsyncIo::pending() const -> std::size_t
+{
+  return this->executor->pending();
+}
+
+auto AsyncIo::poll(const bool wait) -> std::size_t
+{
+  drainEventFd(this->notifications.get());
+
+  // Completions can submit new operations.
+  auto finished = this->executor->reap(wait);
+  for (auto &[operation, result] : finished)
+  {
+    operation.done(result);
+  }
+  return finished.size();
+}
+
+auto AsyncIo::eventFd() const -> int
+{
+  return this->notifications.get();
+}
+
+} // namespace storage
@@ -0,0 +1,72 @@
+
+#pragma once
+
+#include "FileDescriptor.hh"
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <sys/types.h>
+
+namespace storage {
+
+// Reads, writes and syncs completing on the thread calling `poll`. They are
+// submitted to io_uring when the kernel allows it and run by a pool of
+// threads otherwise, so one thread can keep many of them in flight.
+class AsyncIo
+{
+  public:
+  enum class Backend
+  {
+    IO_URING,
+    THREADS
+  };
+
+  // Called with the number of bytes transferred, or with -errno.
+  using Completion = std::function<void(const std::int64_t result)>;
+
+  // `entries` bounds the operations submitted to io_uring at once, the other
+  // ones waiting for a slot. `threads` workers (16 when 0) run them when
+  // io_uring is not available or not wanted.
+  explicit AsyncIo(const std::size_t entries = 256,
+                   const std::size_t threads = 0,
+                   const bool useIoUring = true);
+  ~AsyncIo();
+
+  AsyncIo(const AsyncIo &) = delete;
+  AsyncIo &operator=(const AsyncIo &) = delete;
+
+  auto backend() const -> Backend;
+
+  // Buffers must stay valid until the operation completes. Operations are
+  // independent: their order is only known from their completions.
+  void read(const int fd, char *data, const std::size_t size, const off_t offset, Completion done);
+  void write(const int fd,
+             const char *data,
+             const std::size_t size,
+             const off_t offset,
+             Completion done);
+  void sync(const int fd, Completion done);
+
+  // Operations submitted and not completed yet.
+  auto pending() const -> std::size_t;
+
+  // Submits the queued operations and calls the completions of the finished
+  // ones, waiting for at least one when `wait` is set and some are pending.
+  // Returns the number of completions called.
+  auto poll(const bool wait = false) -> std::size_t;
+
+  // Becomes readable when completions are ready, for event loops.
+  auto eventFd() const -> int;
+
+  private:
+  struct Operation;
+  class Executor;
+  class RingExecutor;
+  class ThreadExecutor;
+
+  FileDescriptor notifications{};
+  std::unique_ptr<Executor> executor;
+};
+
+} // namespace storage
@@ -0,0 +1,107 @@
+
+#pragma once
+
+#include <coroutine>
+#include <exception>
+#include <memory>
+#include <optional>
+#include <type_traits>
+#include <utility>
+#include <variant>
+
+namespace storage {
+
+// Result of an asynchronous operation, which starts when it is created. A
+// coroutine awaiting it is resumed from the completion of the operation,
+// other callers can check `done` and `get` the result.
+template <typename T>
+class Awaitable
+{
+  using Value = std::conditional_t<std::is_void_v<T>, std::monostate, T>;
+
+  public:
+  class State
+  {
+    public:
+    void set(Value value)
+    {
+      this->value = std::move(value);
+      this->resume();
+    }
+
+    void fail(std::exception_ptr error)
+    {
+      this->error = std::move(error);
+      this->resume();
+    }
+
+    auto done() const -> bool
+    {
+      return this->value || this->error;
+    }
+
+    private:
+    friend class Awaitable;
+
+    std::optional<Value> value{};
+    std::exception_ptr error{};
+    std::coroutine_handle<> waiter{};
+
+    void resume()
+    {
+      if (this->waiter)
+      {
+        std::exchange(this->waiter, {}).resume();
+      }
+    }
+  };
+
+  explicit Awaitable(std::shared_ptr<State> state)
+    : state(std::move(state))
+  {}
+
+  static auto ready(Value value) -> Awaitable
+  {
+    auto state = std::make_shared<State>();
+    state->set(std::move(value));
+    return Awaitable(std::move(state));
+  }
+
+  auto await_ready() const noexcept -> bool
+  {
+    return this->state->done();
+  }
+
+  void await_suspend(const std::coroutine_handle<> handle)
+  {
+    this->state->waiter = handle;
+  }
+
+  auto await_resume() -> T
+  {
+    return this->get();
+  }
+
+  auto done() const -> bool
+  {
+    return this->state->done();
+  }
+
+  // Rethrows the error of a failed operation.
+  auto get() -> T
+  {
+    if (this->state->error)
+    {
+      std::rethrow_exception(this->state->error);
+    }
+    if constexpr (!std::is_void_v<T>)
+    {
+      return std::move(*this->state->value);
+    }
+  }
+
+  private:
+  std::shared_ptr<State> state;
+};
+
+} // namespace storage
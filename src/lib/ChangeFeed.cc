@@ -0,0 +1,145 @@
+
+#include "ChangeFeed.hh"
+#include "Checksum.hh"
+
+#include <cstring>
+#include <fcntl.h>
+
+namespace storage::v2 {
+
+constexpr std::size_t READ_SIZE       = 64u << 10;
+constexpr std::size_t MAX_CHANGE_SIZE = 64u << 20;
+
+namespace {
+struct ChangeHeader
+{
+  std::uint32_t checksum;
+  std::uint32_t size;
+  std::uint64_t sequence;
+  std::uint64_t index;
+  std::uint64_t length;
+  std::uint8_t type;
+  std::uint8_t padding[7];
+};
+
+static_assert(sizeof(ChangeHeader) == 40);
+
+auto computeChecksum(const ChangeHeader &header, const std::string_view value) -> std::uint32_t
+{
+  const auto raw = reinterpret_cast<const char *>(&header);
+  const std::string_view fields(raw + sizeof(header.checksum),
+                                sizeof(header) - sizeof(header.checksum));
+  return crc32(value, crc32(fields));
+}
+} // namespace
+
+void encodeChange(std::string &out, const Change &change)
+{
+  encodeChange(out, change.sequence, change.type, change.index, change.length, change.value);
+}
+
+void encodeChange(std::string &out,
+                  const std::uint64_t sequence,
+                  const ChangeType &type,
+                  const std::size_t index,
+                  const std::size_t length,
+                  const std::string_view value)
+{
+  ChangeHeader header{};
+  header.size     = static_cast<std::uint32_t>(value.size());
+  header.sequence = sequence;
+  header.index    = index;
+  header.length   = length;
+  header.type     = static_cast<std::uint8_t>(type);
+  header.checksum = computeChecksum(header, value);
+
+  out.append(reinterpret_cast<const char *>(&header), sizeof(header));
+  out.append(value);
+}
+
+ChangeFeed::ChangeFeed(const std::filesystem::path &path, const std::uint64_t fromSequence)
+  : path(path)
+  , fromSequence(fromSequence)
+{}
+
+auto ChangeFeed::next() -> std::optional<Change>
+{
+  while (true)
+  {
+    ChangeHeader header;
+    if (!this->fill(sizeof(header)))
+    {
+      return {};
+    }
+
+    std::memcpy(&header, this->buffer.data() + this->consumed, sizeof(header));
+    if (header.size > MAX_CHANGE_SIZE || !this->fill(sizeof(header) + header.size))
+    {
+      return {};
+    }
+
+    const std::string_view value(this->buffer.data() + this->consumed + sizeof(header),
+                                 header.size);
+
+    // A change being written is not complete yet: it will be read again.
+    if (computeChecksum(header, value) != header.checksum)
+    {
+      return {};
+    }
+
+    this->consumed += sizeof(header) + header.size;
+    this->position += sizeof(header) + header.size;
+
+    if (header.sequence < this->fromSequence)
+    {
+      continue;
+    }
+
+    return Change{
+      .sequence = header.sequence,
+      .type     = static_cast<ChangeType>(header.type),
+      .index    = header.index,
+      .length   = header.length,
+      .value    = std::string(value),
+    };
+  }
+}
+
+auto ChangeFeed::offset() const -> std::uint64_t
+{
+  return this->position;
+}
+
+auto ChangeFeed::fill(const std::size_t size) -> bool
+{
+  if (this->buffer.size() - this->consumed >= size)
+  {
+    return true;
+  }
+
+  if (!this->file.valid())
+  {
+    if (!std::filesystem::exists(this->path))
+    {
+      return false;
+    }
+    this->file = FileDescriptor(this->path, O_RDONLY);
+  }
+
+  this->buffer.erase(0, this->consumed);
+  this->consumed = 0;
+
+  const auto available = this->buffer.size();
+  const auto toRead    = std::max(size - available, READ_SIZE);
+  this->buffer.resize(available + toRead);
+
+  const auto read = readAt(this->file.get(),
+                           this->buffer.data() + available,
+                           toRead,
+                           static_cast<off_t>(this->position + available));
+  this->buffer.resize(available + read);
+
+  return this->buffer.size() >= size;
+}
+
+} // namespace storage::v2
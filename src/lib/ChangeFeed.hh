@@ -0,0 +1,70 @@
+
+#pragma once
+
+#include "FileDescriptor.hh"
+
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <string>
+#include <string_view>
+
+namespace storage::v2 {
+
+constexpr auto CHANGES_FILE_NAME = "CHANGES.log";
+
+// A reset is logged when the vector is opened for writing without its feed:
+// the changes made then are missing, consumers must copy the vector again.
+enum class ChangeType : std::uint8_t
+{
+  APPEND = 1,
+  ERASE  = 2,
+  RESET  = 3
+};
+
+// One operation applied to a vector. `length` is the size of the vector
+// before the operation and `value` is only set for appends.
+struct Change
+{
+  std::uint64_t sequence{};
+  ChangeType type{};
+  std::size_t index{};
+  std::size_t length{};
+  std::string value{};
+};
+
+void encodeChange(std::string &out, const Change &change);
+void encodeChange(std::string &out,
+                  const std::uint64_t sequence,
+                  const ChangeType &type,
+                  const std::size_t index,
+                  const std::size_t length,
+                  const std::string_view value);
+
+// Iterates over the changes of a vector log, starting from the first change
+// with a sequence number not less than `fromSequence`. Reaching the end of
+// the log is not final: `next` returns new changes as soon as they are
+// appended.
+class ChangeFeed
+{
+  public:
+  ChangeFeed(const std::filesystem::path &path, const std::uint64_t fromSequence);
+
+  auto next() -> std::optional<Change>;
+
+  // Position in the log right after the last change returned by `next`.
+  auto offset() const -> std::uint64_t;
+
+  private:
+  std::filesystem::path path{};
+  FileDescriptor file{};
+  std::uint64_t fromSequence{};
+
+  std::uint64_t position{};
+  std::string buffer{};
+  std::size_t consumed{};
+
+  auto fill(const std::size_t size) -> bool;
+};
+
+} // namespace storage::v2
@@ -0,0 +1,81 @@
+
+#include "Checksum.hh"
+
+#include <array>
+#include <cstring>
+
+namespace storage {
+
+namespace {
+constexpr std::uint32_t CRC32_POLYNOMIAL  = 0xEDB88320u;
+constexpr std::uint64_t MURMUR_MULTIPLIER = 0xC6A4A7935BD1E995ull;
+constexpr int MURMUR_SHIFT                = 47;
+
+constexpr auto generateCrc32Table() -> std::array<std::uint32_t, 256>
+{
+  std::array<std::uint32_t, 256> table{};
+
+  for (std::uint32_t id = 0; id < table.size(); ++id)
+  {
+    auto crc = id;
+    for (int bit = 0; bit < 8; ++bit)
+    {
+      crc = (crc & 1u ? (crc >> 1) ^ CRC32_POLYNOMIAL : crc >> 1);
+    }
+    table[id] = crc;
+  }
+
+  return table;
+}
+
+constexpr auto CRC32_TABLE = generateCrc32Table();
+} // namespace
+
+auto crc32(const std::string_view data, const std::uint32_t seed) -> std::uint32_t
+{
+  auto crc = ~seed;
+  for (const auto c : data)
+  {
+    crc = CRC32_TABLE[(crc ^ static_cast<std::uint8_t>(c)) & 0xFFu] ^ (crc >> 8);
+  }
+
+  return ~crc;
+}
+
+auto hash64(const std::string_view data, const std::uint64_t seed) -> std::uint64_t
+{
+  auto hash = seed ^ (data.size() * MURMUR_MULTIPLIER);
+
+  const auto blocksCount = data.size() / sizeof(std::uint64_t);
+  for (std::size_t id = 0; id < blocksCount; ++id)
+  {
+    std::uint64_t block;
+    std::memcpy(&block, data.data() + id * sizeof(block), sizeof(block));
+
+    block *= MURMUR_MULTIPLIER;
+    block ^= block >> MURMUR_SHIFT;
+    block *= MURMUR_MULTIPLIER;
+
+    hash ^= block;
+    hash *= MURMUR_MULTIPLIER;
+  }
+
+  const auto tail = data.substr(blocksCount * sizeof(std::uint64_t));
+  if (!tail.empty())
+  {
+    for (std::size_t id = tail.size(); id > 0u; --id)
+    {
+      const auto byte = static_cast<std::uint64_t>(static_cast<std::uint8_t>(tail[id - 1]));
+      hash ^= byte << (8u * (id - 1));
+    }
+    hash *= MURMUR_MULTIPLIER;
+  }
+
+  hash ^= hash >> MURMUR_SHIFT;
+  hash *= MURMUR_MULTIPLIER;
+  hash ^= hash >> MURMUR_SHIFT;
+
+  return hash;
+}
+
+} // namespace storage
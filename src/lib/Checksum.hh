@@ -0,0 +1,16 @@
+
+#pragma once
+
+#include <cstdint>
+#include <string_view>
+
+namespace storage {
+
+// CRC-32 (IEEE) of `data`, `seed` allows to chain calls over several buffers.
+auto crc32(const std::string_view data, const std::uint32_t seed = 0u) -> std::uint32_t;
+
+// Fast 64 bits hash of `data` (MurmurHash64A), stable across runs and
+// platforms of the same endianness: it can be persisted.
+auto hash64(const std::string_view data, const std::uint64_t seed = 0u) -> std::uint64_t;
+
+} // namespace storage
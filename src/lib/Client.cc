@@ -0,0 +1,172 @@
+
+#include "Client.hh"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <poll.h>
+#include <stdexcept>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace storage {
+
+constexpr std::size_t RECEIVE_SIZE = 64u << 10u;
+
+namespace {
+auto encodeIndices(const std::size_t first, const std::size_t last) -> std::string
+{
+  std::string out;
+  appendInteger(out, first);
+  appendInteger(out, last);
+  return out;
+}
+
+auto decodeInteger(std::string_view payload) -> std::size_t
+{
+  const auto value = readInteger(payload);
+  if (!value)
+  {
+    throw std::runtime_error("Invalid response from the server");
+  }
+  return *value;
+}
+} // namespace
+
+Client::Client(const std::filesystem::path &socketPath)
+  : socket(::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0))
+{
+  sockaddr_un address{};
+  address.sun_family = AF_UNIX;
+  if (socketPath.native().size() >= sizeof(address.sun_path))
+  {
+    throw std::invalid_argument("Socket path " + socketPath.string() + " is too long");
+  }
+  std::strcpy(address.sun_path, socketPath.c_str());
+
+  if (!this->socket.valid()
+      || ::connect(this->socket.get(), reinterpret_cast<const sockaddr *>(&address),
+                   sizeof(address))
+           != 0)
+  {
+    throw std::runtime_error("Failed to connect to " + socketPath.string() + ": "
+                             + std::strerror(errno));
+  }
+}
+
+auto Client::push_back(const std::string_view value) -> std::size_t
+{
+  this->send(Opcode::PUSH_BACK, value);
+  return decodeInteger(this->receive());
+}
+
+auto Client::at(const std::size_t index) -> std::string
+{
+  std::string payload;
+  appendInteger(payload, index);
+  this->send(Opcode::AT, payload);
+  return this->receive();
+}
+
+void Client::erase(const std::size_t index)
+{
+  std::string payload;
+  appendInteger(payload, index);
+  this->send(Opcode::ERASE, payload);
+  this->receive();
+}
+
+auto Client::size() -> std::size_t
+{
+  this->send(Opcode::SIZE);
+  return decodeInteger(this->receive());
+}
+
+auto Client::scan(const std::size_t first, const std::size_t last) -> std::vector<std::string>
+{
+  this->send(Opcode::SCAN, encodeIndices(first, last));
+  const auto response = this->receive();
+
+  std::vector<std::string> values;
+  std::string_view payload(response);
+  while (!payload.empty())
+  {
+    const auto size = readInteger(payload);
+    if (!size || *size > payload.size())
+    {
+      throw std::runtime_error("Invalid response from the server");
+    }
+
+    values.emplace_back(payload.substr(0, *size));
+    payload.remove_prefix(*size);
+  }
+  return values;
+}
+
+void Client::send(const Opcode opcode, const std::string_view payload)
+{
+  appendFrame(this->pending, static_cast<std::uint8_t>(opcode), payload);
+}
+
+auto Client::receive() -> std::string
+{
+  std::optional<Frame> response;
+  while (!(response = parseFrame(this->input)))
+  {
+    // Requests are sent while responses are read: the server stops reading
+    // from clients which do not read their responses.
+    pollfd events{.fd = this->socket.get(), .events = POLLIN, .revents = 0};
+    if (!this->pending.empty())
+    {
+      events.events |= POLLOUT;
+    }
+    if (::poll(&events, 1, -1) < 0)
+    {
+      if (errno == EINTR)
+      {
+        continue;
+      }
+      throw std::runtime_error(std::string("Failed to wait for the server: ")
+                               + std::strerror(errno));
+    }
+
+    if ((events.revents & POLLOUT) != 0)
+    {
+      const auto sent = ::send(this->socket.get(), this->pending.data(), this->pending.size(),
+                               MSG_DONTWAIT | MSG_NOSIGNAL);
+      if (sent < 0 && errno != EINTR && errno != EAGAIN && errno != EWOULDBLOCK)
+      {
+        throw std::runtime_error("Connection to the server lost");
+      }
+      this->pending.erase(0, static_cast<std::size_t>(std::max<ssize_t>(sent, 0)));
+    }
+
+    if ((events.revents & (POLLIN | POLLHUP | POLLERR)) != 0)
+    {
+      char buffer[RECEIVE_SIZE];
+      const auto received = ::recv(this->socket.get(), buffer, sizeof(buffer), MSG_DONTWAIT);
+      if (received < 0 && (errno == EINTR || errno == EAGAIN || errno == EWOULDBLOCK))
+      {
+        continue;
+      }
+      if (received <= 0)
+      {
+        throw std::runtime_error("Connection to the server lost");
+      }
+      this->input.append(buffer, static_cast<std::size_t>(received));
+    }
+  }
+
+  std::string payload(response->payload);
+  const auto status = static_cast<Status>(response->type);
+  this->input.erase(0, response->size());
+
+  if (status != Status::OK)
+  {
+    throw std::runtime_error(payload);
+  }
+  return payload;
+}
+
+} // namespace storage
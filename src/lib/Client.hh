@@ -0,0 +1,41 @@
+
+#pragma once
+
+#include "FileDescriptor.hh"
+#include "Protocol.hh"
+
+#include <filesystem>
+#include <string>
+#include <vector>
+
+namespace storage {
+
+// Connection to a `Server`. Each operation waits for its response, requests
+// can also be pipelined by queuing them with `send` before reading their
+// responses in the same order with `receive`.
+class Client
+{
+  public:
+  explicit Client(const std::filesystem::path &socketPath);
+
+  // Returns the index of the new element.
+  auto push_back(const std::string_view value) -> std::size_t;
+  auto at(const std::size_t index) -> std::string;
+  void erase(const std::size_t index);
+  auto size() -> std::size_t;
+  auto scan(const std::size_t first, const std::size_t last) -> std::vector<std::string>;
+
+  // Queues a request, sent while waiting for responses with `receive`.
+  void send(const Opcode opcode, const std::string_view payload = {});
+
+  // Payload of the response to the oldest request without one, throwing
+  // with the message of the server when it failed.
+  auto receive() -> std::string;
+
+  private:
+  FileDescriptor socket{};
+  std::string pending{};
+  std::string input{};
+};
+
+} // namespace storage
@@ -0,0 +1,262 @@
+
+#include "Codec.hh"
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+
+namespace storage {
+
+constexpr auto LZ_CODEC_NAME          = "lz";
+constexpr std::size_t MIN_MATCH       = 4;
+constexpr std::size_t MAX_OFFSET      = 65535;
+constexpr std::size_t HASH_BITS       = 14;
+constexpr std::size_t LAST_LITERALS   = 8;
+constexpr std::size_t LENGTH_IN_TOKEN = 15;
+
+namespace {
+auto read32(const char *data) -> std::uint32_t
+{
+  std::uint32_t out;
+  std::memcpy(&out, data, sizeof(out));
+  return out;
+}
+
+auto read64(const char *data) -> std::uint64_t
+{
+  std::uint64_t out;
+  std::memcpy(&out, data, sizeof(out));
+  return out;
+}
+
+auto hashOf(const std::uint32_t sequence) -> std::size_t
+{
+  return (sequence * 2654435761u) >> (32 - HASH_BITS);
+}
+
+// Lengths which do not fit in the token continue with bytes of 255 and end
+// with a smaller byte.
+void writeLength(std::string &out, std::size_t length)
+{
+  while (length >= 255u)
+  {
+    out.push_back(static_cast<char>(255));
+    length -= 255u;
+  }
+  out.push_back(static_cast<char>(length));
+}
+
+auto readLength(const unsigned char *&in, const unsigned char *end) -> std::size_t
+{
+  std::size_t out = 0;
+  unsigned char byte;
+  do
+  {
+    if (in == end)
+    {
+      throw std::runtime_error("Corrupted compressed data: truncated length");
+    }
+    byte = *in++;
+    out += byte;
+  } while (byte == 255u);
+
+  return out;
+}
+
+// A sequence is a token holding both lengths, the literals and the match
+// offset. The last sequence only holds literals.
+void writeSequence(std::string &out,
+                   const char *literals,
+                   const std::size_t literalLength,
+                   const std::size_t offset,
+                   const std::size_t matchLength)
+{
+  const auto matchCode = matchLength - MIN_MATCH;
+  const auto token     = (std::min(literalLength, LENGTH_IN_TOKEN) << 4)
+                     | std::min(matchCode, LENGTH_IN_TOKEN);
+  out.push_back(static_cast<char>(token));
+  if (literalLength >= LENGTH_IN_TOKEN)
+  {
+    writeLength(out, literalLength - LENGTH_IN_TOKEN);
+  }
+  out.append(literals, literalLength);
+
+  out.push_back(static_cast<char>(offset & 0xffu));
+  out.push_back(static_cast<char>(offset >> 8));
+  if (matchCode >= LENGTH_IN_TOKEN)
+  {
+    writeLength(out, matchCode - LENGTH_IN_TOKEN);
+  }
+}
+
+void writeLastLiterals(std::string &out, const char *literals, const std::size_t literalLength)
+{
+  out.push_back(static_cast<char>(std::min(literalLength, LENGTH_IN_TOKEN) << 4));
+  if (literalLength >= LENGTH_IN_TOKEN)
+  {
+    writeLength(out, literalLength - LENGTH_IN_TOKEN);
+  }
+  out.append(literals, literalLength);
+}
+
+auto matchLength(const char *data,
+                 const std::size_t candidate,
+                 const std::size_t position,
+                 const std::size_t limit) -> std::size_t
+{
+  auto length = MIN_MATCH;
+  while (position + length + sizeof(std::uint64_t) <= limit)
+  {
+    const auto difference = read64(data + candidate + length) ^ read64(data + position + length);
+    if (difference != 0u)
+    {
+      return length + static_cast<std::size_t>(__builtin_ctzll(difference)) / 8u;
+    }
+    length += sizeof(std::uint64_t);
+  }
+
+  while (position + length < limit && data[candidate + length] == data[position + length])
+  {
+    ++length;
+  }
+
+  return length;
+}
+
+// Matches can overlap the output, e.g. runs of zeros: the pattern is then
+// copied with a distance doubling at each step.
+void copyMatch(char *out, const std::size_t offset, std::size_t length)
+{
+  const char *match = out - offset;
+  if (offset >= length)
+  {
+    std::memcpy(out, match, length);
+    return;
+  }
+
+  while (length > 0u)
+  {
+    const auto chunk = std::min(length, static_cast<std::size_t>(out - match));
+    std::memcpy(out, match, chunk);
+    out += chunk;
+    length -= chunk;
+  }
+}
+
+const LzCodec LZ_CODEC;
+} // namespace
+
+auto LzCodec::name() const -> std::string_view
+{
+  return LZ_CODEC_NAME;
+}
+
+void LzCodec::compress(const std::string_view input, std::string &out) const
+{
+  const auto data = input.data();
+  const auto size = input.size();
+  out.reserve(out.size() + size / 4u);
+
+  // Positions of the last sequences of 4 bytes seen with each hash.
+  std::array<std::uint32_t, 1u << HASH_BITS> positions{};
+
+  // Position 0 is where all the hashes point to at first.
+  const auto limit     = (size > LAST_LITERALS ? size - LAST_LITERALS : 0u);
+  std::size_t anchor   = 0;
+  std::size_t position = 1;
+  std::size_t misses   = 0;
+  while (position + MIN_MATCH <= limit)
+  {
+    const auto sequence  = read32(data + position);
+    auto &slot           = positions[hashOf(sequence)];
+    const auto candidate = static_cast<std::size_t>(slot);
+    slot                 = static_cast<std::uint32_t>(position);
+
+    if (position - candidate > MAX_OFFSET || read32(data + candidate) != sequence)
+    {
+      // Incompressible data is skipped faster and faster.
+      position += 1u + (misses++ >> 6);
+      continue;
+    }
+
+    const auto length = matchLength(data, candidate, position, limit);
+    writeSequence(out, data + anchor, position - anchor, position - candidate, length);
+
+    position += length;
+    anchor = position;
+    misses = 0;
+  }
+
+  writeLastLiterals(out, data + anchor, size - anchor);
+}
+
+void LzCodec::decompress(const std::string_view input, char *out, const std::size_t size) const
+{
+  auto in        = reinterpret_cast<const unsigned char *>(input.data());
+  const auto end = in + input.size();
+
+  std::size_t written = 0;
+  while (in < end)
+  {
+    const auto token = *in++;
+
+    auto literalLength = static_cast<std::size_t>(token >> 4);
+    if (literalLength == LENGTH_IN_TOKEN)
+    {
+      literalLength += readLength(in, end);
+    }
+    if (literalLength > static_cast<std::size_t>(end - in) || literalLength > size - written)
+    {
+      throw std::runtime_error("Corrupted compressed data: literals out of bounds");
+    }
+
+    std::memcpy(out + written, in, literalLength);
+    written += literalLength;
+    in += literalLength;
+
+    if (in == end)
+    {
+      break;
+    }
+
+    if (end - in < 2)
+    {
+      throw std::runtime_error("Corrupted compressed data: truncated offset");
+    }
+    const auto offset = static_cast<std::size_t>(in[0] | in[1] << 8);
+    in += 2;
+
+    auto length = static_cast<std::size_t>(token & 0xfu) + MIN_MATCH;
+    if ((token & 0xfu) == LENGTH_IN_TOKEN)
+    {
+      length += readLength(in, end);
+    }
+    if (offset == 0u || offset > written || length > size - written)
+    {
+      throw std::runtime_error("Corrupted compressed data: match out of bounds");
+    }
+
+    copyMatch(out + written, offset, length);
+    written += length;
+  }
+
+  if (written != size)
+  {
+    throw std::runtime_error("Corrupted compressed data: " + std::to_string(written)
+                             + " byte(s) decoded instead of " + std::to_string(size));
+  }
+}
+
+auto findBuiltinCodec(const std::string_view name) -> const Codec *
+{
+  if (name == LZ_CODEC.name())
+  {
+    return &LZ_CODEC;
+  }
+
+  return nullptr;
+}
+
+} // namespace storage
@@ -0,0 +1,43 @@
+
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+namespace storage {
+
+// Compression of whole data blocks. Implementations are called concurrently
+// and must not keep any state between calls.
+class Codec
+{
+  public:
+  virtual ~Codec() = default;
+
+  // Identifies the codec in the compressed data, at most 8 characters.
+  virtual auto name() const -> std::string_view = 0;
+
+  // Appends the compressed `input` to `out`.
+  virtual void compress(const std::string_view input, std::string &out) const = 0;
+
+  // Decompresses `input` to `out`, `size` being the size of the original
+  // data. Throws std::runtime_error when `input` is corrupted.
+  virtual void decompress(const std::string_view input, char *out, const std::size_t size) const
+    = 0;
+};
+
+// Built-in LZ77 codec in the spirit of LZ4: literals and matches of at least
+// 4 bytes at most 64 KiB back are encoded in sequences, without any entropy
+// coding. Favors speed, especially when decoding, over the ratio.
+class LzCodec : public Codec
+{
+  public:
+  auto name() const -> std::string_view override;
+  void compress(const std::string_view input, std::string &out) const override;
+  void decompress(const std::string_view input, char *out, const std::size_t size) const override;
+};
+
+// The codecs available without being provided, by name.
+auto findBuiltinCodec(const std::string_view name) -> const Codec *;
+
+} // namespace storage
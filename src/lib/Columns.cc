@@ -0,0 +1,60 @@
+
+#include "Columns.hh"
+
+#include <stdexcept>
+#include <string>
+
+namespace storage::v2 {
+
+Columns::Columns(const std::filesystem::path &offsetsPath, const std::filesystem::path &dataPath)
+  : offsetsFile(offsetsPath)
+  , dataFile(dataPath)
+{
+  const auto offsets = reinterpret_cast<const std::uint64_t *>(this->offsetsFile.data());
+  const auto entries = this->offsetsFile.size() / sizeof(std::uint64_t);
+  if (entries == 0u || offsets[0] != 0u)
+  {
+    throw std::runtime_error("Invalid column offsets in " + offsetsPath.string());
+  }
+
+  // Entries written after the data was mapped are ignored.
+  this->length = entries - 1;
+  while (this->length > 0u && offsets[this->length] > this->dataFile.size())
+  {
+    --this->length;
+  }
+}
+
+Columns::Columns(const std::filesystem::path &directory)
+  : Columns(directory / COLUMN_OFFSETS_FILE_NAME, directory / COLUMN_DATA_FILE_NAME)
+{}
+
+auto Columns::size() const -> std::size_t
+{
+  return this->length;
+}
+
+auto Columns::at(const std::size_t index) const -> std::string_view
+{
+  if (index >= this->length)
+  {
+    throw std::out_of_range("Requested column " + std::to_string(index) + " but only "
+                            + std::to_string(this->length) + " available");
+  }
+
+  const auto offsets = this->offsets();
+  return this->data().substr(offsets[index], offsets[index + 1] - offsets[index]);
+}
+
+auto Columns::offsets() const -> std::span<const std::uint64_t>
+{
+  return {reinterpret_cast<const std::uint64_t *>(this->offsetsFile.data()),
+          this->length + 1};
+}
+
+auto Columns::data() const -> std::string_view
+{
+  return this->dataFile.view();
+}
+
+} // namespace storage::v2
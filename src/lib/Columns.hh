@@ -0,0 +1,43 @@
+
+#pragma once
+
+#include "MappedFile.hh"
+
+#include <cstdint>
+#include <filesystem>
+#include <span>
+#include <string_view>
+
+namespace storage::v2 {
+
+// Files of the columnar sidecar maintained next to the header of a vector.
+constexpr auto COLUMN_OFFSETS_FILE_NAME = "COLUMNS.offsets";
+constexpr auto COLUMN_DATA_FILE_NAME    = "COLUMNS.data";
+
+// Elements laid out as two buffers, like Arrow binary arrays: `size() + 1`
+// native 64 bits offsets followed by the concatenated values, element `i`
+// being the bytes in `[offsets[i], offsets[i + 1])` of the data. Both files
+// are mapped as is, without any parsing.
+class Columns
+{
+  public:
+  Columns(const std::filesystem::path &offsetsPath, const std::filesystem::path &dataPath);
+
+  // The sidecar of the vector in `directory`. Erases truncate it: the
+  // mapping must not be used after the vector erased one of its elements.
+  explicit Columns(const std::filesystem::path &directory);
+
+  auto size() const -> std::size_t;
+  auto at(const std::size_t index) const -> std::string_view;
+
+  auto offsets() const -> std::span<const std::uint64_t>;
+  auto data() const -> std::string_view;
+
+  private:
+  // The offsets are mapped first: values are written before their offsets.
+  MappedFile offsetsFile;
+  MappedFile dataFile;
+  std::size_t length{};
+};
+
+} // namespace storage::v2
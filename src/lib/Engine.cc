@@ -0,0 +1,185 @@
+
+#include "Engine.hh"
+#include "Header.hh"
+#include "PersistentVector.hh"
+
+#include <fstream>
+#include <sstream>
+#include <string>
+
+namespace storage {
+
+constexpr auto HEADER_FILE_NAME = "HEADER.txt";
+constexpr auto INDEX_FILE_NAME  = "INDEX.txt";
+
+namespace {
+class V1Engine : public Engine
+{
+  public:
+  explicit V1Engine(const std::filesystem::path &directory);
+
+  auto backend() const -> Backend override;
+  auto size() const -> std::size_t override;
+  auto at(const std::size_t index) const -> std::string_view override;
+  void push_back(const std::string_view value) override;
+  void erase(const std::size_t index) override;
+
+  private:
+  v1::PersistentVector vector;
+};
+
+class V2Engine : public Engine
+{
+  public:
+  V2Engine(const std::filesystem::path &directory, const v2::Options &options);
+
+  auto backend() const -> Backend override;
+  auto size() const -> std::size_t override;
+  auto at(const std::size_t index) const -> std::string_view override;
+  void push_back(const std::string_view value) override;
+  void erase(const std::size_t index) override;
+
+  private:
+  v2::PersistentVector vector;
+};
+
+V1Engine::V1Engine(const std::filesystem::path &directory)
+  : vector(directory)
+{}
+
+auto V1Engine::backend() const -> Backend
+{
+  return Backend::V1;
+}
+
+auto V1Engine::size() const -> std::size_t
+{
+  return this->vector.size();
+}
+
+auto V1Engine::at(const std::size_t index) const -> std::string_view
+{
+  return this->vector.at(index);
+}
+
+void V1Engine::push_back(const std::string_view value)
+{
+  this->vector.push_back(std::string(value));
+}
+
+void V1Engine::erase(const std::size_t index)
+{
+  this->vector.erase(index);
+}
+
+V2Engine::V2Engine(const std::filesystem::path &directory, const v2::Options &options)
+  : vector(directory, options)
+{}
+
+auto V2Engine::backend() const -> Backend
+{
+  return Backend::V2;
+}
+
+auto V2Engine::size() const -> std::size_t
+{
+  return this->vector.size();
+}
+
+auto V2Engine::at(const std::size_t index) const -> std::string_view
+{
+  return this->vector.at(index);
+}
+
+void V2Engine::push_back(const std::string_view value)
+{
+  this->vector.push_back(value);
+}
+
+void V2Engine::erase(const std::size_t index)
+{
+  this->vector.erase(index);
+}
+
+// Entries of a v1 index are "id path" while v2 ones start with the first id
+// and the size of a data block, the path being quoted in both.
+auto detectBackendFromIndex(const std::filesystem::path &path) -> std::optional<Backend>
+{
+  std::ifstream indexFile(path);
+  std::string line;
+  if (!std::getline(indexFile, line))
+  {
+    return {};
+  }
+
+  std::istringstream entry(line);
+  std::size_t id;
+  if (!(entry >> id >> std::ws))
+  {
+    return {};
+  }
+  return (entry.peek() == '"' ? Backend::V1 : Backend::V2);
+}
+} // namespace
+
+auto backendName(const Backend &backend) -> std::string_view
+{
+  return (backend == Backend::V1 ? "v1" : "v2");
+}
+
+auto parseBackend(const std::string_view name) -> std::optional<Backend>
+{
+  if (name == "v1")
+  {
+    return Backend::V1;
+  }
+  if (name == "v2")
+  {
+    return Backend::V2;
+  }
+  return {};
+}
+
+auto detectBackend(const std::filesystem::path &directory) -> std::optional<Backend>
+{
+  std::ifstream formatFile(directory / FORMAT_FILE_NAME);
+  std::string name;
+  if (formatFile >> name)
+  {
+    const auto backend = parseBackend(name);
+    if (!backend)
+    {
+      throw std::runtime_error("Unknown format \"" + name + "\" for the vector at "
+                               + directory.string());
+    }
+    return backend;
+  }
+
+  if (!std::filesystem::exists(directory / HEADER_FILE_NAME))
+  {
+    return {};
+  }
+  return detectBackendFromIndex(directory / INDEX_FILE_NAME);
+}
+
+auto openEngine(const std::filesystem::path &directory, const EngineOptions &options)
+  -> std::unique_ptr<Engine>
+{
+  const auto detected = detectBackend(directory);
+  if (detected && options.backend && *detected != *options.backend)
+  {
+    throw std::invalid_argument("Vector at " + directory.string() + " uses the "
+                                + std::string(backendName(*detected))
+                                + " format and cannot be opened with "
+                                + std::string(backendName(*options.backend)));
+  }
+
+  const auto backend = detected.value_or(options.backend.value_or(Backend::V2));
+  if (backend == Backend::V1)
+  {
+    return std::make_unique<V1Engine>(directory);
+  }
+  return std::make_unique<V2Engine>(directory, options.v2);
+}
+
+} // namespace storage
@@ -0,0 +1,57 @@
+
+#pragma once
+
+#include "PersistentVectorBlock.hh"
+
+#include <filesystem>
+#include <memory>
+#include <optional>
+#include <string_view>
+
+namespace storage {
+
+enum class Backend
+{
+  V1,
+  V2
+};
+
+// Operations shared by the vector implementations, for callers selecting one
+// at runtime. Features of a single backend, e.g. imports, are only available
+// through its own class.
+class Engine
+{
+  public:
+  virtual ~Engine() = default;
+
+  virtual auto backend() const -> Backend = 0;
+  virtual auto size() const -> std::size_t = 0;
+  virtual auto at(const std::size_t index) const -> std::string_view = 0;
+  virtual void push_back(const std::string_view value) = 0;
+  virtual void erase(const std::size_t index) = 0;
+};
+
+struct EngineOptions
+{
+  // Backend to use, which must match the one of an existing vector. Existing
+  // vectors keep their backend and new ones use v2 when not set.
+  std::optional<Backend> backend{};
+
+  // Only used by the v2 backend.
+  v2::Options v2{};
+};
+
+// Backend of the vector in `directory`, from the FORMAT.txt tag written when
+// the vector is opened for writing or, for older vectors, from the entries of
+// their index. Nothing for a new or empty vector.
+auto detectBackend(const std::filesystem::path &directory) -> std::optional<Backend>;
+
+// Opens the vector in `directory` with the backend selected by `options` or
+// detected from the directory.
+auto openEngine(const std::filesystem::path &directory, const EngineOptions &options = {})
+  -> std::unique_ptr<Engine>;
+
+auto backendName(const Backend &backend) -> std::string_view;
+auto parseBackend(const std::string_view name) -> std::optional<Backend>;
+
+} // namespace storage
@@ -0,0 +1,137 @@
+
+#include "FileDescriptor.hh"
+
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <stdexcept>
+#include <unistd.h>
+
+namespace storage {
+
+FileDescriptor::FileDescriptor(const int fd)
+  : fd(fd)
+{}
+
+FileDescriptor::FileDescriptor(const std::filesystem::path &path, const int flags, const int mode)
+  : fd(::open(path.c_str(), flags | O_CLOEXEC, mode))
+{
+  if (this->fd < 0)
+  {
+    throw std::runtime_error("Failed to open " + path.string() + ": " + std::strerror(errno));
+  }
+}
+
+FileDescriptor::~FileDescriptor()
+{
+  this->close();
+}
+
+FileDescriptor::FileDescriptor(FileDescriptor &&other) noexcept
+  : fd(other.fd)
+{
+  other.fd = -1;
+}
+
+FileDescriptor &FileDescriptor::operator=(FileDescriptor &&other) noexcept
+{
+  if (this != &other)
+  {
+    this->close();
+    this->fd = other.fd;
+    other.fd = -1;
+  }
+
+  return *this;
+}
+
+auto FileDescriptor::get() const -> int
+{
+  return this->fd;
+}
+
+auto FileDescriptor::valid() const -> bool
+{
+  return this->fd >= 0;
+}
+
+void FileDescriptor::close()
+{
+  if (this->fd >= 0)
+  {
+    ::close(this->fd);
+    this->fd = -1;
+  }
+}
+
+auto readAt(const int fd, char *data, std::size_t size, off_t offset) -> std::size_t
+{
+  std::size_t total = 0;
+  while (size > 0u)
+  {
+    const auto read = ::pread(fd, data, size, offset);
+    if (read < 0 && errno == EINTR)
+    {
+      continue;
+    }
+    if (read < 0)
+    {
+      throw std::runtime_error("Failed to read from fd " + std::to_string(fd) + ": "
+                               + std::strerror(errno));
+    }
+    if (read == 0)
+    {
+      break;
+    }
+
+    data += read;
+    size -= static_cast<std::size_t>(read);
+    offset += read;
+    total += static_cast<std::size_t>(read);
+  }
+
+  return total;
+}
+
+void writeAll(const int fd, const char *data, std::size_t size)
+{
+  while (size > 0u)
+  {
+    const auto written = ::write(fd, data, size);
+    if (written < 0 && errno == EINTR)
+    {
+      continue;
+    }
+    if (written < 0)
+    {
+      throw std::runtime_error("Failed to write to fd " + std::to_string(fd) + ": "
+                               + std::strerror(errno));
+    }
+
+    data += written;
+    size -= static_cast<std::size_t>(written);
+  }
+}
+
+void writeAt(const int fd, const char *data, std::size_t size, off_t offset)
+{
+  while (size > 0u)
+  {
+    const auto written = ::pwrite(fd, data, size, offset);
+    if (written < 0 && errno == EINTR)
+    {
+      continue;
+    }
+    if (written < 0)
+    {
+      throw std::runtime_error("Failed to write to fd " + std::to_string(fd) + ": "
+                               + std::strerror(errno));
+    }
+
+    data += written;
+    size -= static_cast<std::size_t>(written);
+    offset += written;
+  }
+}
+
+} // namespace storage
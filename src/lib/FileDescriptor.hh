@@ -0,0 +1,38 @@
+
+#pragma once
+
+#include <filesystem>
+#include <sys/types.h>
+
+namespace storage {
+
+// Owning wrapper around a raw file descriptor.
+class FileDescriptor
+{
+  public:
+  FileDescriptor() = default;
+  explicit FileDescriptor(const int fd);
+  FileDescriptor(const std::filesystem::path &path, const int flags, const int mode = 0644);
+  ~FileDescriptor();
+
+  FileDescriptor(FileDescriptor &&other) noexcept;
+  FileDescriptor &operator=(FileDescriptor &&other) noexcept;
+
+  FileDescriptor(const FileDescriptor &) = delete;
+  FileDescriptor &operator=(const FileDescriptor &) = delete;
+
+  auto get() const -> int;
+  auto valid() const -> bool;
+  void close();
+
+  private:
+  int fd{-1};
+};
+
+// Reads up to `size` bytes at `offset`, stopping early at the end of file.
+auto readAt(const int fd, char *data, std::size_t size, off_t offset) -> std::size_t;
+
+void writeAll(const int fd, const char *data, std::size_t size);
+void writeAt(const int fd, const char *data, std::size_t size, off_t offset);
+
+} // namespace storage
@@ -0,0 +1,154 @@
+
+#include "Follower.hh"
+#include "WriteBatch.hh"
+
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <utility>
+
+namespace storage::v2 {
+
+constexpr auto PROGRESS_FILE_NAME = "FOLLOWER.txt";
+
+namespace {
+auto loadProgress(const std::filesystem::path &path) -> std::uint64_t
+{
+  std::uint64_t sequence = 0u;
+
+  std::ifstream in(path);
+  in >> sequence;
+
+  return sequence;
+}
+
+auto prepareReplicaDirectory(const std::filesystem::path &directory) -> std::filesystem::path
+{
+  std::filesystem::create_directories(directory);
+  return directory;
+}
+} // namespace
+
+Follower::Follower(const std::filesystem::path &leaderDirectory,
+                   const std::filesystem::path &replicaDirectory)
+  : progressFilePath(replicaDirectory / PROGRESS_FILE_NAME)
+  , appliedSequence(loadProgress(progressFilePath))
+  , vector(prepareReplicaDirectory(replicaDirectory))
+  , feed(leaderDirectory / CHANGES_FILE_NAME, appliedSequence + 1u)
+{
+  std::cout << "[INFO] Following " << leaderDirectory << " from sequence " << this->appliedSequence
+            << " into " << replicaDirectory << "\n";
+}
+
+auto Follower::poll(const std::size_t maxChanges) -> std::size_t
+{
+  std::size_t applied = 0;
+  std::vector<Change> changes;
+  while (applied < maxChanges)
+  {
+    // Batches only hold changes of the same type, which move the length of
+    // the replica in one direction: whether a batch was applied is then
+    // known from the length alone.
+    changes.clear();
+    while (applied + changes.size() < maxChanges)
+    {
+      auto change = (this->pending ? std::exchange(this->pending, {}) : this->feed.next());
+      if (!change)
+      {
+        break;
+      }
+      if (change->type == ChangeType::RESET)
+      {
+        throw std::runtime_error("Change feed of the leader was reset at sequence "
+                                 + std::to_string(change->sequence)
+                                 + ", the replica must be copied again");
+      }
+      if (!changes.empty() && change->type != changes.front().type)
+      {
+        this->pending = std::move(change);
+        break;
+      }
+      changes.push_back(std::move(*change));
+    }
+
+    if (changes.empty())
+    {
+      break;
+    }
+
+    this->apply(changes);
+    this->appliedSequence = changes.back().sequence;
+    applied += changes.size();
+    this->saveProgress();
+  }
+
+  return applied;
+}
+
+auto Follower::sequence() const -> std::uint64_t
+{
+  return this->appliedSequence;
+}
+
+auto Follower::replica() const -> const PersistentVector &
+{
+  return this->vector;
+}
+
+void Follower::apply(const std::vector<Change> &changes)
+{
+  const auto append       = (changes.front().type == ChangeType::APPEND);
+  const auto lengthBefore = changes.front().length;
+  const auto lengthAfter  = (append ? lengthBefore + changes.size()
+                                    : lengthBefore - changes.size());
+
+  // The first batch after a restart can have been applied before the
+  // progress was saved.
+  const auto firstBatch = std::exchange(this->restarted, false);
+  if (firstBatch && this->vector.size() == lengthAfter && lengthAfter != lengthBefore)
+  {
+    std::cout << "[INFO] Skipping changes up to " << changes.back().sequence
+              << ", already applied to the replica\n";
+    return;
+  }
+
+  WriteBatch batch;
+  auto length = this->vector.size();
+  for (const auto &change : changes)
+  {
+    if (change.length != length)
+    {
+      throw std::runtime_error("Change " + std::to_string(change.sequence) + " expects length "
+                               + std::to_string(change.length) + " but the replica has "
+                               + std::to_string(length) + ", it diverged from the leader");
+    }
+
+    if (append)
+    {
+      batch.push_back(change.value);
+      ++length;
+    }
+    else
+    {
+      batch.erase(change.index);
+      --length;
+    }
+  }
+
+  this->vector.write(batch);
+}
+
+void Follower::saveProgress() const
+{
+  auto temporaryPath = this->progressFilePath;
+  temporaryPath += ".tmp";
+
+  {
+    std::ofstream out(temporaryPath, std::ofstream::trunc);
+    out << this->appliedSequence << "\n";
+  }
+
+  std::filesystem::rename(temporaryPath, this->progressFilePath);
+}
+
+} // namespace storage::v2
@@ -0,0 +1,45 @@
+
+#pragma once
+
+#include "ChangeFeed.hh"
+#include "PersistentVectorBlock.hh"
+
+#include <filesystem>
+#include <optional>
+#include <vector>
+
+namespace storage::v2 {
+
+// Keeps a replica of a vector up to date by applying the change feed of the
+// leader in batches. The last applied sequence is persisted in the replica
+// directory, a batch replayed after a crash is detected from the length of
+// the replica and skipped. Changes which do not match the replica, e.g.
+// after a reset of the feed, throw.
+class Follower
+{
+  public:
+  Follower(const std::filesystem::path &leaderDirectory,
+           const std::filesystem::path &replicaDirectory);
+
+  // Applies at most `maxChanges` pending changes and returns how many were
+  // applied.
+  auto poll(const std::size_t maxChanges = 1024) -> std::size_t;
+
+  auto sequence() const -> std::uint64_t;
+  auto replica() const -> const PersistentVector &;
+
+  private:
+  std::filesystem::path progressFilePath{};
+  std::uint64_t appliedSequence{};
+  PersistentVector vector;
+  ChangeFeed feed;
+
+  // Read from the feed but left for the next batch.
+  std::optional<Change> pending{};
+  bool restarted{true};
+
+  void apply(const std::vector<Change> &changes);
+  void saveProgress() const;
+};
+
+} // namespace storage::v2
@@ -0,0 +1,271 @@
+
+#include "HashIndex.hh"
+#include "Checksum.hh"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <fcntl.h>
+#include <iostream>
+#include <stdexcept>
+
+namespace storage::v2 {
+
+constexpr auto TEMPORARY_FILE_EXTENSION     = ".tmp";
+constexpr std::size_t MIN_ERASED_TO_COMPACT = 1024;
+
+namespace {
+enum class Operation : std::uint32_t
+{
+  APPEND = 1,
+  ERASE  = 2
+};
+
+// An append holds the hash of the element, an erase the id of the element.
+struct Record
+{
+  std::uint64_t value;
+  Operation operation;
+  std::uint32_t checksum;
+};
+static_assert(sizeof(Record) == 16);
+
+auto computeChecksum(const Record &record) -> std::uint32_t
+{
+  return crc32({reinterpret_cast<const char *>(&record), offsetof(Record, checksum)});
+}
+
+void encodeRecord(std::string &out, const Operation &operation, const std::uint64_t value)
+{
+  Record record{.value = value, .operation = operation, .checksum = 0u};
+  record.checksum = computeChecksum(record);
+
+  out.append(reinterpret_cast<const char *>(&record), sizeof(record));
+}
+} // namespace
+
+HashIndex::HashIndex(const std::filesystem::path &path)
+  : path(path)
+{
+  this->load();
+  this->log = FileDescriptor(this->path, O_WRONLY | O_CREAT | O_APPEND);
+}
+
+auto HashIndex::size() const -> std::size_t
+{
+  return this->hashes.size() - this->erased.size();
+}
+
+void HashIndex::append(const std::uint64_t hash)
+{
+  this->logBuffer.clear();
+  encodeRecord(this->logBuffer, Operation::APPEND, hash);
+  writeAll(this->log.get(), this->logBuffer.data(), this->logBuffer.size());
+
+  this->add(hash);
+}
+
+void HashIndex::append(const std::vector<std::uint64_t> &hashes)
+{
+  this->logBuffer.clear();
+  for (const auto hash : hashes)
+  {
+    encodeRecord(this->logBuffer, Operation::APPEND, hash);
+  }
+  writeAll(this->log.get(), this->logBuffer.data(), this->logBuffer.size());
+
+  for (const auto hash : hashes)
+  {
+    this->add(hash);
+  }
+}
+
+void HashIndex::erase(const std::size_t position)
+{
+  if (position >= this->size())
+  {
+    throw std::out_of_range("Cannot erase position " + std::to_string(position)
+                            + " from index, only " + std::to_string(this->size()) + " indexed");
+  }
+
+  const auto id = this->idOf(position);
+
+  this->logBuffer.clear();
+  encodeRecord(this->logBuffer, Operation::ERASE, id);
+  writeAll(this->log.get(), this->logBuffer.data(), this->logBuffer.size());
+
+  this->remove(id);
+
+  if (this->erased.size() >= MIN_ERASED_TO_COMPACT && this->erased.size() > this->size())
+  {
+    this->compact();
+  }
+}
+
+auto HashIndex::positions(const std::uint64_t hash) const -> std::vector<std::size_t>
+{
+  std::vector<std::size_t> out;
+
+  const auto [first, last] = this->ids.equal_range(hash);
+  for (auto it = first; it != last; ++it)
+  {
+    out.push_back(this->positionOf(it->second));
+  }
+
+  std::sort(out.begin(), out.end());
+  return out;
+}
+
+void HashIndex::reset(const std::vector<std::uint64_t> &hashes)
+{
+  this->hashes.clear();
+  this->ids.clear();
+  this->erased.clear();
+  for (const auto hash : hashes)
+  {
+    this->add(hash);
+  }
+
+  this->compact();
+}
+
+void HashIndex::load()
+{
+  if (!std::filesystem::exists(this->path))
+  {
+    return;
+  }
+
+  const FileDescriptor in(this->path, O_RDONLY);
+  const auto size = std::filesystem::file_size(this->path);
+
+  std::string content(size, '\0');
+  const auto read = readAt(in.get(), content.data(), content.size(), 0);
+
+  // A record which was not completely written ends the log.
+  std::size_t offset = 0;
+  for (; offset + sizeof(Record) <= read; offset += sizeof(Record))
+  {
+    Record record;
+    std::memcpy(&record, content.data() + offset, sizeof(record));
+    if (record.checksum != computeChecksum(record))
+    {
+      break;
+    }
+
+    if (record.operation == Operation::APPEND)
+    {
+      this->add(record.value);
+    }
+    else if (record.operation == Operation::ERASE && record.value < this->hashes.size()
+             && !std::binary_search(this->erased.begin(), this->erased.end(), record.value))
+    {
+      this->remove(record.value);
+    }
+    else
+    {
+      break;
+    }
+  }
+
+  if (offset < size)
+  {
+    std::filesystem::resize_file(this->path, offset);
+  }
+
+  std::cout << "[INFO] Loaded hash index " << this->path << " with " << this->size()
+            << " element(s)\n";
+}
+
+void HashIndex::compact()
+{
+  // The live elements get new ids, matching their positions.
+  std::vector<std::uint64_t> liveHashes;
+  liveHashes.reserve(this->size());
+
+  auto erasedId = this->erased.begin();
+  for (std::uint64_t id = 0; id < this->hashes.size(); ++id)
+  {
+    if (erasedId != this->erased.end() && *erasedId == id)
+    {
+      ++erasedId;
+      continue;
+    }
+    liveHashes.push_back(this->hashes[id]);
+  }
+
+  this->logBuffer.clear();
+  for (const auto hash : liveHashes)
+  {
+    encodeRecord(this->logBuffer, Operation::APPEND, hash);
+  }
+
+  auto temporaryPath = this->path;
+  temporaryPath += TEMPORARY_FILE_EXTENSION;
+  {
+    const FileDescriptor out(temporaryPath, O_WRONLY | O_CREAT | O_TRUNC);
+    writeAll(out.get(), this->logBuffer.data(), this->logBuffer.size());
+  }
+  std::filesystem::rename(temporaryPath, this->path);
+  this->log = FileDescriptor(this->path, O_WRONLY | O_CREAT | O_APPEND);
+
+  this->hashes.clear();
+  this->ids.clear();
+  this->erased.clear();
+  for (const auto hash : liveHashes)
+  {
+    this->add(hash);
+  }
+}
+
+void HashIndex::add(const std::uint64_t hash)
+{
+  this->ids.emplace(hash, this->hashes.size());
+  this->hashes.push_back(hash);
+}
+
+void HashIndex::remove(const std::uint64_t id)
+{
+  const auto [first, last] = this->ids.equal_range(this->hashes[id]);
+  for (auto it = first; it != last; ++it)
+  {
+    if (it->second == id)
+    {
+      this->ids.erase(it);
+      break;
+    }
+  }
+
+  this->erased.insert(std::upper_bound(this->erased.begin(), this->erased.end(), id), id);
+}
+
+auto HashIndex::positionOf(const std::uint64_t id) const -> std::size_t
+{
+  const auto erasedBefore = std::lower_bound(this->erased.begin(), this->erased.end(), id)
+                            - this->erased.begin();
+  return static_cast<std::size_t>(id) - static_cast<std::size_t>(erasedBefore);
+}
+
+auto HashIndex::idOf(const std::size_t position) const -> std::uint64_t
+{
+  // There are `erased[i] - i` live elements before the i-th erased id: the
+  // id is the position shifted by the erased ids before it.
+  std::size_t low  = 0;
+  std::size_t high = this->erased.size();
+  while (low < high)
+  {
+    const auto middle = low + (high - low) / 2u;
+    if (this->erased[middle] - middle <= position)
+    {
+      low = middle + 1u;
+    }
+    else
+    {
+      high = middle;
+    }
+  }
+
+  return position + low;
+}
+
+} // namespace storage::v2
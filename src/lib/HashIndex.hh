@@ -0,0 +1,57 @@
+
+#pragma once
+
+#include "FileDescriptor.hh"
+
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace storage::v2 {
+
+// Persistent index from the hash of the elements of a vector to their
+// positions. Every element gets a stable id when appended, erasing an
+// element only records its id: the position of an id is the id minus the
+// number of erased ids before it. All operations are appended to a log,
+// replayed when opening the index and rewritten when too many elements were
+// erased.
+class HashIndex
+{
+  public:
+  explicit HashIndex(const std::filesystem::path &path);
+
+  // Number of elements currently indexed.
+  auto size() const -> std::size_t;
+
+  void append(const std::uint64_t hash);
+  void append(const std::vector<std::uint64_t> &hashes);
+  void erase(const std::size_t position);
+
+  // Positions of the elements with the given hash, in increasing order.
+  auto positions(const std::uint64_t hash) const -> std::vector<std::size_t>;
+
+  // Replaces the content of the index with `hashes`, the hashes of all the
+  // elements in order.
+  void reset(const std::vector<std::uint64_t> &hashes);
+
+  private:
+  std::filesystem::path path{};
+  FileDescriptor log{};
+  std::string logBuffer{};
+
+  std::vector<std::uint64_t> hashes{};
+  std::unordered_multimap<std::uint64_t, std::uint64_t> ids{};
+  std::vector<std::uint64_t> erased{};
+
+  void load();
+  void compact();
+  void add(const std::uint64_t hash);
+  void remove(const std::uint64_t id);
+
+  auto positionOf(const std::uint64_t id) const -> std::size_t;
+  auto idOf(const std::size_t position) const -> std::uint64_t;
+};
+
+} // namespace storage::v2
@@ -0,0 +1,38 @@
+
+#include "Header.hh"
+
+#include <fstream>
+#include <sstream>
+#include <string>
+
+namespace storage {
+
+auto readHeader(const std::filesystem::path &path) -> std::optional<HeaderEntry>
+{
+  std::optional<HeaderEntry> out;
+
+  std::ifstream headerFile(path);
+  std::string line;
+  while (std::getline(headerFile, line) && !headerFile.eof())
+  {
+    std::istringstream entry(line);
+    HeaderEntry header;
+    if (entry >> header.capacity >> header.length)
+    {
+      out = header;
+    }
+  }
+
+  return out;
+}
+
+void tagFormat(const std::filesystem::path &directory, const std::string_view format)
+{
+  const auto path = directory / FORMAT_FILE_NAME;
+  if (!std::filesystem::exists(path))
+  {
+    std::ofstream(path) << format << "\n";
+  }
+}
+
+} // namespace storage
@@ -0,0 +1,28 @@
+
+#pragma once
+
+#include <cstddef>
+#include <filesystem>
+#include <optional>
+#include <string_view>
+
+namespace storage {
+
+// The header of a vector, in both formats, holds "capacity length" entries
+// appended on every change. The last complete entry is the current state:
+// an entry not followed by a newline was not completely written.
+struct HeaderEntry
+{
+  std::size_t capacity{};
+  std::size_t length{};
+};
+
+auto readHeader(const std::filesystem::path &path) -> std::optional<HeaderEntry>;
+
+// Both formats tag the directories they open for writing with their name,
+// unless already tagged.
+constexpr auto FORMAT_FILE_NAME = "FORMAT.txt";
+
+void tagFormat(const std::filesystem::path &directory, const std::string_view format);
+
+} // namespace storage
@@ -0,0 +1,71 @@
+
+#include "MappedFile.hh"
+
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace storage {
+
+MappedFile::MappedFile(const std::filesystem::path &path)
+{
+  const auto fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0)
+  {
+    throw std::runtime_error("Failed to open " + path.string() + ": " + std::strerror(errno));
+  }
+
+  struct stat status;
+  if (::fstat(fd, &status) != 0)
+  {
+    ::close(fd);
+    throw std::runtime_error("Failed to stat " + path.string() + ": " + std::strerror(errno));
+  }
+
+  this->length = static_cast<std::size_t>(status.st_size);
+  if (this->length == 0u)
+  {
+    ::close(fd);
+    return;
+  }
+
+  // The mapping holds its own reference to the file.
+  this->mapping = ::mmap(nullptr, this->length, PROT_READ, MAP_PRIVATE, fd, 0);
+  ::close(fd);
+  if (this->mapping == MAP_FAILED)
+  {
+    this->mapping = nullptr;
+    throw std::runtime_error("Failed to map " + path.string() + ": " + std::strerror(errno));
+  }
+
+  ::madvise(this->mapping, this->length, MADV_SEQUENTIAL);
+}
+
+MappedFile::~MappedFile()
+{
+  if (this->mapping != nullptr)
+  {
+    ::munmap(this->mapping, this->length);
+  }
+}
+
+auto MappedFile::data() const -> const char *
+{
+  return static_cast<const char *>(this->mapping);
+}
+
+auto MappedFile::size() const -> std::size_t
+{
+  return this->length;
+}
+
+auto MappedFile::view() const -> std::string_view
+{
+  return std::string_view(this->data(), this->length);
+}
+
+} // namespace storage
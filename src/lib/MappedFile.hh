@@ -0,0 +1,29 @@
+
+#pragma once
+
+#include <filesystem>
+#include <string_view>
+
+namespace storage {
+
+// Read-only memory mapping of a whole file. The file is closed once mapped:
+// only the mapping is held.
+class MappedFile
+{
+  public:
+  explicit MappedFile(const std::filesystem::path &path);
+  ~MappedFile();
+
+  MappedFile(const MappedFile &) = delete;
+  MappedFile &operator=(const MappedFile &) = delete;
+
+  auto data() const -> const char *;
+  auto size() const -> std::size_t;
+  auto view() const -> std::string_view;
+
+  private:
+  void *mapping{nullptr};
+  std::size_t length{};
+};
+
+} // namespace storage
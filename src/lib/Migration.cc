@@ -0,0 +1,259 @@
+
+#include "Migration.hh"
+#include "FileDescriptor.hh"
+#include "Header.hh"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <fstream>
+#include <iostream>
+#include <optional>
+#include <sys/stat.h>
+#include <thread>
+#include <unistd.h>
+
+namespace storage::v2 {
+
+constexpr auto HEADER_FILE_NAME            = "HEADER.txt";
+constexpr auto INDEX_FILE_NAME             = "INDEX.txt";
+constexpr auto MIGRATION_FILE_NAME         = "MIGRATION.txt";
+constexpr auto BATCH_FILE_NAME             = "MIGRATION.batch";
+constexpr auto STAGING_DIRECTORY_SUFFIX    = ".migration";
+constexpr auto TEMPORARY_FILE_EXTENSION    = ".tmp";
+constexpr std::size_t MIGRATION_BATCH_SIZE = 10000;
+
+namespace {
+// Length of the v1 vector, from the last complete entry of its header.
+auto loadSourceLength(const std::filesystem::path &headerPath) -> std::size_t
+{
+  if (!std::filesystem::exists(headerPath))
+  {
+    throw std::runtime_error("No v1 vector found, cannot open " + headerPath.string());
+  }
+
+  return readHeader(headerPath).value_or(HeaderEntry{}).length;
+}
+
+// The marker holds the length of the v1 vector being migrated.
+auto loadMarker(const std::filesystem::path &path) -> std::optional<std::size_t>
+{
+  std::ifstream in(path);
+  std::size_t length;
+  if (in >> length)
+  {
+    return length;
+  }
+
+  return std::nullopt;
+}
+
+void writeFileAtomically(const std::filesystem::path &path, const std::string &content)
+{
+  auto temporaryPath = path;
+  temporaryPath += TEMPORARY_FILE_EXTENSION;
+  {
+    const FileDescriptor file(temporaryPath, O_WRONLY | O_CREAT | O_TRUNC);
+    writeAll(file.get(), content.data(), content.size());
+    if (::fsync(file.get()) != 0)
+    {
+      throw std::runtime_error("Failed to sync " + temporaryPath.string() + ": "
+                               + std::strerror(errno));
+    }
+  }
+  std::filesystem::rename(temporaryPath, path);
+}
+
+auto readElement(const std::filesystem::path &directory, const std::filesystem::path &path)
+  -> std::string
+{
+  FileDescriptor file(::open(path.c_str(), O_RDONLY | O_CLOEXEC));
+  if (!file.valid())
+  {
+    // Paths are relative to the working directory of the v1 writer: the
+    // element is then looked for in its data block directory.
+    file = FileDescriptor(directory / path.parent_path().filename() / path.filename(), O_RDONLY);
+  }
+
+  struct stat status;
+  if (::fstat(file.get(), &status) != 0)
+  {
+    throw std::runtime_error("Failed to stat " + path.string() + ": " + std::strerror(errno));
+  }
+
+  std::string out(static_cast<std::size_t>(status.st_size), '\0');
+  out.resize(readAt(file.get(), out.data(), out.size(), 0));
+  return out;
+}
+
+// Reads the element files of a batch with `threads` readers and writes them
+// as length prefixed records to `batchPath`.
+void writeBatch(const std::filesystem::path &directory,
+                const std::vector<std::filesystem::path> &paths,
+                const std::size_t threads,
+                const std::filesystem::path &batchPath)
+{
+  std::vector<std::string> values(paths.size());
+
+  const auto hardwareThreads = std::max(1u, std::thread::hardware_concurrency());
+  const auto readersCount    = std::min(paths.size(), threads == 0 ? hardwareThreads : threads);
+
+  std::atomic<std::size_t> nextElement{0};
+  std::vector<std::exception_ptr> errors(readersCount);
+
+  const auto readElements = [&](const std::size_t readerId) {
+    try
+    {
+      for (auto id = nextElement++; id < paths.size(); id = nextElement++)
+      {
+        values[id] = readElement(directory, paths[id]);
+      }
+    }
+    catch (...)
+    {
+      errors[readerId] = std::current_exception();
+    }
+  };
+
+  std::vector<std::thread> readers;
+  for (std::size_t id = 0; id < readersCount; ++id)
+  {
+    readers.emplace_back(readElements, id);
+  }
+  for (auto &reader : readers)
+  {
+    reader.join();
+  }
+
+  for (const auto &error : errors)
+  {
+    if (error)
+    {
+      std::rethrow_exception(error);
+    }
+  }
+
+  std::string content;
+  for (const auto &value : values)
+  {
+    const auto size = value.size();
+    content.append(reinterpret_cast<const char *>(&size), sizeof(size));
+    content.append(value);
+  }
+
+  const FileDescriptor file(batchPath, O_WRONLY | O_CREAT | O_TRUNC);
+  writeAll(file.get(), content.data(), content.size());
+}
+
+// Appends the elements of the v1 vector missing from `target`.
+void copyElements(const std::filesystem::path &directory,
+                  const std::size_t length,
+                  PersistentVector &target,
+                  const std::size_t threads,
+                  const std::filesystem::path &batchPath)
+{
+  std::ifstream indexFile(directory / INDEX_FILE_NAME);
+
+  std::size_t elementId;
+  std::filesystem::path path;
+  for (std::size_t id = 0; id < target.size(); ++id)
+  {
+    indexFile >> elementId >> path;
+  }
+
+  std::vector<std::filesystem::path> paths;
+  while (target.size() < length)
+  {
+    paths.clear();
+    while (paths.size() < std::min(MIGRATION_BATCH_SIZE, length - target.size())
+           && indexFile >> elementId >> path)
+    {
+      paths.push_back(path);
+    }
+
+    if (paths.empty())
+    {
+      throw std::runtime_error("The index of " + directory.string() + " only describes "
+                               + std::to_string(target.size()) + " element(s) out of "
+                               + std::to_string(length));
+    }
+
+    writeBatch(directory, paths, threads, batchPath);
+    target.import(batchPath, Format::LENGTH_PREFIXED, threads);
+
+    std::cout << "[INFO] Migrated " << target.size() << " element(s) out of " << length
+              << " from " << directory << "\n";
+  }
+
+  std::filesystem::remove(batchPath);
+}
+
+// Removes the v1 content once the directories were exchanged.
+void finish(const std::filesystem::path &directory, const std::filesystem::path &staging)
+{
+  std::filesystem::remove_all(staging);
+  std::filesystem::remove(directory / MIGRATION_FILE_NAME);
+
+  std::cout << "[INFO] Migration of " << directory << " complete\n";
+}
+} // namespace
+
+void migrate(const std::filesystem::path &directory,
+             const Options &options,
+             const std::size_t threads)
+{
+  const auto source  = (directory.has_filename() ? directory : directory.parent_path());
+  const auto staging
+    = source.parent_path() / (source.filename().string() + STAGING_DIRECTORY_SUFFIX);
+
+  // The directories were already exchanged, only the v1 content is left.
+  if (std::filesystem::exists(source / MIGRATION_FILE_NAME))
+  {
+    finish(source, staging);
+    return;
+  }
+
+  const auto length = loadSourceLength(source / HEADER_FILE_NAME);
+  const auto marker = loadMarker(staging / MIGRATION_FILE_NAME);
+  if (std::filesystem::exists(staging) && marker != length)
+  {
+    std::cout << "[INFO] Restarting the migration of " << source << ", its length changed\n";
+    std::filesystem::remove_all(staging);
+  }
+
+  if (!marker || *marker != length)
+  {
+    std::filesystem::create_directories(staging);
+    writeFileAtomically(staging / MIGRATION_FILE_NAME, std::to_string(length) + "\n");
+  }
+
+  {
+    PersistentVector target(staging, options);
+    if (target.size() > length)
+    {
+      throw std::runtime_error("The staging directory " + staging.string() + " holds "
+                               + std::to_string(target.size()) + " element(s), more than the "
+                               + std::to_string(length) + " of " + source.string());
+    }
+
+    std::cout << "[INFO] Migrating " << source << " to " << staging << " from element "
+              << target.size() << " out of " << length << "\n";
+
+    copyElements(source, length, target, threads, staging / BATCH_FILE_NAME);
+  }
+
+  // Data blocks are indexed by name only: the staging directory is usable
+  // as is once renamed.
+  if (::renameat2(AT_FDCWD, staging.c_str(), AT_FDCWD, source.c_str(), RENAME_EXCHANGE) != 0)
+  {
+    throw std::runtime_error("Failed to exchange " + staging.string() + " and " + source.string()
+                             + ": " + std::strerror(errno));
+  }
+
+  finish(source, staging);
+}
+
+} // namespace storage::v2
@@ -0,0 +1,26 @@
+
+#pragma once
+
+#include "PersistentVectorBlock.hh"
+
+#include <filesystem>
+
+namespace storage::v2 {
+
+// Converts the v1 vector of `directory` (one file per element) to a v2 vector
+// created with `options`, in place:
+//
+// - the elements are streamed in batches to a v2 vector in the sibling
+//   directory `<directory>.migration`, the element files of each batch being
+//   read by `threads` readers (defaults to the number of cores).
+// - once complete, the staging directory is exchanged with `directory` in a
+//   single rename and the v1 content is removed.
+//
+// The v1 vector must not be modified during the migration. After a crash
+// calling `migrate` again resumes from the elements already in the staging
+// directory, or only cleans up when the directories were already exchanged.
+void migrate(const std::filesystem::path &directory,
+             const Options &options    = {},
+             const std::size_t threads = 0);
+
+} // namespace storage::v2
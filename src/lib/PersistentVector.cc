@@ -1,5 +1,6 @@
 
 #include "PersistentVector.hh"
+#include "Header.hh"
 
 #include <fstream>
 #include <iostream>
@@ -103,6 +104,7 @@ void PersistentVector::init()
     std::cout << "[INFO] Initializing empty directory at " << this->headerFilePath << "\n";
     this->saveToDisk();
   }
+  tagFormat(this->directory, "v1");
 
   // TODO: Check that the file was correctly open.
   this->headerFileStream.open(this->headerFilePath, std::ofstream::trunc);
@@ -139,25 +141,9 @@ void PersistentVector::saveToDisk()
 void PersistentVector::loadHeader()
 {
   // TODO: Check that the file was correctly open.
-  std::ifstream headerFile(this->headerFilePath);
-
-  headerFile >> this->capacity >> this->length;
-
-  std::size_t capacityFromFile;
-  std::size_t lengthFromFile;
-
-  bool moreEntries = (headerFile.peek() != EOF);
-  while (moreEntries)
-  {
-    headerFile >> capacityFromFile >> lengthFromFile;
-    moreEntries = (headerFile.peek() != EOF);
-
-    if (moreEntries)
-    {
-      this->capacity = capacityFromFile;
-      this->length   = lengthFromFile;
-    }
-  }
+  const auto header = readHeader(this->headerFilePath).value_or(HeaderEntry{});
+  this->capacity    = header.capacity;
+  this->length      = header.length;
 
   std::cout << "[INFO] Loaded capacity " << this->capacity << " and length " << this->length
             << " from " << this->headerFilePath << "\n";
@@ -1,409 +1,4097 @@
 
 #include "PersistentVectorBlock.hh"
+#include "Checksum.hh"
+#include "Columns.hh"
+#include "FileDescriptor.hh"
+#include "Header.hh"
+#include "MappedFile.hh"
+#include "Search.hh"
 
+#include <atomic>
+#include <cerrno>
+#include <climits>
+#include <cstdint>
+#include <cstring>
+#include <exception>
+#include <fcntl.h>
 #include <fstream>
 #include <iostream>
+#include <linux/fs.h>
+#include <numeric>
+#include <poll.h>
+#include <sstream>
+#include <sys/file.h>
+#include <sys/inotify.h>
+#include <sys/ioctl.h>
+#include <sys/sendfile.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <thread>
+#include <unistd.h>
+#include <unordered_set>
 
 namespace storage::v2 {
 
 constexpr auto HEADER_FILE_NAME                        = "HEADER.txt";
 constexpr auto INDEX_FILE_NAME                         = "INDEX.txt";
-constexpr std::size_t DATA_BLOCK_DIRECTORY_NAME_LENGTH = 4;
-constexpr std::size_t ELEMENT_FILE_NAME_LENGTH         = 8;
-constexpr auto ELEMENT_FILE_EXTENSION                  = ".txt";
+constexpr auto HASH_INDEX_FILE_NAME                    = "HASH_INDEX.log";
+constexpr auto LAYOUT_FILE_NAME                        = "LAYOUT.txt";
+constexpr auto VALUES_FILE_NAME                        = "VALUES.log";
+constexpr auto VERSIONS_FILE_NAME                      = "VERSIONS.log";
+constexpr auto EPOCH_RECORD                            = "epoch";
+constexpr auto OLDEST_RECORD                           = "oldest";
+constexpr auto BATCH_FILE_NAME                         = "BATCH.log";
+constexpr std::size_t MIN_STALE_VERSION_RECORDS        = 1024;
+constexpr std::size_t DATA_BLOCK_FILE_NAME_LENGTH      = 10;
+constexpr auto DATA_BLOCK_FILE_EXTENSION               = ".txt";
+constexpr auto TEMPORARY_FILE_EXTENSION                = ".tmp";
 constexpr std::size_t DATA_BLOCK_ELEMENT_SIZE          = 4096;
 constexpr std::size_t DATA_BLOCK_SIZE                  = 100;
 
-PersistentVector::PersistentVector(const std::filesystem::path &directory)
-  : directory(directory)
+// Both are stored on a single byte in the metadata of the data blocks.
+static_assert(DATA_BLOCK_SIZE <= UINT8_MAX);
+constexpr std::size_t MAX_DIRECTORIES = UINT8_MAX + 1;
+
+constexpr std::size_t MAX_ELEMENT_SIZE = DATA_BLOCK_ELEMENT_SIZE - sizeof(std::size_t);
+
+// Loads of `multi_get` wait for the disk rather than the CPU: they use more
+// readers than there are cores.
+constexpr std::size_t MAX_PARALLEL_LOADS = 16;
+
+// Set in the size of the slots holding the key of their value in the value
+// store rather than the value itself.
+constexpr std::size_t REFERENCE_FLAG = std::size_t{1} << 63;
+
+namespace {
+auto findMetadataDirectory(const std::vector<std::filesystem::path> &directories)
+  -> std::filesystem::path
+{
+  if (directories.empty())
+  {
+    throw std::invalid_argument("At least one directory is needed to store the vector");
+  }
+
+  for (const auto &directory : directories)
+  {
+    if (std::filesystem::exists(directory / HEADER_FILE_NAME))
+    {
+      return directory;
+    }
+  }
+
+  return directories.front();
+}
+
+auto withColdDirectory(std::vector<std::filesystem::path> directories, const Options &options)
+  -> std::vector<std::filesystem::path>
+{
+  if (!options.coldDirectory.empty())
+  {
+    directories.push_back(options.coldDirectory);
+  }
+  return directories;
+}
+
+// Data block files are named after their file id, zero padded. Names of the
+// randomly named files of older vectors are shorter.
+auto dataBlockFileName(const std::uint32_t fileId) -> std::string
+{
+  auto out = std::to_string(fileId);
+  out.insert(0, DATA_BLOCK_FILE_NAME_LENGTH - out.size(), '0');
+  out += DATA_BLOCK_FILE_EXTENSION;
+  return out;
+}
+
+auto dataBlockFileId(const std::filesystem::path &fileName) -> std::optional<std::uint32_t>
+{
+  const auto stem = fileName.stem().string();
+  if (fileName.extension() != DATA_BLOCK_FILE_EXTENSION
+      || stem.size() != DATA_BLOCK_FILE_NAME_LENGTH
+      || stem.find_first_not_of("0123456789") != std::string::npos)
+  {
+    return {};
+  }
+
+  const auto fileId = std::stoull(stem);
+  if (fileId > UINT32_MAX)
+  {
+    return {};
+  }
+  return static_cast<std::uint32_t>(fileId);
+}
+
+// Entries of the index are "firstId size fileId directoryId". Older vectors
+// stored the path of the data block instead of the last two.
+struct IndexEntry
+{
+  std::size_t firstId{};
+  std::size_t size{};
+  std::uint32_t fileId{};
+  std::size_t directoryId{};
+  std::optional<std::filesystem::path> path{};
+};
+
+auto parseIndexEntry(std::istream &in) -> std::optional<IndexEntry>
+{
+  IndexEntry entry;
+  if (!(in >> entry.firstId >> entry.size >> std::ws))
+  {
+    return {};
+  }
+
+  if (in.peek() == '"')
+  {
+    std::filesystem::path path;
+    if (!(in >> path))
+    {
+      return {};
+    }
+    entry.path = std::move(path);
+  }
+  else if (!(in >> entry.fileId >> entry.directoryId))
+  {
+    return {};
+  }
+
+  if (entry.size > DATA_BLOCK_SIZE || entry.directoryId >= MAX_DIRECTORIES)
+  {
+    return {};
+  }
+  return entry;
+}
+
+// Writes `value` and its size to a whole slot, padded with zeros.
+void encodeElement(char *slot, const std::size_t slotSize, const std::string_view value)
+{
+  const auto valueSize = value.size();
+  std::memcpy(slot, &valueSize, sizeof(std::size_t));
+  std::memcpy(slot + sizeof(std::size_t), value.data(), valueSize);
+  std::memset(slot + sizeof(std::size_t) + valueSize, 0,
+              slotSize - sizeof(std::size_t) - valueSize);
+}
+
+void encodeReference(char *slot,
+                     const std::size_t slotSize,
+                     const std::size_t valueSize,
+                     const std::uint64_t key)
+{
+  const auto size = valueSize | REFERENCE_FLAG;
+  std::memcpy(slot, &size, sizeof(std::size_t));
+  std::memcpy(slot + sizeof(std::size_t), &key, sizeof(key));
+  std::memset(slot + sizeof(std::size_t) + sizeof(key), 0,
+              slotSize - sizeof(std::size_t) - sizeof(key));
+}
+
+// Compressed data blocks start with this header, followed by the output of
+// their codec. Raw data blocks start with the size of their first element,
+// which can never match the magic number.
+struct CompressedDataBlockHeader
+{
+  char magic[8];
+  char codec[8];
+  std::uint64_t size;
+  std::uint64_t compressedSize;
+};
+static_assert(sizeof(CompressedDataBlockHeader) == 32);
+
+constexpr char COMPRESSED_DATA_BLOCK_MAGIC[8] = {'P', 'V', 'B', 'L', 'O', 'C', 'K', 'Z'};
+
+auto isCompressedDataBlock(const std::string_view data) -> bool
+{
+  constexpr auto MAGIC_SIZE = sizeof(COMPRESSED_DATA_BLOCK_MAGIC);
+  return data.size() >= sizeof(CompressedDataBlockHeader)
+         && std::memcmp(data.data(), COMPRESSED_DATA_BLOCK_MAGIC, MAGIC_SIZE) == 0;
+}
+
+auto isCompressedDataBlock(const int fd) -> bool
+{
+  char header[sizeof(CompressedDataBlockHeader)];
+  const auto read = readAt(fd, header, sizeof(header), 0);
+  return isCompressedDataBlock({header, read});
+}
+
+auto slotReference(const char *slot) -> std::optional<std::uint64_t>
+{
+  std::size_t size;
+  std::memcpy(&size, slot, sizeof(size));
+  if ((size & REFERENCE_FLAG) == 0u)
+  {
+    return {};
+  }
+
+  std::uint64_t key;
+  std::memcpy(&key, slot + sizeof(std::size_t), sizeof(key));
+  return key;
+}
+
+// A logged batch is this header, the index before the batch and the
+// operations of the batch. `headerSize` is the size of the header file when
+// the batch started: the batch was applied once a line follows.
+struct BatchRecordHeader
+{
+  std::uint32_t checksum;
+  std::uint32_t padding;
+  std::uint64_t headerSize;
+  std::uint64_t capacity;
+  std::uint64_t length;
+  std::uint64_t changesSize;
+  std::uint64_t indexSize;
+  std::uint64_t batchSize;
+};
+static_assert(sizeof(BatchRecordHeader) == 56);
+
+auto computeChecksum(const BatchRecordHeader &header, const std::string_view content)
+  -> std::uint32_t
+{
+  const auto raw = reinterpret_cast<const char *>(&header);
+  const std::string_view fields(raw + sizeof(header.checksum),
+                                sizeof(header) - sizeof(header.checksum));
+  return crc32(content, crc32(fields));
+}
+} // namespace
+
+PersistentVector::PersistentVector(const std::filesystem::path &directory, const Options &options)
+  : PersistentVector(std::vector<std::filesystem::path>{directory}, options)
+{}
+
+PersistentVector::PersistentVector(const std::vector<std::filesystem::path> &directories,
+                                   const Options &options)
+  : directories(withColdDirectory(directories, options))
+  , hotDirectoriesCount(directories.size())
+  , options(options)
+  , directory(findMetadataDirectory(directories))
   , headerFilePath(directory / HEADER_FILE_NAME)
   , indexFilePath(directory / INDEX_FILE_NAME)
-  , saveToDiskBuffer(DATA_BLOCK_ELEMENT_SIZE, '\0')
+  , layout(loadLayout(directory, options))
+  , dataBlockBuffers(DATA_BLOCK_SIZE * layout.slotSize,
+                     DATA_BLOCK_ELEMENT_SIZE,
+                     options.memoryResource)
+  , changesFilePath(directory / CHANGES_FILE_NAME)
+  , versionsFilePath(directory / VERSIONS_FILE_NAME)
+  , batchFilePath(directory / BATCH_FILE_NAME)
+{
+  this->init();
+}
+
+PersistentVector::~PersistentVector()
+{
+  try
+  {
+    this->releaseReservedDataBlocks();
+  }
+  catch (const std::exception &e)
+  {
+    std::cout << "[INFO] Failed to remove the data blocks allocated ahead in " << this->directory
+              << ": " << e.what() << "\n";
+  }
+}
+
+auto PersistentVector::size() const -> std::size_t
+{
+  return this->length;
+}
+
+auto PersistentVector::DataBlocks::size() const -> std::size_t
+{
+  return this->firstIds.size();
+}
+
+auto PersistentVector::DataBlocks::empty() const -> bool
+{
+  return this->firstIds.empty();
+}
+
+void PersistentVector::DataBlocks::push_back(const std::size_t firstId,
+                                             const std::uint32_t fileId,
+                                             const std::size_t size,
+                                             const std::uint8_t directoryId)
+{
+  this->firstIds.push_back(firstId);
+  this->fileIds.push_back(fileId);
+  this->sizes.push_back(static_cast<std::uint8_t>(size));
+  this->directoryIds.push_back(directoryId);
+}
+
+void PersistentVector::DataBlocks::erase(const std::size_t dataBlockId)
+{
+  const auto offset = static_cast<std::ptrdiff_t>(dataBlockId);
+  this->firstIds.erase(this->firstIds.begin() + offset);
+  this->fileIds.erase(this->fileIds.begin() + offset);
+  this->sizes.erase(this->sizes.begin() + offset);
+  this->directoryIds.erase(this->directoryIds.begin() + offset);
+}
+
+void PersistentVector::DataBlocks::clear()
+{
+  this->firstIds.clear();
+  this->fileIds.clear();
+  this->sizes.clear();
+  this->directoryIds.clear();
+}
+
+auto PersistentVector::at(const std::size_t index) const -> std::string_view
+{
+  if (index >= this->length)
+  {
+    throw std::out_of_range("Requested size " + std::to_string(index) + " but only "
+                            + std::to_string(this->length) + " available");
+  }
+
+  // TODO: Check that the data block is valid.
+  const auto dataBlockId = this->findDataBlockIdForIndex(index);
+
+  // Moves only change the directory of the data blocks.
+  if (this->tiering)
+  {
+    this->tiering->recordAccess(this->dataBlocks.fileIds[dataBlockId]);
+    this->tierDataBlocks();
+  }
+
+  if (const auto cached = this->cachedDataBlock(dataBlockId))
+  {
+    // std::cout << "[INFO] Element " << index << " was already in cache\n";
+    cached->lastAccess = ++this->accesses;
+    return this->fetchElementDataFromDataBlock(*cached, dataBlockId, index);
+  }
+
+  const auto path = this->dataBlockPath(dataBlockId);
+
+  // Full data blocks of a read-only vector are mapped rather than copied.
+  if (this->options.mode == OpenMode::READ_ONLY && !this->options.directIo
+      && dataBlockId + 1 < this->dataBlocks.size())
+  {
+    auto mapping = std::make_unique<MappedFile>(path);
+
+    std::cout << "[INFO] Mapped element " << index << " from " << path << " with size "
+              << mapping->size() << "\n";
+
+    if (isCompressedDataBlock(mapping->view()))
+    {
+      auto &cached = this->cacheDataBlock(dataBlockId,
+                                          this->decompressDataBlock(path, mapping->view()));
+      return this->fetchElementDataFromDataBlock(cached, dataBlockId, index);
+    }
+
+    auto &cached      = this->cachedDataBlocks[this->dataBlocks.fileIds[dataBlockId]];
+    cached.mapping    = std::move(mapping);
+    cached.lastAccess = ++this->accesses;
+    this->evictDataBlocks();
+    return this->fetchElementDataFromDataBlock(cached, dataBlockId, index);
+  }
+
+  // TODO: Verify that the size matches what we expect.
+  auto &cached = this->cacheDataBlock(dataBlockId, this->loadDataBlockFromDisk(path));
+
+  std::cout << "[INFO] Loaded element " << index << " from " << path << " with size "
+            << cached.data->size() << "\n";
+
+  return this->fetchElementDataFromDataBlock(cached, dataBlockId, index);
+}
+
+auto PersistentVector::multi_get(const std::span<const std::size_t> indices) const
+  -> std::vector<std::string_view>
+{
+  for (const auto index : indices)
+  {
+    if (index >= this->length)
+    {
+      throw std::out_of_range("Requested size " + std::to_string(index) + " but only "
+                              + std::to_string(this->length) + " available");
+    }
+  }
+
+  // Requests sorted by index, each data block being looked up once for all
+  // the requests it holds.
+  std::vector<std::size_t> order(indices.size());
+  std::iota(order.begin(), order.end(), 0u);
+  std::sort(order.begin(), order.end(),
+            [&](const std::size_t a, const std::size_t b) { return indices[a] < indices[b]; });
+
+  std::vector<std::size_t> dataBlockIds;
+  std::vector<std::size_t> groupEnds;
+  for (std::size_t position = 0; position < order.size(); ++position)
+  {
+    const auto index = indices[order[position]];
+    if (dataBlockIds.empty()
+        || index >= this->dataBlocks.firstIds[dataBlockIds.back()]
+                      + this->elementsInDataBlock(dataBlockIds.back()))
+    {
+      dataBlockIds.push_back(this->findDataBlockIdForIndex(index));
+      groupEnds.push_back(position);
+    }
+    groupEnds.back() = position + 1;
+  }
+
+  // Moves only change the directory of the data blocks.
+  if (this->tiering)
+  {
+    for (const auto dataBlockId : dataBlockIds)
+    {
+      this->tiering->recordAccess(this->dataBlocks.fileIds[dataBlockId]);
+    }
+    this->tierDataBlocks();
+  }
+
+  std::vector<std::size_t> missing;
+  for (const auto dataBlockId : dataBlockIds)
+  {
+    if (this->cachedDataBlock(dataBlockId) == nullptr)
+    {
+      missing.push_back(dataBlockId);
+    }
+  }
+
+  const auto readersCount = std::min(missing.size(), MAX_PARALLEL_LOADS);
+  std::atomic<std::size_t> nextLoad{0};
+  std::vector<CachedDataBlock> loaded(missing.size());
+  std::vector<std::exception_ptr> errors(readersCount);
+
+  const auto loadDataBlocks = [&](const std::size_t readerId) {
+    try
+    {
+      for (auto id = nextLoad++; id < missing.size(); id = nextLoad++)
+      {
+        loaded[id] = this->loadDataBlock(missing[id]);
+      }
+    }
+    catch (...)
+    {
+      errors[readerId] = std::current_exception();
+    }
+  };
+
+  if (readersCount == 1u)
+  {
+    loadDataBlocks(0);
+  }
+  else
+  {
+    std::vector<std::thread> readers;
+    for (std::size_t id = 0; id < readersCount; ++id)
+    {
+      readers.emplace_back(loadDataBlocks, id);
+    }
+    for (auto &reader : readers)
+    {
+      reader.join();
+    }
+  }
+
+  for (const auto &error : errors)
+  {
+    if (error)
+    {
+      std::rethrow_exception(error);
+    }
+  }
+
+  for (std::size_t id = 0; id < missing.size(); ++id)
+  {
+    this->cachedDataBlocks[this->dataBlocks.fileIds[missing[id]]] = std::move(loaded[id]);
+  }
+
+  std::vector<std::string_view> out(indices.size());
+  std::size_t position = 0;
+  for (std::size_t group = 0; group < dataBlockIds.size(); ++group)
+  {
+    const auto dataBlockId = dataBlockIds[group];
+    auto &cached           = *this->cachedDataBlock(dataBlockId);
+    cached.lastAccess      = ++this->accesses;
+    for (; position < groupEnds[group]; ++position)
+    {
+      const auto request = order[position];
+      out[request] = this->fetchElementDataFromDataBlock(cached, dataBlockId, indices[request]);
+    }
+  }
+
+  // All the data blocks read stay cached until the next read, the cache
+  // shrinking back to its limit then.
+  if (dataBlockIds.size() <= this->options.cachedDataBlocks)
+  {
+    this->evictDataBlocks();
+  }
+  return out;
+}
+
+auto PersistentVector::loadDataBlock(const std::size_t dataBlockId) const -> CachedDataBlock
+{
+  const auto path = this->dataBlockPath(dataBlockId);
+
+  // Full data blocks of a read-only vector are mapped rather than copied, as
+  // in `at`.
+  CachedDataBlock out;
+  if (this->options.mode == OpenMode::READ_ONLY && !this->options.directIo
+      && dataBlockId + 1 < this->dataBlocks.size())
+  {
+    auto mapping = std::make_unique<MappedFile>(path);
+    if (isCompressedDataBlock(mapping->view()))
+    {
+      out.data = this->decompressDataBlock(path, mapping->view());
+    }
+    else
+    {
+      out.mapping = std::move(mapping);
+    }
+    return out;
+  }
+
+  out.data = this->loadDataBlockFromDisk(path);
+  return out;
+}
+
+void PersistentVector::push_back(std::string &&value)
+{
+  // The value is copied to its slot anyway, there is nothing to take over.
+  this->push_back(std::string_view(value));
+}
+
+void PersistentVector::push_back(const char *value)
+{
+  this->push_back(std::string_view(value));
+}
+
+void PersistentVector::push_back(const std::string_view value)
+{
+  this->ensureWritable();
+  this->ensureNoAsyncAppends();
+
+  if (value.size() > MAX_ELEMENT_SIZE)
+  {
+    throw std::invalid_argument("Element of size " + std::to_string(value.size())
+                                + " does not fit in a slot of " + std::to_string(MAX_ELEMENT_SIZE)
+                                + " byte(s)");
+  }
+
+  this->tierDataBlocks();
+
+  if (this->capacity == 0u || this->length >= this->capacity)
+  {
+    std::cout << "[INFO] Need to grow for \"" << value << "\", length is " << this->length
+              << " and capacity " << this->capacity << "\n";
+    this->grow();
+  }
+
+  this->saveElementToDisk(this->length - this->dataBlocks.firstIds.back(), value);
+
+  if (this->tiering)
+  {
+    this->tiering->recordAccess(this->dataBlocks.fileIds.back());
+  }
+
+  // std::cout << "[INFO] Saved element " << this->length << ", size: " << value.size() << "\n";
+
+  this->commitAppend(value);
+}
+
+void PersistentVector::commitAppend(const std::string_view value)
+{
+  ++this->length;
+  this->updateState(Operation::INSERT);
+
+  if (this->hashIndex)
+  {
+    this->hashIndex->append(hash64(value));
+  }
+
+  if (this->options.changeFeed)
+  {
+    this->recordChange(ChangeType::APPEND, this->length - 1, this->length - 1, value);
+  }
+}
+
+void PersistentVector::erase(const std::size_t index)
+{
+  this->ensureWritable();
+  this->ensureNoAsyncAppends();
+
+  if (index >= this->length)
+  {
+    throw std::out_of_range("Cannot erase element " + std::to_string(index) + ", only "
+                            + std::to_string(this->length) + " available");
+  }
+
+  this->tierDataBlocks();
+  this->freezeDataBlocks();
+
+  // The sidecar only ever holds elements of the vector, even after a crash.
+  this->truncateColumns(index);
+
+  const auto dataBlockId = this->findDataBlockIdForIndex(index);
+  const auto path        = this->dataBlockPath(dataBlockId);
+
+  std::cout << "[INFO] Erasing element " << index << " out of " << this->length
+            << " (capacity: " << this->capacity << ")\n";
+
+  this->removeFromDataBlock(dataBlockId, index);
+  const auto size = --this->dataBlocks.sizes[dataBlockId];
+
+  this->updateFollowingDataBlocks(dataBlockId + 1);
+
+  std::cout << "[INFO] Erased element " << index << " at " << path << "\n";
+
+  if (size == 0)
+  {
+    this->eraseElementFromDisk(this->dataBlockPath(dataBlockId));
+
+    if (dataBlockId + 1 == this->dataBlocks.size())
+    {
+      this->lastDataBlockFile.close();
+    }
+    this->cachedDataBlocks.erase(this->dataBlocks.fileIds[dataBlockId]);
+    this->dataBlocks.erase(dataBlockId);
+  }
+
+  --this->length;
+  --this->capacity;
+
+  this->updateState(Operation::ERASE);
+
+  if (this->hashIndex)
+  {
+    this->hashIndex->erase(index);
+  }
+
+  if (this->options.changeFeed)
+  {
+    this->recordChange(ChangeType::ERASE, index, this->length + 1, {});
+  }
+}
+
+auto PersistentVector::async_at(const std::size_t index) const -> Awaitable<std::string>
+{
+  if (index >= this->length)
+  {
+    throw std::out_of_range("Requested size " + std::to_string(index) + " but only "
+                            + std::to_string(this->length) + " available");
+  }
+
+  const auto dataBlockId = this->findDataBlockIdForIndex(index);
+  if (this->cachedDataBlock(dataBlockId) != nullptr)
+  {
+    return Awaitable<std::string>::ready(std::string(this->at(index)));
+  }
+
+  // Checked before registering a load the read would leave behind.
+  this->asyncIo();
+
+  const auto fileId = this->dataBlocks.fileIds[dataBlockId];
+  auto &load        = this->asyncLoads[fileId];
+  if (!load)
+  {
+    const auto path = this->dataBlockPath(dataBlockId);
+    auto file       = this->openDataBlock(path, O_RDONLY);
+
+    struct stat status;
+    if (::fstat(file.get(), &status) != 0)
+    {
+      this->asyncLoads.erase(fileId);
+      throw std::runtime_error("Failed to stat " + path.string() + ": " + std::strerror(errno));
+    }
+
+    load          = std::make_unique<AsyncLoad>();
+    load->file    = std::move(file);
+    load->content = this->dataBlockBuffers.acquire();
+    load->size    = std::min(static_cast<std::size_t>(status.st_size), load->content.capacity());
+    this->readDataBlockAsync(fileId);
+  }
+
+  // The element is looked up once its data block is cached: erases applied
+  // in the meantime shift it like for `at`.
+  auto state = std::make_shared<Awaitable<std::string>::State>();
+  load->waiters.push_back([this, state, index](const std::exception_ptr &error) {
+    if (error)
+    {
+      state->fail(error);
+      return;
+    }
+
+    try
+    {
+      state->set(std::string(this->at(index)));
+    }
+    catch (...)
+    {
+      state->fail(std::current_exception());
+    }
+  });
+
+  return Awaitable<std::string>(state);
+}
+
+void PersistentVector::readDataBlockAsync(const std::uint32_t fileId) const
+{
+  // Direct reads need sizes aligned on the slots, like in
+  // `loadDataBlockFromDisk`.
+  auto &load             = *this->asyncLoads.at(fileId);
+  const auto slotSize    = this->layout.slotSize;
+  const auto alignedSize = (load.size + slotSize - 1) / slotSize * slotSize;
+
+  this->asyncIo().read(load.file.get(), load.content.data() + load.loaded,
+                       alignedSize - load.loaded, static_cast<off_t>(load.loaded),
+                       [this, fileId](const std::int64_t result) {
+                         this->completeDataBlockRead(fileId, result);
+                       });
+}
+
+void PersistentVector::completeDataBlockRead(const std::uint32_t fileId,
+                                             const std::int64_t result) const
+{
+  const auto found = this->asyncLoads.find(fileId);
+  auto &load       = *found->second;
+  if (result > 0)
+  {
+    load.loaded += static_cast<std::size_t>(result);
+    if (load.loaded < load.size)
+    {
+      this->readDataBlockAsync(fileId);
+      return;
+    }
+  }
+
+  const auto loaded = std::move(found->second);
+  this->asyncLoads.erase(found);
+
+  std::exception_ptr error;
+  try
+  {
+    if (result < 0)
+    {
+      throw std::runtime_error("Failed to read data block file " + std::to_string(fileId) + ": "
+                               + std::strerror(static_cast<int>(-result)));
+    }
+
+    // Data blocks rewritten in the meantime are loaded again by `at`.
+    const auto dataBlockId = this->findDataBlockIdForFileId(fileId);
+    if (dataBlockId && this->cachedFile(fileId) == nullptr)
+    {
+      auto content = std::move(loaded->content);
+      content.resize(std::min(loaded->loaded, loaded->size));
+
+      const std::string_view view(content.data(), content.size());
+      if (isCompressedDataBlock(view))
+      {
+        content = this->decompressDataBlock(this->dataBlockPath(*dataBlockId), view);
+      }
+      this->cacheFile(fileId, std::move(content));
+    }
+  }
+  catch (...)
+  {
+    error = std::current_exception();
+  }
+
+  for (const auto &waiter : loaded->waiters)
+  {
+    waiter(error);
+  }
+}
+
+auto PersistentVector::async_push_back(const std::string_view value) -> Awaitable<std::size_t>
+{
+  this->ensureWritable();
+  auto &io = this->asyncIo();
+
+  if (value.size() > MAX_ELEMENT_SIZE)
+  {
+    throw std::invalid_argument("Element of size " + std::to_string(value.size())
+                                + " does not fit in a slot of " + std::to_string(MAX_ELEMENT_SIZE)
+                                + " byte(s)");
+  }
+
+  this->tierDataBlocks();
+
+  // Pending appends already took the slots after the length.
+  const auto index = this->length + this->asyncAppends.size();
+  if (this->capacity == 0u || index >= this->capacity)
+  {
+    this->grow();
+  }
+
+  const auto position = index - this->dataBlocks.firstIds.back();
+  const auto slot     = this->encodeElementInCache(position, value);
+  if (!this->lastDataBlockFile.valid())
+  {
+    this->openLastDataBlock(O_WRONLY);
+  }
+
+  // The last data block can change before the write completes.
+  auto append   = std::make_unique<AsyncAppend>();
+  append->file  = FileDescriptor(::fcntl(this->lastDataBlockFile.get(), F_DUPFD_CLOEXEC, 0));
+  append->slot  = std::string(slot, this->layout.slotSize);
+  append->value = std::string(value);
+  append->state = std::make_shared<Awaitable<std::size_t>::State>();
+  if (!append->file.valid())
+  {
+    throw std::runtime_error("Failed to duplicate the data block file descriptor: "
+                             + std::string(std::strerror(errno)));
+  }
+
+  if (this->tiering)
+  {
+    this->tiering->recordAccess(this->dataBlocks.fileIds.back());
+  }
+
+  auto &pending = *append;
+  this->asyncAppends.push_back(std::move(append));
+  try
+  {
+    io.write(pending.file.get(), pending.slot.data(), pending.slot.size(),
+             static_cast<off_t>(position * this->layout.slotSize),
+             [this, &pending](const std::int64_t result) {
+               if (result < 0 || static_cast<std::size_t>(result) != pending.slot.size())
+               {
+                 pending.error = std::make_exception_ptr(std::runtime_error(
+                   "Failed to write an element: "
+                   + std::string(result < 0 ? std::strerror(static_cast<int>(-result))
+                                            : "short write")));
+               }
+               pending.written = true;
+               this->commitAsyncAppends();
+             });
+  }
+  catch (...)
+  {
+    this->asyncAppends.pop_back();
+    throw;
+  }
+
+  return Awaitable<std::size_t>(pending.state);
+}
+
+void PersistentVector::commitAsyncAppends()
+{
+  // Awaiting coroutines are only resumed once the queue is consistent, as
+  // they can append again.
+  std::vector<std::pair<std::shared_ptr<Awaitable<std::size_t>::State>, std::exception_ptr>>
+    failed;
+  std::vector<std::pair<std::shared_ptr<Awaitable<std::size_t>::State>, std::size_t>> committed;
+
+  while (!this->asyncAppends.empty() && this->asyncAppends.front()->written)
+  {
+    const auto append = std::move(this->asyncAppends.front());
+    this->asyncAppends.pop_front();
+
+    if (append->error && !this->asyncAppendError)
+    {
+      this->asyncAppendError = append->error;
+    }
+    if (!this->asyncAppendError)
+    {
+      try
+      {
+        this->commitAppend(append->value);
+        committed.emplace_back(append->state, this->length - 1);
+        continue;
+      }
+      catch (...)
+      {
+        this->asyncAppendError = std::current_exception();
+      }
+    }
+
+    failed.emplace_back(append->state, this->asyncAppendError);
+  }
+
+  // Resumed coroutines can append again: the vector is rolled back to its
+  // length first.
+  std::exception_ptr rollbackError;
+  if (this->asyncAppends.empty())
+  {
+    if (this->asyncAppendError)
+    {
+      try
+      {
+        this->dropEmptyDataBlocks();
+      }
+      catch (...)
+      {
+        rollbackError = std::current_exception();
+      }
+    }
+    this->asyncAppendError = nullptr;
+  }
+
+  for (const auto &[state, index] : committed)
+  {
+    state->set(index);
+  }
+  for (const auto &[state, error] : failed)
+  {
+    state->fail(error);
+  }
+
+  if (rollbackError)
+  {
+    std::rethrow_exception(rollbackError);
+  }
+}
+
+auto PersistentVector::async_flush() -> Awaitable<void>
+{
+  this->ensureWritable();
+  auto &io = this->asyncIo();
+
+  // Files are synced in parallel, the header last as it commits the rest.
+  struct Flush
+  {
+    std::vector<FileDescriptor> files{};
+    FileDescriptor header{};
+    std::size_t remaining{};
+    std::exception_ptr error{};
+    std::shared_ptr<Awaitable<void>::State> state{};
+  };
+
+  auto flush    = std::make_shared<Flush>();
+  flush->state  = std::make_shared<Awaitable<void>::State>();
+  flush->header = FileDescriptor(this->headerFilePath, O_RDONLY);
+
+  std::unordered_set<std::uint8_t> directoryIds;
+  for (const auto fileId : this->unflushedFileIds)
+  {
+    if (const auto dataBlockId = this->findDataBlockIdForFileId(fileId))
+    {
+      flush->files.emplace_back(this->dataBlockPath(*dataBlockId), O_RDONLY);
+      directoryIds.insert(this->dataBlocks.directoryIds[*dataBlockId]);
+    }
+  }
+  for (const auto directoryId : directoryIds)
+  {
+    flush->files.emplace_back(this->directories[directoryId], O_RDONLY | O_DIRECTORY);
+  }
+  flush->files.emplace_back(this->indexFilePath, O_RDONLY);
+  flush->files.emplace_back(this->directory, O_RDONLY | O_DIRECTORY);
+  this->unflushedFileIds.clear();
+
+  const auto fail = [](const std::int64_t result) {
+    return std::make_exception_ptr(std::runtime_error(
+      "Failed to sync: " + std::string(std::strerror(static_cast<int>(-result)))));
+  };
+
+  flush->remaining = flush->files.size();
+  for (const auto &file : flush->files)
+  {
+    io.sync(file.get(), [&io, flush, fail](const std::int64_t result) {
+      if (result < 0 && !flush->error)
+      {
+        flush->error = fail(result);
+      }
+      if (--flush->remaining > 0u)
+      {
+        return;
+      }
+
+      if (flush->error)
+      {
+        flush->state->fail(flush->error);
+        return;
+      }
+      io.sync(flush->header.get(), [flush, fail](const std::int64_t result) {
+        if (result < 0)
+        {
+          flush->state->fail(fail(result));
+          return;
+        }
+        flush->state->set({});
+      });
+    });
+  }
+
+  return Awaitable<void>(flush->state);
+}
+
+void PersistentVector::init()
+{
+  if (this->directories.size() > MAX_DIRECTORIES)
+  {
+    throw std::invalid_argument("Cannot spread a vector over more than "
+                                + std::to_string(MAX_DIRECTORIES) + " directories");
+  }
+
+  if (this->layout.deduplication && this->options.directIo)
+  {
+    throw std::invalid_argument("Vector at " + this->directory.string()
+                                + " is deduplicated and cannot use direct I/O");
+  }
+
+  // Erased values are dropped from the value store, older versions could
+  // still reference them.
+  if (this->layout.deduplication && this->options.versioning)
+  {
+    throw std::invalid_argument("Vector at " + this->directory.string()
+                                + " is deduplicated and cannot be versioned");
+  }
+
+  if (this->options.mode == OpenMode::READ_ONLY)
+  {
+    if (!std::filesystem::exists(this->headerFilePath))
+    {
+      throw std::runtime_error("No vector to open in read-only mode at "
+                               + this->directory.string());
+    }
+
+    this->loadFromDisk();
+    if (this->layout.deduplication)
+    {
+      this->openValueStore();
+    }
+    if (this->options.versioning)
+    {
+      this->loadVersions();
+      this->collectVersions();
+    }
+    return;
+  }
+
+  this->lockDirectory();
+
+  std::optional<WriteBatch> pendingBatch;
+
+  if (!this->options.coldDirectory.empty())
+  {
+    std::filesystem::create_directories(this->options.coldDirectory);
+  }
+
+  if (std::filesystem::exists(this->headerFilePath))
+  {
+    std::cout << "[INFO] Detected existing content at " << this->headerFilePath << ", loading...\n";
+    pendingBatch = this->recoverBatch();
+    this->loadFromDisk();
+    this->openVersions();
+    this->removeUncommittedDataBlocks();
+  }
+  else
+  {
+    std::cout << "[INFO] Initializing empty directory at " << this->headerFilePath << "\n";
+    if (this->layout.deduplication)
+    {
+      this->saveLayout();
+    }
+    this->saveToDisk();
+    this->openVersions();
+  }
+  tagFormat(this->directory, "v2");
+
+  // TODO: Check that the file was correctly open.
+  this->headerFileStream.open(this->headerFilePath, std::ofstream::trunc);
+  this->saveHeader();
+
+  // Left by a crash while asynchronous appends were pending.
+  this->dropEmptyDataBlocks();
+
+  if (this->layout.deduplication)
+  {
+    this->openValueStore();
+  }
+
+  this->openChangeFeed();
+
+  this->openHashIndex();
+  this->openColumns();
+
+  if (!this->options.coldDirectory.empty())
+  {
+    this->tiering = std::make_unique<Tiering>(this->options.tieringInterval);
+  }
+
+  // The vector is back to its state before the batch, which is applied
+  // again.
+  if (pendingBatch)
+  {
+    this->write(*pendingBatch);
+  }
+}
+
+void PersistentVector::lockDirectory()
+{
+  this->directoryLock = FileDescriptor(this->directory, O_RDONLY | O_DIRECTORY);
+  if (::flock(this->directoryLock.get(), LOCK_EX | LOCK_NB) != 0)
+  {
+    throw std::runtime_error("Cannot open " + this->directory.string()
+                             + " for writing: " + std::strerror(errno));
+  }
+}
+
+void PersistentVector::ensureWritable() const
+{
+  if (this->options.mode == OpenMode::READ_ONLY)
+  {
+    throw std::logic_error("Vector at " + this->directory.string()
+                           + " is opened in read-only mode");
+  }
+}
+
+void PersistentVector::ensureNoAsyncAppends() const
+{
+  if (!this->asyncAppends.empty())
+  {
+    throw std::logic_error("Vector at " + this->directory.string() + " has "
+                           + std::to_string(this->asyncAppends.size())
+                           + " asynchronous append(s) pending");
+  }
+}
+
+auto PersistentVector::asyncIo() const -> AsyncIo &
+{
+  if (!this->options.asyncIo)
+  {
+    throw std::logic_error("Vector at " + this->directory.string()
+                           + " was opened without asynchronous I/O");
+  }
+  return *this->options.asyncIo;
+}
+
+void PersistentVector::updateState(const Operation &operation)
+{
+  if (this->batching)
+  {
+    return;
+  }
+
+  this->saveHeader();
+  if (operation == Operation::ERASE)
+  {
+    this->saveIndex();
+  }
+  this->commitVersion();
+  this->syncColumns();
+}
+
+auto PersistentVector::loadLayout(const std::filesystem::path &directory, const Options &options)
+  -> Layout
+{
+  const auto path = directory / LAYOUT_FILE_NAME;
+  if (!std::filesystem::exists(path))
+  {
+    // Only new vectors can be deduplicated, the others use full slots.
+    if (!options.deduplication || std::filesystem::exists(directory / HEADER_FILE_NAME))
+    {
+      return {.deduplication = false, .slotSize = DATA_BLOCK_ELEMENT_SIZE};
+    }
+
+    if (options.deduplicationThreshold > MAX_ELEMENT_SIZE)
+    {
+      throw std::invalid_argument("Deduplication threshold "
+                                  + std::to_string(options.deduplicationThreshold)
+                                  + " exceeds the maximum element size of "
+                                  + std::to_string(MAX_ELEMENT_SIZE));
+    }
+
+    // Slots hold at least a reference and stay aligned on its size.
+    const auto inlineSize = std::max(options.deduplicationThreshold, sizeof(std::uint64_t));
+    const auto slotSize   = (sizeof(std::size_t) + inlineSize + sizeof(std::uint64_t) - 1)
+                          / sizeof(std::uint64_t) * sizeof(std::uint64_t);
+    return {.deduplication = true, .slotSize = slotSize};
+  }
+
+  Layout layout{.deduplication = false, .slotSize = DATA_BLOCK_ELEMENT_SIZE};
+
+  std::ifstream layoutFile(path);
+  std::string key;
+  while (layoutFile >> key)
+  {
+    if (key == "deduplication")
+    {
+      layoutFile >> layout.deduplication;
+    }
+    else if (key == "slot-size")
+    {
+      layoutFile >> layout.slotSize;
+    }
+    else
+    {
+      throw std::runtime_error("Unknown entry " + key + " in " + path.string());
+    }
+  }
+
+  if (!layoutFile.eof() || layout.slotSize < sizeof(std::size_t) + sizeof(std::uint64_t)
+      || layout.slotSize > DATA_BLOCK_ELEMENT_SIZE)
+  {
+    throw std::runtime_error("Invalid layout in " + path.string());
+  }
+
+  std::cout << "[INFO] Loaded layout from " << path << ", deduplication: " << layout.deduplication
+            << ", slot size: " << layout.slotSize << "\n";
+  return layout;
+}
+
+void PersistentVector::saveLayout() const
+{
+  std::ofstream layoutFile(this->directory / LAYOUT_FILE_NAME, std::ofstream::trunc);
+  layoutFile << "deduplication " << this->layout.deduplication << "\n";
+  layoutFile << "slot-size " << this->layout.slotSize << "\n";
+  layoutFile.close();
+
+  if (!layoutFile)
+  {
+    throw std::runtime_error("Failed to write the layout of " + this->directory.string());
+  }
+}
+
+void PersistentVector::openChangeFeed()
+{
+  const auto exists = std::filesystem::exists(this->changesFilePath);
+
+  std::optional<ChangeType> lastType;
+  if (exists)
+  {
+    ChangeFeed feed(this->changesFilePath, 0u);
+    while (const auto change = feed.next())
+    {
+      this->lastSequence = change->sequence;
+      lastType           = change->type;
+    }
+
+    // Drop a change which was not completely written.
+    if (std::filesystem::file_size(this->changesFilePath) > feed.offset())
+    {
+      std::filesystem::resize_file(this->changesFilePath, feed.offset());
+    }
+  }
+
+  // Changes made without the feed are not logged: the log is ended with a
+  // reset so that they are not mistaken for a continuous history.
+  if (!this->options.changeFeed)
+  {
+    if (exists && lastType != ChangeType::RESET)
+    {
+      std::string record;
+      encodeChange(record, ++this->lastSequence, ChangeType::RESET, 0u, this->length, {});
+
+      const FileDescriptor file(this->changesFilePath, O_WRONLY | O_APPEND);
+      writeAll(file.get(), record.data(), record.size());
+
+      std::cout << "[INFO] Change feed at " << this->changesFilePath << " reset at sequence "
+                << this->lastSequence << "\n";
+    }
+    return;
+  }
+
+  this->changesFile = FileDescriptor(this->changesFilePath, O_WRONLY | O_CREAT | O_APPEND);
+
+  std::cout << "[INFO] Change feed at " << this->changesFilePath << " is at sequence "
+            << this->lastSequence << "\n";
+}
+
+void PersistentVector::recordChange(const ChangeType &type,
+                                    const std::size_t index,
+                                    const std::size_t lengthBefore,
+                                    const std::string_view value)
+{
+  // Changes of a batch are written together once it is applied.
+  if (!this->batching)
+  {
+    this->changesBuffer.clear();
+  }
+  encodeChange(this->changesBuffer, ++this->lastSequence, type, index, lengthBefore, value);
+
+  if (!this->batching)
+  {
+    writeAll(this->changesFile.get(), this->changesBuffer.data(), this->changesBuffer.size());
+  }
+}
+
+void PersistentVector::write(const WriteBatch &batch)
+{
+  this->ensureWritable();
+  this->ensureNoAsyncAppends();
+
+  // Erases release values from the store, which cannot be undone.
+  if (this->layout.deduplication)
+  {
+    throw std::logic_error("Vector at " + this->directory.string()
+                           + " is deduplicated and cannot apply write batches");
+  }
+
+  // A logged batch is applied again after a crash: it must not fail.
+  auto length = this->length;
+  for (const auto &entry : batch.entries())
+  {
+    if (entry.type == ChangeType::ERASE && entry.index >= length)
+    {
+      throw std::out_of_range("Cannot erase element " + std::to_string(entry.index) + ", only "
+                              + std::to_string(length) + " available");
+    }
+    if (entry.type == ChangeType::APPEND && entry.value.size() > MAX_ELEMENT_SIZE)
+    {
+      throw std::invalid_argument("Element of size " + std::to_string(entry.value.size())
+                                  + " does not fit in a slot of "
+                                  + std::to_string(MAX_ELEMENT_SIZE) + " byte(s)");
+    }
+    length = (entry.type == ChangeType::ERASE ? length - 1 : length + 1);
+  }
+
+  if (batch.empty())
+  {
+    return;
+  }
+
+  this->saveBatch(batch);
+
+  const auto sequence   = this->lastSequence;
+  const auto nextFileId = this->nextFileId;
+
+  this->batching = true;
+  try
+  {
+    for (const auto &entry : batch.entries())
+    {
+      if (entry.type == ChangeType::ERASE)
+      {
+        this->erase(entry.index);
+      }
+      else
+      {
+        this->push_back(std::string_view(entry.value));
+      }
+    }
+  }
+  catch (...)
+  {
+    this->abortBatch(sequence, nextFileId);
+    throw;
+  }
+  this->batching = false;
+
+  // The header is written last: the batch is applied once it is.
+  this->saveIndex();
+  if (this->options.changeFeed)
+  {
+    writeAll(this->changesFile.get(), this->changesBuffer.data(), this->changesBuffer.size());
+    this->changesBuffer.clear();
+  }
+  this->saveHeader();
+  this->commitVersion();
+  this->syncColumns();
+
+  for (const auto &path : this->replacedFiles)
+  {
+    std::filesystem::remove(path);
+  }
+  this->replacedFiles.clear();
+
+  std::cout << "[INFO] Applied a batch of " << batch.size() << " operation(s), length is now "
+            << this->length << "\n";
+}
+
+void PersistentVector::saveBatch(const WriteBatch &batch)
+{
+  std::ostringstream index;
+  writeIndexEntries(index, this->dataBlocks, 0);
+
+  BatchRecordHeader header{};
+  header.headerSize  = static_cast<std::uint64_t>(this->headerFileStream.tellp());
+  header.capacity    = this->capacity;
+  header.length      = this->length;
+  header.changesSize = (std::filesystem::exists(this->changesFilePath)
+                          ? std::filesystem::file_size(this->changesFilePath)
+                          : 0u);
+
+  std::string record(sizeof(header), '\0');
+  record += index.str();
+  header.indexSize = record.size() - sizeof(header);
+  batch.encode(record);
+  header.batchSize = record.size() - sizeof(header) - header.indexSize;
+
+  header.checksum = computeChecksum(header, std::string_view(record).substr(sizeof(header)));
+  std::memcpy(record.data(), &header, sizeof(header));
+
+  // The only synced write of the batch.
+  if (!this->batchFile.valid())
+  {
+    this->batchFile = FileDescriptor(this->batchFilePath, O_WRONLY | O_CREAT);
+  }
+  writeAt(this->batchFile.get(), record.data(), record.size(), 0);
+  if (::fdatasync(this->batchFile.get()) != 0)
+  {
+    throw std::runtime_error("Failed to sync " + this->batchFilePath.string() + ": "
+                             + std::strerror(errno));
+  }
+}
+
+auto PersistentVector::recoverBatch() -> std::optional<WriteBatch>
+{
+  if (!std::filesystem::exists(this->batchFilePath)
+      || std::filesystem::file_size(this->batchFilePath) == 0u)
+  {
+    return {};
+  }
+
+  std::ifstream in(this->batchFilePath, std::ifstream::binary);
+  const std::string record(std::istreambuf_iterator<char>(in), {});
+
+  // A batch which was not completely logged was not applied either.
+  BatchRecordHeader header{};
+  std::optional<WriteBatch> batch;
+  std::string_view index;
+  if (record.size() >= sizeof(header))
+  {
+    std::memcpy(&header, record.data(), sizeof(header));
+    const auto content = std::string_view(record).substr(sizeof(header));
+    if (header.indexSize <= content.size()
+        && header.batchSize <= content.size() - header.indexSize
+        && header.checksum
+             == computeChecksum(header, content.substr(0, header.indexSize + header.batchSize)))
+    {
+      index = content.substr(0, header.indexSize);
+      batch = WriteBatch::decode(content.substr(header.indexSize, header.batchSize));
+    }
+  }
+
+  std::ifstream headerFile(this->headerFilePath);
+  headerFile.seekg(static_cast<std::streamoff>(header.headerSize));
+  const std::string committed(std::istreambuf_iterator<char>(headerFile), {});
+
+  // The header file is rewritten when the vector is opened: a batch found
+  // afterwards would be taken for an interrupted one.
+  if (!batch || committed.find('\n') != std::string::npos)
+  {
+    this->clearBatch();
+    return {};
+  }
+
+  std::cout << "[INFO] Found an interrupted batch of " << batch->size()
+            << " operation(s), restoring length " << header.length << "\n";
+
+  // Erases of the batch wrote to new files: the data blocks before it are
+  // intact. Files created by the batch are numbered after them and are
+  // removed as uncommitted.
+  std::ofstream(this->indexFilePath, std::ofstream::trunc) << index;
+  std::ofstream(this->headerFilePath, std::ofstream::app)
+    << header.capacity << " " << header.length << "\n";
+
+  if (std::filesystem::exists(this->changesFilePath)
+      && std::filesystem::file_size(this->changesFilePath) > header.changesSize)
+  {
+    std::filesystem::resize_file(this->changesFilePath, header.changesSize);
+  }
+  std::filesystem::remove(this->directory / HASH_INDEX_FILE_NAME);
+
+  return batch;
+}
+
+void PersistentVector::abortBatch(const std::uint64_t sequence, const std::uint32_t nextFileId)
+{
+  // Nothing of the batch was committed: the header and the index on disk are
+  // still the ones logged with it, which the vector is reloaded from.
+  this->batching = false;
+  this->releaseReservedDataBlocks();
+  this->replacedFiles.clear();
+  this->changesBuffer.clear();
+  this->lastSequence = sequence;
+  this->nextFileId   = nextFileId;
+
+  this->lastDataBlockFile.close();
+  this->cachedDataBlocks.clear();
+  this->loadFromDisk();
+  this->removeUncommittedDataBlocks();
+
+  // Appends and erases of the batch were already added to the hash index.
+  std::filesystem::remove(this->directory / HASH_INDEX_FILE_NAME);
+  this->hashIndex.reset();
+  this->openHashIndex();
+  this->syncColumns();
+
+  this->clearBatch();
+
+  std::cout << "[INFO] Aborted a batch, length is back to " << this->length << "\n";
+}
+
+void PersistentVector::clearBatch()
+{
+  const FileDescriptor file(this->batchFilePath, O_WRONLY);
+  if (::ftruncate(file.get(), 0) != 0 || ::fdatasync(file.get()) != 0)
+  {
+    throw std::runtime_error("Failed to clear " + this->batchFilePath.string() + ": "
+                             + std::strerror(errno));
+  }
+}
+
+void PersistentVector::openVersions()
+{
+  // The history is dropped once the vector is opened without versioning:
+  // files only kept for older versions would otherwise never be removed.
+  if (!this->options.versioning)
+  {
+    if (std::filesystem::exists(this->versionsFilePath))
+    {
+      this->loadVersions();
+      std::vector<Epoch> dropped(std::make_move_iterator(this->epochs.begin()),
+                                 std::make_move_iterator(this->epochs.end()));
+      this->epochs.clear();
+      this->versionLengths.clear();
+      this->removeUnreferencedFiles(dropped);
+      std::filesystem::remove(this->versionsFilePath);
+
+      std::cout << "[INFO] Dropped the versions of " << this->directory << "\n";
+    }
+    return;
+  }
+
+  this->loadVersions();
+  const auto dropped = this->collectVersions();
+
+  // Files of older versions can be numbered after the current data blocks,
+  // e.g. when the last data block was erased.
+  for (const auto &epoch : this->epochs)
+  {
+    for (const auto fileId : epoch.dataBlocks.fileIds)
+    {
+      this->nextFileId = std::max(this->nextFileId, fileId + 1);
+    }
+  }
+
+  // Rewriting the log drops a record which was not completely written.
+  this->saveVersions();
+  this->removeUnreferencedFiles(dropped);
+  if (this->versionLengths.empty() || this->versionLengths.back() != this->length)
+  {
+    this->commitVersion();
+  }
+
+  std::cout << "[INFO] Vector at " << this->directory << " is at version " << this->currentVersion
+            << " (oldest: " << this->oldestVersion << ")\n";
+}
+
+void PersistentVector::loadVersions()
+{
+  this->versionLengths.clear();
+  this->epochs.clear();
+  this->staleVersionRecords = 0;
+
+  // Records are "<version> <length>" for each version and "epoch
+  // <lastVersion> <count>" followed by `count` index entries for the data
+  // blocks of the versions up to `lastVersion`. "oldest <version>" is written
+  // before the files of older versions are removed. Parsing stops at the
+  // first record which was not completely written.
+  std::uint64_t oldest = 0;
+  std::ifstream in(this->versionsFilePath);
+  std::string line;
+  while (std::getline(in, line) && !in.eof())
+  {
+    std::istringstream record(line);
+    if (line.starts_with(OLDEST_RECORD))
+    {
+      std::string tag;
+      if (!(record >> tag >> oldest))
+      {
+        break;
+      }
+      continue;
+    }
+
+    if (line.starts_with(EPOCH_RECORD))
+    {
+      std::string tag;
+      Epoch epoch;
+      std::size_t count = 0;
+      if (!(record >> tag >> epoch.lastVersion >> count))
+      {
+        break;
+      }
+
+      for (std::size_t id = 0; id < count && std::getline(in, line) && !in.eof(); ++id)
+      {
+        std::istringstream entryStream(line);
+        const auto entry = parseIndexEntry(entryStream);
+        if (!entry || entry->path)
+        {
+          break;
+        }
+        epoch.dataBlocks.push_back(entry->firstId, entry->fileId, entry->size,
+                                   static_cast<std::uint8_t>(entry->directoryId));
+      }
+      if (epoch.dataBlocks.size() != count)
+      {
+        break;
+      }
+
+      this->epochs.push_back(std::move(epoch));
+      continue;
+    }
+
+    std::uint64_t version = 0;
+    std::size_t length    = 0;
+    if (!(record >> version >> length))
+    {
+      break;
+    }
+
+    if (this->versionLengths.empty())
+    {
+      this->oldestVersion = version;
+    }
+    this->currentVersion = version;
+    this->versionLengths.push_back(length);
+  }
+
+  while (!this->versionLengths.empty() && this->oldestVersion < oldest)
+  {
+    this->versionLengths.pop_front();
+    ++this->oldestVersion;
+  }
+  while (!this->epochs.empty() && this->epochs.front().lastVersion < oldest)
+  {
+    this->epochs.pop_front();
+  }
+
+  // Readers of a vector written without versioning only see its current
+  // state.
+  if (this->versionLengths.empty() && this->options.mode == OpenMode::READ_ONLY)
+  {
+    this->currentVersion = 0;
+    this->oldestVersion  = 0;
+    this->versionLengths.push_back(this->length);
+  }
+}
+
+void PersistentVector::saveVersions()
+{
+  auto temporaryPath = this->versionsFilePath;
+  temporaryPath += TEMPORARY_FILE_EXTENSION;
+  {
+    std::ofstream out(temporaryPath, std::ofstream::trunc);
+    for (std::size_t id = 0; id < this->versionLengths.size(); ++id)
+    {
+      out << this->oldestVersion + id << " " << this->versionLengths[id] << "\n";
+    }
+    for (const auto &epoch : this->epochs)
+    {
+      out << EPOCH_RECORD << " " << epoch.lastVersion << " " << epoch.dataBlocks.size() << "\n";
+      writeIndexEntries(out, epoch.dataBlocks, 0);
+    }
+  }
+  std::filesystem::rename(temporaryPath, this->versionsFilePath);
+
+  this->versionsFileStream.close();
+  this->versionsFileStream.open(this->versionsFilePath, std::ofstream::app);
+  this->staleVersionRecords = 0;
+}
+
+void PersistentVector::freezeDataBlocks()
+{
+  // Only erases rewrite data blocks: the data blocks of the versions since
+  // the last erase are recorded once, before the next one.
+  if (!this->options.versioning
+      || (!this->epochs.empty() && this->epochs.back().lastVersion == this->currentVersion))
+  {
+    return;
+  }
+
+  Epoch epoch{.lastVersion = this->currentVersion, .dataBlocks = this->dataBlocks};
+  this->versionsFileStream << EPOCH_RECORD << " " << epoch.lastVersion << " "
+                           << epoch.dataBlocks.size() << "\n";
+  writeIndexEntries(this->versionsFileStream, epoch.dataBlocks, 0);
+  this->versionsFileStream.flush();
+
+  this->epochs.push_back(std::move(epoch));
+}
+
+void PersistentVector::commitVersion()
+{
+  if (!this->options.versioning)
+  {
+    return;
+  }
+
+  if (!this->versionLengths.empty())
+  {
+    ++this->currentVersion;
+  }
+  else
+  {
+    this->oldestVersion = this->currentVersion;
+  }
+  this->versionLengths.push_back(this->length);
+
+  this->versionsFileStream << this->currentVersion << " " << this->length << "\n";
+  this->versionsFileStream.flush();
+
+  // Records of dropped versions stay in the log until it is rewritten: the
+  // oldest version is recorded before their files are removed so they are
+  // not read again, e.g. with a longer retention.
+  const auto dropped = this->collectVersions();
+  if (this->staleVersionRecords
+      > std::max(this->options.retainedVersions, MIN_STALE_VERSION_RECORDS))
+  {
+    this->saveVersions();
+  }
+  else if (!dropped.empty())
+  {
+    this->versionsFileStream << OLDEST_RECORD << " " << this->oldestVersion << "\n";
+    this->versionsFileStream.flush();
+    ++this->staleVersionRecords;
+  }
+  this->removeUnreferencedFiles(dropped);
+}
+
+auto PersistentVector::collectVersions() -> std::vector<Epoch>
+{
+  while (this->versionLengths.size() > std::max<std::size_t>(this->options.retainedVersions, 1u))
+  {
+    this->versionLengths.pop_front();
+    ++this->oldestVersion;
+    ++this->staleVersionRecords;
+  }
+
+  std::vector<Epoch> dropped;
+  while (!this->epochs.empty() && this->epochs.front().lastVersion < this->oldestVersion)
+  {
+    this->staleVersionRecords += 1 + this->epochs.front().dataBlocks.size();
+    dropped.push_back(std::move(this->epochs.front()));
+    this->epochs.pop_front();
+  }
+  return dropped;
+}
+
+void PersistentVector::removeUnreferencedFiles(const std::vector<Epoch> &droppedEpochs)
+{
+  if (droppedEpochs.empty() || this->options.mode == OpenMode::READ_ONLY)
+  {
+    return;
+  }
+
+  std::unordered_set<std::uint32_t> referenced(this->dataBlocks.fileIds.begin(),
+                                               this->dataBlocks.fileIds.end());
+  for (const auto &epoch : this->epochs)
+  {
+    referenced.insert(epoch.dataBlocks.fileIds.begin(), epoch.dataBlocks.fileIds.end());
+  }
+
+  // Moves between tiers only update the current data blocks: the file is
+  // looked for in every directory.
+  for (const auto &epoch : droppedEpochs)
+  {
+    for (const auto fileId : epoch.dataBlocks.fileIds)
+    {
+      if (!referenced.insert(fileId).second)
+      {
+        continue;
+      }
+
+      for (const auto &directory : this->directories)
+      {
+        if (std::filesystem::remove(directory / dataBlockFileName(fileId)))
+        {
+          std::cout << "[INFO] Removed data block " << dataBlockFileName(fileId)
+                    << " of an older version from " << directory << "\n";
+        }
+      }
+      this->cachedDataBlocks.erase(fileId);
+    }
+  }
+}
+
+auto PersistentVector::versionDataBlocks(const std::uint64_t version) const -> const DataBlocks &
+{
+  const auto before = [](const Epoch &epoch, const std::uint64_t value) {
+    return epoch.lastVersion < value;
+  };
+  const auto epoch = std::lower_bound(this->epochs.begin(), this->epochs.end(), version, before);
+  return (epoch == this->epochs.end() ? this->dataBlocks : epoch->dataBlocks);
+}
+
+auto PersistentVector::version() const -> std::uint64_t
+{
+  return this->currentVersion;
+}
+
+auto PersistentVector::size(const std::uint64_t version) const -> std::size_t
+{
+  if (!this->options.versioning)
+  {
+    throw std::logic_error("Vector at " + this->directory.string() + " is not versioned");
+  }
+
+  if (version < this->oldestVersion || version > this->currentVersion)
+  {
+    throw std::out_of_range("Requested version " + std::to_string(version)
+                            + " but only versions " + std::to_string(this->oldestVersion)
+                            + " to " + std::to_string(this->currentVersion) + " are retained");
+  }
+  return this->versionLengths[version - this->oldestVersion];
+}
+
+auto PersistentVector::at(const std::size_t index, const std::uint64_t version) const
+  -> std::string_view
+{
+  const auto length = this->size(version);
+
+  // Readers may see the data blocks of the writer before its last version.
+  if (version == this->currentVersion && this->options.mode == OpenMode::READ_WRITE)
+  {
+    return this->at(index);
+  }
+
+  if (index >= length)
+  {
+    throw std::out_of_range("Requested size " + std::to_string(index) + " but only "
+                            + std::to_string(length) + " available at version "
+                            + std::to_string(version));
+  }
+
+  // Versions only append to the data blocks they share with the later ones:
+  // the slots of their elements never change.
+  const auto &dataBlocks  = this->versionDataBlocks(version);
+  const auto &firstIds    = dataBlocks.firstIds;
+  const auto dataBlockId  = static_cast<std::size_t>(
+                             std::upper_bound(firstIds.begin(), firstIds.end(), index)
+                             - firstIds.begin())
+                           - 1;
+  const auto fileId = dataBlocks.fileIds[dataBlockId];
+
+  auto cached = this->cachedFile(fileId);
+  if (cached == nullptr)
+  {
+    const auto fileName = dataBlockFileName(fileId);
+    auto path           = this->directories[dataBlocks.directoryIds[dataBlockId]] / fileName;
+    if (!std::filesystem::exists(path))
+    {
+      path = this->directories[this->locateDataBlock(fileName)] / fileName;
+    }
+    cached = &this->cacheFile(fileId, this->loadDataBlockFromDisk(path));
+  }
+  cached->lastAccess = ++this->accesses;
+
+  const auto data = (cached->data ? cached->data->data() : cached->mapping->data());
+  return this->slotValue(data + (index - firstIds[dataBlockId]) * this->layout.slotSize);
+}
+
+void PersistentVector::loadFromDisk()
+{
+  this->dataBlocks.clear();
+
+  this->loadHeader();
+
+  std::cout << "[INFO] Found " << this->length << " element(s) to load from "
+            << this->headerFilePath << " (capacity: " << this->capacity << ")\n";
+
+  this->loadIndex();
+}
+
+void PersistentVector::saveToDisk()
+{
+  this->saveHeader();
+  this->saveIndex();
+}
+
+void PersistentVector::loadHeader()
+{
+  // TODO: Check that the file was correctly open.
+  const auto header = readHeader(this->headerFilePath).value_or(HeaderEntry{});
+  this->capacity    = header.capacity;
+  this->length      = header.length;
+
+  std::cout << "[INFO] Loaded capacity " << this->capacity << " and length " << this->length
+            << " from " << this->headerFilePath << "\n";
+}
+
+void PersistentVector::saveHeader()
+{
+  // TODO: Maybe use binary instead of plain text.
+  this->headerFileStream << this->capacity << " " << this->length << "\n";
+  this->headerFileStream.flush();
+}
+
+void PersistentVector::loadIndex()
+{
+  std::ifstream indexFile(this->indexFilePath);
+
+  // The capacity is the sum of the sizes of the data blocks: entries left
+  // after it are not committed yet.
+  bool relocated     = false;
+  std::size_t loaded = 0;
+  std::vector<std::filesystem::path> legacyPaths;
+  for (std::size_t id = 0; loaded < this->capacity; ++id)
+  {
+    auto entry = parseIndexEntry(indexFile);
+    if (!entry)
+    {
+      throw std::runtime_error("Index " + this->indexFilePath.string() + " only describes "
+                               + std::to_string(loaded) + " element(s) out of "
+                               + std::to_string(this->capacity));
+    }
+    loaded += entry->size;
+
+    if (entry->path)
+    {
+      entry->directoryId = this->locateDataBlock(entry->path->filename());
+      legacyPaths.push_back(this->directories[entry->directoryId] / entry->path->filename());
+    }
+    else if (entry->directoryId >= this->directories.size()
+             || !std::filesystem::exists(this->directories[entry->directoryId]
+                                         / dataBlockFileName(entry->fileId)))
+    {
+      entry->directoryId = this->locateDataBlock(dataBlockFileName(entry->fileId));
+      relocated          = true;
+    }
+
+    this->dataBlocks.push_back(entry->firstId, entry->fileId, entry->size,
+                               static_cast<std::uint8_t>(entry->directoryId));
+    this->nextFileId = std::max(this->nextFileId, entry->fileId + 1);
+
+    std::cout << "[INFO] Loading data block " << id << " with file id " << entry->fileId
+              << " and first id " << entry->firstId << " and size " << entry->size << "\n";
+  }
+  indexFile.close();
+
+  if (!legacyPaths.empty() && legacyPaths.size() != this->dataBlocks.size())
+  {
+    throw std::runtime_error("Index " + this->indexFilePath.string()
+                             + " mixes file paths and file ids");
+  }
+
+  if (!legacyPaths.empty())
+  {
+    this->upgradeIndex(legacyPaths);
+  }
+  else if (relocated && this->options.mode == OpenMode::READ_WRITE)
+  {
+    this->saveIndex();
+  }
+}
+
+void PersistentVector::upgradeIndex(const std::vector<std::filesystem::path> &paths)
+{
+  if (this->options.mode == OpenMode::READ_ONLY)
+  {
+    throw std::runtime_error("Index " + this->indexFilePath.string()
+                             + " uses file paths, open the vector for writing once to upgrade it");
+  }
+
+  std::cout << "[INFO] Renaming the " << paths.size() << " data block(s) of "
+            << this->directory << " after their file id\n";
+
+  // The numbered files are links to the old ones until the new index is in
+  // place: a crash at any point leaves one of the indexes usable.
+  for (std::size_t id = 0; id < paths.size(); ++id)
+  {
+    this->dataBlocks.fileIds[id] = static_cast<std::uint32_t>(id);
+
+    const auto path = this->dataBlockPath(id);
+    std::filesystem::remove(path);
+    std::filesystem::create_hard_link(paths[id], path);
+  }
+  this->nextFileId = static_cast<std::uint32_t>(paths.size());
+
+  auto temporaryPath = this->indexFilePath;
+  temporaryPath += TEMPORARY_FILE_EXTENSION;
+  {
+    std::ofstream indexFile(temporaryPath, std::ofstream::trunc);
+    writeIndexEntries(indexFile, this->dataBlocks, 0);
+    indexFile.close();
+    if (!indexFile)
+    {
+      throw std::runtime_error("Failed to write " + temporaryPath.string());
+    }
+  }
+  std::filesystem::rename(temporaryPath, this->indexFilePath);
+
+  for (const auto &path : paths)
+  {
+    std::filesystem::remove(path);
+  }
+}
+
+void PersistentVector::saveIndex() const
+{
+  std::ofstream indexFile;
+  // TODO: Check that the file was correctly open.
+  indexFile.open(this->indexFilePath, std::ofstream::trunc);
+
+  writeIndexEntries(indexFile, this->dataBlocks, 0);
+}
+
+void PersistentVector::appendToIndex(const std::size_t startDataBlockId) const
+{
+  std::ofstream indexFile;
+  // TODO: Check that the file was correctly open.
+  indexFile.open(this->indexFilePath, std::ofstream::app);
+
+  writeIndexEntries(indexFile, this->dataBlocks, startDataBlockId);
+}
+
+void PersistentVector::writeIndexEntries(std::ostream &out,
+                                         const DataBlocks &dataBlocks,
+                                         const std::size_t startDataBlockId)
+{
+  // TODO: Maybe use binary instead of plain text.
+  for (std::size_t id = startDataBlockId; id < dataBlocks.size(); ++id)
+  {
+    out << dataBlocks.firstIds[id] << " " << +dataBlocks.sizes[id] << " "
+        << dataBlocks.fileIds[id] << " " << +dataBlocks.directoryIds[id] << "\n";
+  }
+}
+
+void PersistentVector::removeUncommittedDataBlocks() const
+{
+  // File ids only grow: files numbered after the last data block of the
+  // index were created by a `grow` or an `import` interrupted by a crash.
+  // Files of known data blocks outside of their directory are copies left
+  // by an interrupted move between tiers.
+  std::unordered_map<std::uint32_t, std::uint8_t> directoryIds;
+  for (std::size_t id = 0; id < this->dataBlocks.size(); ++id)
+  {
+    directoryIds.emplace(this->dataBlocks.fileIds[id], this->dataBlocks.directoryIds[id]);
+  }
+
+  for (std::size_t directoryId = 0; directoryId < this->directories.size(); ++directoryId)
+  {
+    for (const auto &entry : std::filesystem::directory_iterator(this->directories[directoryId]))
+    {
+      const auto fileId = dataBlockFileId(entry.path().filename());
+      if (!fileId)
+      {
+        continue;
+      }
+
+      const auto current = directoryIds.find(*fileId);
+      if (*fileId >= this->nextFileId
+          || (current != directoryIds.end() && current->second != directoryId))
+      {
+        std::cout << "[INFO] Removing uncommitted data block " << entry.path() << "\n";
+        std::filesystem::remove(entry.path());
+      }
+    }
+  }
+}
+
+auto PersistentVector::dataBlockPath(const std::size_t dataBlockId) const -> std::filesystem::path
+{
+  return this->directories[this->dataBlocks.directoryIds[dataBlockId]]
+         / dataBlockFileName(this->dataBlocks.fileIds[dataBlockId]);
+}
+
+auto PersistentVector::cachedDataBlock(const std::size_t dataBlockId) const -> CachedDataBlock *
+{
+  return this->cachedFile(this->dataBlocks.fileIds[dataBlockId]);
+}
+
+auto PersistentVector::cachedFile(const std::uint32_t fileId) const -> CachedDataBlock *
+{
+  const auto cached = this->cachedDataBlocks.find(fileId);
+  if (cached == this->cachedDataBlocks.end() || (!cached->second.data && !cached->second.mapping))
+  {
+    return nullptr;
+  }
+  return &cached->second;
+}
+
+auto PersistentVector::openDataBlock(const std::filesystem::path &path, const int flags) const
+  -> FileDescriptor
+{
+  if (this->options.directIo)
+  {
+    FileDescriptor file(::open(path.c_str(), flags | O_DIRECT | O_CLOEXEC, 0644));
+    if (file.valid())
+    {
+      return file;
+    }
+
+    // Some file systems (e.g. tmpfs) do not support direct I/O.
+    if (errno != EINVAL)
+    {
+      throw std::runtime_error("Failed to open " + path.string() + ": " + std::strerror(errno));
+    }
+  }
+
+  return FileDescriptor(path, flags);
+}
+
+auto PersistentVector::loadDataBlockFromDisk(const std::filesystem::path &path) const
+  -> AlignedBuffer
+{
+  const auto file = this->openDataBlock(path, O_RDONLY);
+
+  struct stat status;
+  if (::fstat(file.get(), &status) != 0)
+  {
+    throw std::runtime_error("Failed to stat " + path.string() + ": " + std::strerror(errno));
+  }
+
+  auto buffer     = this->dataBlockBuffers.acquire();
+  const auto size = std::min(static_cast<std::size_t>(status.st_size), buffer.capacity());
+
+  // Direct reads need sizes aligned on the slots: the end of the file is
+  // reached with a short read.
+  const auto slotSize    = this->layout.slotSize;
+  const auto alignedSize = (size + slotSize - 1) / slotSize * slotSize;
+  std::size_t loaded     = 0;
+  while (loaded < size)
+  {
+    const auto read = ::pread(file.get(), buffer.data() + loaded, alignedSize - loaded,
+                              static_cast<off_t>(loaded));
+    if (read < 0 && errno == EINTR)
+    {
+      continue;
+    }
+    if (read < 0)
+    {
+      throw std::runtime_error("Failed to read " + path.string() + ": " + std::strerror(errno));
+    }
+    if (read == 0)
+    {
+      break;
+    }
+
+    loaded += static_cast<std::size_t>(read);
+  }
+  buffer.resize(std::min(loaded, size));
+
+  std::cout << "[INFO] Loading content of " << path << " (size: " << buffer.size() << ", " << size
+            << ")\n";
+
+  if (isCompressedDataBlock({buffer.data(), buffer.size()}))
+  {
+    return this->decompressDataBlock(path, {buffer.data(), buffer.size()});
+  }
+  return buffer;
+}
+
+auto PersistentVector::compressDataBlock(const std::string_view content, std::string &out) const
+  -> bool
+{
+  const auto &codec = *this->options.codec;
+
+  CompressedDataBlockHeader header{};
+  std::memcpy(header.magic, COMPRESSED_DATA_BLOCK_MAGIC, sizeof(header.magic));
+  std::memcpy(header.codec, codec.name().data(),
+              std::min(codec.name().size(), sizeof(header.codec)));
+  header.size = content.size();
+
+  out.assign(sizeof(header), '\0');
+  codec.compress(content, out);
+  header.compressedSize = out.size() - sizeof(header);
+  std::memcpy(out.data(), &header, sizeof(header));
+
+  // Data blocks which do not compress are kept raw.
+  return out.size() < content.size();
+}
+
+auto PersistentVector::decompressDataBlock(const std::filesystem::path &path,
+                                           const std::string_view data) const -> AlignedBuffer
+{
+  CompressedDataBlockHeader header;
+  std::memcpy(&header, data.data(), sizeof(header));
+
+  const std::string_view name(header.codec, strnlen(header.codec, sizeof(header.codec)));
+  const Codec *codec = nullptr;
+  if (this->options.codec && this->options.codec->name() == name)
+  {
+    codec = this->options.codec.get();
+  }
+  else
+  {
+    codec = findBuiltinCodec(name);
+  }
+
+  auto buffer = this->dataBlockBuffers.acquire();
+  if (codec == nullptr || header.size > buffer.capacity()
+      || header.compressedSize != data.size() - sizeof(header))
+  {
+    throw std::runtime_error("Cannot decompress data block " + path.string() + " with codec \""
+                             + std::string(name) + "\"");
+  }
+
+  codec->decompress(data.substr(sizeof(header)), buffer.data(), header.size);
+  buffer.resize(header.size);
+  return buffer;
+}
+
+void PersistentVector::sealDataBlock(const std::size_t dataBlockId)
+{
+  this->lastDataBlockFile.close();
+
+  if (this->options.codec)
+  {
+    const auto path = this->dataBlockPath(dataBlockId);
+
+    auto cached = this->cachedDataBlock(dataBlockId);
+    if (cached == nullptr || !cached->data)
+    {
+      cached = &this->cacheDataBlock(dataBlockId, this->loadDataBlockFromDisk(path));
+    }
+
+    std::string compressed;
+    const std::string_view content(cached->data->data(), cached->data->size());
+    if (this->compressDataBlock(content, compressed))
+    {
+      // Replaced at once: readers see either version.
+      auto temporaryPath = path;
+      temporaryPath += TEMPORARY_FILE_EXTENSION;
+      {
+        const FileDescriptor file(temporaryPath, O_WRONLY | O_CREAT | O_TRUNC);
+        writeAll(file.get(), compressed.data(), compressed.size());
+      }
+      std::filesystem::rename(temporaryPath, path);
+
+      std::cout << "[INFO] Compressed " << path << " from " << content.size() << " to "
+                << compressed.size() << " byte(s)\n";
+    }
+  }
+
+  this->cachedDataBlocks.erase(this->dataBlocks.fileIds[dataBlockId]);
+}
+
+auto PersistentVector::cacheDataBlock(const std::size_t dataBlockId, AlignedBuffer &&content) const
+  -> CachedDataBlock &
+{
+  return this->cacheFile(this->dataBlocks.fileIds[dataBlockId], std::move(content));
+}
+
+auto PersistentVector::cacheFile(const std::uint32_t fileId, AlignedBuffer &&content) const
+  -> CachedDataBlock &
+{
+  auto &cached      = this->cachedDataBlocks[fileId];
+  cached.data       = std::move(content);
+  cached.lastAccess = ++this->accesses;
+
+  this->evictDataBlocks();
+  return cached;
+}
+
+void PersistentVector::evictDataBlocks() const
+{
+  const auto limit = this->options.cachedDataBlocks;
+  if (limit == 0u || this->dataBlocks.empty())
+  {
+    return;
+  }
+
+  // The last data block is never evicted: it is appended to in place.
+  const auto lastFileId = this->dataBlocks.fileIds.back();
+  while (true)
+  {
+    std::size_t cachedCount = 0;
+    auto leastRecentlyUsed  = this->cachedDataBlocks.end();
+    for (auto candidate = this->cachedDataBlocks.begin(); candidate != this->cachedDataBlocks.end();
+         ++candidate)
+    {
+      // Mapped data blocks count as much as loaded ones.
+      if (candidate->first != lastFileId && (candidate->second.data || candidate->second.mapping))
+      {
+        ++cachedCount;
+        if (leastRecentlyUsed == this->cachedDataBlocks.end()
+            || candidate->second.lastAccess < leastRecentlyUsed->second.lastAccess)
+        {
+          leastRecentlyUsed = candidate;
+        }
+      }
+    }
+
+    if (cachedCount <= limit)
+    {
+      break;
+    }
+
+    this->cachedDataBlocks.erase(leastRecentlyUsed);
+  }
+}
+
+void PersistentVector::saveElementToDisk(const std::size_t position, const std::string_view value)
+{
+  const auto slot = this->encodeElementInCache(position, value);
+  if (!this->lastDataBlockFile.valid())
+  {
+    this->openLastDataBlock(O_WRONLY);
+  }
+
+  writeAt(this->lastDataBlockFile.get(), slot, this->layout.slotSize,
+          static_cast<off_t>(position * this->layout.slotSize));
+
+  // std::cout << "[INFO] Saved \"" << value << "\" to data block " << dataBlockId << "\n";
+}
+
+auto PersistentVector::encodeElementInCache(const std::size_t position,
+                                            const std::string_view value) -> const char *
+{
+  // The data block being appended to is kept in memory and used as the write
+  // buffer: reading the elements just written costs no I/O.
+  const auto dataBlockId = this->dataBlocks.size() - 1;
+
+  auto cached = this->cachedDataBlock(dataBlockId);
+  if (cached == nullptr || !cached->data)
+  {
+    cached = &this->cacheDataBlock(dataBlockId,
+                                   this->loadDataBlockFromDisk(this->dataBlockPath(dataBlockId)));
+  }
+  this->unflushedFileIds.insert(this->dataBlocks.fileIds[dataBlockId]);
+
+  // The buffer has the capacity of a full data block so the elements already
+  // in it never move.
+  auto &content       = *cached->data;
+  const auto slotSize = this->layout.slotSize;
+  const auto offset   = position * slotSize;
+  content.resize(std::max(content.size(), offset + slotSize));
+
+  // Values longer than a slot only happen with deduplication.
+  if (value.size() > slotSize - sizeof(std::size_t))
+  {
+    encodeReference(content.data() + offset, slotSize, value.size(),
+                    this->valueStore->insert(value));
+  }
+  else
+  {
+    encodeElement(content.data() + offset, slotSize, value);
+  }
+
+  return content.data() + offset;
+}
+
+void PersistentVector::eraseElementFromDisk(const std::filesystem::path &path) const
+{
+  // TODO: Check that the content was actually deleted.
+  std::filesystem::remove(path);
+  std::cout << "[INFO] Erased content at " << path << "\n";
+}
+
+namespace {
+auto readRecord(const std::string_view content,
+                const Format &format,
+                std::size_t &offset,
+                std::string_view &record) -> bool
+{
+  if (offset >= content.size())
+  {
+    return false;
+  }
+
+  switch (format)
+  {
+    case Format::NEWLINE:
+    {
+      const auto start = content.data() + offset;
+      const auto end   = static_cast<const char *>(
+        std::memchr(start, '\n', content.size() - offset));
+      const auto size  = (end == nullptr ? content.size() - offset
+                                         : static_cast<std::size_t>(end - start));
+
+      record = content.substr(offset, size);
+      offset += size + 1;
+      break;
+    }
+    case Format::SLOTS:
+    {
+      std::size_t size;
+      if (content.size() - offset < DATA_BLOCK_ELEMENT_SIZE)
+      {
+        throw std::runtime_error("Truncated slot at offset " + std::to_string(offset));
+      }
+
+      std::memcpy(&size, content.data() + offset, sizeof(size));
+      if (size > MAX_ELEMENT_SIZE)
+      {
+        throw std::runtime_error("Invalid slot size " + std::to_string(size) + " at offset "
+                                 + std::to_string(offset));
+      }
+
+      record = content.substr(offset + sizeof(size), size);
+      offset += DATA_BLOCK_ELEMENT_SIZE;
+      break;
+    }
+    case Format::LENGTH_PREFIXED:
+    {
+      std::size_t size;
+      if (content.size() - offset < sizeof(size))
+      {
+        throw std::runtime_error("Truncated record size at offset " + std::to_string(offset));
+      }
+
+      std::memcpy(&size, content.data() + offset, sizeof(size));
+      offset += sizeof(size);
+      if (content.size() - offset < size)
+      {
+        throw std::runtime_error("Truncated record of size " + std::to_string(size)
+                                 + " at offset " + std::to_string(offset));
+      }
+
+      record = content.substr(offset, size);
+      offset += size;
+      break;
+    }
+  }
+
+  if (record.size() > MAX_ELEMENT_SIZE)
+  {
+    throw std::invalid_argument("Record of size " + std::to_string(record.size())
+                                + " exceeds the maximum element size of "
+                                + std::to_string(MAX_ELEMENT_SIZE));
+  }
+
+  return true;
+}
+
+void writeVectors(const int fd, std::vector<iovec> &buffers)
+{
+  std::size_t first = 0;
+  while (first < buffers.size())
+  {
+    const auto count   = std::min<std::size_t>(buffers.size() - first, IOV_MAX);
+    const auto written = ::writev(fd, buffers.data() + first, static_cast<int>(count));
+    if (written < 0 && errno == EINTR)
+    {
+      continue;
+    }
+    if (written < 0)
+    {
+      throw std::runtime_error("Failed to write to fd " + std::to_string(fd) + ": "
+                               + std::strerror(errno));
+    }
+
+    // Skip the buffers that were fully written and adjust the partial one.
+    auto remaining = static_cast<std::size_t>(written);
+    while (first < buffers.size() && remaining >= buffers[first].iov_len)
+    {
+      remaining -= buffers[first].iov_len;
+      ++first;
+    }
+    if (remaining > 0u)
+    {
+      buffers[first].iov_base = static_cast<char *>(buffers[first].iov_base) + remaining;
+      buffers[first].iov_len -= remaining;
+    }
+  }
+}
+
+void readAll(const int fd, char *data, const std::size_t size, const off_t offset)
+{
+  if (readAt(fd, data, size, offset) != size)
+  {
+    throw std::runtime_error("Failed to read " + std::to_string(size) + " byte(s) from fd "
+                             + std::to_string(fd) + ": unexpected end of file");
+  }
+}
+
+// Copies `size` bytes at `offset` of `in` to `out` without going through
+// user space when the kernel supports it for this pair of files.
+void transferFileRange(const int in, const int out, off_t offset, std::size_t size)
+{
+  struct stat status;
+  const auto toRegularFile = (::fstat(out, &status) == 0 && S_ISREG(status.st_mode));
+
+  while (size > 0u)
+  {
+    const auto transferred = (toRegularFile
+                                ? ::copy_file_range(in, &offset, out, nullptr, size, 0)
+                                : ::sendfile(out, in, &offset, size));
+    if (transferred < 0 && errno == EINTR)
+    {
+      continue;
+    }
+    if (transferred <= 0)
+    {
+      break;
+    }
+
+    size -= static_cast<std::size_t>(transferred);
+  }
+
+  if (size == 0u)
+  {
+    return;
+  }
+
+  std::string buffer(std::min<std::size_t>(size, 1 << 20), '\0');
+  while (size > 0u)
+  {
+    const auto chunk = std::min(size, buffer.size());
+    readAll(in, buffer.data(), chunk, offset);
+    writeAll(out, buffer.data(), chunk);
+
+    offset += static_cast<off_t>(chunk);
+    size -= chunk;
+  }
+}
+
+// Shares the extents of `from` with `to` on file systems supporting it and
+// copies the content otherwise.
+void cloneFile(const std::filesystem::path &from, const std::filesystem::path &to)
+{
+  {
+    const FileDescriptor in(from, O_RDONLY);
+    const FileDescriptor out(to, O_WRONLY | O_CREAT | O_TRUNC);
+    if (::ioctl(out.get(), FICLONE, in.get()) == 0)
+    {
+      return;
+    }
+  }
+
+  std::filesystem::copy_file(from, to, std::filesystem::copy_options::overwrite_existing);
+}
+
+// Makes the content of the file or directory at `path` durable.
+void syncPath(const std::filesystem::path &path)
+{
+  const FileDescriptor file(path, O_RDONLY);
+  if (::fsync(file.get()) != 0)
+  {
+    throw std::runtime_error("Failed to sync " + path.string() + ": " + std::strerror(errno));
+  }
+}
+
+// Allocates the first `size` bytes of `fd` and extends it to that size, the
+// new bytes reading as zeros. Skipped on file systems without fallocate.
+void allocateFile(const int fd, const std::size_t size, const std::filesystem::path &path)
+{
+  if (::fallocate(fd, 0, 0, static_cast<off_t>(size)) != 0 && errno != EOPNOTSUPP)
+  {
+    throw std::runtime_error("Failed to allocate " + std::to_string(size) + " byte(s) for "
+                             + path.string() + ": " + std::strerror(errno));
+  }
+}
+} // namespace
+
+void PersistentVector::grow()
+{
+  std::cout << "[INFO] Growing, current length: " << this->length << " and capacity "
+            << this->capacity << "\n";
+
+  // Only the last data block is written to. The previous one is now sealed
+  // and, like the other data blocks, only cached once read again: its buffer
+  // is reused for the new one.
+  if (!this->dataBlocks.empty())
+  {
+    this->sealDataBlock(this->dataBlocks.size() - 1);
+  }
+
+  // A data block allocated ahead already exists and only holds zeros.
+  const auto reserved    = !this->reservedDirectoryIds.empty();
+  const auto directoryId = (reserved ? this->reservedDirectoryIds.front()
+                                     : this->selectDirectory(this->dataBlocks.size()));
+  if (reserved)
+  {
+    this->reservedDirectoryIds.erase(this->reservedDirectoryIds.begin());
+  }
+  this->dataBlocks.push_back(this->capacity, this->nextFileId++, DATA_BLOCK_SIZE, directoryId);
+
+  const auto dataBlockId = this->dataBlocks.size() - 1;
+  this->openLastDataBlock(reserved ? O_WRONLY : O_WRONLY | O_CREAT | O_TRUNC);
+
+  auto &cached      = this->cachedDataBlocks[this->dataBlocks.fileIds[dataBlockId]];
+  cached.data       = this->dataBlockBuffers.acquire();
+  cached.lastAccess = ++this->accesses;
+
+  this->capacity += DATA_BLOCK_SIZE;
+
+  if (!this->batching)
+  {
+    this->saveHeader();
+    this->appendToIndex(dataBlockId);
+  }
+}
+
+void PersistentVector::dropEmptyDataBlocks()
+{
+  // Asynchronous appends grow the vector ahead of their commit: the data
+  // blocks grown for appends which then failed hold no element.
+  if (this->dataBlocks.empty() || this->dataBlocks.firstIds.back() <= this->length)
+  {
+    return;
+  }
+
+  this->lastDataBlockFile.close();
+  while (this->dataBlocks.firstIds.back() > this->length)
+  {
+    const auto dataBlockId = this->dataBlocks.size() - 1;
+    const auto fileId      = this->dataBlocks.fileIds[dataBlockId];
+
+    std::cout << "[INFO] Dropping empty data block " << this->dataBlockPath(dataBlockId) << "\n";
+    std::filesystem::remove(this->dataBlockPath(dataBlockId));
+    this->cachedDataBlocks.erase(fileId);
+    this->unflushedFileIds.erase(fileId);
+    this->capacity -= this->dataBlocks.sizes[dataBlockId];
+    this->dataBlocks.erase(dataBlockId);
+  }
+
+  // The data block sealed by the grow is appended to again: it is cached
+  // and, when it was compressed, written back uncompressed.
+  const auto dataBlockId = this->dataBlocks.size() - 1;
+  const auto path        = this->dataBlockPath(dataBlockId);
+  auto cached            = this->cachedDataBlock(dataBlockId);
+  if (cached == nullptr || !cached->data)
+  {
+    cached = &this->cacheDataBlock(dataBlockId, this->loadDataBlockFromDisk(path));
+  }
+  if (isCompressedDataBlock(FileDescriptor(path, O_RDONLY).get()))
+  {
+    auto temporaryPath = path;
+    temporaryPath += TEMPORARY_FILE_EXTENSION;
+    {
+      const FileDescriptor file(temporaryPath, O_WRONLY | O_CREAT | O_TRUNC);
+      writeAll(file.get(), cached->data->data(), cached->data->size());
+    }
+    std::filesystem::rename(temporaryPath, path);
+  }
+
+  // The header commits the smaller capacity first, the index entries after
+  // it being ignored until rewritten.
+  this->saveHeader();
+  this->saveIndex();
+}
+
+void PersistentVector::openLastDataBlock(const int flags)
+{
+  const auto path         = this->dataBlockPath(this->dataBlocks.size() - 1);
+  this->lastDataBlockFile = this->openDataBlock(path, flags);
+
+  // Appends then only write data, the size of the file no longer changes.
+  if (this->options.preallocatedDataBlocks > 0u)
+  {
+    allocateFile(this->lastDataBlockFile.get(), DATA_BLOCK_SIZE * this->layout.slotSize, path);
+    this->reserveDataBlocks(this->options.preallocatedDataBlocks - 1);
+  }
+}
+
+void PersistentVector::reserveDataBlocks(const std::size_t count)
+{
+  // The files are numbered after the last data block, like the ones a
+  // `grow` creates: they are removed as uncommitted when opening the vector.
+  while (this->reservedDirectoryIds.size() < count)
+  {
+    const auto offset      = this->reservedDirectoryIds.size();
+    const auto directoryId = this->selectDirectory(this->dataBlocks.size() + offset);
+    const auto path        = this->directories[directoryId]
+                      / dataBlockFileName(this->nextFileId + static_cast<std::uint32_t>(offset));
+
+    const auto file = this->openDataBlock(path, O_WRONLY | O_CREAT | O_TRUNC);
+    allocateFile(file.get(), DATA_BLOCK_SIZE * this->layout.slotSize, path);
+    this->reservedDirectoryIds.push_back(directoryId);
+
+    std::cout << "[INFO] Allocated data block " << path << " ahead of the writer\n";
+  }
+}
+
+void PersistentVector::releaseReservedDataBlocks()
+{
+  for (std::size_t offset = 0; offset < this->reservedDirectoryIds.size(); ++offset)
+  {
+    std::filesystem::remove(
+      this->directories[this->reservedDirectoryIds[offset]]
+      / dataBlockFileName(this->nextFileId + static_cast<std::uint32_t>(offset)));
+  }
+  this->reservedDirectoryIds.clear();
+}
+
+void PersistentVector::reserve(const std::size_t count)
+{
+  this->ensureWritable();
+
+  if (!this->dataBlocks.empty())
+  {
+    if (!this->lastDataBlockFile.valid())
+    {
+      this->openLastDataBlock(O_WRONLY);
+    }
+    allocateFile(this->lastDataBlockFile.get(), DATA_BLOCK_SIZE * this->layout.slotSize,
+                 this->dataBlockPath(this->dataBlocks.size() - 1));
+  }
+
+  if (count > this->capacity)
+  {
+    this->reserveDataBlocks((count - this->capacity + DATA_BLOCK_SIZE - 1) / DATA_BLOCK_SIZE);
+  }
+
+  std::cout << "[INFO] Reserved room for " << count << " element(s), "
+            << this->reservedDirectoryIds.size() << " data block(s) allocated ahead\n";
+}
+
+auto PersistentVector::selectDirectory(const std::size_t dataBlockId) const -> std::uint8_t
+{
+  // New data blocks are hot.
+  const auto count = this->hotDirectoriesCount;
+  if (count == 1u)
+  {
+    return 0u;
+  }
+
+  if (this->options.striping == StripingPolicy::ROUND_ROBIN)
+  {
+    return static_cast<std::uint8_t>(dataBlockId % count);
+  }
+
+  // Directories are picked with a probability proportional to their free
+  // space, so that they all fill up at the same rate.
+  std::vector<std::uintmax_t> availableSpaces;
+  std::uintmax_t totalSpace = 0;
+  for (std::size_t id = 0; id < count; ++id)
+  {
+    std::error_code error;
+    const auto space = std::filesystem::space(this->directories[id], error);
+    availableSpaces.push_back(error ? 0u : space.available);
+    totalSpace += availableSpaces.back();
+  }
+
+  if (totalSpace == 0u)
+  {
+    return static_cast<std::uint8_t>(dataBlockId % count);
+  }
+
+  const auto draw = (static_cast<std::uintmax_t>(std::rand()) << 31 | std::rand()) % totalSpace;
+
+  std::uintmax_t cumulatedSpace = 0;
+  for (std::size_t id = 0; id < count; ++id)
+  {
+    cumulatedSpace += availableSpaces[id];
+    if (draw < cumulatedSpace)
+    {
+      return static_cast<std::uint8_t>(id);
+    }
+  }
+
+  return static_cast<std::uint8_t>(count - 1);
+}
+
+auto PersistentVector::locateDataBlock(const std::filesystem::path &fileName) const
+  -> std::uint8_t
+{
+  for (std::size_t id = 0; id < this->directories.size(); ++id)
+  {
+    const auto candidate = this->directories[id] / fileName;
+    if (std::filesystem::exists(candidate))
+    {
+      std::cout << "[INFO] Located data block " << fileName << " in " << this->directories[id]
+                << "\n";
+      return static_cast<std::uint8_t>(id);
+    }
+  }
+
+  throw std::runtime_error("Cannot find data block " + fileName.string() + " in any directory");
+}
+
+void PersistentVector::tierDataBlocks() const
+{
+  if (!this->tiering || this->batching)
+  {
+    return;
+  }
+
+  this->commitDataBlockMoves();
+  if (const auto accessCounts = this->tiering->startPass())
+  {
+    this->scheduleDataBlockMoves(*accessCounts);
+  }
+}
+
+void PersistentVector::commitDataBlockMoves() const
+{
+  const auto moves = this->tiering->completed();
+
+  std::vector<std::filesystem::path> sources;
+  for (const auto &move : moves)
+  {
+    // The copy is dropped when the data block was erased, rewritten or
+    // became the one appended to while being copied.
+    const auto dataBlockId = this->findDataBlockIdForFileId(move.fileId);
+
+    struct stat status;
+    const auto unchanged = move.copied && dataBlockId
+                           && *dataBlockId + 1 < this->dataBlocks.size()
+                           && this->dataBlockPath(*dataBlockId) == move.source
+                           && ::stat(move.source.c_str(), &status) == 0
+                           && status.st_ino == move.sourceInode;
+    if (!unchanged)
+    {
+      std::filesystem::remove(move.target);
+      continue;
+    }
+
+    this->dataBlocks.directoryIds[*dataBlockId] = move.toDirectoryId;
+    sources.push_back(move.source);
+  }
+
+  if (sources.empty())
+  {
+    return;
+  }
+
+  // The sources are only removed once the index points to the copies.
+  this->saveIndex();
+  for (const auto &source : sources)
+  {
+    std::filesystem::remove(source);
+  }
+
+  std::cout << "[INFO] Moved " << sources.size() << " data block(s) between tiers\n";
+}
+
+void PersistentVector::scheduleDataBlockMoves(const Tiering::AccessCounts &accessCounts) const
+{
+  const auto coldDirectoryId = static_cast<std::uint8_t>(this->hotDirectoriesCount);
+
+  // The last data block, being appended to, always stays hot.
+  for (std::size_t id = 0; id + 1 < this->dataBlocks.size(); ++id)
+  {
+    const auto fileId = this->dataBlocks.fileIds[id];
+    if (this->tiering->moving(fileId))
+    {
+      continue;
+    }
+
+    const auto counted  = accessCounts.find(fileId);
+    const auto accesses = (counted == accessCounts.end() ? 0u : counted->second);
+    const auto cold     = (this->dataBlocks.directoryIds[id] == coldDirectoryId);
+
+    std::uint8_t targetDirectoryId;
+    if (!cold && accesses == 0u)
+    {
+      targetDirectoryId = coldDirectoryId;
+    }
+    else if (cold && accesses >= this->options.promotionAccesses)
+    {
+      targetDirectoryId = this->selectDirectory(id);
+    }
+    else
+    {
+      continue;
+    }
+
+    const auto source = this->dataBlockPath(id);
+    this->tiering->schedule(Tiering::Move{
+      .fileId        = fileId,
+      .toDirectoryId = targetDirectoryId,
+      .source        = source,
+      .target        = this->directories[targetDirectoryId] / source.filename(),
+    });
+  }
+}
+
+void PersistentVector::import(const std::filesystem::path &file,
+                              const Format &format,
+                              const std::size_t threads)
+{
+  this->ensureWritable();
+  this->ensureNoAsyncAppends();
+  this->tierDataBlocks();
+
+  const MappedFile input(file);
+  const auto content = input.view();
+
+  std::cout << "[INFO] Importing " << file << " (size: " << content.size() << ")\n";
+
+  // Records are validated and split before anything is written: the ones
+  // fitting in the remaining capacity of the last data block are appended
+  // in place, the rest is spread over new data blocks. Deduplicated values
+  // go through the value store one by one: all the records are appended.
+  const auto remainingCapacity = (this->layout.deduplication ? SIZE_MAX
+                                                             : this->capacity - this->length);
+
+  std::vector<std::string_view> tailRecords;
+  std::vector<std::size_t> chunkOffsets;
+  std::size_t recordsCount = 0;
+
+  std::size_t offset = 0;
+  auto recordOffset  = offset;
+  std::string_view record;
+  while (readRecord(content, format, offset, record))
+  {
+    if (tailRecords.size() < remainingCapacity)
+    {
+      tailRecords.push_back(record);
+    }
+    else
+    {
+      if (recordsCount % DATA_BLOCK_SIZE == 0)
+      {
+        chunkOffsets.push_back(recordOffset);
+      }
+      ++recordsCount;
+    }
+
+    recordOffset = offset;
+  }
+
+  for (const auto &tailRecord : tailRecords)
+  {
+    this->push_back(std::string(tailRecord));
+  }
+
+  if (recordsCount == 0u)
+  {
+    return;
+  }
+
+  // Imported data blocks take the file ids of the ones allocated ahead.
+  this->releaseReservedDataBlocks();
+
+  // Imported data blocks are only added to the metadata once written.
+  DataBlocks importedDataBlocks;
+  std::vector<std::filesystem::path> importedPaths;
+  for (std::size_t id = 0; id < chunkOffsets.size(); ++id)
+  {
+    const auto fileId      = this->nextFileId + static_cast<std::uint32_t>(id);
+    const auto directoryId = this->selectDirectory(this->dataBlocks.size() + id);
+    importedDataBlocks.push_back(this->capacity + id * DATA_BLOCK_SIZE, fileId, DATA_BLOCK_SIZE,
+                                 directoryId);
+    importedPaths.push_back(this->directories[directoryId] / dataBlockFileName(fileId));
+  }
+
+  const auto hardwareThreads = std::max(1u, std::thread::hardware_concurrency());
+  const auto workersCount    = std::min(chunkOffsets.size(),
+                                        threads == 0 ? hardwareThreads : threads);
+
+  std::cout << "[INFO] Writing " << recordsCount << " record(s) to " << chunkOffsets.size()
+            << " data block(s) with " << workersCount << " worker(s)\n";
+
+  std::atomic<std::size_t> nextChunk{0};
+  std::vector<std::exception_ptr> errors(workersCount);
+
+  const auto writeChunks = [&](const std::size_t workerId) {
+    try
+    {
+      auto buffer = this->dataBlockBuffers.acquire();
+      std::string compressed;
+      for (auto chunk = nextChunk++; chunk < chunkOffsets.size(); chunk = nextChunk++)
+      {
+        auto recordOffset = chunkOffsets[chunk];
+        std::size_t count = 0;
+        std::string_view chunkRecord;
+        while (count < DATA_BLOCK_SIZE && readRecord(content, format, recordOffset, chunkRecord))
+        {
+          encodeElement(buffer.data() + count * this->layout.slotSize, this->layout.slotSize,
+                        chunkRecord);
+          ++count;
+        }
+
+        // The last imported data block is appended to afterwards.
+        const auto &path = importedPaths[chunk];
+        const std::string_view content(buffer.data(), count * this->layout.slotSize);
+        if (this->options.codec && chunk + 1 < chunkOffsets.size()
+            && this->compressDataBlock(content, compressed))
+        {
+          const FileDescriptor file(path, O_WRONLY | O_CREAT | O_TRUNC);
+          writeAll(file.get(), compressed.data(), compressed.size());
+          continue;
+        }
+
+        const auto file = this->openDataBlock(path, O_WRONLY | O_CREAT | O_TRUNC);
+        writeAt(file.get(), content.data(), content.size(), 0);
+      }
+    }
+    catch (...)
+    {
+      errors[workerId] = std::current_exception();
+    }
+  };
+
+  std::vector<std::thread> workers;
+  for (std::size_t id = 0; id < workersCount; ++id)
+  {
+    workers.emplace_back(writeChunks, id);
+  }
+  for (auto &worker : workers)
+  {
+    worker.join();
+  }
+
+  for (const auto &error : errors)
+  {
+    if (error)
+    {
+      for (const auto &path : importedPaths)
+      {
+        std::filesystem::remove(path);
+      }
+      std::rethrow_exception(error);
+    }
+  }
+
+  // Only the last data block is appended to afterwards.
+  if (!this->dataBlocks.empty())
+  {
+    this->sealDataBlock(this->dataBlocks.size() - 1);
+  }
+
+  const auto firstImportedDataBlockId = this->dataBlocks.size();
+  for (std::size_t id = 0; id < importedDataBlocks.size(); ++id)
+  {
+    this->dataBlocks.push_back(importedDataBlocks.firstIds[id], importedDataBlocks.fileIds[id],
+                               importedDataBlocks.sizes[id], importedDataBlocks.directoryIds[id]);
+  }
+  this->nextFileId += static_cast<std::uint32_t>(importedDataBlocks.size());
+
+  this->capacity += chunkOffsets.size() * DATA_BLOCK_SIZE;
+  this->length += recordsCount;
+
+  this->appendToIndex(firstImportedDataBlockId);
+  this->saveHeader();
+  this->commitVersion();
+  this->syncColumns();
+
+  if (this->hashIndex)
+  {
+    std::vector<std::uint64_t> hashes;
+    hashes.reserve(recordsCount);
+
+    auto recordOffset = chunkOffsets.front();
+    while (readRecord(content, format, recordOffset, record))
+    {
+      hashes.push_back(hash64(record));
+    }
+
+    this->hashIndex->append(hashes);
+  }
+
+  if (this->options.changeFeed)
+  {
+    // All the imported records are published with a single write.
+    this->changesBuffer.clear();
+
+    auto recordOffset = chunkOffsets.front();
+    auto index        = this->length - recordsCount;
+    while (readRecord(content, format, recordOffset, record))
+    {
+      encodeChange(this->changesBuffer, ++this->lastSequence, ChangeType::APPEND, index, index,
+                   record);
+      ++index;
+    }
+
+    writeAll(this->changesFile.get(), this->changesBuffer.data(), this->changesBuffer.size());
+  }
+
+  std::cout << "[INFO] Imported " << recordsCount << " record(s) from " << file
+            << ", length is now " << this->length << "\n";
+}
+
+auto PersistentVector::subscribe(const std::uint64_t fromSequence) const -> ChangeFeed
+{
+  if (!this->options.changeFeed)
+  {
+    throw std::logic_error("Change feed is not enabled for vector at "
+                           + this->directory.string());
+  }
+
+  return ChangeFeed(this->changesFilePath, fromSequence);
+}
+
+auto PersistentVector::sequence() const -> std::uint64_t
+{
+  return this->lastSequence;
+}
+
+auto PersistentVector::refresh() -> bool
+{
+  if (this->options.mode != OpenMode::READ_ONLY)
+  {
+    return false;
+  }
+
+  const auto header = readHeader(this->headerFilePath);
+  if (!header || (header->capacity == this->capacity && header->length == this->length))
+  {
+    return false;
+  }
+
+  const auto [capacity, length] = *header;
+
+  // The writer updates the header before the index: the index might not
+  // describe the new capacity yet, in which case the next refresh will.
+  DataBlocks refreshed;
+  std::size_t loaded = 0;
+
+  std::ifstream indexFile(this->indexFilePath);
+  std::string line;
+  while (loaded < capacity && std::getline(indexFile, line) && !indexFile.eof())
+  {
+    std::istringstream stream(line);
+    auto entry = parseIndexEntry(stream);
+    if (!entry || entry->path)
+    {
+      return false;
+    }
+
+    if (entry->directoryId >= this->directories.size()
+        || !std::filesystem::exists(this->directories[entry->directoryId]
+                                    / dataBlockFileName(entry->fileId)))
+    {
+      try
+      {
+        entry->directoryId = this->locateDataBlock(dataBlockFileName(entry->fileId));
+      }
+      catch (const std::runtime_error &)
+      {
+        return false;
+      }
+    }
+
+    loaded += entry->size;
+    refreshed.push_back(entry->firstId, entry->fileId, entry->size,
+                        static_cast<std::uint8_t>(entry->directoryId));
+  }
+
+  if (loaded != capacity)
+  {
+    return false;
+  }
+
+  // Data blocks are only modified by erasing an element, which changes their
+  // size, or by appending to the last one. Cached content is kept for the
+  // leading data blocks which did not change.
+  std::unordered_map<std::uint32_t, CachedDataBlock> cached;
+  for (std::size_t id = 0; id < refreshed.size() && id + 1 < this->dataBlocks.size(); ++id)
+  {
+    const auto fileId = this->dataBlocks.fileIds[id];
+    if (fileId != refreshed.fileIds[id] || this->dataBlocks.firstIds[id] != refreshed.firstIds[id]
+        || this->dataBlocks.sizes[id] != refreshed.sizes[id])
+    {
+      break;
+    }
+
+    if (const auto previous = this->cachedDataBlocks.find(fileId);
+        previous != this->cachedDataBlocks.end())
+    {
+      cached.emplace(fileId, std::move(previous->second));
+    }
+  }
+
+  // Values are written before the slots referencing them.
+  if (this->valueStore)
+  {
+    this->valueStore->refresh();
+  }
+
+  std::cout << "[INFO] Refreshed " << this->directory << ", length " << this->length << " -> "
+            << length << ", capacity " << this->capacity << " -> " << capacity << "\n";
+
+  this->dataBlocks       = std::move(refreshed);
+  this->cachedDataBlocks = std::move(cached);
+  this->capacity         = capacity;
+  this->length           = length;
+
+  // The log is read after the index: it already holds the data blocks the
+  // index replaced.
+  if (this->options.versioning)
+  {
+    this->loadVersions();
+    this->collectVersions();
+  }
+
+  return true;
+}
+
+auto PersistentVector::waitForChanges(const std::chrono::milliseconds &timeout) -> bool
+{
+  if (this->refresh())
+  {
+    return true;
+  }
+
+  if (!this->notifications.valid())
+  {
+    FileDescriptor notifications(::inotify_init1(IN_NONBLOCK | IN_CLOEXEC));
+    const auto events = IN_MODIFY | IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE;
+    if (notifications.valid()
+        && ::inotify_add_watch(notifications.get(), this->directory.c_str(), events) >= 0)
+    {
+      this->notifications = std::move(notifications);
+    }
+  }
+
+  if (!this->notifications.valid())
+  {
+    std::this_thread::sleep_for(timeout);
+    return this->refresh();
+  }
+
+  pollfd request{.fd = this->notifications.get(), .events = POLLIN, .revents = 0};
+  if (::poll(&request, 1, static_cast<int>(timeout.count())) > 0)
+  {
+    char events[4096];
+    while (::read(this->notifications.get(), events, sizeof(events)) > 0)
+    {}
+  }
+
+  return this->refresh();
+}
+
+void PersistentVector::scanDataBlocks(const SlotsScan &scan,
+                                      const std::atomic<std::size_t> &end,
+                                      const std::size_t begin) const
+{
+  const auto hardwareThreads = std::max(1u, std::thread::hardware_concurrency());
+  const auto workersCount
+    = std::min<std::size_t>(std::max(end.load(), begin) - begin, hardwareThreads);
+  if (workersCount == 0u)
+  {
+    return;
+  }
+
+  std::atomic<std::size_t> nextDataBlock{begin};
+  std::vector<std::exception_ptr> errors(workersCount);
+
+  const auto scanWorker = [&](const std::size_t workerId) {
+    try
+    {
+      AlignedBuffer content;
+      for (auto dataBlockId = nextDataBlock++; dataBlockId < end.load();
+           dataBlockId      = nextDataBlock++)
+      {
+        const auto cached = this->cachedDataBlock(dataBlockId);
+        const auto count  = this->elementsInDataBlock(dataBlockId);
+
+        const char *slots = nullptr;
+        std::size_t size  = 0;
+        if (cached && cached->data)
+        {
+          slots = cached->data->data();
+          size  = cached->data->size();
+        }
+        else if (cached)
+        {
+          slots = cached->mapping->data();
+          size  = cached->mapping->size();
+        }
+        else
+        {
+          content = this->loadDataBlockFromDisk(this->dataBlockPath(dataBlockId));
+          slots   = content.data();
+          size    = content.size();
+        }
+
+        if (size < count * this->layout.slotSize)
+        {
+          throw std::runtime_error("Data block " + this->dataBlockPath(dataBlockId).string()
+                                   + " is truncated");
+        }
+
+        scan(dataBlockId, slots, count);
+      }
+    }
+    catch (...)
+    {
+      errors[workerId] = std::current_exception();
+    }
+  };
+
+  if (workersCount == 1u)
+  {
+    scanWorker(0);
+  }
+  else
+  {
+    std::vector<std::thread> workers;
+    for (std::size_t id = 0; id < workersCount; ++id)
+    {
+      workers.emplace_back(scanWorker, id);
+    }
+    for (auto &worker : workers)
+    {
+      worker.join();
+    }
+  }
+
+  for (const auto &error : errors)
+  {
+    if (error)
+    {
+      std::rethrow_exception(error);
+    }
+  }
+}
+
+template <typename Predicate>
+auto PersistentVector::findFirst(const Predicate &predicate) const -> std::optional<std::size_t>
+{
+  // Data blocks after the first one holding a match are skipped.
+  std::atomic<std::size_t> end{this->dataBlocks.size()};
+  std::vector<std::size_t> firstMatches(this->dataBlocks.size(), this->length);
+
+  this->scanDataBlocks(
+    [&](const std::size_t dataBlockId, const char *slots, const std::size_t count) {
+      for (std::size_t id = 0; id < count; ++id)
+      {
+        if (predicate(this->slotValue(slots + id * this->layout.slotSize)))
+        {
+          firstMatches[dataBlockId] = this->dataBlocks.firstIds[dataBlockId] + id;
+
+          auto current = end.load();
+          while (dataBlockId < current && !end.compare_exchange_weak(current, dataBlockId))
+          {}
+          return;
+        }
+      }
+    },
+    end);
+
+  for (const auto index : firstMatches)
+  {
+    if (index < this->length)
+    {
+      return index;
+    }
+  }
+
+  return {};
+}
+
+auto PersistentVector::find(const std::string_view value) const -> std::optional<std::size_t>
 {
-  this->init();
+  return this->findFirst([value](const std::string_view element) {
+    return element.size() == value.size() && equalBytes(element.data(), value.data(), value.size());
+  });
 }
 
-auto PersistentVector::size() const -> std::size_t
+auto PersistentVector::count(const std::string_view value) const -> std::size_t
 {
-  return this->length;
+  std::atomic<std::size_t> total{0};
+  const std::atomic<std::size_t> end{this->dataBlocks.size()};
+
+  this->scanDataBlocks(
+    [&](const std::size_t, const char *slots, const std::size_t count) {
+      std::size_t matches = 0;
+      for (std::size_t id = 0; id < count; ++id)
+      {
+        const auto element = this->slotValue(slots + id * this->layout.slotSize);
+        matches += element.size() == value.size()
+                   && equalBytes(element.data(), value.data(), value.size());
+      }
+      total += matches;
+    },
+    end);
+
+  return total;
 }
 
-auto PersistentVector::at(const std::size_t index) const -> std::string_view
+auto PersistentVector::find_if(const std::function<bool(std::string_view)> &predicate) const
+  -> std::optional<std::size_t>
 {
-  if (index >= this->length)
+  return this->findFirst(predicate);
+}
+
+auto PersistentVector::search(const std::string_view pattern, const SearchMode &mode) const
+  -> std::vector<std::size_t>
+{
+  std::vector<std::vector<std::size_t>> matches(this->dataBlocks.size());
+  const std::atomic<std::size_t> end{this->dataBlocks.size()};
+
+  this->scanDataBlocks(
+    [&](const std::size_t dataBlockId, const char *slots, const std::size_t count) {
+      const auto firstId = this->dataBlocks.firstIds[dataBlockId];
+      for (std::size_t id = 0; id < count; ++id)
+      {
+        const auto element = this->slotValue(slots + id * this->layout.slotSize);
+        const auto matched = (mode == SearchMode::PREFIX
+                                ? element.size() >= pattern.size()
+                                    && equalBytes(element.data(), pattern.data(), pattern.size())
+                                : findBytes(element, pattern) != std::string_view::npos);
+        if (matched)
+        {
+          matches[dataBlockId].push_back(firstId + id);
+        }
+      }
+    },
+    end);
+
+  std::vector<std::size_t> out;
+  for (const auto &dataBlockMatches : matches)
   {
-    throw std::out_of_range("Requested size " + std::to_string(index) + " but only "
-                            + std::to_string(this->length) + " available");
+    out.insert(out.end(), dataBlockMatches.begin(), dataBlockMatches.end());
   }
 
-  // TODO: Check that the data block is valid.
-  const auto dataBlockId = this->findDataBlockIdForIndex(index);
+  return out;
+}
 
-  auto &dataBlock = *this->dataBlocks.at(dataBlockId);
-  if (dataBlock.cachedData)
+auto PersistentVector::index_of(const std::string_view value) const -> std::optional<std::size_t>
+{
+  if (!this->hashIndex)
   {
-    std::cout << "[INFO] Element " << index
-              << " was already in cache (size: " << dataBlock.cachedData->size() << ")\n";
-    return this->fetchElementDataFromDataBlock(dataBlock, index);
+    return this->find(value);
   }
 
-  // TODO: Verify that the size matches what we expect.
-  dataBlock.cachedData = this->loadDataBlockFromDisk(dataBlock.path);
-
-  std::cout << "[INFO] Loaded element " << index << " from " << dataBlock.path << " with size "
-            << dataBlock.cachedData->size() << "\n";
+  // Elements with the same hash are compared to the value.
+  for (const auto position : this->hashIndex->positions(hash64(value)))
+  {
+    if (this->at(position) == value)
+    {
+      return position;
+    }
+  }
 
-  return this->fetchElementDataFromDataBlock(dataBlock, index);
+  return {};
 }
 
-void PersistentVector::push_back(const std::string &value)
+void PersistentVector::openHashIndex()
 {
-  if (this->capacity == 0u || this->length >= this->capacity)
+  // Modifications made without the index would not be in it, even when they
+  // keep the length unchanged.
+  const auto path = this->directory / HASH_INDEX_FILE_NAME;
+  if (!this->options.hashIndex)
   {
-    std::cout << "[INFO] Need to grow for \"" << value << "\", length is " << this->length
-              << " and capacity " << this->capacity << "\n";
-    this->grow();
+    std::filesystem::remove(path);
+    return;
   }
 
-  // TODO: Check that the size of the value is not bigger than expected.
-  auto &dataBlock = this->dataBlocks.back();
-  this->saveElementToDisk(*dataBlock, value);
-  dataBlock->cachedData.reset();
-  ++this->length;
+  this->hashIndex = std::make_unique<HashIndex>(path);
+  if (this->hashIndex->size() == this->length)
+  {
+    return;
+  }
 
-  // std::cout << "[INFO] Saved element " << this->length << " at " << dataBlock->path
-  //           << ", size: " << value.size() << "\n";
+  // Only the last operation can be missing from the index (or from the
+  // vector) after a crash, which always changes its size.
+  std::cout << "[INFO] Hash index has " << this->hashIndex->size() << " element(s) instead of "
+            << this->length << ", rebuilding it\n";
 
-  this->updateState(Operation::INSERT);
+  std::vector<std::uint64_t> hashes(this->length);
+  const std::atomic<std::size_t> end{this->dataBlocks.size()};
+  this->scanDataBlocks(
+    [&](const std::size_t dataBlockId, const char *slots, const std::size_t count) {
+      const auto firstId = this->dataBlocks.firstIds[dataBlockId];
+      for (std::size_t id = 0; id < count; ++id)
+      {
+        hashes[firstId + id] = hash64(this->slotValue(slots + id * this->layout.slotSize));
+      }
+    },
+    end);
+
+  this->hashIndex->reset(hashes);
 }
 
-void PersistentVector::erase(const std::size_t index)
+void PersistentVector::openColumns()
 {
-  if (index >= this->length)
+  const auto offsetsPath = this->directory / COLUMN_OFFSETS_FILE_NAME;
+  const auto dataPath    = this->directory / COLUMN_DATA_FILE_NAME;
+  if (!this->options.columnarSidecar)
   {
-    throw std::out_of_range("Cannot erase element " + std::to_string(index) + ", only "
-                            + std::to_string(this->length) + " available");
+    std::filesystem::remove(offsetsPath);
+    std::filesystem::remove(dataPath);
+    return;
   }
 
-  const auto dataBlockId = this->findDataBlockIdForIndex(index);
-  auto &dataBlock        = *this->dataBlocks[dataBlockId];
-
-  std::cout << "[INFO] Erasing element " << index << " out of " << this->length
-            << " (capacity: " << this->capacity << ")\n";
-
-  this->removeFromDataBlock(dataBlock, index);
-  --dataBlock.size;
-  dataBlock.cachedData.reset();
+  this->columnOffsetsFile = FileDescriptor(offsetsPath, O_RDWR | O_CREAT);
+  this->columnDataFile    = FileDescriptor(dataPath, O_RDWR | O_CREAT);
 
-  this->updateFollowingDataBlocks(dataBlockId + 1);
+  struct stat offsetsStatus;
+  struct stat dataStatus;
+  if (::fstat(this->columnOffsetsFile.get(), &offsetsStatus) != 0
+      || ::fstat(this->columnDataFile.get(), &dataStatus) != 0)
+  {
+    throw std::runtime_error("Failed to stat the columnar sidecar of "
+                             + this->directory.string() + ": " + std::strerror(errno));
+  }
 
-  if (dataBlock.size == 0)
+  // The offsets of the elements are written after their values: only the
+  // last entries can point past the values after a crash.
+  const auto entries = static_cast<std::size_t>(offsetsStatus.st_size) / sizeof(std::uint64_t);
+  this->columnsLength = (entries == 0u ? 0u : std::min(entries - 1, this->length));
+  while (this->columnsLength > 0u)
   {
-    this->eraseElementFromDisk(dataBlock.path);
+    readAll(this->columnOffsetsFile.get(), reinterpret_cast<char *>(&this->columnsDataSize),
+            sizeof(this->columnsDataSize),
+            static_cast<off_t>(this->columnsLength * sizeof(std::uint64_t)));
+    if (this->columnsDataSize <= static_cast<std::uint64_t>(dataStatus.st_size))
+    {
+      break;
+    }
+    --this->columnsLength;
+  }
 
-    auto toErase = this->dataBlocks.begin();
-    std::advance(toErase, index);
-    this->dataBlocks.erase(toErase);
+  if (this->columnsLength == 0u)
+  {
+    this->columnsDataSize = 0;
+    writeAt(this->columnOffsetsFile.get(), reinterpret_cast<const char *>(&this->columnsDataSize),
+            sizeof(this->columnsDataSize), 0);
   }
 
-  --this->length;
-  --this->capacity;
+  if (this->columnsLength != this->length)
+  {
+    std::cout << "[INFO] Columnar sidecar has " << this->columnsLength
+              << " element(s) instead of " << this->length << ", completing it\n";
+  }
 
-  this->updateState(Operation::ERASE);
+  // Entries past the length, e.g. from a batch which was rolled back, are
+  // dropped before the missing elements are appended.
+  const auto offsetsSize = static_cast<off_t>((this->columnsLength + 1) * sizeof(std::uint64_t));
+  if (::ftruncate(this->columnOffsetsFile.get(), offsetsSize) != 0
+      || ::ftruncate(this->columnDataFile.get(), static_cast<off_t>(this->columnsDataSize)) != 0)
+  {
+    throw std::runtime_error("Failed to truncate the columnar sidecar of "
+                             + this->directory.string() + ": " + std::strerror(errno));
+  }
 
-  std::cout << "[INFO] Erased element " << index << " at " << dataBlock.path << "\n";
+  this->syncColumns();
 }
 
-void PersistentVector::init()
+void PersistentVector::truncateColumns(const std::size_t index)
 {
-  if (std::filesystem::exists(this->headerFilePath))
+  if (!this->columnOffsetsFile.valid() || index >= this->columnsLength)
   {
-    std::cout << "[INFO] Detected existing content at " << this->headerFilePath << ", loading...\n";
-    this->loadFromDisk();
+    return;
   }
-  else
+
+  // The offsets are truncated first: they never point past the values.
+  readAll(this->columnOffsetsFile.get(), reinterpret_cast<char *>(&this->columnsDataSize),
+          sizeof(this->columnsDataSize), static_cast<off_t>(index * sizeof(std::uint64_t)));
+  if (::ftruncate(this->columnOffsetsFile.get(),
+                  static_cast<off_t>((index + 1) * sizeof(std::uint64_t)))
+        != 0
+      || ::ftruncate(this->columnDataFile.get(), static_cast<off_t>(this->columnsDataSize)) != 0)
   {
-    std::cout << "[INFO] Initializing empty directory at " << this->headerFilePath << "\n";
-    this->saveToDisk();
+    throw std::runtime_error("Failed to truncate the columnar sidecar of "
+                             + this->directory.string() + ": " + std::strerror(errno));
   }
-
-  // TODO: Check that the file was correctly open.
-  this->headerFileStream.open(this->headerFilePath, std::ofstream::trunc);
-  this->saveHeader();
+  this->columnsLength = index;
 }
 
-void PersistentVector::updateState(const Operation &operation)
+void PersistentVector::syncColumns()
 {
-  this->saveHeader();
-  if (operation == Operation::ERASE)
+  if (!this->columnOffsetsFile.valid() || this->columnsLength == this->length)
   {
-    this->saveIndex();
+    return;
   }
+
+  this->columnsDataSize
+    += this->writeColumns(this->columnOffsetsFile.get(), this->columnDataFile.get(),
+                          this->columnsLength, this->length, this->columnsLength,
+                          this->columnsDataSize);
+  this->columnsLength = this->length;
 }
 
-void PersistentVector::loadFromDisk()
+auto PersistentVector::writeColumns(const int offsetsFd,
+                                    const int dataFd,
+                                    const std::size_t first,
+                                    const std::size_t last,
+                                    const std::size_t firstEntry,
+                                    const std::uint64_t dataOffset) const -> std::uint64_t
 {
-  this->dataBlocks.clear();
+  if (first == last)
+  {
+    return 0;
+  }
 
-  this->loadHeader();
+  const auto firstDataBlockId = this->findDataBlockIdForIndex(first);
+  const std::atomic<std::size_t> end{this->findDataBlockIdForIndex(last - 1) + 1};
+  const auto slotSize = this->layout.slotSize;
 
-  std::cout << "[INFO] Found " << this->length << " element(s) to load from "
-            << this->headerFilePath << " (capacity: " << this->capacity << ")\n";
+  // Elements of `[first, last)` in a data block, relative to its first id.
+  const auto elementsRange = [&](const std::size_t dataBlockId, const std::size_t count) {
+    const auto firstId = this->dataBlocks.firstIds[dataBlockId];
+    return std::make_pair(std::max(first, firstId) - firstId, std::min(last - firstId, count));
+  };
 
-  this->loadIndex();
-}
+  // The values of each data block are measured first to know where they go.
+  std::vector<std::uint64_t> positions(end.load() - firstDataBlockId + 1, 0);
+  this->scanDataBlocks(
+    [&](const std::size_t dataBlockId, const char *slots, const std::size_t count) {
+      const auto [begin, stop] = elementsRange(dataBlockId, count);
+      std::uint64_t size       = 0;
+      for (auto id = begin; id < stop; ++id)
+      {
+        size += this->slotValue(slots + id * slotSize).size();
+      }
+      positions[dataBlockId - firstDataBlockId + 1] = size;
+    },
+    end, firstDataBlockId);
+  std::inclusive_scan(positions.begin(), positions.end(), positions.begin());
 
-void PersistentVector::saveToDisk()
-{
-  this->saveHeader();
-  this->saveIndex();
-}
+  std::vector<std::uint64_t> offsets(last - first);
+  this->scanDataBlocks(
+    [&](const std::size_t dataBlockId, const char *slots, const std::size_t count) {
+      const auto [begin, stop] = elementsRange(dataBlockId, count);
+      const auto firstId       = this->dataBlocks.firstIds[dataBlockId];
+      auto position            = positions[dataBlockId - firstDataBlockId];
 
-void PersistentVector::loadHeader()
-{
-  // TODO: Check that the file was correctly open.
-  std::ifstream headerFile(this->headerFilePath);
+      std::string values;
+      values.reserve(positions[dataBlockId - firstDataBlockId + 1] - position);
+      for (auto id = begin; id < stop; ++id)
+      {
+        values.append(this->slotValue(slots + id * slotSize));
+        offsets[firstId + id - first] = dataOffset + position + values.size();
+      }
+
+      writeAt(dataFd, values.data(), values.size(), static_cast<off_t>(dataOffset + position));
+    },
+    end, firstDataBlockId);
 
-  headerFile >> this->capacity >> this->length;
+  writeAt(offsetsFd, reinterpret_cast<const char *>(offsets.data()),
+          offsets.size() * sizeof(std::uint64_t),
+          static_cast<off_t>((firstEntry + 1) * sizeof(std::uint64_t)));
 
-  std::size_t capacityFromFile;
-  std::size_t lengthFromFile;
+  return positions.back();
+}
 
-  bool moreEntries = (headerFile.peek() != EOF);
-  while (moreEntries)
+void PersistentVector::openValueStore()
+{
+  const auto readOnly = (this->options.mode == OpenMode::READ_ONLY);
+  this->valueStore    = std::make_unique<ValueStore>(this->directory / VALUES_FILE_NAME, readOnly);
+  if (readOnly)
   {
-    headerFile >> capacityFromFile >> lengthFromFile;
-    moreEntries = (headerFile.peek() != EOF);
+    return;
+  }
+
+  // References are only counted in memory, from the slots of the elements.
+  std::vector<std::vector<std::uint64_t>> references(this->dataBlocks.size());
+  const std::atomic<std::size_t> end{this->dataBlocks.size()};
+  this->scanDataBlocks(
+    [&](const std::size_t dataBlockId, const char *slots, const std::size_t count) {
+      for (std::size_t id = 0; id < count; ++id)
+      {
+        if (const auto key = slotReference(slots + id * this->layout.slotSize))
+        {
+          references[dataBlockId].push_back(*key);
+        }
+      }
+    },
+    end);
 
-    if (moreEntries)
+  for (const auto &keys : references)
+  {
+    for (const auto key : keys)
     {
-      this->capacity = capacityFromFile;
-      this->length   = lengthFromFile;
+      this->valueStore->retain(key);
     }
   }
 
-  std::cout << "[INFO] Loaded capacity " << this->capacity << " and length " << this->length
-            << " from " << this->headerFilePath << "\n";
-}
+  std::cout << "[INFO] " << this->valueStore->size() << " distinct value(s) referenced in "
+            << this->directory << "\n";
 
-void PersistentVector::saveHeader()
-{
-  // TODO: Maybe use binary instead of plain text.
-  this->headerFileStream << this->capacity << " " << this->length << "\n";
-  this->headerFileStream.flush();
+  this->valueStore->collect();
 }
 
-void PersistentVector::loadIndex()
+void PersistentVector::prefetch(const std::size_t first, const std::size_t last) const
 {
-  std::ifstream indexFile(this->indexFilePath);
+  if (first > last || last > this->length)
+  {
+    throw std::out_of_range("Cannot prefetch elements " + std::to_string(first) + " to "
+                            + std::to_string(last) + ", only " + std::to_string(this->length)
+                            + " available");
+  }
 
-  const auto dataBlocksCount = (this->capacity + DATA_BLOCK_SIZE - 1) / DATA_BLOCK_SIZE;
-  for (std::size_t id = 0; id < dataBlocksCount; ++id)
+  if (first == last)
   {
-    std::size_t firstId, size;
-    std::filesystem::path path;
-    indexFile >> firstId >> size >> path;
+    return;
+  }
 
-    std::ofstream dataStream(path, std::ios_base::app);
+  // Each directory is expected to live on its own device.
+  std::vector<std::vector<std::size_t>> dataBlocksPerDirectory(this->directories.size());
+  for (auto dataBlockId = this->findDataBlockIdForIndex(first);
+       dataBlockId < this->dataBlocks.size() && this->dataBlocks.firstIds[dataBlockId] < last;
+       ++dataBlockId)
+  {
+    if (this->cachedDataBlock(dataBlockId) == nullptr)
+    {
+      dataBlocksPerDirectory[this->dataBlocks.directoryIds[dataBlockId]].push_back(dataBlockId);
+    }
+  }
 
-    auto dataBlock        = std::make_unique<DataBlock>();
-    dataBlock->path       = path;
-    dataBlock->dataStream = std::move(dataStream);
-    dataBlock->firstId    = firstId;
-    dataBlock->size       = size;
+  std::vector<std::vector<AlignedBuffer>> contentPerDirectory(this->directories.size());
+  std::vector<std::exception_ptr> errors(this->directories.size());
+  std::vector<std::thread> readers;
+  for (std::size_t directoryId = 0; directoryId < this->directories.size(); ++directoryId)
+  {
+    const auto &toLoad = dataBlocksPerDirectory[directoryId];
+    if (toLoad.empty())
+    {
+      continue;
+    }
 
-    std::cout << "[INFO] Loading element " << id << " with path " << path << " and first id "
-              << firstId << " and size " << size << "\n";
+    auto &content = contentPerDirectory[directoryId];
+    auto &error   = errors[directoryId];
+    content.resize(toLoad.size());
+    readers.emplace_back([this, &toLoad, &content, &error]() {
+      try
+      {
+        for (std::size_t id = 0; id < toLoad.size(); ++id)
+        {
+          content[id] = this->loadDataBlockFromDisk(this->dataBlockPath(toLoad[id]));
+        }
+      }
+      catch (...)
+      {
+        error = std::current_exception();
+      }
+    });
+  }
 
-    this->dataBlocks.push_back(std::move(dataBlock));
+  for (auto &reader : readers)
+  {
+    reader.join();
   }
-}
 
-void PersistentVector::saveIndex() const
-{
-  std::ofstream indexFile;
-  // TODO: Check that the file was correctly open.
-  indexFile.open(this->indexFilePath, std::ofstream::trunc);
+  // Nothing is cached when a data block could not be loaded.
+  for (const auto &error : errors)
+  {
+    if (error)
+    {
+      std::rethrow_exception(error);
+    }
+  }
 
-  // TODO: Maybe use binary instead of plain text.
-  for (std::size_t id = 0; id < this->dataBlocks.size(); ++id)
+  for (std::size_t directoryId = 0; directoryId < this->directories.size(); ++directoryId)
   {
-    const auto &dataBlock = *this->dataBlocks[id];
-    indexFile << dataBlock.firstId << " " << dataBlock.size << " " << dataBlock.path << "\n";
+    const auto &toLoad = dataBlocksPerDirectory[directoryId];
+    auto &content      = contentPerDirectory[directoryId];
+    for (std::size_t id = 0; id < toLoad.size(); ++id)
+    {
+      this->cacheDataBlock(toLoad[id], std::move(content[id]));
+    }
   }
 }
 
-void PersistentVector::appendToIndex(const DataBlock &dataBlock) const
+void PersistentVector::checkpoint(const std::filesystem::path &targetDirectory)
 {
-  std::ofstream indexFile;
-  // TODO: Check that the file was correctly open.
-  indexFile.open(this->indexFilePath, std::ofstream::app);
+  if (std::filesystem::exists(targetDirectory) && !std::filesystem::is_empty(targetDirectory))
+  {
+    throw std::invalid_argument("Cannot checkpoint to " + targetDirectory.string()
+                                + ", directory is not empty");
+  }
 
-  indexFile << dataBlock.firstId << " " << dataBlock.size << " " << dataBlock.path << "\n";
-}
+  std::filesystem::create_directories(targetDirectory);
+  syncPath(std::filesystem::canonical(targetDirectory).parent_path());
 
-auto PersistentVector::loadDataBlockFromDisk(const std::filesystem::path &path) const -> std::string
-{
-  std::ifstream in(path, std::ios::binary | std::ios::ate);
-  const auto size = in.tellg();
-  in.seekg(0, std::ios::beg);
+  // Everything written so far needs to be visible in the files, data blocks
+  // are written without any user space buffering.
+  this->headerFileStream.flush();
 
-  std::string buffer;
-  buffer.resize(size);
-  in.read(buffer.data(), size);
+  // Full data blocks are never modified in place so they can be shared with
+  // the checkpoint: only the last one, still being appended to, is copied.
+  for (std::size_t id = 0; id < this->dataBlocks.size(); ++id)
+  {
+    const auto path = this->dataBlockPath(id);
+    const auto copy = targetDirectory / path.filename();
 
-  std::cout << "[INFO] Loading content of " << path << " (size: " << buffer.size() << ", " << size
-            << "): \"" << buffer << "\"\n";
-  return buffer;
-}
+    std::error_code error;
+    if (id + 1 < this->dataBlocks.size())
+    {
+      std::filesystem::create_hard_link(path, copy, error);
+    }
+    if (id + 1 == this->dataBlocks.size() || error)
+    {
+      cloneFile(path, copy);
+    }
+    syncPath(copy);
+  }
 
-void PersistentVector::saveElementToDisk(DataBlock &dataBlock, const std::string &value)
-{
-  std::fill(this->saveToDiskBuffer.begin(), this->saveToDiskBuffer.end(), '\0');
+  // The checkpoint keeps the file ids, all in its single directory.
+  std::ofstream indexFile(targetDirectory / INDEX_FILE_NAME, std::ofstream::trunc);
+  for (std::size_t id = 0; id < this->dataBlocks.size(); ++id)
+  {
+    indexFile << this->dataBlocks.firstIds[id] << " " << +this->dataBlocks.sizes[id] << " "
+              << this->dataBlocks.fileIds[id] << " 0\n";
+  }
+  indexFile.close();
+  if (!indexFile)
+  {
+    throw std::runtime_error("Failed to write checkpoint metadata to " + targetDirectory.string());
+  }
+  syncPath(targetDirectory / INDEX_FILE_NAME);
 
-  const auto valueSize   = value.size();
-  const auto rawSizeData = reinterpret_cast<const char *>(&valueSize);
-  std::copy(rawSizeData, rawSizeData + sizeof(std::size_t), this->saveToDiskBuffer.begin());
+  // The value store is appended to in place, like the last data block.
+  if (this->layout.deduplication)
+  {
+    std::filesystem::copy_file(this->directory / LAYOUT_FILE_NAME,
+                               targetDirectory / LAYOUT_FILE_NAME);
+    cloneFile(this->directory / VALUES_FILE_NAME, targetDirectory / VALUES_FILE_NAME);
+    syncPath(targetDirectory / LAYOUT_FILE_NAME);
+    syncPath(targetDirectory / VALUES_FILE_NAME);
+  }
 
-  auto startOfData = this->saveToDiskBuffer.begin();
-  std::advance(startOfData, sizeof(std::size_t));
-  std::copy(value.begin(), value.end(), startOfData);
+  // The header commits the checkpoint: it is only written once the rest is
+  // durable.
+  syncPath(targetDirectory);
 
-  dataBlock.dataStream.write(this->saveToDiskBuffer.c_str(), this->saveToDiskBuffer.size());
-  dataBlock.dataStream.flush();
+  std::ofstream headerFile(targetDirectory / HEADER_FILE_NAME, std::ofstream::trunc);
+  headerFile << this->capacity << " " << this->length << "\n";
+  headerFile.close();
+  if (!headerFile)
+  {
+    throw std::runtime_error("Failed to write checkpoint metadata to " + targetDirectory.string());
+  }
+  syncPath(targetDirectory / HEADER_FILE_NAME);
+  syncPath(targetDirectory);
 
-  // std::cout << "[INFO] Saved \"" << value << "\" to " << dataBlock.path << "\n";
+  std::cout << "[INFO] Checkpointed " << this->length << " element(s) in "
+            << this->dataBlocks.size() << " data block(s) to " << targetDirectory << "\n";
 }
 
-void PersistentVector::eraseElementFromDisk(const std::filesystem::path &path) const
+void PersistentVector::export_to(const int fd,
+                                 const std::size_t first,
+                                 const std::size_t last,
+                                 const Format &format) const
 {
-  // TODO: Check that the content was actually deleted.
-  std::filesystem::remove(path);
-  std::cout << "[INFO] Erased content at " << path << "\n";
-}
+  if (first > last || last > this->length)
+  {
+    throw std::out_of_range("Cannot export elements " + std::to_string(first) + " to "
+                            + std::to_string(last) + ", only " + std::to_string(this->length)
+                            + " available");
+  }
 
-namespace {
-const std::string SYMBOLS = "0123456789abcdefghijklmnopqrstuvwxyz";
+  if (first == last)
+  {
+    return;
+  }
 
-auto generateRandomPrefix(const std::size_t length) -> std::string
-{
-  std::string out;
-  out.reserve(length);
+  std::string buffer;
+  AlignedBuffer content;
+  std::vector<iovec> buffers;
+  std::vector<std::size_t> sizes;
+  constexpr char NEWLINE = '\n';
+  static const char PADDING[DATA_BLOCK_ELEMENT_SIZE] = {};
 
-  for (std::size_t id = 0; id < length; ++id)
+  // Slots of deduplicated vectors are rebuilt from their values.
+  const auto slotSize = this->layout.slotSize;
+  const auto rawSlots = !this->layout.deduplication;
+
+  for (auto dataBlockId = this->findDataBlockIdForIndex(first);
+       dataBlockId < this->dataBlocks.size() && this->dataBlocks.firstIds[dataBlockId] < last;
+       ++dataBlockId)
   {
-    out += SYMBOLS[std::rand() % SYMBOLS.size()];
-  }
+    const auto firstId = this->dataBlocks.firstIds[dataBlockId];
+    const auto begin   = std::max(first, firstId) - firstId;
+    const auto end     = std::min(last - firstId, this->elementsInDataBlock(dataBlockId));
 
-  return out;
-}
+    const auto offset = begin * slotSize;
+    const auto size   = (end - begin) * slotSize;
 
-auto generateRandomFileName(const std::size_t length, const std::string_view extension)
-  -> std::string
-{
-  auto out = generateRandomPrefix(length);
-  out += extension;
-  return out;
+    const char *data  = nullptr;
+    const auto cached = this->cachedDataBlock(dataBlockId);
+    if (cached && cached->data)
+    {
+      data = cached->data->data() + offset;
+    }
+    else if (cached)
+    {
+      data = cached->mapping->data() + offset;
+    }
+    else if (const FileDescriptor in(this->dataBlockPath(dataBlockId), O_RDONLY);
+             this->options.directIo || isCompressedDataBlock(in.get()))
+    {
+      // Exported data blocks are not cached.
+      content = this->loadDataBlockFromDisk(this->dataBlockPath(dataBlockId));
+      if (content.size() < offset + size)
+      {
+        throw std::runtime_error("Data block " + this->dataBlockPath(dataBlockId).string()
+                                 + " is truncated");
+      }
+      data = content.data() + offset;
+    }
+    else if (format == Format::SLOTS && rawSlots)
+    {
+      transferFileRange(in.get(), fd, static_cast<off_t>(offset), size);
+      continue;
+    }
+    else
+    {
+      buffer.resize(size);
+      readAll(in.get(), buffer.data(), size, static_cast<off_t>(offset));
+      data = buffer.data();
+    }
+
+    buffers.clear();
+    sizes.resize(end - begin);
+    for (std::size_t id = 0; id < end - begin; ++id)
+    {
+      const auto slot    = const_cast<char *>(data + id * slotSize);
+      const auto element = this->slotValue(slot);
+      const auto value   = const_cast<char *>(element.data());
+      sizes[id]          = element.size();
+
+      switch (format)
+      {
+        case Format::NEWLINE:
+          buffers.push_back({value, element.size()});
+          buffers.push_back({const_cast<char *>(&NEWLINE), 1});
+          break;
+        case Format::LENGTH_PREFIXED:
+          if (rawSlots)
+          {
+            buffers.push_back({slot, sizeof(std::size_t) + element.size()});
+            break;
+          }
+          buffers.push_back({&sizes[id], sizeof(std::size_t)});
+          buffers.push_back({value, element.size()});
+          break;
+        case Format::SLOTS:
+          if (rawSlots)
+          {
+            buffers.push_back({slot, slotSize});
+            break;
+          }
+          buffers.push_back({&sizes[id], sizeof(std::size_t)});
+          buffers.push_back({value, element.size()});
+          buffers.push_back({const_cast<char *>(PADDING),
+                             DATA_BLOCK_ELEMENT_SIZE - sizeof(std::size_t) - element.size()});
+          break;
+      }
+    }
+
+    writeVectors(fd, buffers);
+  }
 }
-} // namespace
 
-void PersistentVector::grow()
+void PersistentVector::export_columns(const std::filesystem::path &offsetsFile,
+                                      const std::filesystem::path &dataFile,
+                                      const std::size_t first,
+                                      const std::size_t last) const
 {
-  std::cout << "[INFO] Growing, current length: " << this->length << " and capacity "
-            << this->capacity << "\n";
-
-  // TODO: Check that path does not exist yet.
-  const auto fileName = generateRandomFileName(ELEMENT_FILE_NAME_LENGTH, ELEMENT_FILE_EXTENSION);
-  const auto filePath = this->directory / fileName;
+  if (first > last || last > this->length)
+  {
+    throw std::out_of_range("Cannot export elements " + std::to_string(first) + " to "
+                            + std::to_string(last) + ", only " + std::to_string(this->length)
+                            + " available");
+  }
 
-  std::ofstream dataStream(filePath, std::ios_base::trunc);
+  const FileDescriptor offsets(offsetsFile, O_WRONLY | O_CREAT | O_TRUNC);
+  const FileDescriptor data(dataFile, O_WRONLY | O_CREAT | O_TRUNC);
 
-  auto dataBlock        = std::make_unique<DataBlock>();
-  dataBlock->path       = filePath;
-  dataBlock->dataStream = std::move(dataStream);
-  dataBlock->firstId    = this->capacity;
-  dataBlock->size       = DATA_BLOCK_SIZE;
+  const std::uint64_t firstOffset = 0;
+  writeAll(offsets.get(), reinterpret_cast<const char *>(&firstOffset), sizeof(firstOffset));
+  const auto size = this->writeColumns(offsets.get(), data.get(), first, last, 0, 0);
 
-  this->dataBlocks.push_back(std::move(dataBlock));
+  std::cout << "[INFO] Exported " << last - first << " element(s) as columns to " << offsetsFile
+            << " and " << dataFile << " (" << size << " byte(s) of values)\n";
+}
 
-  this->capacity += DATA_BLOCK_SIZE;
+auto PersistentVector::elementsInDataBlock(const std::size_t dataBlockId) const -> std::size_t
+{
+  // Only the last data block can be partially filled.
+  if (dataBlockId + 1 == this->dataBlocks.size())
+  {
+    return this->length - this->dataBlocks.firstIds[dataBlockId];
+  }
 
-  this->saveHeader();
-  this->appendToIndex(*this->dataBlocks.back());
+  return this->dataBlocks.sizes[dataBlockId];
 }
 
 auto PersistentVector::findDataBlockIdForIndex(const std::size_t index) const -> std::size_t
 {
-  std::size_t dataBlockId = 1;
-  bool tooFar             = false;
-  while (dataBlockId < this->dataBlocks.size() && !tooFar)
+  // First ids are strictly increasing, the first one being 0: the data block
+  // is the last one starting at or before `index`.
+  const auto &firstIds = this->dataBlocks.firstIds;
+  const auto next      = std::upper_bound(firstIds.begin(), firstIds.end(), index);
+
+  return static_cast<std::size_t>(next - firstIds.begin()) - 1;
+}
+
+auto PersistentVector::findDataBlockIdForFileId(const std::uint32_t fileId) const
+  -> std::optional<std::size_t>
+{
+  // Erases of versioned vectors give data blocks new file ids: they are not
+  // sorted.
+  const auto &fileIds = this->dataBlocks.fileIds;
+  const auto found    = std::find(fileIds.begin(), fileIds.end(), fileId);
+  if (found == fileIds.end())
   {
-    const auto &dataBlock = *this->dataBlocks[dataBlockId];
-    tooFar                = dataBlock.firstId > index;
-    if (!tooFar)
-    {
-      ++dataBlockId;
-    }
+    return std::nullopt;
   }
 
-  return dataBlockId - 1;
+  return static_cast<std::size_t>(found - fileIds.begin());
 }
 
-auto PersistentVector::fetchElementDataFromDataBlock(const DataBlock &dataBlock,
+auto PersistentVector::fetchElementDataFromDataBlock(const CachedDataBlock &dataBlock,
+                                                     const std::size_t dataBlockId,
                                                      const std::size_t index) const
   -> std::string_view
 {
-  const auto elementDataBlockId            = index - dataBlock.firstId;
-  const auto positionOfSizeInDataStream    = elementDataBlockId * DATA_BLOCK_ELEMENT_SIZE;
-  const auto positionOfElementInDataStream = positionOfSizeInDataStream + sizeof(std::size_t);
+  const auto elementDataBlockId         = index - this->dataBlocks.firstIds[dataBlockId];
+  const auto positionOfSizeInDataStream = elementDataBlockId * this->layout.slotSize;
 
-  const auto rawBlockData = dataBlock.cachedData->c_str();
+  const auto rawBlockData = (dataBlock.data ? dataBlock.data->data() : dataBlock.mapping->data());
 
-  const auto elementSize = *reinterpret_cast<const std::size_t *>(rawBlockData
-                                                                  + positionOfSizeInDataStream);
+  const auto out = this->slotValue(rawBlockData + positionOfSizeInDataStream);
 
-  std::string_view out(rawBlockData + positionOfElementInDataStream,
-                       rawBlockData + positionOfElementInDataStream + elementSize);
-
-  std::cout << "[INFO] Determined size " << elementSize << " for element " << index
-            << " (data block offset: " << dataBlock.firstId << "), value = \"" << out << "\"\n";
+  // std::cout << "[INFO] Determined size " << elementSize << " for element " << index
+  //           << " (data block: " << dataBlockId << "), value = \"" << out << "\"\n";
 
   return out;
 }
 
-void PersistentVector::removeFromDataBlock(DataBlock &dataBlock, const std::size_t index)
+void PersistentVector::removeFromDataBlock(const std::size_t dataBlockId, const std::size_t index)
 {
-  dataBlock.cachedData = this->loadDataBlockFromDisk(dataBlock.path);
-  // TODO: Verify that we don't have truncated data.
-  const auto actualElementsCount = dataBlock.cachedData->size() / DATA_BLOCK_ELEMENT_SIZE;
+  const auto path     = this->dataBlockPath(dataBlockId);
+  const auto last     = (dataBlockId + 1 == this->dataBlocks.size());
+  auto content        = this->loadDataBlockFromDisk(path);
+  const auto slotSize = this->layout.slotSize;
+
+  // Allocated slots past the last element are not part of the data block.
+  content.resize(std::min(content.size(), this->elementsInDataBlock(dataBlockId) * slotSize));
+  const auto position = (index - this->dataBlocks.firstIds[dataBlockId]) * slotSize;
+  if (position + slotSize > content.size())
+  {
+    throw std::runtime_error("Data block " + path.string() + " is truncated");
+  }
 
-  dataBlock.dataStream.close();
-  dataBlock.dataStream.open(dataBlock.path, std::ios_base::trunc);
+  const auto reference = slotReference(content.data() + position);
+  std::memmove(content.data() + position, content.data() + position + slotSize,
+               content.size() - position - slotSize);
+  content.resize(content.size() - slotSize);
 
-  const auto elementDataBlockId = index - dataBlock.firstId;
-  for (std::size_t id = 0; id < actualElementsCount; ++id)
+  // The data block is written to a new file which then replaces the old
+  // one: the file might be shared with a checkpoint through a hard link.
+  // Versioned vectors keep the old file for the older versions, the data
+  // block getting a new file id instead, as do batches until they are
+  // applied.
+  const auto copyOnWrite = (this->options.versioning || this->batching);
+  auto temporaryPath     = path;
+  temporaryPath += TEMPORARY_FILE_EXTENSION;
+  if (copyOnWrite)
   {
-    if (id == elementDataBlockId)
-    {
-      continue;
-    }
+    this->releaseReservedDataBlocks();
+    temporaryPath = this->directories[this->dataBlocks.directoryIds[dataBlockId]]
+                    / dataBlockFileName(this->nextFileId);
+  }
+
+  // Sealed data blocks stay compressed.
+  std::string compressed;
+  const std::string_view view(content.data(), content.size());
+  if (this->options.codec && !last && this->compressDataBlock(view, compressed))
+  {
+    const FileDescriptor file(temporaryPath, O_WRONLY | O_CREAT | O_TRUNC);
+    writeAll(file.get(), compressed.data(), compressed.size());
+  }
+  else
+  {
+    const auto file = this->openDataBlock(temporaryPath, O_WRONLY | O_CREAT | O_TRUNC);
+    writeAt(file.get(), content.data(), content.size(), 0);
+  }
+
+  if (copyOnWrite && !this->options.versioning)
+  {
+    this->replacedFiles.push_back(path);
+    this->cachedDataBlocks.erase(this->dataBlocks.fileIds[dataBlockId]);
+  }
+  if (copyOnWrite)
+  {
+    this->dataBlocks.fileIds[dataBlockId] = this->nextFileId++;
+  }
+  else
+  {
+    std::filesystem::rename(temporaryPath, path);
+  }
+  if (last)
+  {
+    this->lastDataBlockFile.close();
+  }
 
-    const auto elementId = dataBlock.firstId + id;
-    const auto value     = std::string(this->fetchElementDataFromDataBlock(dataBlock, elementId));
+  this->cacheDataBlock(dataBlockId, std::move(content));
 
-    std::cout << "[INFO] Saving element " << elementId << " (block index: " << id
-              << ", offset: " << dataBlock.firstId << ") \"" << value << "\" to " << dataBlock.path
-              << "\n";
+  // The value is only dropped once no slot references it anymore.
+  if (reference)
+  {
+    this->valueStore->release(*reference);
+  }
+}
 
-    this->saveElementToDisk(dataBlock, value);
+auto PersistentVector::slotValue(const char *slot) const -> std::string_view
+{
+  if (const auto key = slotReference(slot))
+  {
+    if (!this->valueStore)
+    {
+      throw std::runtime_error("Vector at " + this->directory.string()
+                               + " holds a reference but is not deduplicated");
+    }
+    return this->valueStore->get(*key);
   }
+
+  std::size_t size;
+  std::memcpy(&size, slot, sizeof(size));
+  return {slot + sizeof(std::size_t), std::min(size, this->layout.slotSize - sizeof(std::size_t))};
 }
 
 void PersistentVector::updateFollowingDataBlocks(const std::size_t startDataBlockId)
 {
   for (std::size_t id = startDataBlockId; id < this->dataBlocks.size(); ++id)
   {
-    --this->dataBlocks[id]->firstId;
+    --this->dataBlocks.firstIds[id];
   }
 }
 
@@ -1,46 +1,422 @@
 
 #pragma once
 
+#include "AlignedBuffer.hh"
+#include "AsyncIo.hh"
+#include "Awaitable.hh"
+#include "ChangeFeed.hh"
+#include "Codec.hh"
+#include "FileDescriptor.hh"
+#include "HashIndex.hh"
+#include "MappedFile.hh"
+#include "Tiering.hh"
+#include "ValueStore.hh"
+#include "WriteBatch.hh"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <deque>
 #include <filesystem>
 #include <fstream>
+#include <functional>
+#include <memory>
+#include <memory_resource>
 #include <optional>
+#include <span>
 #include <string>
+#include <string_view>
+#include <type_traits>
 #include <unordered_map>
+#include <unordered_set>
+#include <utility>
 #include <vector>
 
 namespace storage::v2 {
 
+// Record layouts understood by the bulk import and export. Length prefixed
+// records are preceded by their size as a native `std::size_t`, like in the
+// data block files. Slots are the fixed size regions of the data blocks.
+enum class Format
+{
+  NEWLINE,
+  LENGTH_PREFIXED,
+  SLOTS
+};
+
+// How new data blocks are spread over the directories of a striped vector.
+enum class StripingPolicy
+{
+  ROUND_ROBIN,
+  FREE_SPACE
+};
+
+enum class SearchMode
+{
+  PREFIX,
+  SUBSTRING
+};
+
+// Only one process can open a vector for writing. Read-only vectors can be
+// opened concurrently and follow the writer with `refresh`.
+enum class OpenMode
+{
+  READ_WRITE,
+  READ_ONLY
+};
+
+struct Options
+{
+  OpenMode mode{OpenMode::READ_WRITE};
+  StripingPolicy striping{StripingPolicy::ROUND_ROBIN};
+
+  // Records every operation in a sequence numbered log next to the header,
+  // which can be followed with `subscribe`.
+  bool changeFeed{false};
+
+  // Maintains a persistent index from the hash of the elements to their
+  // positions next to the header, used by `index_of`. Rebuilt from the data
+  // blocks when it does not match the vector, e.g. after a crash. Opening the
+  // vector for writing without it removes the index.
+  bool hashIndex{false};
+
+  // Reads and writes data blocks with O_DIRECT, bypassing the page cache,
+  // when the file system supports it. Data blocks are then only cached by
+  // the vector itself.
+  bool directIo{false};
+
+  // Maximum number of data blocks kept in memory besides the last one, the
+  // least recently used one being dropped first. Views returned by `at` are
+  // only valid until the next call to `at` when set. No limit when 0.
+  std::size_t cachedDataBlocks{0};
+
+  // Number of data blocks allocated with fallocate ahead of the writer, the
+  // one being appended to included, so appends never extend a file. Meant
+  // for synced appends: buffered ones gain nothing, ext4 even converting the
+  // allocated extents on the first write. Slots past the length of the
+  // header are never read back as elements. No preallocation when 0.
+  std::size_t preallocatedDataBlocks{0};
+
+  // Moves the sealed data blocks which were neither read nor written during
+  // a whole `tieringInterval` to `coldDirectory`, e.g. on a larger and
+  // cheaper volume, and back to the other directories once read
+  // `promotionAccesses` times during an interval. Files are copied in the
+  // background and the index records where each data block is. The cold
+  // directory must be given to every vector opening the directory. No
+  // tiering when empty.
+  std::filesystem::path coldDirectory{};
+  std::chrono::milliseconds tieringInterval{std::chrono::minutes(1)};
+  std::size_t promotionAccesses{2};
+
+  // Keeps the past states of the vector, read with `at(index, version)` and
+  // `size(version)`. Every push_back, erase and import is a new version.
+  // Data blocks rewritten by an erase get a new file, the previous one being
+  // kept as long as one of the last `retainedVersions` versions uses it.
+  // Opening the vector without versioning drops its history. Cannot be
+  // combined with deduplication.
+  bool versioning{false};
+  std::size_t retainedVersions{1000};
+
+  // Maintains a copy of the elements laid out as columns, an offsets file and
+  // a data file next to the header which can be mapped with `Columns`.
+  // Appends are added to it as they are applied and erases rewrite it from
+  // the erased element on. Opening the vector for writing without it
+  // removes the sidecar.
+  bool columnarSidecar{false};
+
+  // Stores the values longer than `deduplicationThreshold` only once, in a
+  // content addressed file next to the header, their slots holding a
+  // reference instead. Slots are then shrunk to fit the shorter values.
+  // Both are fixed when the vector is created and cannot be combined with
+  // direct I/O.
+  bool deduplication{false};
+  std::size_t deduplicationThreshold{24};
+
+  // Compresses the data blocks with `codec` once they are full, e.g. with
+  // the built-in LzCodec. The last data block is always kept raw. Data
+  // blocks compressed with a codec which is not built-in can only be read
+  // back with that codec.
+  std::shared_ptr<const Codec> codec{};
+
+  // Runs the I/O of `async_at`, `async_push_back` and `async_flush`, which
+  // complete from its `poll`. Can be shared between vectors.
+  std::shared_ptr<AsyncIo> asyncIo{};
+
+  // Where the buffers of the cached data blocks are allocated from, e.g. a
+  // std::pmr::monotonic_buffer_resource arena. Buffers are recycled by the
+  // vector so it is only used when more data blocks are cached at once.
+  std::pmr::memory_resource *memoryResource{std::pmr::get_default_resource()};
+};
+
 // TODO: Not thread safe.
 class PersistentVector
 {
   public:
-  explicit PersistentVector(const std::filesystem::path &directory);
+  explicit PersistentVector(const std::filesystem::path &directory, const Options &options = {});
+
+  // Spreads the data blocks over `directories`. The header and index are kept
+  // in the first directory already holding them, or in the first one for a
+  // new vector: the order of the directories can change between runs.
+  explicit PersistentVector(const std::vector<std::filesystem::path> &directories,
+                            const Options &options = {});
+
+  // Removes the data blocks allocated ahead.
+  ~PersistentVector();
 
   auto size() const -> std::size_t;
   auto at(const std::size_t index) const -> std::string_view;
-  void push_back(const std::string &value);
+
+  // Reads the elements at `indices`, in their order. The data blocks holding
+  // them are each looked up once and the ones not cached are loaded in
+  // parallel. The views are valid until the next read, like those of `at`.
+  auto multi_get(const std::span<const std::size_t> indices) const
+    -> std::vector<std::string_view>;
+
+  // Reads the vector as it was at `version`, which must be one of the
+  // retained versions. Requires versioning to be enabled.
+  auto version() const -> std::uint64_t;
+  auto size(const std::uint64_t version) const -> std::size_t;
+  auto at(const std::size_t index, const std::uint64_t version) const -> std::string_view;
+
+  void push_back(const std::string_view value);
+  void push_back(std::string &&value);
+  void push_back(const char *value);
+
+  // Appends an element built from `args` as a std::string_view, or as a
+  // std::string when that is not possible, and returns it.
+  template <typename... Args>
+  auto emplace_back(Args &&...args) -> std::string_view;
+
   void erase(const std::size_t index);
 
+  // Applies the operations of `batch` as a single one. The batch is written
+  // and synced to a log next to the header before being applied, the header
+  // only being updated once all operations are: a vector opened after a
+  // crash applies the logged batch again from the state before it. Erases
+  // write data blocks to new files instead of replacing them. Cannot be
+  // used with deduplication.
+  void write(const WriteBatch &batch);
+
+  // Allocates the data block files needed to hold `count` elements. Data
+  // blocks allocated ahead are removed when the vector is destroyed.
+  void reserve(const std::size_t count);
+
+  // Picks up the elements committed by the writer since the last call, for
+  // read-only vectors. Returns whether the vector changed.
+  auto refresh() -> bool;
+
+  // Waits at most `timeout` for the writer to modify the vector, then
+  // refreshes it.
+  auto waitForChanges(const std::chrono::milliseconds &timeout) -> bool;
+
+  // Appends all records of `file` to the vector. Full data blocks are
+  // encoded and written by `threads` workers (defaults to the number of
+  // cores) and committed to the index and header in a single step.
+  void import(const std::filesystem::path &file,
+              const Format &format,
+              const std::size_t threads = 0);
+
+  // Searches run inside the vector over the raw data blocks with the SIMD
+  // kernels of Search.hh, the data blocks being spread over one thread per
+  // core. Data blocks which are not cached are read without being cached.
+  auto find(const std::string_view value) const -> std::optional<std::size_t>;
+  auto count(const std::string_view value) const -> std::size_t;
+
+  // `predicate` is called concurrently from several threads.
+  auto find_if(const std::function<bool(std::string_view)> &predicate) const
+    -> std::optional<std::size_t>;
+
+  // Returns the indexes of the elements starting with or containing
+  // `pattern`, in increasing order.
+  auto search(const std::string_view pattern, const SearchMode &mode) const
+    -> std::vector<std::size_t>;
+
+  // Returns the position of the first element equal to `value`, through the
+  // hash index when enabled or with `find` otherwise.
+  auto index_of(const std::string_view value) const -> std::optional<std::size_t>;
+
+  // Returns the changes applied to the vector from `fromSequence` onwards,
+  // sequence numbers start at 1. Requires the change feed to be enabled.
+  auto subscribe(const std::uint64_t fromSequence) const -> ChangeFeed;
+  auto sequence() const -> std::uint64_t;
+
+  // Loads the data blocks holding `[first, last)` in the cache, reading the
+  // data blocks of each directory in parallel.
+  void prefetch(const std::size_t first, const std::size_t last) const;
+
+  // Creates a consistent copy of the vector in `targetDirectory`, which must
+  // be empty. Full data blocks are hard linked and only the last data block
+  // and the metadata are copied.
+  void checkpoint(const std::filesystem::path &targetDirectory);
+
+  // Streams the elements in `[first, last)` to `fd`. Slots are copied from
+  // file to file by the kernel whenever the data block is not cached, the
+  // other formats are written with vectored I/O from a single read.
+  void export_to(const int fd,
+                 const std::size_t first,
+                 const std::size_t last,
+                 const Format &format) const;
+
+  // Writes the elements in `[first, last)` to an offsets file and a data
+  // file readable with `Columns`. The values of the data blocks are measured
+  // then written in place by parallel workers.
+  void export_columns(const std::filesystem::path &offsetsFile,
+                      const std::filesystem::path &dataFile,
+                      const std::size_t first,
+                      const std::size_t last) const;
+
+  // Awaitable variants of `at` and `push_back`, their I/O being submitted to
+  // `Options::asyncIo` and completed by its `poll`. Reads of a data block
+  // which is not cached share a single load, the element being copied once
+  // it is cached. Appends return the index of the element and are visible,
+  // and written to the header, in order once their slot is written: other
+  // writes throw while some are pending. The vector must outlive the
+  // operations it started.
+  auto async_at(const std::size_t index) const -> Awaitable<std::string>;
+  auto async_push_back(const std::string_view value) -> Awaitable<std::size_t>;
+
+  // Syncs the data blocks appended to since the last flush, then the index
+  // and the header: the elements appended before the call are durable once
+  // it completes.
+  auto async_flush() -> Awaitable<void>;
+
   private:
+  // The cold directory, if any, comes after the other ones.
+  std::vector<std::filesystem::path> directories{};
+  std::size_t hotDirectoriesCount{};
+  Options options{};
   std::filesystem::path directory{};
   std::filesystem::path headerFilePath{};
   std::ofstream headerFileStream{};
   std::filesystem::path indexFilePath{};
+  FileDescriptor directoryLock{};
+  FileDescriptor notifications{};
 
-  struct DataBlock
+  struct Layout
   {
-    std::filesystem::path path{};
-    std::ofstream dataStream{};
-    std::size_t firstId{};
-    std::size_t size{};
-    mutable std::optional<std::string> cachedData{};
+    bool deduplication{};
+    std::size_t slotSize{};
+  };
+  Layout layout{};
+
+  // Content of the cached data blocks.
+  mutable BufferPool dataBlockBuffers;
+
+  // Metadata of the data blocks, one entry per data block in each array.
+  // Their files are numbered in creation order and named after that number
+  // in the directory of `directoryIds`, so no path is stored.
+  struct DataBlocks
+  {
+    std::vector<std::size_t> firstIds{};
+    std::vector<std::uint32_t> fileIds{};
+    std::vector<std::uint8_t> sizes{};
+
+    // Data blocks can move between tiers on reads.
+    mutable std::vector<std::uint8_t> directoryIds{};
+
+    auto size() const -> std::size_t;
+    auto empty() const -> bool;
+    void push_back(const std::size_t firstId,
+                   const std::uint32_t fileId,
+                   const std::size_t size,
+                   const std::uint8_t directoryId);
+    void erase(const std::size_t dataBlockId);
+    void clear();
+  };
+
+  struct CachedDataBlock
+  {
+    std::optional<AlignedBuffer> data{};
+    std::unique_ptr<MappedFile> mapping{};
+    std::uint64_t lastAccess{};
   };
 
   std::size_t capacity{};
   std::size_t length{};
-  std::vector<std::unique_ptr<DataBlock>> dataBlocks{};
+  DataBlocks dataBlocks{};
+  std::uint32_t nextFileId{};
+
+  // Only the last data block, the one being appended to, is kept open.
+  FileDescriptor lastDataBlockFile{};
+
+  // Directories of the data block files allocated ahead of the writer, which
+  // are numbered from `nextFileId` on.
+  std::vector<std::uint8_t> reservedDirectoryIds{};
+
+  // Content of the data blocks in memory, by file id.
+  mutable std::unordered_map<std::uint32_t, CachedDataBlock> cachedDataBlocks{};
+
+  mutable std::uint64_t accesses{};
+
+  std::filesystem::path changesFilePath{};
+  FileDescriptor changesFile{};
+  std::uint64_t lastSequence{};
+  std::string changesBuffer{};
+
+  std::unique_ptr<HashIndex> hashIndex{};
+
+  // The columnar sidecar holds the first `columnsLength` elements.
+  FileDescriptor columnOffsetsFile{};
+  FileDescriptor columnDataFile{};
+  std::size_t columnsLength{};
+  std::uint64_t columnsDataSize{};
+
+  std::unique_ptr<ValueStore> valueStore{};
+  std::unique_ptr<Tiering> tiering{};
+
+  // Versions after the last epoch use the current data blocks, an epoch
+  // holding the data blocks of the versions up to `lastVersion` from before
+  // an erase changed them.
+  struct Epoch
+  {
+    std::uint64_t lastVersion{};
+    DataBlocks dataBlocks{};
+  };
+
+  std::filesystem::path versionsFilePath{};
+  std::ofstream versionsFileStream{};
+  std::uint64_t currentVersion{};
+  std::uint64_t oldestVersion{};
+  std::deque<std::size_t> versionLengths{};
+  std::deque<Epoch> epochs{};
+  std::size_t staleVersionRecords{};
 
-  std::string saveToDiskBuffer{};
+  // Data blocks being loaded by `async_at`, by file id, with the reads
+  // waiting for them.
+  struct AsyncLoad
+  {
+    FileDescriptor file{};
+    AlignedBuffer content{};
+    std::size_t size{};
+    std::size_t loaded{};
+    std::vector<std::function<void(const std::exception_ptr &)>> waiters{};
+  };
+  mutable std::unordered_map<std::uint32_t, std::unique_ptr<AsyncLoad>> asyncLoads{};
+
+  // Appends whose slot is being written, committed in order. A failed one
+  // fails all the appends pending with it.
+  struct AsyncAppend
+  {
+    FileDescriptor file{};
+    std::string slot{};
+    std::string value{};
+    bool written{false};
+    std::exception_ptr error{};
+    std::shared_ptr<Awaitable<std::size_t>::State> state{};
+  };
+  std::deque<std::unique_ptr<AsyncAppend>> asyncAppends{};
+  std::exception_ptr asyncAppendError{};
+
+  // Files of the data blocks appended to since the last `async_flush`.
+  std::unordered_set<std::uint32_t> unflushedFileIds{};
+
+  // While a batch is applied, the header, the index and the change feed are
+  // only written once at the end and the files replaced by erases are only
+  // removed then.
+  std::filesystem::path batchFilePath{};
+  FileDescriptor batchFile{};
+  bool batching{false};
+  std::vector<std::filesystem::path> replacedFiles{};
 
   enum class Operation
   {
@@ -49,8 +425,52 @@ class PersistentVector
   };
 
   void init();
+  void lockDirectory();
+  void ensureWritable() const;
+  void ensureNoAsyncAppends() const;
+  auto asyncIo() const -> AsyncIo &;
   void updateState(const Operation &operation);
 
+  static auto loadLayout(const std::filesystem::path &directory, const Options &options)
+    -> Layout;
+  void saveLayout() const;
+
+  void openChangeFeed();
+  void openHashIndex();
+  void openVersions();
+  void openValueStore();
+  void recordChange(const ChangeType &type,
+                    const std::size_t index,
+                    const std::size_t lengthBefore,
+                    const std::string_view value);
+
+  void openColumns();
+  void truncateColumns(const std::size_t index);
+  void syncColumns();
+
+  // Writes the values in `[first, last)` to `dataFd` from `dataOffset` on,
+  // then their end offsets to `offsetsFd` from entry `firstEntry + 1` on.
+  // Returns the size of the values.
+  auto writeColumns(const int offsetsFd,
+                    const int dataFd,
+                    const std::size_t first,
+                    const std::size_t last,
+                    const std::size_t firstEntry,
+                    const std::uint64_t dataOffset) const -> std::uint64_t;
+
+  auto recoverBatch() -> std::optional<WriteBatch>;
+  void saveBatch(const WriteBatch &batch);
+  void abortBatch(const std::uint64_t sequence, const std::uint32_t nextFileId);
+  void clearBatch();
+
+  void loadVersions();
+  void saveVersions();
+  void freezeDataBlocks();
+  void commitVersion();
+  auto collectVersions() -> std::vector<Epoch>;
+  void removeUnreferencedFiles(const std::vector<Epoch> &droppedEpochs);
+  auto versionDataBlocks(const std::uint64_t version) const -> const DataBlocks &;
+
   void loadFromDisk();
   void saveToDisk();
 
@@ -58,20 +478,91 @@ class PersistentVector
   void saveHeader();
 
   void loadIndex();
+  void upgradeIndex(const std::vector<std::filesystem::path> &paths);
   void saveIndex() const;
-  void appendToIndex(const DataBlock &dataBlock) const;
+  void appendToIndex(const std::size_t startDataBlockId) const;
+  static void writeIndexEntries(std::ostream &out,
+                                const DataBlocks &dataBlocks,
+                                const std::size_t startDataBlockId);
+  void removeUncommittedDataBlocks() const;
+
+  auto dataBlockPath(const std::size_t dataBlockId) const -> std::filesystem::path;
+  auto cachedDataBlock(const std::size_t dataBlockId) const -> CachedDataBlock *;
+  auto cachedFile(const std::uint32_t fileId) const -> CachedDataBlock *;
 
-  auto loadDataBlockFromDisk(const std::filesystem::path &path) const -> std::string;
-  void saveElementToDisk(DataBlock &dataBlock, const std::string &value);
+  auto openDataBlock(const std::filesystem::path &path, const int flags) const -> FileDescriptor;
+  auto loadDataBlockFromDisk(const std::filesystem::path &path) const -> AlignedBuffer;
+  auto loadDataBlock(const std::size_t dataBlockId) const -> CachedDataBlock;
+  auto cacheDataBlock(const std::size_t dataBlockId, AlignedBuffer &&content) const
+    -> CachedDataBlock &;
+  auto cacheFile(const std::uint32_t fileId, AlignedBuffer &&content) const -> CachedDataBlock &;
+  void evictDataBlocks() const;
+  void saveElementToDisk(const std::size_t position, const std::string_view value);
+  auto encodeElementInCache(const std::size_t position, const std::string_view value)
+    -> const char *;
+  void commitAppend(const std::string_view value);
+  void commitAsyncAppends();
+  void readDataBlockAsync(const std::uint32_t fileId) const;
+  void completeDataBlockRead(const std::uint32_t fileId, const std::int64_t result) const;
   void eraseElementFromDisk(const std::filesystem::path &path) const;
 
+  // Compressed data blocks are decompressed straight into the buffers of the
+  // cache.
+  auto compressDataBlock(const std::string_view content, std::string &out) const -> bool;
+  auto decompressDataBlock(const std::filesystem::path &path, const std::string_view data) const
+    -> AlignedBuffer;
+  void sealDataBlock(const std::size_t dataBlockId);
+
   void grow();
+  void dropEmptyDataBlocks();
+  void openLastDataBlock(const int flags);
+  void reserveDataBlocks(const std::size_t count);
+  void releaseReservedDataBlocks();
+  auto selectDirectory(const std::size_t dataBlockId) const -> std::uint8_t;
+  auto locateDataBlock(const std::filesystem::path &fileName) const -> std::uint8_t;
+
+  // Commits the moves copied in the background and schedules new ones once
+  // a tiering interval elapsed.
+  void tierDataBlocks() const;
+  void commitDataBlockMoves() const;
+  void scheduleDataBlockMoves(const Tiering::AccessCounts &accessCounts) const;
 
+  auto elementsInDataBlock(const std::size_t dataBlockId) const -> std::size_t;
   auto findDataBlockIdForIndex(const std::size_t index) const -> std::size_t;
-  auto fetchElementDataFromDataBlock(const DataBlock &dataBlock, const std::size_t index) const
-    -> std::string_view;
-  void removeFromDataBlock(DataBlock &dataBlock, const std::size_t index);
+  auto findDataBlockIdForFileId(const std::uint32_t fileId) const -> std::optional<std::size_t>;
+  auto fetchElementDataFromDataBlock(const CachedDataBlock &dataBlock,
+                                     const std::size_t dataBlockId,
+                                     const std::size_t index) const -> std::string_view;
+  void removeFromDataBlock(const std::size_t dataBlockId, const std::size_t index);
+
+  // The element held by a slot, resolving references to the value store.
+  auto slotValue(const char *slot) const -> std::string_view;
+
+  // Calls `scan` with the slots of each data block with an id in
+  // `[begin, end)`, `end` can be lowered while scanning to stop early.
+  using SlotsScan = std::function<
+    void(const std::size_t dataBlockId, const char *slots, const std::size_t count)>;
+  void scanDataBlocks(const SlotsScan &scan,
+                      const std::atomic<std::size_t> &end,
+                      const std::size_t begin = 0) const;
+  template <typename Predicate>
+  auto findFirst(const Predicate &predicate) const -> std::optional<std::size_t>;
   void updateFollowingDataBlocks(const std::size_t startDataBlockId);
 };
 
+template <typename... Args>
+auto PersistentVector::emplace_back(Args &&...args) -> std::string_view
+{
+  if constexpr (std::is_constructible_v<std::string_view, Args &&...>)
+  {
+    this->push_back(std::string_view(std::forward<Args>(args)...));
+  }
+  else
+  {
+    this->push_back(std::string(std::forward<Args>(args)...));
+  }
+
+  return this->at(this->length - 1);
+}
+
 } // namespace storage::v2
@@ -0,0 +1,72 @@
+
+#include "Protocol.hh"
+
+#include <cstring>
+#include <stdexcept>
+
+namespace storage {
+
+auto Frame::size() const -> std::size_t
+{
+  return FRAME_HEADER_SIZE + this->payload.size();
+}
+
+void appendFrame(std::string &out, const std::uint8_t type, const std::string_view payload)
+{
+  if (payload.size() > MAX_PAYLOAD_SIZE)
+  {
+    throw std::length_error("Payload of " + std::to_string(payload.size())
+                            + " byte(s) is too large to be sent");
+  }
+
+  const auto size = static_cast<std::uint32_t>(payload.size());
+  out.append(reinterpret_cast<const char *>(&size), sizeof(size));
+  out.push_back(static_cast<char>(type));
+  out.append(payload);
+}
+
+auto parseFrame(const std::string_view data) -> std::optional<Frame>
+{
+  std::uint32_t size;
+  if (data.size() < FRAME_HEADER_SIZE)
+  {
+    return {};
+  }
+
+  std::memcpy(&size, data.data(), sizeof(size));
+  if (size > MAX_PAYLOAD_SIZE)
+  {
+    throw std::length_error("Received a payload of " + std::to_string(size)
+                            + " byte(s), more than the maximum of "
+                            + std::to_string(MAX_PAYLOAD_SIZE));
+  }
+  if (data.size() < FRAME_HEADER_SIZE + size)
+  {
+    return {};
+  }
+
+  return Frame{
+    .type    = static_cast<std::uint8_t>(data[sizeof(size)]),
+    .payload = data.substr(FRAME_HEADER_SIZE, size),
+  };
+}
+
+void appendInteger(std::string &out, const std::uint64_t value)
+{
+  out.append(reinterpret_cast<const char *>(&value), sizeof(value));
+}
+
+auto readInteger(std::string_view &data) -> std::optional<std::uint64_t>
+{
+  std::uint64_t value;
+  if (data.size() < sizeof(value))
+  {
+    return {};
+  }
+
+  std::memcpy(&value, data.data(), sizeof(value));
+  data.remove_prefix(sizeof(value));
+  return value;
+}
+
+} // namespace storage
@@ -0,0 +1,50 @@
+
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+
+namespace storage {
+
+// Frames exchanged with a `Server`: the size of the payload as a 32 bits
+// integer, a type byte and the payload. Requests carry an `Opcode` and
+// responses a `Status`, responses being sent in the order of the requests.
+// Integers are 64 bits and use the byte order of the host.
+enum class Opcode : std::uint8_t
+{
+  PUSH_BACK = 1, // value -> index of the new element
+  AT        = 2, // index -> value
+  ERASE     = 3, // index -> nothing
+  SIZE      = 4, // nothing -> size
+  SCAN      = 5, // first, last -> size and bytes of each value in [first, last)
+};
+
+enum class Status : std::uint8_t
+{
+  OK    = 0,
+  ERROR = 1, // the payload is the error message
+};
+
+constexpr std::size_t FRAME_HEADER_SIZE = sizeof(std::uint32_t) + sizeof(std::uint8_t);
+constexpr std::size_t MAX_PAYLOAD_SIZE  = 64u << 20u;
+
+struct Frame
+{
+  std::uint8_t type{};
+  std::string_view payload{};
+
+  auto size() const -> std::size_t;
+};
+
+void appendFrame(std::string &out, const std::uint8_t type, const std::string_view payload);
+
+// Frame at the start of `data`, nothing when it is not complete yet. Throws
+// when its payload is larger than `MAX_PAYLOAD_SIZE`.
+auto parseFrame(const std::string_view data) -> std::optional<Frame>;
+
+void appendInteger(std::string &out, const std::uint64_t value);
+auto readInteger(std::string_view &data) -> std::optional<std::uint64_t>;
+
+} // namespace storage
@@ -0,0 +1,233 @@
+
+#include "Search.hh"
+
+#include <cstring>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define STORAGE_X86_KERNELS
+#endif
+
+namespace storage {
+
+namespace {
+auto equalBytesScalar(const char *left, const char *right, const std::size_t size) -> bool
+{
+  return std::memcmp(left, right, size) == 0;
+}
+
+// Looks for the first byte of the needle with memchr and checks the rest.
+auto findBytesScalar(const std::string_view haystack, const std::string_view needle)
+  -> std::size_t
+{
+  if (needle.empty())
+  {
+    return 0u;
+  }
+  if (needle.size() > haystack.size())
+  {
+    return std::string_view::npos;
+  }
+
+  const auto last = haystack.data() + haystack.size() - needle.size();
+  auto candidate  = haystack.data();
+  while (candidate <= last)
+  {
+    candidate = static_cast<const char *>(
+      std::memchr(candidate, needle.front(), static_cast<std::size_t>(last - candidate) + 1u));
+    if (candidate == nullptr)
+    {
+      break;
+    }
+    if (std::memcmp(candidate + 1, needle.data() + 1, needle.size() - 1) == 0)
+    {
+      return static_cast<std::size_t>(candidate - haystack.data());
+    }
+    ++candidate;
+  }
+
+  return std::string_view::npos;
+}
+
+#ifdef STORAGE_X86_KERNELS
+__attribute__((target("sse4.2"))) auto equalBytesSse42(const char *left,
+                                                        const char *right,
+                                                        const std::size_t size) -> bool
+{
+  std::size_t offset = 0;
+  for (; offset + 16u <= size; offset += 16u)
+  {
+    const auto a = _mm_loadu_si128(reinterpret_cast<const __m128i *>(left + offset));
+    const auto b = _mm_loadu_si128(reinterpret_cast<const __m128i *>(right + offset));
+    if (_mm_movemask_epi8(_mm_cmpeq_epi8(a, b)) != 0xFFFF)
+    {
+      return false;
+    }
+  }
+
+  return std::memcmp(left + offset, right + offset, size - offset) == 0;
+}
+
+__attribute__((target("avx2"))) auto equalBytesAvx2(const char *left,
+                                                    const char *right,
+                                                    const std::size_t size) -> bool
+{
+  std::size_t offset = 0;
+  for (; offset + 32u <= size; offset += 32u)
+  {
+    const auto a = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(left + offset));
+    const auto b = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(right + offset));
+    if (static_cast<unsigned>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(a, b))) != 0xFFFFFFFFu)
+    {
+      return false;
+    }
+  }
+
+  return equalBytesSse42(left + offset, right + offset, size - offset);
+}
+
+// Compares the first and last bytes of the needle with 16 (or 32) positions
+// of the haystack at once, only the positions matching both are checked in
+// full.
+__attribute__((target("sse4.2"))) auto findBytesSse42(const std::string_view haystack,
+                                                      const std::string_view needle)
+  -> std::size_t
+{
+  if (needle.size() < 2u || haystack.size() < needle.size() + 15u)
+  {
+    return findBytesScalar(haystack, needle);
+  }
+
+  const auto first = _mm_set1_epi8(needle.front());
+  const auto last  = _mm_set1_epi8(needle.back());
+  const auto end   = haystack.size() - needle.size() + 1u;
+
+  std::size_t offset = 0;
+  for (; offset + 16u <= end; offset += 16u)
+  {
+    const auto head = _mm_loadu_si128(reinterpret_cast<const __m128i *>(haystack.data() + offset));
+    const auto tail = _mm_loadu_si128(
+      reinterpret_cast<const __m128i *>(haystack.data() + offset + needle.size() - 1u));
+
+    auto mask = static_cast<unsigned>(
+      _mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(head, first), _mm_cmpeq_epi8(tail, last))));
+    while (mask != 0u)
+    {
+      const auto position = offset + static_cast<std::size_t>(__builtin_ctz(mask));
+      if (std::memcmp(haystack.data() + position + 1u, needle.data() + 1u, needle.size() - 2u) == 0)
+      {
+        return position;
+      }
+      mask &= mask - 1u;
+    }
+  }
+
+  const auto rest = findBytesScalar(haystack.substr(offset), needle);
+  return rest == std::string_view::npos ? rest : offset + rest;
+}
+
+__attribute__((target("avx2"))) auto findBytesAvx2(const std::string_view haystack,
+                                                   const std::string_view needle) -> std::size_t
+{
+  if (needle.size() < 2u || haystack.size() < needle.size() + 31u)
+  {
+    return findBytesSse42(haystack, needle);
+  }
+
+  const auto first = _mm256_set1_epi8(needle.front());
+  const auto last  = _mm256_set1_epi8(needle.back());
+  const auto end   = haystack.size() - needle.size() + 1u;
+
+  std::size_t offset = 0;
+  for (; offset + 32u <= end; offset += 32u)
+  {
+    const auto head = _mm256_loadu_si256(
+      reinterpret_cast<const __m256i *>(haystack.data() + offset));
+    const auto tail = _mm256_loadu_si256(
+      reinterpret_cast<const __m256i *>(haystack.data() + offset + needle.size() - 1u));
+
+    auto mask = static_cast<unsigned>(_mm256_movemask_epi8(
+      _mm256_and_si256(_mm256_cmpeq_epi8(head, first), _mm256_cmpeq_epi8(tail, last))));
+    while (mask != 0u)
+    {
+      const auto position = offset + static_cast<std::size_t>(__builtin_ctz(mask));
+      if (std::memcmp(haystack.data() + position + 1u, needle.data() + 1u, needle.size() - 2u) == 0)
+      {
+        return position;
+      }
+      mask &= mask - 1u;
+    }
+  }
+
+  const auto rest = findBytesSse42(haystack.substr(offset), needle);
+  return rest == std::string_view::npos ? rest : offset + rest;
+}
+#endif
+} // namespace
+
+auto detectSimdLevel() -> SimdLevel
+{
+#ifdef STORAGE_X86_KERNELS
+  static const auto level = []() {
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+    {
+      return SimdLevel::AVX2;
+    }
+    if (__builtin_cpu_supports("sse4.2"))
+    {
+      return SimdLevel::SSE42;
+    }
+    return SimdLevel::SCALAR;
+  }();
+
+  return level;
+#else
+  return SimdLevel::SCALAR;
+#endif
+}
+
+auto equalBytes(const char *left, const char *right, const std::size_t size) -> bool
+{
+  return equalBytes(left, right, size, detectSimdLevel());
+}
+
+auto equalBytes(const char *left, const char *right, const std::size_t size, const SimdLevel level)
+  -> bool
+{
+  switch (level)
+  {
+#ifdef STORAGE_X86_KERNELS
+    case SimdLevel::AVX2:
+      return equalBytesAvx2(left, right, size);
+    case SimdLevel::SSE42:
+      return equalBytesSse42(left, right, size);
+#endif
+    default:
+      return equalBytesScalar(left, right, size);
+  }
+}
+
+auto findBytes(const std::string_view haystack, const std::string_view needle) -> std::size_t
+{
+  return findBytes(haystack, needle, detectSimdLevel());
+}
+
+auto findBytes(const std::string_view haystack,
+               const std::string_view needle,
+               const SimdLevel level) -> std::size_t
+{
+  switch (level)
+  {
+#ifdef STORAGE_X86_KERNELS
+    case SimdLevel::AVX2:
+      return findBytesAvx2(haystack, needle);
+    case SimdLevel::SSE42:
+      return findBytesSse42(haystack, needle);
+#endif
+    default:
+      return findBytesScalar(haystack, needle);
+  }
+}
+
+} // namespace storage
@@ -0,0 +1,31 @@
+
+#pragma once
+
+#include <cstddef>
+#include <string_view>
+
+namespace storage {
+
+// Instruction sets the search kernels can use, detected once at run time.
+enum class SimdLevel
+{
+  SCALAR,
+  SSE42,
+  AVX2
+};
+
+auto detectSimdLevel() -> SimdLevel;
+
+// Returns whether the `size` bytes at `left` and `right` are equal.
+auto equalBytes(const char *left, const char *right, const std::size_t size) -> bool;
+auto equalBytes(const char *left, const char *right, const std::size_t size, const SimdLevel level)
+  -> bool;
+
+// Returns the position of the first occurrence of `needle` in `haystack`, or
+// std::string_view::npos.
+auto findBytes(const std::string_view haystack, const std::string_view needle) -> std::size_t;
+auto findBytes(const std::string_view haystack,
+               const std::string_view needle,
+               const SimdLevel level) -> std::size_t;
+
+} // namespace storage
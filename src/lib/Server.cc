@@ -0,0 +1,320 @@
+
+#include "Server.hh"
+
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace storage {
+
+constexpr std::size_t MAX_EVENTS         = 64;
+constexpr std::size_t RECEIVE_SIZE       = 64u << 10u;
+constexpr std::size_t MAX_PENDING_OUTPUT = 4u << 20u;
+constexpr int LISTEN_BACKLOG             = 128;
+
+namespace {
+auto systemError(const std::string &message) -> std::runtime_error
+{
+  return std::runtime_error(message + ": " + std::strerror(errno));
+}
+
+void control(const int poller, const int operation, const int fd, const std::uint32_t events)
+{
+  epoll_event event{};
+  event.events  = events;
+  event.data.fd = fd;
+  if (::epoll_ctl(poller, operation, fd, &event) != 0)
+  {
+    throw systemError("Failed to watch fd " + std::to_string(fd));
+  }
+}
+
+auto readIndex(std::string_view &payload) -> std::size_t
+{
+  const auto index = readInteger(payload);
+  if (!index)
+  {
+    throw std::invalid_argument("Missing index in request");
+  }
+  return *index;
+}
+} // namespace
+
+Server::Server(Engine &engine, const std::filesystem::path &socketPath)
+  : engine(engine)
+  , socketPath(socketPath)
+  , listener(::socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0))
+  , poller(::epoll_create1(EPOLL_CLOEXEC))
+  , wakeup(::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC))
+{
+  if (!this->listener.valid() || !this->poller.valid() || !this->wakeup.valid())
+  {
+    throw systemError("Failed to create the server for " + socketPath.string());
+  }
+
+  sockaddr_un address{};
+  address.sun_family = AF_UNIX;
+  if (socketPath.native().size() >= sizeof(address.sun_path))
+  {
+    throw std::invalid_argument("Socket path " + socketPath.string() + " is too long");
+  }
+  std::strcpy(address.sun_path, socketPath.c_str());
+
+  // A socket left by a previous server cannot be bound again.
+  std::filesystem::remove(socketPath);
+  if (::bind(this->listener.get(), reinterpret_cast<const sockaddr *>(&address), sizeof(address))
+        != 0
+      || ::listen(this->listener.get(), LISTEN_BACKLOG) != 0)
+  {
+    throw systemError("Failed to listen on " + socketPath.string());
+  }
+
+  control(this->poller.get(), EPOLL_CTL_ADD, this->listener.get(), EPOLLIN);
+  control(this->poller.get(), EPOLL_CTL_ADD, this->wakeup.get(), EPOLLIN);
+}
+
+Server::~Server()
+{
+  std::error_code error;
+  std::filesystem::remove(this->socketPath, error);
+}
+
+void Server::run()
+{
+  std::cout << "[INFO] Serving on " << this->socketPath << "\n";
+
+  epoll_event events[MAX_EVENTS];
+  while (true)
+  {
+    const auto count = ::epoll_wait(this->poller.get(), events, MAX_EVENTS, -1);
+    if (count < 0 && errno == EINTR)
+    {
+      continue;
+    }
+    if (count < 0)
+    {
+      throw systemError("Failed to wait for clients on " + this->socketPath.string());
+    }
+
+    for (int id = 0; id < count; ++id)
+    {
+      const auto fd = events[id].data.fd;
+      if (fd == this->wakeup.get())
+      {
+        std::cout << "[INFO] Stopped serving on " << this->socketPath << "\n";
+        this->connections.clear();
+        return;
+      }
+      if (fd == this->listener.get())
+      {
+        this->accept();
+        continue;
+      }
+
+      const auto found = this->connections.find(fd);
+      if (found == this->connections.end())
+      {
+        continue;
+      }
+
+      auto &connection = found->second;
+      const auto ready = events[id].events;
+      if (((ready & (EPOLLIN | EPOLLHUP | EPOLLERR)) != 0u && !this->receive(connection))
+          || !this->send(connection))
+      {
+        this->close(fd);
+        continue;
+      }
+      this->watch(connection);
+    }
+  }
+}
+
+void Server::stop()
+{
+  const std::uint64_t value = 1;
+  // Nothing else is async-signal-safe here: a failure cannot be reported.
+  [[maybe_unused]] const auto written = ::write(this->wakeup.get(), &value, sizeof(value));
+}
+
+void Server::accept()
+{
+  while (true)
+  {
+    FileDescriptor socket(
+      ::accept4(this->listener.get(), nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC));
+    if (!socket.valid())
+    {
+      if (errno == EAGAIN || errno == EWOULDBLOCK || errno == ECONNABORTED)
+      {
+        return;
+      }
+      throw systemError("Failed to accept a client on " + this->socketPath.string());
+    }
+
+    const auto fd = socket.get();
+    control(this->poller.get(), EPOLL_CTL_ADD, fd, EPOLLIN);
+    this->connections.emplace(fd, Connection{.socket = std::move(socket), .events = EPOLLIN});
+  }
+}
+
+void Server::close(const int fd)
+{
+  ::epoll_ctl(this->poller.get(), EPOLL_CTL_DEL, fd, nullptr);
+  this->connections.erase(fd);
+}
+
+auto Server::receive(Connection &connection) -> bool
+{
+  char buffer[RECEIVE_SIZE];
+  while (connection.output.size() < MAX_PENDING_OUTPUT)
+  {
+    const auto received = ::recv(connection.socket.get(), buffer, sizeof(buffer), 0);
+    if (received < 0 && errno == EINTR)
+    {
+      continue;
+    }
+    if (received < 0)
+    {
+      return errno == EAGAIN || errno == EWOULDBLOCK;
+    }
+    if (received == 0)
+    {
+      return false;
+    }
+
+    connection.input.append(buffer, static_cast<std::size_t>(received));
+    try
+    {
+      this->process(connection);
+    }
+    catch (const std::length_error &error)
+    {
+      std::cout << "[INFO] Closing client " << connection.socket.get() << ": " << error.what()
+                << "\n";
+      return false;
+    }
+  }
+
+  return true;
+}
+
+auto Server::send(Connection &connection) -> bool
+{
+  std::size_t offset = 0;
+  while (offset < connection.output.size())
+  {
+    const auto sent = ::send(connection.socket.get(), connection.output.data() + offset,
+                             connection.output.size() - offset, MSG_NOSIGNAL);
+    if (sent < 0 && errno == EINTR)
+    {
+      continue;
+    }
+    if (sent < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+    {
+      break;
+    }
+    if (sent < 0)
+    {
+      return false;
+    }
+
+    offset += static_cast<std::size_t>(sent);
+  }
+
+  connection.output.erase(0, offset);
+  return true;
+}
+
+void Server::process(Connection &connection)
+{
+  std::string_view input(connection.input);
+  while (const auto request = parseFrame(input))
+  {
+    this->execute(*request, connection.output);
+    input.remove_prefix(request->size());
+  }
+
+  connection.input.erase(0, connection.input.size() - input.size());
+}
+
+void Server::execute(const Frame &request, std::string &output)
+{
+  std::string response;
+  try
+  {
+    auto payload = request.payload;
+    switch (static_cast<Opcode>(request.type))
+    {
+    case Opcode::PUSH_BACK:
+      this->engine.push_back(payload);
+      appendInteger(response, this->engine.size() - 1u);
+      break;
+    case Opcode::AT:
+      response.append(this->engine.at(readIndex(payload)));
+      break;
+    case Opcode::ERASE:
+      this->engine.erase(readIndex(payload));
+      break;
+    case Opcode::SIZE:
+      appendInteger(response, this->engine.size());
+      break;
+    case Opcode::SCAN:
+    {
+      const auto first = readIndex(payload);
+      const auto last  = readIndex(payload);
+      if (first > last || last > this->engine.size())
+      {
+        throw std::out_of_range("Cannot scan [" + std::to_string(first) + ", "
+                                + std::to_string(last) + "), only "
+                                + std::to_string(this->engine.size()) + " available");
+      }
+
+      for (auto id = first; id < last; ++id)
+      {
+        const auto value = this->engine.at(id);
+        appendInteger(response, value.size());
+        response.append(value);
+      }
+      break;
+    }
+    default:
+      throw std::invalid_argument("Unknown opcode " + std::to_string(request.type));
+    }
+
+    appendFrame(output, static_cast<std::uint8_t>(Status::OK), response);
+  }
+  catch (const std::exception &error)
+  {
+    appendFrame(output, static_cast<std::uint8_t>(Status::ERROR), error.what());
+  }
+}
+
+void Server::watch(Connection &connection)
+{
+  // Clients sending requests faster than they read the responses are only
+  // read from again once the responses are sent.
+  std::uint32_t events = 0;
+  if (connection.output.size() < MAX_PENDING_OUTPUT)
+  {
+    events |= EPOLLIN;
+  }
+  if (!connection.output.empty())
+  {
+    events |= EPOLLOUT;
+  }
+
+  if (events != connection.events)
+  {
+    control(this->poller.get(), EPOLL_CTL_MOD, connection.socket.get(), events);
+    connection.events = events;
+  }
+}
+
+} // namespace storage
@@ -0,0 +1,62 @@
+
+#pragma once
+
+#include "Engine.hh"
+#include "FileDescriptor.hh"
+#include "Protocol.hh"
+
+#include <filesystem>
+#include <string>
+#include <unordered_map>
+
+namespace storage {
+
+// Serves a vector to local clients over a Unix domain socket, with the
+// protocol described in Protocol.hh. A single thread runs an epoll loop:
+// every complete request received from a client is executed in order and
+// the responses are sent together, so clients can pipeline their requests
+// while sharing the cache and the commits of one vector.
+class Server
+{
+  public:
+  Server(Engine &engine, const std::filesystem::path &socketPath);
+  ~Server();
+
+  Server(const Server &) = delete;
+  Server &operator=(const Server &) = delete;
+
+  // Serves clients until `stop` is called.
+  void run();
+
+  // Can be called from any thread or from a signal handler.
+  void stop();
+
+  private:
+  struct Connection
+  {
+    FileDescriptor socket{};
+    std::string input{};
+    std::string output{};
+    std::uint32_t events{};
+  };
+
+  Engine &engine;
+  std::filesystem::path socketPath{};
+  FileDescriptor listener{};
+  FileDescriptor poller{};
+  FileDescriptor wakeup{};
+  std::unordered_map<int, Connection> connections{};
+
+  void accept();
+  void close(const int fd);
+
+  // Return false when the connection was closed or failed.
+  auto receive(Connection &connection) -> bool;
+  auto send(Connection &connection) -> bool;
+
+  void process(Connection &connection);
+  void execute(const Frame &request, std::string &output);
+  void watch(Connection &connection);
+};
+
+} // namespace storage
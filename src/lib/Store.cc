@@ -0,0 +1,618 @@
+
+#include "Store.hh"
+#include "Checksum.hh"
+#include "MappedFile.hh"
+
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <fcntl.h>
+#include <iomanip>
+#include <iostream>
+#include <iterator>
+#include <sstream>
+#include <unistd.h>
+
+namespace storage {
+
+constexpr auto SEGMENT_FILE_EXTENSION          = ".log";
+constexpr auto TEMPORARY_FILE_EXTENSION        = ".tmp";
+constexpr std::size_t SEGMENT_FILE_NAME_LENGTH = 8;
+constexpr std::uint64_t MAX_SEGMENT_SIZE       = 64u << 20;
+constexpr std::size_t GROUP_COMMIT_SIZE        = 1u << 20;
+constexpr std::uint64_t CHUNK_SIZE             = 64u << 10;
+constexpr std::size_t MAX_CACHED_CHUNKS        = 1024;
+constexpr std::size_t MAX_OPEN_SEGMENTS        = 64;
+
+// A record always fits in a segment, and its size in the 32 bits of its
+// header.
+constexpr std::size_t MAX_VALUE_SIZE = MAX_SEGMENT_SIZE;
+
+namespace {
+struct RecordHeader
+{
+  std::uint32_t checksum;
+  std::uint8_t operation;
+  std::uint8_t padding[3];
+  std::uint32_t id;
+  std::uint32_t size;
+  std::uint64_t argument;
+};
+
+static_assert(sizeof(RecordHeader) == 24);
+
+auto computeChecksum(const RecordHeader &header, const std::string_view payload) -> std::uint32_t
+{
+  const auto raw = reinterpret_cast<const char *>(&header);
+  const std::string_view fields(raw + sizeof(header.checksum),
+                                sizeof(header) - sizeof(header.checksum));
+  return crc32(payload, crc32(fields));
+}
+
+void encodeRecord(std::string &out,
+                  const std::uint8_t operation,
+                  const std::uint32_t id,
+                  const std::uint64_t argument,
+                  const std::string_view payload)
+{
+  RecordHeader header{};
+  header.operation = operation;
+  header.id        = id;
+  header.size      = static_cast<std::uint32_t>(payload.size());
+  header.argument  = argument;
+  header.checksum  = computeChecksum(header, payload);
+
+  out.append(reinterpret_cast<const char *>(&header), sizeof(header));
+  out.append(payload);
+}
+
+// Segments are named after their number, other files are ignored.
+auto isSegment(const std::filesystem::path &path) -> bool
+{
+  const auto stem = path.stem().string();
+  return path.extension() == SEGMENT_FILE_EXTENSION && stem.size() == SEGMENT_FILE_NAME_LENGTH
+         && std::all_of(stem.begin(), stem.end(), [](const unsigned char c) {
+              return std::isdigit(c) != 0;
+            });
+}
+} // namespace
+
+Store::Store(const std::filesystem::path &directory)
+  : directory(directory)
+{
+  std::filesystem::create_directories(this->directory);
+  this->recover();
+  this->openActiveSegment();
+}
+
+Store::~Store()
+{
+  try
+  {
+    this->flush();
+  }
+  catch (const std::exception &e)
+  {
+    std::cout << "[INFO] Failed to flush store at " << this->directory << ": " << e.what() << "\n";
+  }
+}
+
+auto Store::open(const std::string &name) -> StoreVector
+{
+  if (name.empty())
+  {
+    throw std::invalid_argument("Vector name cannot be empty");
+  }
+
+  const auto it = this->vectorIds.find(name);
+  if (it != this->vectorIds.end())
+  {
+    return StoreVector(*this, it->second);
+  }
+
+  const auto id       = static_cast<std::uint32_t>(this->vectors.size());
+  const auto location = this->appendRecord(Operation::CREATE, id, 0u, name);
+  this->apply(Operation::CREATE, id, 0u, name, location);
+
+  return StoreVector(*this, id);
+}
+
+auto Store::contains(const std::string &name) const -> bool
+{
+  return this->vectorIds.contains(name);
+}
+
+auto Store::vectorsCount() const -> std::size_t
+{
+  return this->vectors.size();
+}
+
+void Store::flush()
+{
+  if (this->pending.empty())
+  {
+    return;
+  }
+
+  try
+  {
+    writeAll(this->activeSegmentFile.get(), this->pending.data(), this->pending.size());
+    if (::fdatasync(this->activeSegmentFile.get()) != 0)
+    {
+      throw std::runtime_error("Failed to sync "
+                               + this->segmentPath(this->activeSegment).string());
+    }
+  }
+  catch (...)
+  {
+    // The pending records are kept for the next flush, which must write
+    // them after the last complete one again.
+    [[maybe_unused]] const auto result = ::ftruncate(
+      this->activeSegmentFile.get(), static_cast<off_t>(this->activeSegmentSize));
+    throw;
+  }
+
+  // The last chunk of the segment might have been cached while partial.
+  this->invalidateChunks(this->activeSegment, this->activeSegmentSize);
+
+  this->activeSegmentSize += this->pending.size();
+  this->pending.clear();
+
+  if (this->activeSegmentSize >= MAX_SEGMENT_SIZE)
+  {
+    ++this->activeSegment;
+    this->activeSegmentSize = 0u;
+    this->openActiveSegment();
+
+    if (this->logSize - this->liveSize > this->liveSize)
+    {
+      this->compact();
+    }
+  }
+}
+
+void Store::compact()
+{
+  this->flush();
+
+  // The new segment is only renamed in place once complete: the store is
+  // recovered from it from then on.
+  const auto segment = this->activeSegment + 1u;
+  const auto path    = this->segmentPath(segment);
+  auto temporaryPath = path;
+  temporaryPath += TEMPORARY_FILE_EXTENSION;
+
+  std::vector<Vector> vectors(this->vectors.size());
+  {
+    const FileDescriptor file(temporaryPath, O_WRONLY | O_CREAT | O_TRUNC);
+
+    std::string buffer;
+    std::uint64_t written = 0u;
+
+    const auto append = [&](const Operation &operation,
+                            const std::uint32_t id,
+                            const std::string_view payload) -> Location {
+      encodeRecord(buffer, static_cast<std::uint8_t>(operation), id, 0u, payload);
+      const Location location{
+        .segment = segment,
+        .size    = static_cast<std::uint32_t>(payload.size()),
+        .offset  = written + buffer.size() - payload.size(),
+      };
+
+      if (buffer.size() >= GROUP_COMMIT_SIZE)
+      {
+        writeAll(file.get(), buffer.data(), buffer.size());
+        written += buffer.size();
+        buffer.clear();
+      }
+      return location;
+    };
+
+    append(Operation::BASE, 0u, {});
+    for (std::uint32_t id = 0; id < this->vectors.size(); ++id)
+    {
+      vectors[id].name = this->vectors[id].name;
+      append(Operation::CREATE, id, vectors[id].name);
+      for (std::size_t index = 0; index < this->vectors[id].elements.size(); ++index)
+      {
+        vectors[id].elements.push_back(append(Operation::APPEND, id, this->at(id, index)));
+      }
+    }
+
+    writeAll(file.get(), buffer.data(), buffer.size());
+    if (::fdatasync(file.get()) != 0)
+    {
+      throw std::runtime_error("Failed to sync " + temporaryPath.string());
+    }
+  }
+
+  std::filesystem::rename(temporaryPath, path);
+  {
+    const FileDescriptor directoryFile(this->directory, O_RDONLY | O_DIRECTORY);
+    if (::fsync(directoryFile.get()) != 0)
+    {
+      throw std::runtime_error("Failed to sync " + this->directory.string());
+    }
+  }
+
+  std::size_t removed = 0;
+  for (const auto &entry : std::filesystem::directory_iterator(this->directory))
+  {
+    if (isSegment(entry.path()) && entry.path() != path)
+    {
+      std::filesystem::remove(entry.path());
+      ++removed;
+    }
+  }
+
+  this->openSegments.clear();
+  this->openSegmentsOrder.clear();
+  this->cachedChunks.clear();
+  this->cachedChunksOrder.clear();
+
+  this->vectors           = std::move(vectors);
+  this->activeSegment     = segment;
+  this->activeSegmentSize = std::filesystem::file_size(path);
+  this->logSize           = this->activeSegmentSize;
+  this->liveSize          = this->activeSegmentSize;
+  this->openActiveSegment();
+
+  std::cout << "[INFO] Compacted " << removed << " segment(s) of " << this->directory << " into "
+            << path << " (" << this->activeSegmentSize << " byte(s))\n";
+}
+
+auto Store::size(const std::uint32_t id) const -> std::size_t
+{
+  return this->vectors[id].elements.size();
+}
+
+auto Store::at(const std::uint32_t id, const std::size_t index) const -> std::string_view
+{
+  const auto &elements = this->vectors[id].elements;
+  if (index >= elements.size())
+  {
+    throw std::out_of_range("Requested size " + std::to_string(index) + " but only "
+                            + std::to_string(elements.size()) + " available");
+  }
+
+  const auto &location = elements[index];
+  if (location.segment == this->activeSegment && location.offset >= this->activeSegmentSize)
+  {
+    return std::string_view(this->pending.data() + (location.offset - this->activeSegmentSize),
+                            location.size);
+  }
+
+  if (location.size == 0u)
+  {
+    return std::string_view();
+  }
+
+  const auto firstChunk = location.offset / CHUNK_SIZE;
+  const auto lastChunk  = (location.offset + location.size - 1u) / CHUNK_SIZE;
+  if (firstChunk == lastChunk)
+  {
+    const auto &data = this->chunk(location.segment, firstChunk);
+    return std::string_view(data.data() + location.offset % CHUNK_SIZE, location.size);
+  }
+
+  // Values spanning several chunks are assembled in a dedicated buffer.
+  this->scratch.clear();
+  for (auto chunkId = firstChunk; chunkId <= lastChunk; ++chunkId)
+  {
+    const auto &data = this->chunk(location.segment, chunkId);
+    const auto start = std::max(location.offset, chunkId * CHUNK_SIZE) - chunkId * CHUNK_SIZE;
+    const auto end   = std::min(location.offset + location.size, (chunkId + 1u) * CHUNK_SIZE)
+                     - chunkId * CHUNK_SIZE;
+    this->scratch.append(data, start, end - start);
+  }
+
+  return this->scratch;
+}
+
+void Store::push_back(const std::uint32_t id, const std::string_view value)
+{
+  const auto location = this->appendRecord(Operation::APPEND, id, 0u, value);
+  this->apply(Operation::APPEND, id, 0u, value, location);
+
+  if (this->pending.size() >= GROUP_COMMIT_SIZE)
+  {
+    this->flush();
+  }
+}
+
+void Store::erase(const std::uint32_t id, const std::size_t index)
+{
+  const auto &elements = this->vectors[id].elements;
+  if (index >= elements.size())
+  {
+    throw std::out_of_range("Cannot erase element " + std::to_string(index) + ", only "
+                            + std::to_string(elements.size()) + " available");
+  }
+
+  const auto location = this->appendRecord(Operation::ERASE, id, index, {});
+  this->apply(Operation::ERASE, id, index, {}, location);
+
+  if (this->pending.size() >= GROUP_COMMIT_SIZE)
+  {
+    this->flush();
+  }
+}
+
+void Store::recover()
+{
+  std::vector<std::uint32_t> segments;
+  for (const auto &entry : std::filesystem::directory_iterator(this->directory))
+  {
+    const auto &path = entry.path();
+    if (isSegment(path))
+    {
+      segments.push_back(static_cast<std::uint32_t>(std::stoul(path.stem().string())));
+    }
+    else if (path.extension() == TEMPORARY_FILE_EXTENSION && isSegment(path.stem()))
+    {
+      // A compaction interrupted before its segment was renamed in place.
+      std::filesystem::remove(path);
+    }
+  }
+
+  std::sort(segments.begin(), segments.end());
+
+  // Segments before the last compacted one are left by a compaction
+  // interrupted before removing them.
+  const auto base = std::find_if(segments.rbegin(), segments.rend(), [&](const auto segment) {
+    return this->startsWithBase(segment);
+  });
+  if (base != segments.rend())
+  {
+    const auto first = std::prev(base.base());
+    for (auto obsolete = segments.begin(); obsolete != first; ++obsolete)
+    {
+      std::filesystem::remove(this->segmentPath(*obsolete));
+    }
+    segments.erase(segments.begin(), first);
+  }
+
+  for (std::size_t id = 0; id < segments.size(); ++id)
+  {
+    this->recoverSegment(segments[id], id + 1 == segments.size());
+  }
+
+  if (!segments.empty())
+  {
+    this->activeSegment     = segments.back();
+    this->activeSegmentSize = std::filesystem::file_size(this->segmentPath(this->activeSegment));
+  }
+
+  std::cout << "[INFO] Recovered " << this->vectors.size() << " vector(s) from "
+            << segments.size() << " segment(s) in " << this->directory << "\n";
+}
+
+void Store::recoverSegment(const std::uint32_t segment, const bool last)
+{
+  const auto path = this->segmentPath(segment);
+
+  std::uint64_t offset = 0u;
+  std::uint64_t size   = 0u;
+  {
+    const MappedFile file(path);
+    const auto content = file.view();
+    size               = content.size();
+
+    RecordHeader header;
+    while (offset + sizeof(header) <= size)
+    {
+      std::memcpy(&header, content.data() + offset, sizeof(header));
+
+      const auto operation = static_cast<Operation>(header.operation);
+      const auto valid     = (operation == Operation::CREATE || operation == Operation::APPEND
+                          || operation == Operation::ERASE || operation == Operation::BASE);
+      if (!valid || offset + sizeof(header) + header.size > size)
+      {
+        break;
+      }
+
+      const auto payload = content.substr(offset + sizeof(header), header.size);
+      if (computeChecksum(header, payload) != header.checksum)
+      {
+        break;
+      }
+
+      const Location location{
+        .segment = segment,
+        .size    = header.size,
+        .offset  = offset + sizeof(header),
+      };
+      this->apply(operation, header.id, header.argument, payload, location);
+
+      offset += sizeof(header) + header.size;
+    }
+  }
+  this->logSize += offset;
+
+  if (offset == size)
+  {
+    return;
+  }
+
+  if (!last)
+  {
+    throw std::runtime_error("Corrupted record at offset " + std::to_string(offset) + " of "
+                             + path.string());
+  }
+
+  // A torn write at the end of the log belongs to a commit which did not
+  // complete: it is discarded.
+  std::cout << "[INFO] Discarding " << size - offset << " byte(s) at the end of " << path << "\n";
+  std::filesystem::resize_file(path, offset);
+}
+
+void Store::openActiveSegment()
+{
+  this->activeSegmentFile = FileDescriptor(this->segmentPath(this->activeSegment),
+                                           O_WRONLY | O_CREAT | O_APPEND);
+}
+
+auto Store::appendRecord(const Operation &operation,
+                         const std::uint32_t id,
+                         const std::uint64_t argument,
+                         const std::string_view payload) -> Location
+{
+  if (payload.size() > MAX_VALUE_SIZE)
+  {
+    throw std::invalid_argument("Value of size " + std::to_string(payload.size())
+                                + " exceeds the maximum of " + std::to_string(MAX_VALUE_SIZE)
+                                + " byte(s)");
+  }
+
+  const Location location{
+    .segment = this->activeSegment,
+    .size    = static_cast<std::uint32_t>(payload.size()),
+    .offset  = this->activeSegmentSize + this->pending.size() + sizeof(RecordHeader),
+  };
+
+  encodeRecord(this->pending, static_cast<std::uint8_t>(operation), id, argument, payload);
+  this->logSize += sizeof(RecordHeader) + payload.size();
+
+  return location;
+}
+
+void Store::apply(const Operation &operation,
+                  const std::uint32_t id,
+                  const std::uint64_t argument,
+                  const std::string_view payload,
+                  const Location &location)
+{
+  // Erase records are never needed once applied, nor are the records they
+  // erase.
+  if (operation != Operation::ERASE)
+  {
+    this->liveSize += sizeof(RecordHeader) + location.size;
+  }
+
+  switch (operation)
+  {
+    case Operation::BASE:
+      this->vectors.clear();
+      this->vectorIds.clear();
+      break;
+    case Operation::CREATE:
+      if (id != this->vectors.size())
+      {
+        throw std::runtime_error("Unexpected id " + std::to_string(id) + " for vector \""
+                                 + std::string(payload) + "\"");
+      }
+      this->vectors.push_back(Vector{.name = std::string(payload), .elements = {}});
+      this->vectorIds.emplace(this->vectors.back().name, id);
+      break;
+    case Operation::APPEND:
+      this->vectors.at(id).elements.push_back(location);
+      break;
+    case Operation::ERASE:
+    {
+      auto &elements = this->vectors.at(id).elements;
+      if (argument >= elements.size())
+      {
+        throw std::runtime_error("Cannot erase element " + std::to_string(argument)
+                                 + " of vector " + std::to_string(id));
+      }
+
+      auto toErase = elements.begin();
+      std::advance(toErase, argument);
+      this->liveSize -= sizeof(RecordHeader) + toErase->size;
+      elements.erase(toErase);
+      break;
+    }
+  }
+}
+
+auto Store::startsWithBase(const std::uint32_t segment) const -> bool
+{
+  const FileDescriptor file(this->segmentPath(segment), O_RDONLY);
+
+  RecordHeader header;
+  const auto read = readAt(file.get(), reinterpret_cast<char *>(&header), sizeof(header), 0);
+  return read == sizeof(header) && header.operation == static_cast<std::uint8_t>(Operation::BASE)
+         && header.size == 0u && computeChecksum(header, {}) == header.checksum;
+}
+
+auto Store::segmentPath(const std::uint32_t segment) const -> std::filesystem::path
+{
+  std::ostringstream name;
+  name << std::setw(SEGMENT_FILE_NAME_LENGTH) << std::setfill('0') << segment
+       << SEGMENT_FILE_EXTENSION;
+  return this->directory / name.str();
+}
+
+auto Store::segmentFile(const std::uint32_t segment) const -> int
+{
+  const auto it = this->openSegments.find(segment);
+  if (it != this->openSegments.end())
+  {
+    this->openSegmentsOrder.splice(this->openSegmentsOrder.begin(),
+                                   this->openSegmentsOrder,
+                                   it->second.second);
+    return it->second.first.get();
+  }
+
+  if (this->openSegments.size() >= MAX_OPEN_SEGMENTS)
+  {
+    this->openSegments.erase(this->openSegmentsOrder.back());
+    this->openSegmentsOrder.pop_back();
+  }
+
+  this->openSegmentsOrder.push_front(segment);
+  auto &entry = this->openSegments[segment];
+  entry.first  = FileDescriptor(this->segmentPath(segment), O_RDONLY);
+  entry.second = this->openSegmentsOrder.begin();
+
+  return entry.first.get();
+}
+
+auto Store::chunk(const std::uint32_t segment, const std::uint64_t chunkId) const
+  -> const std::string &
+{
+  const auto key = (static_cast<std::uint64_t>(segment) << 32) | chunkId;
+
+  const auto it = this->cachedChunks.find(key);
+  if (it != this->cachedChunks.end())
+  {
+    this->cachedChunksOrder.splice(this->cachedChunksOrder.begin(),
+                                   this->cachedChunksOrder,
+                                   it->second.second);
+    return it->second.first;
+  }
+
+  if (this->cachedChunks.size() >= MAX_CACHED_CHUNKS)
+  {
+    this->cachedChunks.erase(this->cachedChunksOrder.back());
+    this->cachedChunksOrder.pop_back();
+  }
+
+  std::string data(CHUNK_SIZE, '\0');
+  const auto read = readAt(this->segmentFile(segment),
+                           data.data(),
+                           data.size(),
+                           static_cast<off_t>(chunkId * CHUNK_SIZE));
+  data.resize(read);
+
+  this->cachedChunksOrder.push_front(key);
+  auto &entry  = this->cachedChunks[key];
+  entry.first  = std::move(data);
+  entry.second = this->cachedChunksOrder.begin();
+
+  return entry.first;
+}
+
+void Store::invalidateChunks(const std::uint32_t segment, const std::uint64_t fromOffset)
+{
+  const auto key = (static_cast<std::uint64_t>(segment) << 32) | (fromOffset / CHUNK_SIZE);
+
+  const auto it = this->cachedChunks.find(key);
+  if (it != this->cachedChunks.end())
+  {
+    this->cachedChunksOrder.erase(it->second.second);
+    this->cachedChunks.erase(it);
+  }
+}
+
+} // namespace storage
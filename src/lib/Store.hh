@@ -0,0 +1,124 @@
+
+#pragma once
+
+#include "FileDescriptor.hh"
+#include "StoreVector.hh"
+
+#include <cstdint>
+#include <filesystem>
+#include <list>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace storage {
+
+// Hosts many named vectors in a single directory. All the operations are
+// appended to a shared log split in segment files, which also holds the
+// values: the vectors themselves only keep the location of their elements.
+// Operations are buffered and made durable together by `flush`, which is
+// also triggered when enough data is pending.
+// Views returned by `at` are valid until the next call to the store.
+// Once erased records take more space than live ones, the live records are
+// rewritten to a new segment replacing all the previous ones.
+// Not thread safe: the store and its vectors must only be used by one thread
+// at a time, callers sharing them across threads serializing the calls.
+class Store
+{
+  public:
+  explicit Store(const std::filesystem::path &directory);
+  ~Store();
+
+  Store(const Store &) = delete;
+  Store &operator=(const Store &) = delete;
+
+  // Returns the vector registered under `name`, creating it if needed.
+  auto open(const std::string &name) -> StoreVector;
+  auto contains(const std::string &name) const -> bool;
+  auto vectorsCount() const -> std::size_t;
+
+  void flush();
+
+  // Rewrites the live records to a single new segment and removes the
+  // previous ones, which are then neither kept on disk nor replayed.
+  void compact();
+
+  private:
+  friend class StoreVector;
+
+  struct Location
+  {
+    std::uint32_t segment{};
+    std::uint32_t size{};
+    std::uint64_t offset{};
+  };
+
+  struct Vector
+  {
+    std::string name{};
+    std::vector<Location> elements{};
+  };
+
+  // A base record starts a compacted segment, the previous segments being
+  // obsolete.
+  enum class Operation : std::uint8_t
+  {
+    CREATE = 1,
+    APPEND = 2,
+    ERASE  = 3,
+    BASE   = 4
+  };
+
+  std::filesystem::path directory{};
+
+  std::vector<Vector> vectors{};
+  std::unordered_map<std::string, std::uint32_t> vectorIds{};
+
+  std::uint32_t activeSegment{};
+  std::uint64_t activeSegmentSize{};
+  FileDescriptor activeSegmentFile{};
+  std::string pending{};
+
+  // Sizes of all the records of the log and of the ones still needed.
+  std::uint64_t logSize{};
+  std::uint64_t liveSize{};
+
+  mutable std::list<std::uint32_t> openSegmentsOrder{};
+  mutable std::unordered_map<std::uint32_t,
+                             std::pair<FileDescriptor, std::list<std::uint32_t>::iterator>>
+    openSegments{};
+
+  mutable std::list<std::uint64_t> cachedChunksOrder{};
+  mutable std::unordered_map<std::uint64_t,
+                             std::pair<std::string, std::list<std::uint64_t>::iterator>>
+    cachedChunks{};
+  mutable std::string scratch{};
+
+  auto size(const std::uint32_t id) const -> std::size_t;
+  auto at(const std::uint32_t id, const std::size_t index) const -> std::string_view;
+  void push_back(const std::uint32_t id, const std::string_view value);
+  void erase(const std::uint32_t id, const std::size_t index);
+
+  void recover();
+  auto startsWithBase(const std::uint32_t segment) const -> bool;
+  void recoverSegment(const std::uint32_t segment, const bool last);
+  void openActiveSegment();
+
+  auto appendRecord(const Operation &operation,
+                    const std::uint32_t id,
+                    const std::uint64_t argument,
+                    const std::string_view payload) -> Location;
+  void apply(const Operation &operation,
+             const std::uint32_t id,
+             const std::uint64_t argument,
+             const std::string_view payload,
+             const Location &location);
+
+  auto segmentPath(const std::uint32_t segment) const -> std::filesystem::path;
+  auto segmentFile(const std::uint32_t segment) const -> int;
+  auto chunk(const std::uint32_t segment, const std::uint64_t chunkId) const
+    -> const std::string &;
+  void invalidateChunks(const std::uint32_t segment, const std::uint64_t fromOffset);
+};
+
+} // namespace storage
@@ -0,0 +1,32 @@
+
+#include "StoreVector.hh"
+#include "Store.hh"
+
+namespace storage {
+
+StoreVector::StoreVector(Store &store, const std::uint32_t id)
+  : store(&store)
+  , id(id)
+{}
+
+auto StoreVector::size() const -> std::size_t
+{
+  return this->store->size(this->id);
+}
+
+auto StoreVector::at(const std::size_t index) const -> std::string_view
+{
+  return this->store->at(this->id, index);
+}
+
+void StoreVector::push_back(const std::string &value)
+{
+  this->store->push_back(this->id, value);
+}
+
+void StoreVector::erase(const std::size_t index)
+{
+  this->store->erase(this->id, index);
+}
+
+} // namespace storage
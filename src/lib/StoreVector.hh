@@ -0,0 +1,30 @@
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+namespace storage {
+
+class Store;
+
+// Handle to a vector hosted in a `Store`. It does not own any resource and
+// is only valid as long as the store it comes from.
+class StoreVector
+{
+  public:
+  auto size() const -> std::size_t;
+  auto at(const std::size_t index) const -> std::string_view;
+  void push_back(const std::string &value);
+  void erase(const std::size_t index);
+
+  private:
+  friend class Store;
+  StoreVector(Store &store, const std::uint32_t id);
+
+  Store *store{nullptr};
+  std::uint32_t id{};
+};
+
+} // namespace storage
@@ -0,0 +1,163 @@
+
+#include "Tiering.hh"
+#include "FileDescriptor.hh"
+
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <iostream>
+#include <string>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace storage::v2 {
+
+constexpr auto TEMPORARY_FILE_EXTENSION = ".tmp";
+constexpr std::size_t COPY_BUFFER_SIZE  = 1 << 20;
+
+namespace {
+// Copies `move.source` under a temporary name, synced, then renames it: a
+// target with the final name is always complete.
+void copyDataBlock(Tiering::Move &move, std::string &buffer)
+{
+  const FileDescriptor in(move.source, O_RDONLY);
+
+  struct stat status;
+  if (::fstat(in.get(), &status) != 0)
+  {
+    throw std::runtime_error("Failed to stat " + move.source.string() + ": "
+                             + std::strerror(errno));
+  }
+  move.sourceInode = status.st_ino;
+
+  auto temporaryPath = move.target;
+  temporaryPath += TEMPORARY_FILE_EXTENSION;
+  {
+    const FileDescriptor out(temporaryPath, O_WRONLY | O_CREAT | O_TRUNC);
+
+    buffer.resize(COPY_BUFFER_SIZE);
+    off_t offset = 0;
+    while (true)
+    {
+      const auto read = readAt(in.get(), buffer.data(), buffer.size(), offset);
+      if (read == 0u)
+      {
+        break;
+      }
+      writeAll(out.get(), buffer.data(), read);
+      offset += static_cast<off_t>(read);
+    }
+
+    if (::fsync(out.get()) != 0)
+    {
+      throw std::runtime_error("Failed to sync " + temporaryPath.string() + ": "
+                               + std::strerror(errno));
+    }
+  }
+  std::filesystem::rename(temporaryPath, move.target);
+}
+} // namespace
+
+Tiering::Tiering(const std::chrono::milliseconds &interval)
+  : interval(interval)
+  , lastPass(std::chrono::steady_clock::now())
+  , worker(&Tiering::run, this)
+{}
+
+Tiering::~Tiering()
+{
+  // Copies not committed yet are left in place, the vector drops them when
+  // it is opened again.
+  {
+    const std::lock_guard lock(this->mutex);
+    this->stopping = true;
+  }
+  this->wakeUp.notify_one();
+  this->worker.join();
+}
+
+void Tiering::recordAccess(const std::uint32_t fileId)
+{
+  ++this->accessCounts[fileId];
+}
+
+auto Tiering::startPass() -> std::optional<AccessCounts>
+{
+  const auto now = std::chrono::steady_clock::now();
+  if (now - this->lastPass < this->interval)
+  {
+    return std::nullopt;
+  }
+
+  this->lastPass = now;
+
+  AccessCounts counts;
+  counts.swap(this->accessCounts);
+  return counts;
+}
+
+auto Tiering::moving(const std::uint32_t fileId) const -> bool
+{
+  return this->pendingFileIds.contains(fileId);
+}
+
+void Tiering::schedule(Move &&move)
+{
+  this->pendingFileIds.insert(move.fileId);
+  {
+    const std::lock_guard lock(this->mutex);
+    this->queue.push_back(std::move(move));
+  }
+  this->wakeUp.notify_one();
+}
+
+auto Tiering::completed() -> std::vector<Move>
+{
+  std::vector<Move> moves;
+  {
+    const std::lock_guard lock(this->mutex);
+    moves.swap(this->done);
+  }
+
+  for (const auto &move : moves)
+  {
+    this->pendingFileIds.erase(move.fileId);
+  }
+  return moves;
+}
+
+void Tiering::run()
+{
+  std::string buffer;
+  while (true)
+  {
+    Move move;
+    {
+      std::unique_lock lock(this->mutex);
+      this->wakeUp.wait(lock, [this] { return this->stopping || !this->queue.empty(); });
+      if (this->stopping)
+      {
+        return;
+      }
+
+      move = std::move(this->queue.front());
+      this->queue.pop_front();
+    }
+
+    try
+    {
+      copyDataBlock(move, buffer);
+      move.copied = true;
+    }
+    catch (const std::exception &error)
+    {
+      std::cout << "[INFO] Failed to move " << move.source << " to " << move.target << ": "
+                << error.what() << "\n";
+    }
+
+    const std::lock_guard lock(this->mutex);
+    this->done.push_back(std::move(move));
+  }
+}
+
+} // namespace storage::v2
@@ -0,0 +1,77 @@
+
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <filesystem>
+#include <mutex>
+#include <optional>
+#include <sys/types.h>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace storage::v2 {
+
+// Counts the reads of the data blocks of a vector and copies data block files
+// between directories on a background thread. The vector decides which data
+// blocks move at each pass and commits the completed copies itself: only the
+// copies run concurrently with it.
+class Tiering
+{
+  public:
+  struct Move
+  {
+    std::uint32_t fileId{};
+    std::uint8_t toDirectoryId{};
+    std::filesystem::path source{};
+    std::filesystem::path target{};
+
+    // Set by the copy: the inode tells whether the source was replaced, e.g.
+    // by an erase, while being copied.
+    ino_t sourceInode{};
+    bool copied{};
+  };
+
+  explicit Tiering(const std::chrono::milliseconds &interval);
+  ~Tiering();
+
+  Tiering(const Tiering &)            = delete;
+  Tiering &operator=(const Tiering &) = delete;
+
+  using AccessCounts = std::unordered_map<std::uint32_t, std::size_t>;
+
+  void recordAccess(const std::uint32_t fileId);
+
+  // Returns the reads of each data block since the last pass once
+  // `interval` elapsed, the counts then starting over.
+  auto startPass() -> std::optional<AccessCounts>;
+
+  // Whether a move of the data block is scheduled and not yet committed.
+  auto moving(const std::uint32_t fileId) const -> bool;
+  void schedule(Move &&move);
+
+  // Returns the moves whose copy ended since the last call, successful or
+  // not: they are then no longer pending.
+  auto completed() -> std::vector<Move>;
+
+  private:
+  std::chrono::milliseconds interval{};
+  std::chrono::steady_clock::time_point lastPass{};
+  AccessCounts accessCounts{};
+  std::unordered_set<std::uint32_t> pendingFileIds{};
+
+  std::mutex mutex{};
+  std::condition_variable wakeUp{};
+  std::deque<Move> queue{};
+  std::vector<Move> done{};
+  bool stopping{false};
+  std::thread worker{};
+
+  void run();
+};
+
+} // namespace storage::v2
@@ -0,0 +1,348 @@
+
+#include "ValueStore.hh"
+#include "Checksum.hh"
+
+#include <cerrno>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <iostream>
+#include <stdexcept>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
+
+namespace storage::v2 {
+
+constexpr auto TEMPORARY_FILE_EXTENSION           = ".tmp";
+constexpr std::uint64_t MIN_DEAD_BYTES_TO_COMPACT = 1 << 20;
+constexpr std::size_t COMPACTION_BUFFER_SIZE      = 1 << 20;
+
+namespace {
+// Each value is preceded by its key and size, the checksum covering both
+// and the value.
+struct RecordHeader
+{
+  std::uint64_t key;
+  std::uint32_t size;
+  std::uint32_t checksum;
+};
+static_assert(sizeof(RecordHeader) == 16);
+
+auto computeChecksum(const RecordHeader &header, const std::string_view value) -> std::uint32_t
+{
+  const auto checksum = crc32({reinterpret_cast<const char *>(&header),
+                               offsetof(RecordHeader, checksum)});
+  return crc32(value, checksum);
+}
+
+void encodeRecord(std::string &out, const std::uint64_t key, const std::string_view value)
+{
+  RecordHeader header{.key      = key,
+                      .size     = static_cast<std::uint32_t>(value.size()),
+                      .checksum = 0u};
+  header.checksum = computeChecksum(header, value);
+
+  out.append(reinterpret_cast<const char *>(&header), sizeof(header));
+  out.append(value);
+}
+
+auto recordSize(const std::size_t valueSize) -> std::uint64_t
+{
+  return sizeof(RecordHeader) + valueSize;
+}
+
+auto keyToString(const std::uint64_t key) -> std::string
+{
+  char out[17];
+  std::snprintf(out, sizeof(out), "%016llx", static_cast<unsigned long long>(key));
+  return out;
+}
+} // namespace
+
+ValueStore::ValueStore(const std::filesystem::path &path, const bool readOnly)
+  : path(path)
+  , readOnly(readOnly)
+{
+  this->open();
+  this->load();
+
+  std::cout << "[INFO] Loaded value store " << this->path << " with " << this->entries.size()
+            << " value(s)\n";
+}
+
+auto ValueStore::size() const -> std::size_t
+{
+  return this->referenced;
+}
+
+auto ValueStore::insert(const std::string_view value) -> std::uint64_t
+{
+  // Another value with the same hash is very unlikely but possible: the value
+  // is then stored under the hash obtained with the next seed.
+  for (std::uint64_t seed = 0;; ++seed)
+  {
+    const auto key   = hash64(value, seed);
+    const auto found = this->entries.find(key);
+    if (found == this->entries.end())
+    {
+      this->buffer.clear();
+      encodeRecord(this->buffer, key, value);
+      try
+      {
+        writeAll(this->file.get(), this->buffer.data(), this->buffer.size());
+      }
+      catch (...)
+      {
+        // Appends must keep starting at the end of the last record.
+        [[maybe_unused]] const auto result = ::ftruncate(this->file.get(),
+                                                         static_cast<off_t>(this->end));
+        throw;
+      }
+
+      this->entries.emplace(key,
+                            Entry{.offset = this->end, .size = value.size(), .references = 1});
+      this->end += this->buffer.size();
+
+      ++this->referenced;
+      this->liveBytes += recordSize(value.size());
+      return key;
+    }
+
+    if (found->second.size == value.size())
+    {
+      this->read(found->second, this->buffer);
+      if (this->buffer == value)
+      {
+        this->retain(key);
+        return key;
+      }
+    }
+  }
+}
+
+void ValueStore::retain(const std::uint64_t key)
+{
+  const auto found = this->entries.find(key);
+  if (found == this->entries.end())
+  {
+    throw std::runtime_error("Value " + keyToString(key) + " is missing from "
+                             + this->path.string());
+  }
+
+  auto &entry = found->second;
+  if (entry.references++ == 0u)
+  {
+    ++this->referenced;
+    this->liveBytes += recordSize(entry.size);
+    this->deadBytes -= recordSize(entry.size);
+  }
+}
+
+void ValueStore::release(const std::uint64_t key)
+{
+  const auto found = this->entries.find(key);
+  if (found == this->entries.end() || found->second.references == 0u)
+  {
+    throw std::logic_error("Value " + keyToString(key) + " of " + this->path.string()
+                           + " is not referenced");
+  }
+
+  auto &entry = found->second;
+  if (--entry.references == 0u)
+  {
+    --this->referenced;
+    this->liveBytes -= recordSize(entry.size);
+    this->deadBytes += recordSize(entry.size);
+
+    const std::lock_guard lock(this->cacheMutex);
+    this->cache.erase(key);
+  }
+
+  this->collect();
+}
+
+auto ValueStore::get(const std::uint64_t key) const -> std::string_view
+{
+  const std::lock_guard lock(this->cacheMutex);
+
+  auto cached = this->cache.find(key);
+  if (cached == this->cache.end())
+  {
+    std::string value;
+    this->read(this->find(key), value);
+    cached = this->cache.emplace(key, std::move(value)).first;
+  }
+
+  return cached->second;
+}
+
+void ValueStore::collect()
+{
+  if (!this->readOnly && this->deadBytes >= MIN_DEAD_BYTES_TO_COMPACT
+      && this->deadBytes > this->liveBytes)
+  {
+    this->compact();
+  }
+}
+
+void ValueStore::refresh()
+{
+  struct stat status;
+  if (::stat(this->path.c_str(), &status) != 0)
+  {
+    return;
+  }
+
+  // The writer replaces the file when compacting it: keys do not change but
+  // the offsets do.
+  if (status.st_ino != this->inode || static_cast<std::uint64_t>(status.st_size) < this->end)
+  {
+    this->entries.clear();
+    this->end = 0;
+    this->open();
+  }
+
+  this->load();
+}
+
+void ValueStore::open()
+{
+  this->file = FileDescriptor(this->path,
+                              this->readOnly ? O_RDONLY : O_RDWR | O_CREAT | O_APPEND);
+
+  struct stat status;
+  if (::fstat(this->file.get(), &status) != 0)
+  {
+    throw std::runtime_error("Failed to stat " + this->path.string() + ": "
+                             + std::strerror(errno));
+  }
+  this->inode = status.st_ino;
+}
+
+void ValueStore::load()
+{
+  struct stat status;
+  if (::fstat(this->file.get(), &status) != 0)
+  {
+    throw std::runtime_error("Failed to stat " + this->path.string() + ": "
+                             + std::strerror(errno));
+  }
+  const auto size = static_cast<std::uint64_t>(status.st_size);
+
+  // A record which was not completely written ends the file.
+  std::string value;
+  while (this->end + sizeof(RecordHeader) <= size)
+  {
+    RecordHeader header;
+    if (readAt(this->file.get(), reinterpret_cast<char *>(&header), sizeof(header),
+               static_cast<off_t>(this->end))
+          != sizeof(header)
+        || header.size > size - this->end - sizeof(header))
+    {
+      break;
+    }
+
+    value.resize(header.size);
+    if (readAt(this->file.get(), value.data(), value.size(),
+               static_cast<off_t>(this->end + sizeof(header)))
+          != value.size()
+        || computeChecksum(header, value) != header.checksum)
+    {
+      break;
+    }
+
+    // Values are not referenced until the slots holding them are counted.
+    this->entries.emplace(header.key, Entry{.offset = this->end, .size = header.size});
+    this->deadBytes += recordSize(header.size);
+    this->end += recordSize(header.size);
+  }
+
+  if (!this->readOnly && this->end < size)
+  {
+    std::cout << "[INFO] Dropping " << size - this->end << " byte(s) at the end of " << this->path
+              << "\n";
+    if (::ftruncate(this->file.get(), static_cast<off_t>(this->end)) != 0)
+    {
+      throw std::runtime_error("Failed to truncate " + this->path.string() + ": "
+                               + std::strerror(errno));
+    }
+  }
+}
+
+void ValueStore::compact()
+{
+  std::cout << "[INFO] Compacting " << this->path << ", " << this->deadBytes
+            << " byte(s) are not referenced\n";
+
+  auto temporaryPath = this->path;
+  temporaryPath += TEMPORARY_FILE_EXTENSION;
+
+  // Offsets are only updated once the new file replaced the old one.
+  std::vector<std::pair<Entry *, std::uint64_t>> moved;
+  {
+    const FileDescriptor out(temporaryPath, O_WRONLY | O_CREAT | O_TRUNC);
+
+    std::string value;
+    std::uint64_t offset = 0;
+    this->buffer.clear();
+    for (auto &[key, entry] : this->entries)
+    {
+      if (entry.references == 0u)
+      {
+        continue;
+      }
+
+      this->read(entry, value);
+      encodeRecord(this->buffer, key, value);
+      moved.emplace_back(&entry, offset);
+      offset += recordSize(entry.size);
+
+      if (this->buffer.size() >= COMPACTION_BUFFER_SIZE)
+      {
+        writeAll(out.get(), this->buffer.data(), this->buffer.size());
+        this->buffer.clear();
+      }
+    }
+    writeAll(out.get(), this->buffer.data(), this->buffer.size());
+  }
+
+  std::filesystem::rename(temporaryPath, this->path);
+  this->open();
+
+  this->end = 0;
+  for (const auto &[entry, offset] : moved)
+  {
+    entry->offset = offset;
+    this->end += recordSize(entry->size);
+  }
+  std::erase_if(this->entries, [](const auto &item) { return item.second.references == 0u; });
+  this->deadBytes = 0;
+}
+
+void ValueStore::read(const Entry &entry, std::string &out) const
+{
+  out.resize(entry.size);
+  if (readAt(this->file.get(), out.data(), out.size(),
+             static_cast<off_t>(entry.offset + sizeof(RecordHeader)))
+      != out.size())
+  {
+    throw std::runtime_error("Failed to read value at offset " + std::to_string(entry.offset)
+                             + " of " + this->path.string());
+  }
+}
+
+auto ValueStore::find(const std::uint64_t key) const -> const Entry &
+{
+  const auto found = this->entries.find(key);
+  if (found == this->entries.end())
+  {
+    throw std::runtime_error("Value " + keyToString(key) + " is missing from "
+                             + this->path.string());
+  }
+
+  return found->second;
+}
+
+} // namespace storage::v2
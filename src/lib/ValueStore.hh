@@ -0,0 +1,84 @@
+
+#pragma once
+
+#include "FileDescriptor.hh"
+
+#include <cstdint>
+#include <filesystem>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <sys/types.h>
+#include <unordered_map>
+
+namespace storage::v2 {
+
+// Content addressed store for the values of a deduplicated vector. Each
+// distinct value is appended once to a file and addressed by its hash, which
+// the slots of the vector hold instead of the value. References are only
+// counted in memory: they are rebuilt from the slots when opening the vector,
+// so a crash can at worst leave unreferenced values behind, which are dropped
+// when the file is compacted.
+class ValueStore
+{
+  public:
+  ValueStore(const std::filesystem::path &path, const bool readOnly);
+
+  // Number of distinct values currently referenced.
+  auto size() const -> std::size_t;
+
+  // Stores `value` unless already present and returns its key, adding a
+  // reference to it.
+  auto insert(const std::string_view value) -> std::uint64_t;
+
+  // Adds a reference to a value already stored, when rebuilding the counts.
+  void retain(const std::uint64_t key);
+
+  // Drops a reference, the file being compacted once enough values are no
+  // longer referenced.
+  void release(const std::uint64_t key);
+
+  // Views stay valid while the value is referenced. Can be called
+  // concurrently.
+  auto get(const std::uint64_t key) const -> std::string_view;
+
+  // Compacts the file if enough values are not referenced, e.g. after the
+  // counts were rebuilt.
+  void collect();
+
+  // Picks up the values appended by the writer, for read-only stores.
+  void refresh();
+
+  private:
+  struct Entry
+  {
+    std::uint64_t offset{};
+    std::size_t size{};
+    std::size_t references{};
+  };
+
+  std::filesystem::path path{};
+  bool readOnly{};
+  FileDescriptor file{};
+  ino_t inode{};
+  std::uint64_t end{};
+
+  std::unordered_map<std::uint64_t, Entry> entries{};
+  std::size_t referenced{};
+  std::uint64_t liveBytes{};
+  std::uint64_t deadBytes{};
+
+  std::string buffer{};
+
+  // Values read so far: a key always designates the same value.
+  mutable std::mutex cacheMutex{};
+  mutable std::unordered_map<std::uint64_t, std::string> cache{};
+
+  void open();
+  void load();
+  void compact();
+  void read(const Entry &entry, std::string &out) const;
+  auto find(const std::uint64_t key) const -> const Entry &;
+};
+
+} // namespace storage::v2
@@ -0,0 +1,108 @@
+
+#include "WriteBatch.hh"
+
+#include <cstring>
+
+namespace storage::v2 {
+
+namespace {
+// Each entry is its type followed by the index of an erase or by the size
+// and bytes of the appended value.
+void appendInteger(std::string &out, const std::uint64_t value)
+{
+  out.append(reinterpret_cast<const char *>(&value), sizeof(value));
+}
+
+auto readInteger(std::string_view &data) -> std::optional<std::uint64_t>
+{
+  std::uint64_t value;
+  if (data.size() < sizeof(value))
+  {
+    return {};
+  }
+
+  std::memcpy(&value, data.data(), sizeof(value));
+  data.remove_prefix(sizeof(value));
+  return value;
+}
+} // namespace
+
+void WriteBatch::push_back(const std::string_view value)
+{
+  this->operations.push_back({.type = ChangeType::APPEND, .index = 0, .value = std::string(value)});
+}
+
+void WriteBatch::erase(const std::size_t index)
+{
+  this->operations.push_back({.type = ChangeType::ERASE, .index = index, .value = {}});
+}
+
+void WriteBatch::clear()
+{
+  this->operations.clear();
+}
+
+auto WriteBatch::size() const -> std::size_t
+{
+  return this->operations.size();
+}
+
+auto WriteBatch::empty() const -> bool
+{
+  return this->operations.empty();
+}
+
+auto WriteBatch::entries() const -> const std::vector<Entry> &
+{
+  return this->operations;
+}
+
+void WriteBatch::encode(std::string &out) const
+{
+  for (const auto &entry : this->operations)
+  {
+    out.push_back(static_cast<char>(entry.type));
+    if (entry.type == ChangeType::ERASE)
+    {
+      appendInteger(out, entry.index);
+    }
+    else
+    {
+      appendInteger(out, entry.value.size());
+      out.append(entry.value);
+    }
+  }
+}
+
+auto WriteBatch::decode(std::string_view data) -> std::optional<WriteBatch>
+{
+  WriteBatch batch;
+  while (!data.empty())
+  {
+    const auto type = static_cast<ChangeType>(data.front());
+    data.remove_prefix(1);
+
+    const auto value = readInteger(data);
+    if (!value)
+    {
+      return {};
+    }
+
+    if (type == ChangeType::ERASE)
+    {
+      batch.erase(*value);
+    }
+    else if (type == ChangeType::APPEND && *value <= data.size())
+    {
+      batch.push_back(data.substr(0, *value));
+      data.remove_prefix(*value);
+    }
+    else
+    {
+      return {};
+    }
+  }
+  return batch;
+}
+
+} // namespace storage::v2
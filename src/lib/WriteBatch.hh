@@ -0,0 +1,45 @@
+
+#pragma once
+
+#include "ChangeFeed.hh"
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace storage::v2 {
+
+// Appends and erases applied to a vector as a whole with
+// `PersistentVector::write`: after a crash, either all of them are visible
+// or none. Operations apply in order, the index of an erase referring to the
+// vector as left by the previous operations of the batch.
+class WriteBatch
+{
+  public:
+  struct Entry
+  {
+    ChangeType type{};
+    std::size_t index{};
+    std::string value{};
+  };
+
+  void push_back(const std::string_view value);
+  void erase(const std::size_t index);
+  void clear();
+
+  auto size() const -> std::size_t;
+  auto empty() const -> bool;
+  auto entries() const -> const std::vector<Entry> &;
+
+  // Appends the operations of the batch to `out`, `decode` returning nothing
+  // when `data` is not a complete encoding.
+  void encode(std::string &out) const;
+  static auto decode(const std::string_view data) -> std::optional<WriteBatch>;
+
+  private:
+  std::vector<Entry> operations{};
+};
+
+} // namespace storage::v2
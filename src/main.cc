@@ -1,9 +1,16 @@
+#include <csignal>
+#include <fcntl.h>
 #include <filesystem>
 #include <iostream>
 #include <string>
+#include <thread>
+#include <unistd.h>
 
-#include "PersistentVector.hh"
+#include "Engine.hh"
+#include "Follower.hh"
+#include "Migration.hh"
 #include "PersistentVectorBlock.hh"
+#include "Server.hh"
 
 using PersistentVector = storage::v2::PersistentVector;
 
@@ -36,65 +43,295 @@ std::string all_chars()
   return rv;
 }
 
-void run_test_one(const std::filesystem::path &p)
+void run_test_one(const std::filesystem::path &p, const storage::EngineOptions &options)
 {
-  PersistentVector v(p);
+  const auto v = storage::openEngine(p, options);
   using namespace std::literals;
 
-  v.push_back("foo");
-  CHECK(v.at(0) == "foo");
-  CHECK(v.size() == 1);
+  v->push_back("foo");
+  CHECK(v->at(0) == "foo");
+  CHECK(v->size() == 1);
 
-  v.push_back(all_chars());
-  CHECK(v.at(1) == all_chars());
-  CHECK(v.size() == 2);
+  v->push_back(all_chars());
+  CHECK(v->at(1) == all_chars());
+  CHECK(v->size() == 2);
 
   auto start = std::chrono::system_clock::now();
   for (auto i = 0u; i < LOOP_COUNT; ++i)
   {
     std::stringstream s;
     s << "loop " << i;
-    v.push_back(s.str());
+    v->push_back(s.str());
   }
   auto end = std::chrono::system_clock::now();
   CHECK((end - start) / 1s < 1);
-  CHECK(v.size() == LOOP_COUNT + 2);
+  CHECK(v->size() == LOOP_COUNT + 2);
 }
 
-void run_test_two(const std::filesystem::path &p)
+void run_test_two(const std::filesystem::path &p, const storage::EngineOptions &options)
 {
-  PersistentVector v(p);
-
-  CHECK(v.size() == LOOP_COUNT + 2);
-  CHECK(v.at(0) == "foo");
-  CHECK(v.at(1) == all_chars());
-  CHECK(v.at(873) == "loop 871");
-
-  v.erase(873);
-  CHECK(v.size() == LOOP_COUNT + 1);
-  CHECK(v.at(0) == "foo");
-  CHECK(v.at(1) == all_chars());
-  CHECK(v.at(873) == "loop 872");
+  const auto v = storage::openEngine(p, options);
+
+  CHECK(v->size() == LOOP_COUNT + 2);
+  CHECK(v->at(0) == "foo");
+  CHECK(v->at(1) == all_chars());
+  CHECK(v->at(873) == "loop 871");
+
+  v->erase(873);
+  CHECK(v->size() == LOOP_COUNT + 1);
+  CHECK(v->at(0) == "foo");
+  CHECK(v->at(1) == all_chars());
+  CHECK(v->at(873) == "loop 872");
+}
+
+void run_test_three(const std::filesystem::path &p, const storage::EngineOptions &options)
+{
+  const auto v = storage::openEngine(p, options);
+
+  CHECK(v->size() == LOOP_COUNT + 1);
+  CHECK(v->at(0) == "foo");
+  CHECK(v->at(1) == all_chars());
+  CHECK(v->at(873) == "loop 872");
+
+  v->erase(873);
+  CHECK(v->size() == LOOP_COUNT);
+  CHECK(v->at(0) == "foo");
+  CHECK(v->at(1) == all_chars());
+  CHECK(v->at(873) == "loop 873");
+}
+
+auto parseFormat(const std::string_view name) -> storage::v2::Format
+{
+  if (name == "newline")
+  {
+    return storage::v2::Format::NEWLINE;
+  }
+  if (name == "length-prefixed")
+  {
+    return storage::v2::Format::LENGTH_PREFIXED;
+  }
+  if (name == "slots")
+  {
+    return storage::v2::Format::SLOTS;
+  }
+
+  throw std::invalid_argument("Unknown format \"" + std::string(name) + "\"");
+}
+
+int run_import(int argc, char *argv[])
+{
+  if (argc < 4)
+  {
+    std::cout << "usage: " << argv[0]
+              << " import <directory> <file> [newline|length-prefixed|slots] [threads]\n";
+    return 1;
+  }
+
+  const std::filesystem::path directory(argv[2]);
+  const std::filesystem::path file(argv[3]);
+  const auto format         = parseFormat(argc > 4 ? argv[4] : "newline");
+  const std::size_t threads = (argc > 5 ? std::stoul(argv[5]) : 0u);
+
+  std::filesystem::create_directories(directory);
+  PersistentVector v(directory);
+
+  auto start = std::chrono::system_clock::now();
+  v.import(file, format, threads);
+  auto end = std::chrono::system_clock::now();
+
+  std::cout << "imported " << file << " into " << directory << ", size is now " << v.size()
+            << " (" << std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count()
+            << "ms)\n";
+  return 0;
 }
 
-void run_test_three(const std::filesystem::path &p)
+int run_export(int argc, char *argv[])
 {
-  PersistentVector v(p);
-
-  CHECK(v.size() == LOOP_COUNT + 1);
-  CHECK(v.at(0) == "foo");
-  CHECK(v.at(1) == all_chars());
-  CHECK(v.at(873) == "loop 872");
-
-  v.erase(873);
-  CHECK(v.size() == LOOP_COUNT);
-  CHECK(v.at(0) == "foo");
-  CHECK(v.at(1) == all_chars());
-  CHECK(v.at(873) == "loop 873");
+  if (argc < 4)
+  {
+    std::cout << "usage: " << argv[0]
+              << " export <directory> <file> [newline|length-prefixed|slots] [first] [last]\n";
+    return 1;
+  }
+
+  const std::filesystem::path directory(argv[2]);
+  const std::filesystem::path file(argv[3]);
+  const auto format = parseFormat(argc > 4 ? argv[4] : "newline");
+
+  PersistentVector v(directory);
+  const std::size_t first = (argc > 5 ? std::stoul(argv[5]) : 0u);
+  const std::size_t last  = (argc > 6 ? std::stoul(argv[6]) : v.size());
+
+  const auto fd = ::open(file.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0)
+  {
+    std::cout << "failed to open " << file << "\n";
+    return 1;
+  }
+
+  auto start = std::chrono::system_clock::now();
+  v.export_to(fd, first, last, format);
+  auto end = std::chrono::system_clock::now();
+  ::close(fd);
+
+  std::cout << "exported " << last - first << " element(s) of " << directory << " to " << file
+            << " (" << std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count()
+            << "ms)\n";
+  return 0;
 }
 
-int main(int /*argc*/, char * /*argv*/[])
+int run_export_columns(int argc, char *argv[])
 {
+  if (argc < 5)
+  {
+    std::cout << "usage: " << argv[0]
+              << " export-columns <directory> <offsets file> <data file> [first] [last]\n";
+    return 1;
+  }
+
+  const std::filesystem::path directory(argv[2]);
+  const std::filesystem::path offsetsFile(argv[3]);
+  const std::filesystem::path dataFile(argv[4]);
+
+  PersistentVector v(directory);
+  const std::size_t first = (argc > 5 ? std::stoul(argv[5]) : 0u);
+  const std::size_t last  = (argc > 6 ? std::stoul(argv[6]) : v.size());
+
+  auto start = std::chrono::system_clock::now();
+  v.export_columns(offsetsFile, dataFile, first, last);
+  auto end = std::chrono::system_clock::now();
+
+  std::cout << "exported " << last - first << " element(s) of " << directory << " to "
+            << offsetsFile << " and " << dataFile << " ("
+            << std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count()
+            << "ms)\n";
+  return 0;
+}
+
+int run_follow(int argc, char *argv[])
+{
+  if (argc < 4)
+  {
+    std::cout << "usage: " << argv[0] << " follow <leader directory> <replica directory>\n";
+    return 1;
+  }
+
+  storage::v2::Follower follower(argv[2], argv[3]);
+  while (true)
+  {
+    if (follower.poll() == 0u)
+    {
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+  }
+
+  return 0;
+}
+
+int run_migrate(int argc, char *argv[])
+{
+  if (argc < 3)
+  {
+    std::cout << "usage: " << argv[0] << " migrate <v1 directory> [threads]\n";
+    return 1;
+  }
+
+  const std::filesystem::path directory(argv[2]);
+  const std::size_t threads = (argc > 3 ? std::stoul(argv[3]) : 0u);
+
+  auto start = std::chrono::system_clock::now();
+  storage::v2::migrate(directory, {}, threads);
+  auto end = std::chrono::system_clock::now();
+
+  std::cout << "migrated " << directory << " to v2 ("
+            << std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count()
+            << "ms)\n";
+  return 0;
+}
+
+storage::Server *server = nullptr;
+
+void stop_server(int)
+{
+  if (server != nullptr)
+  {
+    server->stop();
+  }
+}
+
+int run_serve(int argc, char *argv[])
+{
+  if (argc < 4)
+  {
+    std::cout << "usage: " << argv[0] << " serve <directory> <socket> [v1|v2]\n";
+    return 1;
+  }
+
+  const std::filesystem::path directory(argv[2]);
+  storage::EngineOptions options;
+  if (argc > 4)
+  {
+    options.backend = storage::parseBackend(argv[4]);
+    if (!options.backend)
+    {
+      std::cout << "unknown backend " << argv[4] << "\n";
+      return 1;
+    }
+  }
+
+  std::filesystem::create_directories(directory);
+  const auto v = storage::openEngine(directory, options);
+
+  storage::Server s(*v, argv[3]);
+  server = &s;
+  std::signal(SIGINT, stop_server);
+  std::signal(SIGTERM, stop_server);
+
+  s.run();
+  server = nullptr;
+  return 0;
+}
+
+int main(int argc, char *argv[])
+{
+  if (argc > 1 && std::string_view(argv[1]) == "import")
+  {
+    return run_import(argc, argv);
+  }
+  if (argc > 1 && std::string_view(argv[1]) == "export")
+  {
+    return run_export(argc, argv);
+  }
+  if (argc > 1 && std::string_view(argv[1]) == "export-columns")
+  {
+    return run_export_columns(argc, argv);
+  }
+  if (argc > 1 && std::string_view(argv[1]) == "follow")
+  {
+    return run_follow(argc, argv);
+  }
+  if (argc > 1 && std::string_view(argv[1]) == "migrate")
+  {
+    return run_migrate(argc, argv);
+  }
+  if (argc > 1 && std::string_view(argv[1]) == "serve")
+  {
+    return run_serve(argc, argv);
+  }
+
+  // The self-test runs on the backend given as argument, v2 by default.
+  storage::EngineOptions options;
+  if (argc > 1)
+  {
+    options.backend = storage::parseBackend(argv[1]);
+    if (!options.backend)
+    {
+      std::cout << "usage: " << argv[0]
+                << " [v1|v2|import|export|export-columns|follow|migrate|serve]\n";
+      return 1;
+    }
+  }
+
   constexpr auto DEFAULT_DATA_DIR = "dataDir";
 
   std::filesystem::current_path(std::filesystem::temp_directory_path());
@@ -103,9 +340,9 @@ int main(int /*argc*/, char * /*argv*/[])
   std::filesystem::path data_dir(DEFAULT_DATA_DIR);
   std::filesystem::create_directory(data_dir);
 
-  run_test_one(data_dir);
-  run_test_two(data_dir);
-  run_test_three(data_dir);
+  run_test_one(data_dir, options);
+  run_test_two(data_dir, options);
+  run_test_three(data_dir, options);
 
   if (errors != 0)
   {
@@ -0,0 +1,117 @@
+
+#include "PersistentVectorBlock.hh"
+#include "TestDirectory.hh"
+
+#include <atomic>
+#include <cstdlib>
+#include <gtest/gtest.h>
+#include <new>
+
+using namespace ::testing;
+
+namespace {
+std::atomic<std::size_t> allocations{0};
+} // namespace
+
+// Counts every heap allocation of the test binary, including the ones made
+// by the library.
+auto operator new(std::size_t size) -> void *
+{
+  ++allocations;
+  if (const auto memory = std::malloc(size == 0u ? 1u : size))
+  {
+    return memory;
+  }
+  throw std::bad_alloc();
+}
+
+auto operator new(std::size_t size, std::align_val_t alignment) -> void *
+{
+  ++allocations;
+  void *memory = nullptr;
+  if (::posix_memalign(&memory, static_cast<std::size_t>(alignment), size == 0u ? 1u : size) == 0)
+  {
+    return memory;
+  }
+  throw std::bad_alloc();
+}
+
+void operator delete(void *memory) noexcept
+{
+  std::free(memory);
+}
+
+void operator delete(void *memory, std::size_t) noexcept
+{
+  std::free(memory);
+}
+
+void operator delete(void *memory, std::align_val_t) noexcept
+{
+  std::free(memory);
+}
+
+void operator delete(void *memory, std::size_t, std::align_val_t) noexcept
+{
+  std::free(memory);
+}
+
+namespace storage {
+using PersistentVector = v2::PersistentVector;
+
+TEST(Unit_Storage_Allocation, SteadyStateAppendAndRead)
+{
+  const auto path = createEmptyDirectory("allocationDir");
+
+  PersistentVector vec(path);
+  vec.push_back("first");
+  ASSERT_EQ("first", vec.at(0));
+
+  constexpr std::size_t APPENDS = 30u;
+  const std::string value(100, 'x');
+  char buffer[16] = "element";
+
+  std::size_t mismatches = 0;
+  const auto before      = allocations.load();
+  for (std::size_t id = 1; id <= APPENDS; ++id)
+  {
+    // Stays in the first data block: starting a new one allocates.
+    buffer[7] = static_cast<char>('a' + id % 26);
+    vec.push_back(std::string_view(buffer, 8));
+    vec.push_back(value);
+    vec.emplace_back(buffer, 8u);
+
+    mismatches += vec.at(3 * id - 2) != std::string_view(buffer, 8);
+    mismatches += vec.at(3 * id - 1) != value;
+    mismatches += vec.at(0) != "first";
+  }
+  const auto after = allocations.load();
+
+  ASSERT_EQ(0u, mismatches);
+  ASSERT_EQ(1u + 3 * APPENDS, vec.size());
+  ASSERT_EQ(before, after);
+}
+
+TEST(Unit_Storage_Allocation, ArenaBackedCache)
+{
+  const auto path = createEmptyDirectory("allocationDir");
+
+  std::pmr::monotonic_buffer_resource arena;
+  PersistentVector vec(path, v2::Options{.memoryResource = &arena});
+  for (std::size_t id = 0; id < 250u; ++id)
+  {
+    vec.push_back(std::to_string(id));
+  }
+
+  // Reading the full data blocks again only allocates their buffers once.
+  ASSERT_EQ("0", vec.at(0));
+  ASSERT_EQ("100", vec.at(100));
+
+  const auto before = allocations.load();
+  for (std::size_t id = 0; id < 250u; ++id)
+  {
+    ASSERT_EQ(std::to_string(id).size(), vec.at(id).size());
+  }
+  ASSERT_EQ(before, allocations.load());
+}
+} // namespace storage
@@ -0,0 +1,274 @@
+#include "AsyncIo.hh"
+#include "PersistentVectorBlock.hh"
+#include "TestDirectory.hh"
+
+#include <gtest/gtest.h>
+
+#include <coroutine>
+#include <cstring>
+#include <fcntl.h>
+
+using namespace ::testing;
+
+namespace storage {
+using PersistentVector = v2::PersistentVector;
+
+namespace {
+constexpr std::size_t ELEMENTS_COUNT = 300u;
+
+auto generateElement(const std::size_t id) -> std::string
+{
+  return "element " + std::to_string(id);
+}
+
+// Coroutine running until its first suspension when called, then from the
+// completions polled by the test.
+struct Task
+{
+  struct promise_type
+  {
+    auto get_return_object() -> Task
+    {
+      return {};
+    }
+    auto initial_suspend() noexcept -> std::suspend_never
+    {
+      return {};
+    }
+    auto final_suspend() noexcept -> std::suspend_never
+    {
+      return {};
+    }
+    void return_void() {}
+    void unhandled_exception()
+    {
+      std::terminate();
+    }
+  };
+};
+
+auto pushBack(PersistentVector &vec, const std::size_t id, std::vector<std::size_t> &indices)
+  -> Task
+{
+  indices[id] = co_await vec.async_push_back(generateElement(id));
+}
+
+auto tryPushBack(PersistentVector &vec, const std::size_t id, std::size_t &failures) -> Task
+{
+  try
+  {
+    co_await vec.async_push_back(generateElement(id));
+  }
+  catch (const std::runtime_error &)
+  {
+    ++failures;
+  }
+}
+
+auto readAt(const PersistentVector &vec, const std::size_t index, std::vector<std::string> &values)
+  -> Task
+{
+  values[index] = co_await vec.async_at(index);
+}
+
+auto flush(PersistentVector &vec, bool &flushed) -> Task
+{
+  co_await vec.async_flush();
+  flushed = true;
+}
+
+void drain(AsyncIo &io)
+{
+  while (io.pending() > 0u)
+  {
+    io.poll(true);
+  }
+}
+
+void testOperations(AsyncIo &io)
+{
+  const auto path = createEmptyDirectory("asyncIoDir") / "file";
+  const FileDescriptor file(path, O_RDWR | O_CREAT | O_TRUNC);
+
+  const std::string first(4096, 'a');
+  const std::string second(4096, 'b');
+  std::vector<std::int64_t> results;
+  const auto record = [&results](const std::int64_t result) { results.push_back(result); };
+
+  io.write(file.get(), first.data(), first.size(), 0, record);
+  io.write(file.get(), second.data(), second.size(), 4096, record);
+  drain(io);
+  ASSERT_EQ((std::vector<std::int64_t>{4096, 4096}), results);
+
+  io.sync(file.get(), record);
+  drain(io);
+  ASSERT_EQ(0, results.back());
+
+  std::string content(8192, '\0');
+  io.read(file.get(), content.data(), content.size(), 0, record);
+  drain(io);
+  ASSERT_EQ(8192, results.back());
+  ASSERT_EQ(first + second, content);
+
+  // Errors are reported as -errno.
+  io.read(-1, content.data(), content.size(), 0, record);
+  drain(io);
+  ASSERT_EQ(-EBADF, results.back());
+}
+} // namespace
+
+TEST(Unit_Storage_Async, IoUring)
+{
+  AsyncIo io;
+  testOperations(io);
+}
+
+TEST(Unit_Storage_Async, Threads)
+{
+  AsyncIo io(256, 4, false);
+  ASSERT_EQ(AsyncIo::Backend::THREADS, io.backend());
+  testOperations(io);
+}
+
+TEST(Unit_Storage_Async, PushBack)
+{
+  const auto path = createEmptyDirectory("asyncDir");
+  auto io         = std::make_shared<AsyncIo>();
+  v2::Options options;
+  options.asyncIo = io;
+
+  {
+    PersistentVector vec(path, options);
+    std::vector<std::size_t> indices(ELEMENTS_COUNT);
+    for (std::size_t id = 0; id < ELEMENTS_COUNT; ++id)
+    {
+      pushBack(vec, id, indices);
+    }
+
+    // Synchronous modifications would reorder the pending appends.
+    ASSERT_THROW(vec.push_back("sync"), std::logic_error);
+    ASSERT_THROW(vec.erase(0), std::logic_error);
+
+    drain(*io);
+    ASSERT_EQ(ELEMENTS_COUNT, vec.size());
+    for (std::size_t id = 0; id < ELEMENTS_COUNT; ++id)
+    {
+      ASSERT_EQ(id, indices[id]);
+      ASSERT_EQ(generateElement(id), vec.at(id));
+    }
+
+    bool flushed = false;
+    flush(vec, flushed);
+    drain(*io);
+    ASSERT_TRUE(flushed);
+  }
+
+  PersistentVector vec(path);
+  ASSERT_EQ(ELEMENTS_COUNT, vec.size());
+  for (std::size_t id = 0; id < ELEMENTS_COUNT; ++id)
+  {
+    ASSERT_EQ(generateElement(id), vec.at(id));
+  }
+}
+
+TEST(Unit_Storage_Async, At)
+{
+  const auto path = createEmptyDirectory("asyncDir");
+  {
+    PersistentVector vec(path);
+    for (std::size_t id = 0; id < ELEMENTS_COUNT; ++id)
+    {
+      vec.push_back(generateElement(id));
+    }
+  }
+
+  auto io = std::make_shared<AsyncIo>(256, 0, false);
+  v2::Options options;
+  options.asyncIo = io;
+  const PersistentVector vec(path, options);
+
+  // Reads of the same data block share its load.
+  std::vector<std::string> values(ELEMENTS_COUNT);
+  for (std::size_t index = 0; index < ELEMENTS_COUNT; ++index)
+  {
+    readAt(vec, index, values);
+  }
+  drain(*io);
+  for (std::size_t index = 0; index < ELEMENTS_COUNT; ++index)
+  {
+    ASSERT_EQ(generateElement(index), values[index]);
+  }
+
+  ASSERT_THROW(vec.async_at(ELEMENTS_COUNT), std::out_of_range);
+
+  v2::Options readOnly;
+  readOnly.mode = v2::OpenMode::READ_ONLY;
+  const PersistentVector synchronous(path, readOnly);
+  ASSERT_THROW(synchronous.async_at(0), std::logic_error);
+}
+
+TEST(Unit_Storage_Async, FailedPushBackAcrossDataBlocks)
+{
+  const std::vector<std::shared_ptr<const Codec>> codecs{nullptr, std::make_shared<LzCodec>()};
+  for (const auto &codec : codecs)
+  {
+    const auto path = createEmptyDirectory("asyncDir");
+    {
+      PersistentVector vec(path, v2::Options{.codec = codec});
+      for (std::size_t id = 0; id < 95u; ++id)
+      {
+        vec.push_back(generateElement(id));
+      }
+    }
+
+    auto io = std::make_shared<AsyncIo>();
+    v2::Options options;
+    options.codec   = codec;
+    options.asyncIo = io;
+
+    {
+      PersistentVector vec(path, options);
+      ASSERT_EQ(generateElement(0), vec.at(0));
+
+      // The appends to the first data block fail, growing the vector anyway.
+      const auto dataBlock = path / "0000000000.txt";
+      std::filesystem::rename(dataBlock, path / "backup");
+      std::filesystem::create_symlink("/dev/full", dataBlock);
+
+      std::size_t failures = 0;
+      for (std::size_t id = 95; id < 105u; ++id)
+      {
+        tryPushBack(vec, id, failures);
+      }
+
+      // Compressing the sealed data block already replaced the link.
+      if (std::filesystem::is_symlink(dataBlock))
+      {
+        std::filesystem::rename(path / "backup", dataBlock);
+      }
+      std::filesystem::remove(path / "backup");
+      drain(*io);
+
+      // The data block grown for them is dropped.
+      ASSERT_EQ(10u, failures);
+      ASSERT_EQ(95u, vec.size());
+      ASSERT_FALSE(std::filesystem::exists(path / "0000000001.txt"));
+
+      vec.push_back(generateElement(95));
+      ASSERT_EQ(generateElement(95), vec.at(95));
+    }
+
+    PersistentVector vec(path, v2::Options{.codec = codec});
+    ASSERT_EQ(96u, vec.size());
+    for (std::size_t id = 96; id < 105u; ++id)
+    {
+      vec.push_back(generateElement(id));
+    }
+    for (std::size_t id = 0; id < 105u; ++id)
+    {
+      ASSERT_EQ(generateElement(id), vec.at(id));
+    }
+  }
+}
+
+} // namespace storage
@@ -0,0 +1,190 @@
+
+#include "Follower.hh"
+#include "PersistentVectorBlock.hh"
+#include "TestDirectory.hh"
+
+#include <gtest/gtest.h>
+
+using namespace ::testing;
+
+namespace storage {
+using PersistentVector = v2::PersistentVector;
+
+namespace {
+constexpr std::size_t ELEMENTS_COUNT = 150u;
+
+auto generateElement(const std::size_t id) -> std::string
+{
+  return "element " + std::to_string(id);
+}
+
+const v2::Options CHANGE_FEED{.changeFeed = true};
+} // namespace
+
+TEST(Unit_Storage_ChangeFeed, Subscribe)
+{
+  const auto path = createEmptyDirectory("leaderDir");
+
+  PersistentVector vec(path, CHANGE_FEED);
+  for (std::size_t id = 0; id < ELEMENTS_COUNT; ++id)
+  {
+    vec.push_back(generateElement(id));
+  }
+  vec.erase(3);
+
+  ASSERT_EQ(ELEMENTS_COUNT + 1, vec.sequence());
+
+  auto feed        = vec.subscribe(1);
+  const auto first = feed.next();
+  ASSERT_TRUE(first);
+  ASSERT_EQ(1u, first->sequence);
+  ASSERT_EQ(v2::ChangeType::APPEND, first->type);
+  ASSERT_EQ(0u, first->index);
+  ASSERT_EQ(generateElement(0), first->value);
+
+  auto tail         = vec.subscribe(ELEMENTS_COUNT + 1);
+  const auto erased = tail.next();
+  ASSERT_TRUE(erased);
+  ASSERT_EQ(v2::ChangeType::ERASE, erased->type);
+  ASSERT_EQ(3u, erased->index);
+  ASSERT_EQ(ELEMENTS_COUNT, erased->length);
+
+  // New changes are visible to existing subscribers.
+  ASSERT_FALSE(tail.next());
+  vec.push_back("new");
+  const auto appended = tail.next();
+  ASSERT_TRUE(appended);
+  ASSERT_EQ(ELEMENTS_COUNT + 2, appended->sequence);
+  ASSERT_EQ("new", appended->value);
+}
+
+TEST(Unit_Storage_ChangeFeed, SequenceSurvivesRestart)
+{
+  const auto path = createEmptyDirectory("leaderDir");
+
+  {
+    PersistentVector vec(path, CHANGE_FEED);
+    vec.push_back("a");
+    vec.push_back("b");
+  }
+
+  // Simulate a change torn by a crash.
+  const auto changes = path / "CHANGES.log";
+  std::filesystem::resize_file(changes, std::filesystem::file_size(changes) - 1u);
+
+  PersistentVector vec(path, CHANGE_FEED);
+  ASSERT_EQ(1u, vec.sequence());
+
+  vec.push_back("c");
+  ASSERT_EQ(2u, vec.sequence());
+
+  auto feed = vec.subscribe(2);
+  ASSERT_EQ("c", feed.next()->value);
+  ASSERT_THROW(PersistentVector(createEmptyDirectory("otherDir")).subscribe(0), std::logic_error);
+}
+
+TEST(Unit_Storage_ChangeFeed, Follower)
+{
+  const auto leaderPath  = createEmptyDirectory("leaderDir");
+  const auto replicaPath = createEmptyDirectory("replicaDir");
+
+  PersistentVector leader(leaderPath, CHANGE_FEED);
+
+  {
+    v2::Follower follower(leaderPath, replicaPath);
+    ASSERT_EQ(0u, follower.poll());
+
+    for (std::size_t id = 0; id < ELEMENTS_COUNT; ++id)
+    {
+      leader.push_back(generateElement(id));
+    }
+    leader.erase(120);
+
+    ASSERT_EQ(100u, follower.poll(100));
+    ASSERT_EQ(100u, follower.replica().size());
+    ASSERT_EQ(ELEMENTS_COUNT - 100 + 1, follower.poll());
+
+    ASSERT_EQ(leader.sequence(), follower.sequence());
+    ASSERT_EQ(ELEMENTS_COUNT - 1, follower.replica().size());
+    ASSERT_EQ(generateElement(121), follower.replica().at(120));
+  }
+
+  leader.push_back("after restart");
+  leader.erase(0);
+
+  v2::Follower follower(leaderPath, replicaPath);
+  ASSERT_EQ(2u, follower.poll());
+
+  ASSERT_EQ(leader.size(), follower.replica().size());
+  ASSERT_EQ(leader.at(0), follower.replica().at(0));
+  ASSERT_EQ("after restart", follower.replica().at(ELEMENTS_COUNT - 2));
+}
+
+TEST(Unit_Storage_ChangeFeed, ResetWithoutFeed)
+{
+  const auto leaderPath  = createEmptyDirectory("leaderDir");
+  const auto replicaPath = createEmptyDirectory("replicaDir");
+
+  {
+    PersistentVector leader(leaderPath, CHANGE_FEED);
+    leader.push_back("a");
+    leader.push_back("b");
+  }
+
+  {
+    v2::Follower follower(leaderPath, replicaPath);
+    ASSERT_EQ(2u, follower.poll());
+  }
+
+  // Changes made without the feed are missing from the log.
+  {
+    PersistentVector leader(leaderPath);
+    leader.push_back("c");
+    leader.erase(0);
+  }
+
+  PersistentVector leader(leaderPath, CHANGE_FEED);
+  leader.push_back("d");
+
+  auto feed        = leader.subscribe(3u);
+  const auto reset = feed.next();
+  ASSERT_TRUE(reset);
+  ASSERT_EQ(v2::ChangeType::RESET, reset->type);
+  ASSERT_EQ(2u, reset->length);
+
+  const auto next = feed.next();
+  ASSERT_TRUE(next);
+  ASSERT_EQ(4u, next->sequence);
+  ASSERT_EQ(2u, next->length);
+
+  v2::Follower follower(leaderPath, replicaPath);
+  ASSERT_THROW(follower.poll(), std::runtime_error);
+}
+
+TEST(Unit_Storage_ChangeFeed, FollowerDiverged)
+{
+  const auto leaderPath  = createEmptyDirectory("leaderDir");
+  const auto replicaPath = createEmptyDirectory("replicaDir");
+
+  PersistentVector leader(leaderPath, CHANGE_FEED);
+  leader.push_back("a");
+  leader.push_back("b");
+
+  {
+    v2::Follower follower(leaderPath, replicaPath);
+    ASSERT_EQ(2u, follower.poll());
+  }
+
+  {
+    PersistentVector replica(replicaPath);
+    replica.erase(0);
+  }
+
+  leader.push_back("c");
+
+  v2::Follower follower(leaderPath, replicaPath);
+  ASSERT_THROW(follower.poll(), std::runtime_error);
+  ASSERT_EQ(1u, follower.replica().size());
+}
+
+} // namespace storage
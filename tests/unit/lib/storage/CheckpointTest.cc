@@ -0,0 +1,99 @@
+
+#include "PersistentVectorBlock.hh"
+#include "TestDirectory.hh"
+
+#include <gtest/gtest.h>
+
+using namespace ::testing;
+
+namespace storage {
+using PersistentVector = v2::PersistentVector;
+
+namespace {
+constexpr std::size_t ELEMENTS_COUNT = 250u;
+
+auto generateElement(const std::size_t id) -> std::string
+{
+  return "element " + std::to_string(id);
+}
+} // namespace
+
+TEST(Unit_Storage_Checkpoint, SharesFullDataBlocks)
+{
+  const auto path = createEmptyDirectory("checkpointDir");
+  const std::filesystem::path checkpointPath("checkpointCopyDir");
+  std::filesystem::remove_all(checkpointPath);
+
+  PersistentVector vec(path);
+  for (std::size_t id = 0; id < ELEMENTS_COUNT; ++id)
+  {
+    vec.push_back(generateElement(id));
+  }
+
+  vec.checkpoint(checkpointPath);
+
+  std::size_t linked = 0, copied = 0;
+  for (const auto &entry : std::filesystem::directory_iterator(checkpointPath))
+  {
+    if (entry.path().extension() != ".txt" || entry.path().stem() == "HEADER"
+        || entry.path().stem() == "INDEX")
+    {
+      continue;
+    }
+
+    (std::filesystem::hard_link_count(entry.path()) == 2u ? linked : copied) += 1;
+  }
+  ASSERT_EQ(2u, linked);
+  ASSERT_EQ(1u, copied);
+
+  // Modifications of the vector must not leak into the checkpoint.
+  vec.erase(10);
+  vec.erase(220);
+  vec.push_back("after checkpoint");
+
+  ASSERT_EQ(ELEMENTS_COUNT - 1, vec.size());
+  ASSERT_EQ(generateElement(11), vec.at(10));
+  ASSERT_EQ("after checkpoint", vec.at(ELEMENTS_COUNT - 2));
+
+  PersistentVector checkpoint(checkpointPath);
+
+  ASSERT_EQ(ELEMENTS_COUNT, checkpoint.size());
+  ASSERT_EQ(generateElement(10), checkpoint.at(10));
+  ASSERT_EQ(generateElement(221), checkpoint.at(221));
+  ASSERT_EQ(generateElement(ELEMENTS_COUNT - 1), checkpoint.at(ELEMENTS_COUNT - 1));
+}
+
+TEST(Unit_Storage_Checkpoint, ReopenedVector)
+{
+  const auto path = createEmptyDirectory("checkpointDir");
+  const std::filesystem::path checkpointPath("checkpointCopyDir");
+  std::filesystem::remove_all(checkpointPath);
+
+  {
+    PersistentVector vec(path);
+    for (std::size_t id = 0; id < ELEMENTS_COUNT; ++id)
+    {
+      vec.push_back(generateElement(id));
+    }
+  }
+
+  PersistentVector vec(path);
+  vec.checkpoint(checkpointPath);
+
+  // The checkpoint is a vector of its own.
+  {
+    PersistentVector checkpoint(checkpointPath);
+    checkpoint.push_back("in checkpoint");
+    checkpoint.erase(0);
+    ASSERT_EQ(ELEMENTS_COUNT, checkpoint.size());
+    ASSERT_EQ("in checkpoint", checkpoint.at(ELEMENTS_COUNT - 1));
+  }
+
+  ASSERT_EQ(ELEMENTS_COUNT, vec.size());
+  ASSERT_EQ(generateElement(0), vec.at(0));
+  ASSERT_EQ(generateElement(ELEMENTS_COUNT - 1), vec.at(ELEMENTS_COUNT - 1));
+
+  ASSERT_THROW(vec.checkpoint(checkpointPath), std::invalid_argument);
+}
+
+} // namespace storage
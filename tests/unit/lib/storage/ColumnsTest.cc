@@ -0,0 +1,114 @@
+#include "Columns.hh"
+#include "PersistentVectorBlock.hh"
+#include "TestDirectory.hh"
+
+#include <gtest/gtest.h>
+
+using namespace ::testing;
+
+namespace storage {
+using PersistentVector = v2::PersistentVector;
+
+namespace {
+constexpr std::size_t ELEMENTS_COUNT = 450u;
+
+// Values of various sizes, some of them empty.
+auto generateElement(const std::size_t id) -> std::string
+{
+  return std::string(id % 7, 'a' + static_cast<char>(id % 26)) + std::to_string(id);
+}
+
+void expectColumns(const PersistentVector &vec, const v2::Columns &columns)
+{
+  ASSERT_EQ(vec.size(), columns.size());
+  ASSERT_EQ(vec.size() + 1u, columns.offsets().size());
+  for (std::size_t id = 0; id < vec.size(); ++id)
+  {
+    ASSERT_EQ(vec.at(id), columns.at(id));
+  }
+  ASSERT_EQ(columns.data().size(), columns.offsets().back());
+}
+} // namespace
+
+TEST(Unit_Storage_Columns, Export)
+{
+  const auto path = createEmptyDirectory("columnsDir");
+  PersistentVector vec(path);
+  for (std::size_t id = 0; id < ELEMENTS_COUNT; ++id)
+  {
+    vec.push_back(id % 50 == 0 ? std::string() : generateElement(id));
+  }
+  vec.erase(120);
+
+  vec.export_columns("columns.offsets", "columns.data", 0, vec.size());
+  expectColumns(vec, v2::Columns("columns.offsets", "columns.data"));
+
+  // Ranges start at offset 0, whatever their first element.
+  vec.export_columns("columns.offsets", "columns.data", 95, 310);
+  const v2::Columns range("columns.offsets", "columns.data");
+  ASSERT_EQ(215u, range.size());
+  ASSERT_EQ(0u, range.offsets().front());
+  for (std::size_t id = 0; id < range.size(); ++id)
+  {
+    ASSERT_EQ(vec.at(id + 95), range.at(id));
+  }
+  ASSERT_THROW(range.at(215), std::out_of_range);
+
+  vec.export_columns("columns.offsets", "columns.data", 10, 10);
+  ASSERT_EQ(0u, v2::Columns("columns.offsets", "columns.data").size());
+
+  ASSERT_THROW(vec.export_columns("columns.offsets", "columns.data", 10, vec.size() + 1),
+               std::out_of_range);
+}
+
+TEST(Unit_Storage_Columns, Sidecar)
+{
+  const auto path = createEmptyDirectory("columnsDir");
+  const v2::Options options{.columnarSidecar = true};
+  {
+    PersistentVector vec(path, options);
+    for (std::size_t id = 0; id < ELEMENTS_COUNT; ++id)
+    {
+      vec.push_back(generateElement(id));
+    }
+    expectColumns(vec, v2::Columns(path));
+
+    vec.erase(ELEMENTS_COUNT - 1);
+    vec.erase(150);
+    vec.erase(0);
+    expectColumns(vec, v2::Columns(path));
+
+    v2::WriteBatch batch;
+    batch.erase(3);
+    batch.push_back("batched");
+    vec.write(batch);
+    expectColumns(vec, v2::Columns(path));
+  }
+
+  // A missing tail is completed when the vector is opened.
+  std::filesystem::resize_file(path / v2::COLUMN_OFFSETS_FILE_NAME, 200 * sizeof(std::uint64_t));
+  {
+    PersistentVector vec(path, options);
+    expectColumns(vec, v2::Columns(path));
+  }
+  std::filesystem::resize_file(path / v2::COLUMN_DATA_FILE_NAME, 100);
+  {
+    ASSERT_GT(v2::Columns(path).size(), 0u);
+    ASSERT_LT(v2::Columns(path).size(), ELEMENTS_COUNT / 2);
+
+    PersistentVector vec(path, options);
+    expectColumns(vec, v2::Columns(path));
+  }
+
+  {
+    PersistentVector vec(path);
+  }
+  ASSERT_FALSE(std::filesystem::exists(path / v2::COLUMN_OFFSETS_FILE_NAME));
+  ASSERT_FALSE(std::filesystem::exists(path / v2::COLUMN_DATA_FILE_NAME));
+
+  // The sidecar of an existing vector is built when it is opened.
+  PersistentVector vec(path, options);
+  expectColumns(vec, v2::Columns(path));
+}
+
+} // namespace storage
@@ -0,0 +1,245 @@
+
+#include "Codec.hh"
+#include "PersistentVectorBlock.hh"
+#include "TestDirectory.hh"
+
+#include <atomic>
+#include <fcntl.h>
+#include <gtest/gtest.h>
+#include <random>
+#include <unistd.h>
+
+using namespace ::testing;
+
+namespace storage {
+using PersistentVector = v2::PersistentVector;
+
+namespace {
+constexpr std::size_t ELEMENTS_COUNT = 250u;
+constexpr std::size_t SLOT_SIZE      = 4096u;
+
+auto generateElement(const std::size_t id) -> std::string
+{
+  return "element " + std::to_string(id);
+}
+
+// Sizes of the data blocks, in the order of the index.
+auto dataBlockSizes(const std::filesystem::path &path) -> std::vector<std::uintmax_t>
+{
+  std::vector<std::uintmax_t> out;
+
+  std::ifstream indexFile(path / "INDEX.txt");
+  std::size_t firstId, size, fileId, directoryId;
+  while (indexFile >> firstId >> size >> fileId >> directoryId)
+  {
+    const auto name = std::to_string(fileId);
+    out.push_back(std::filesystem::file_size(path / (std::string(10u - name.size(), '0') + name
+                                                     + ".txt")));
+  }
+  return out;
+}
+
+auto roundTrip(const Codec &codec, const std::string &input) -> std::string
+{
+  std::string compressed;
+  codec.compress(input, compressed);
+
+  std::string out(input.size(), '\0');
+  codec.decompress(compressed, out.data(), out.size());
+  return out;
+}
+
+// Built-in codec under another name, which is thus only known when provided.
+class CustomCodec : public LzCodec
+{
+  public:
+  auto name() const -> std::string_view override
+  {
+    return "custom";
+  }
+
+  void compress(const std::string_view input, std::string &out) const override
+  {
+    ++this->calls;
+    LzCodec::compress(input, out);
+  }
+
+  mutable std::atomic<std::size_t> calls{0};
+};
+
+const v2::Options COMPRESSION{.codec = std::make_shared<LzCodec>()};
+} // namespace
+
+TEST(Unit_Storage_Compression, LzCodec)
+{
+  const LzCodec codec;
+
+  std::mt19937_64 random(42);
+  std::string noise(100000, '\0');
+  for (auto &byte : noise)
+  {
+    byte = static_cast<char>(random());
+  }
+
+  std::string text;
+  for (std::size_t id = 0; id < 10000; ++id)
+  {
+    text += generateElement(id % 97) + ";";
+  }
+
+  for (const auto &input : {std::string(), std::string("a"), std::string("abcdefghijkl"),
+                            std::string(409600, '\0'), noise, text, text + noise + text})
+  {
+    ASSERT_EQ(input, roundTrip(codec, input));
+  }
+
+  std::string compressed;
+  codec.compress(std::string(409600, '\0'), compressed);
+  ASSERT_LT(compressed.size(), 2000u);
+
+  compressed.clear();
+  codec.compress(text, compressed);
+  ASSERT_LT(compressed.size(), text.size() / 10u);
+
+  // Corrupted data is detected rather than decoded out of bounds.
+  std::string out(text.size(), '\0');
+  ASSERT_THROW(codec.decompress(std::string_view(compressed).substr(0, compressed.size() / 2),
+                                out.data(), out.size()),
+               std::runtime_error);
+  ASSERT_THROW(codec.decompress(compressed, out.data(), out.size() - 1), std::runtime_error);
+  ASSERT_THROW(codec.decompress(std::string_view("\x00\x05\x00", 3), out.data(), out.size()),
+               std::runtime_error);
+
+  ASSERT_NE(nullptr, findBuiltinCodec("lz"));
+  ASSERT_EQ(nullptr, findBuiltinCodec("custom"));
+}
+
+TEST(Unit_Storage_Compression, SealedDataBlocks)
+{
+  const auto path = createEmptyDirectory("compressionDir");
+  {
+    PersistentVector vec(path, COMPRESSION);
+    for (std::size_t id = 0; id < ELEMENTS_COUNT; ++id)
+    {
+      vec.push_back(generateElement(id));
+    }
+
+    for (std::size_t id = 0; id < ELEMENTS_COUNT; ++id)
+    {
+      ASSERT_EQ(generateElement(id), vec.at(id));
+    }
+  }
+
+  // The last data block stays raw.
+  const auto sizes = dataBlockSizes(path);
+  ASSERT_EQ(3u, sizes.size());
+  ASSERT_LT(sizes[0], 100u * SLOT_SIZE / 20u);
+  ASSERT_LT(sizes[1], 100u * SLOT_SIZE / 20u);
+  ASSERT_EQ(50u * SLOT_SIZE, sizes[2]);
+
+  // The built-in codecs are found without being provided.
+  PersistentVector vec(path);
+  for (std::size_t id = 0; id < ELEMENTS_COUNT; ++id)
+  {
+    ASSERT_EQ(generateElement(id), vec.at(id));
+  }
+  ASSERT_EQ(42u, vec.find(generateElement(42)));
+  ASSERT_EQ(std::vector<std::size_t>({12, 120, 121, 122, 123, 124, 125, 126, 127, 128, 129}),
+            vec.search("element 12", v2::SearchMode::PREFIX));
+
+  // Erasing from a sealed data block keeps it compressed.
+  PersistentVector compressed(createEmptyDirectory("compressionDir"), COMPRESSION);
+  for (std::size_t id = 0; id < ELEMENTS_COUNT; ++id)
+  {
+    compressed.push_back(generateElement(id));
+  }
+  compressed.erase(10);
+  ASSERT_EQ(generateElement(11), compressed.at(10));
+  ASSERT_EQ(generateElement(101), compressed.at(100));
+  ASSERT_LT(dataBlockSizes(path)[0], 100u * SLOT_SIZE / 20u);
+}
+
+TEST(Unit_Storage_Compression, ImportExport)
+{
+  const auto path = createEmptyDirectory("compressionDir");
+
+  const std::filesystem::path input("compression.txt");
+  {
+    std::ofstream out(input, std::ofstream::trunc);
+    for (std::size_t id = 0; id < ELEMENTS_COUNT; ++id)
+    {
+      out << generateElement(id) << "\n";
+    }
+  }
+
+  PersistentVector vec(path, COMPRESSION);
+  vec.import(input, v2::Format::NEWLINE);
+  vec.push_back(generateElement(ELEMENTS_COUNT));
+
+  const auto sizes = dataBlockSizes(path);
+  ASSERT_EQ(3u, sizes.size());
+  ASSERT_LT(sizes[0], 100u * SLOT_SIZE / 20u);
+  ASSERT_LT(sizes[1], 100u * SLOT_SIZE / 20u);
+  ASSERT_EQ(51u * SLOT_SIZE, sizes[2]);
+
+  const PersistentVector reopened(path, v2::Options{.mode = v2::OpenMode::READ_ONLY});
+  const std::filesystem::path output("compression.out");
+  {
+    const auto fd = ::open(output.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    ASSERT_GE(fd, 0);
+    reopened.export_to(fd, 0, reopened.size(), v2::Format::SLOTS);
+    ::close(fd);
+  }
+  ASSERT_EQ((ELEMENTS_COUNT + 1u) * SLOT_SIZE, std::filesystem::file_size(output));
+
+  PersistentVector imported(createEmptyDirectory("compressionImportDir"));
+  imported.import(output, v2::Format::SLOTS);
+  ASSERT_EQ(ELEMENTS_COUNT + 1u, imported.size());
+  for (std::size_t id = 0; id <= ELEMENTS_COUNT; ++id)
+  {
+    ASSERT_EQ(generateElement(id), imported.at(id));
+  }
+}
+
+TEST(Unit_Storage_Compression, Reader)
+{
+  const auto path = createEmptyDirectory("compressionDir");
+
+  PersistentVector writer(path, COMPRESSION);
+  for (std::size_t id = 0; id < ELEMENTS_COUNT; ++id)
+  {
+    writer.push_back(generateElement(id));
+  }
+
+  const PersistentVector reader(path, v2::Options{.mode = v2::OpenMode::READ_ONLY});
+  for (std::size_t id = 0; id < ELEMENTS_COUNT; ++id)
+  {
+    ASSERT_EQ(generateElement(id), reader.at(id));
+  }
+}
+
+TEST(Unit_Storage_Compression, CustomCodec)
+{
+  const auto path  = createEmptyDirectory("compressionDir");
+  const auto codec = std::make_shared<CustomCodec>();
+  {
+    PersistentVector vec(path, v2::Options{.codec = codec});
+    for (std::size_t id = 0; id < ELEMENTS_COUNT; ++id)
+    {
+      vec.push_back(generateElement(id));
+    }
+  }
+  ASSERT_EQ(2u, codec->calls);
+
+  {
+    const PersistentVector vec(path);
+    ASSERT_THROW(vec.at(0), std::runtime_error);
+    ASSERT_EQ(generateElement(200), vec.at(200));
+  }
+
+  const PersistentVector vec(path, v2::Options{.codec = codec});
+  ASSERT_EQ(generateElement(0), vec.at(0));
+  ASSERT_EQ(generateElement(150), vec.at(150));
+}
+
+} // namespace storage
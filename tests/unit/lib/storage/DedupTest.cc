@@ -0,0 +1,232 @@
+
+#include "PersistentVectorBlock.hh"
+#include "TestDirectory.hh"
+
+#include <fcntl.h>
+#include <gtest/gtest.h>
+#include <unistd.h>
+
+using namespace ::testing;
+
+namespace storage {
+using PersistentVector = v2::PersistentVector;
+
+namespace {
+constexpr std::size_t ELEMENTS_COUNT = 1000u;
+constexpr std::size_t HOSTS_COUNT    = 5u;
+
+// Alternates between a few long host names and short status codes.
+auto generateElement(const std::size_t id) -> std::string
+{
+  if (id % 2u == 0u)
+  {
+    return std::to_string(200 + id % 3u);
+  }
+
+  return "frontend-" + std::to_string(id % HOSTS_COUNT) + ".eu-west-1.compute.internal.example.com";
+}
+
+auto directorySize(const std::filesystem::path &path) -> std::uintmax_t
+{
+  std::uintmax_t out = 0;
+  for (const auto &entry : std::filesystem::directory_iterator(path))
+  {
+    out += entry.file_size();
+  }
+  return out;
+}
+
+const v2::Options DEDUPLICATION{.deduplication = true};
+} // namespace
+
+TEST(Unit_Storage_Dedup, RepeatedValues)
+{
+  const auto path = createEmptyDirectory("dedupDir");
+  {
+    PersistentVector vec(path, DEDUPLICATION);
+    for (std::size_t id = 0; id < ELEMENTS_COUNT; ++id)
+    {
+      vec.push_back(generateElement(id));
+    }
+
+    for (std::size_t id = 0; id < ELEMENTS_COUNT; ++id)
+    {
+      ASSERT_EQ(generateElement(id), vec.at(id));
+    }
+  }
+
+  // Each host name is stored once, next to slots of 32 bytes.
+  const auto valueSize = generateElement(1).size() + 16u;
+  ASSERT_EQ(HOSTS_COUNT * valueSize, std::filesystem::file_size(path / "VALUES.log"));
+  ASSERT_LT(directorySize(path), ELEMENTS_COUNT * 4096u / 10u);
+
+  PersistentVector vec(path);
+  ASSERT_EQ(ELEMENTS_COUNT, vec.size());
+  for (std::size_t id = 0; id < ELEMENTS_COUNT; ++id)
+  {
+    ASSERT_EQ(generateElement(id), vec.at(id));
+  }
+
+  vec.push_back(generateElement(3));
+  ASSERT_EQ(HOSTS_COUNT * valueSize, std::filesystem::file_size(path / "VALUES.log"));
+}
+
+TEST(Unit_Storage_Dedup, EraseKeepsSharedValues)
+{
+  const auto path = createEmptyDirectory("dedupDir");
+  {
+    PersistentVector vec(path, DEDUPLICATION);
+    for (std::size_t id = 0; id < ELEMENTS_COUNT; ++id)
+    {
+      vec.push_back(generateElement(id));
+    }
+
+    // Erasing some of the copies of a value keeps the other ones readable.
+    vec.erase(1);
+    vec.erase(10);
+    ASSERT_EQ(generateElement(10), vec.at(9));
+    ASSERT_EQ(generateElement(21), vec.at(19));
+  }
+
+  PersistentVector vec(path, DEDUPLICATION);
+  ASSERT_EQ(ELEMENTS_COUNT - 2u, vec.size());
+  ASSERT_EQ(generateElement(0), vec.at(0));
+  ASSERT_EQ(generateElement(21), vec.at(19));
+  ASSERT_EQ(generateElement(ELEMENTS_COUNT - 1), vec.at(ELEMENTS_COUNT - 3));
+  ASSERT_EQ(ELEMENTS_COUNT / 2u / HOSTS_COUNT - 2u, vec.count(generateElement(1)));
+}
+
+TEST(Unit_Storage_Dedup, Compaction)
+{
+  const auto path = createEmptyDirectory("dedupDir");
+
+  constexpr std::size_t UNIQUE_COUNT = 300u;
+  const auto unique = [](const std::size_t id) {
+    return std::to_string(id) + std::string(4000, 'x');
+  };
+
+  PersistentVector vec(path, DEDUPLICATION);
+  vec.push_back(generateElement(1));
+  for (std::size_t id = 0; id < UNIQUE_COUNT; ++id)
+  {
+    vec.push_back(unique(id));
+  }
+  vec.push_back(generateElement(1));
+  ASSERT_GT(std::filesystem::file_size(path / "VALUES.log"), UNIQUE_COUNT * 4000u);
+
+  // Unreferenced values are dropped once they outweigh the referenced ones.
+  for (std::size_t id = 0; id < UNIQUE_COUNT; ++id)
+  {
+    vec.erase(1);
+  }
+  ASSERT_LT(std::filesystem::file_size(path / "VALUES.log"), UNIQUE_COUNT * 4000u / 5u);
+  ASSERT_EQ(generateElement(1), vec.at(0));
+  ASSERT_EQ(generateElement(1), vec.at(1));
+
+  vec.push_back(unique(7));
+  ASSERT_EQ(unique(7), vec.at(2));
+}
+
+TEST(Unit_Storage_Dedup, Search)
+{
+  const auto path = createEmptyDirectory("dedupDir");
+
+  PersistentVector vec(path, v2::Options{.hashIndex = true, .deduplication = true});
+  for (std::size_t id = 0; id < ELEMENTS_COUNT; ++id)
+  {
+    vec.push_back(generateElement(id));
+  }
+
+  ASSERT_EQ(3u, vec.find(generateElement(3)));
+  ASSERT_EQ(7u, vec.index_of(generateElement(7)));
+  ASSERT_EQ(ELEMENTS_COUNT / 2u / HOSTS_COUNT, vec.count(generateElement(3)));
+  ASSERT_EQ(ELEMENTS_COUNT / 2u, vec.search("frontend-", v2::SearchMode::PREFIX).size());
+
+  const auto matches = vec.search("200", v2::SearchMode::SUBSTRING);
+  ASSERT_EQ(ELEMENTS_COUNT / 6u + 1u, matches.size());
+  ASSERT_EQ(std::vector<std::size_t>({0, 6, 12}),
+            std::vector<std::size_t>(matches.begin(), matches.begin() + 3));
+}
+
+TEST(Unit_Storage_Dedup, ExportImport)
+{
+  const auto path = createEmptyDirectory("dedupDir");
+  {
+    PersistentVector vec(path, DEDUPLICATION);
+    for (std::size_t id = 0; id < 250u; ++id)
+    {
+      vec.push_back(generateElement(id));
+    }
+  }
+
+  // Slots are exported in the layout of the regular vectors.
+  const PersistentVector vec(path);
+  const std::filesystem::path file("dedup.slots");
+  {
+    const auto fd = ::open(file.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    ASSERT_GE(fd, 0);
+    vec.export_to(fd, 0, vec.size(), v2::Format::SLOTS);
+    ::close(fd);
+  }
+  ASSERT_EQ(250u * 4096u, std::filesystem::file_size(file));
+
+  const auto plainPath = createEmptyDirectory("dedupPlainDir");
+  PersistentVector plain(plainPath);
+  plain.import(file, v2::Format::SLOTS);
+
+  const auto dedupPath = createEmptyDirectory("dedupImportDir");
+  PersistentVector deduplicated(dedupPath, DEDUPLICATION);
+  deduplicated.import(file, v2::Format::SLOTS);
+
+  ASSERT_EQ(250u, plain.size());
+  ASSERT_EQ(250u, deduplicated.size());
+  for (std::size_t id = 0; id < 250u; ++id)
+  {
+    ASSERT_EQ(generateElement(id), plain.at(id));
+    ASSERT_EQ(generateElement(id), deduplicated.at(id));
+  }
+}
+
+TEST(Unit_Storage_Dedup, Reader)
+{
+  const auto path = createEmptyDirectory("dedupDir");
+
+  PersistentVector writer(path, DEDUPLICATION);
+  writer.push_back(generateElement(1));
+
+  PersistentVector reader(path, v2::Options{.mode = v2::OpenMode::READ_ONLY});
+  ASSERT_EQ(generateElement(1), reader.at(0));
+
+  writer.push_back(generateElement(3));
+  writer.push_back(generateElement(4));
+  ASSERT_TRUE(reader.refresh());
+  ASSERT_EQ(3u, reader.size());
+  ASSERT_EQ(generateElement(3), reader.at(1));
+  ASSERT_EQ(generateElement(4), reader.at(2));
+}
+
+TEST(Unit_Storage_Dedup, Options)
+{
+  const auto path = createEmptyDirectory("dedupDir");
+  ASSERT_THROW(PersistentVector(path, v2::Options{.directIo = true, .deduplication = true}),
+               std::invalid_argument);
+  ASSERT_THROW(PersistentVector(path, v2::Options{.deduplication = true,
+                                                  .deduplicationThreshold = 5000}),
+               std::invalid_argument);
+
+  // Existing vectors keep their layout.
+  {
+    PersistentVector vec(path);
+    vec.push_back(generateElement(1));
+  }
+  {
+    PersistentVector vec(path, DEDUPLICATION);
+    vec.push_back(generateElement(1));
+  }
+  ASSERT_FALSE(std::filesystem::exists(path / "VALUES.log"));
+  ASSERT_EQ(2u * 4096u, directorySize(path) - std::filesystem::file_size(path / "HEADER.txt")
+                          - std::filesystem::file_size(path / "INDEX.txt")
+                          - std::filesystem::file_size(path / "FORMAT.txt"));
+}
+
+} // namespace storage
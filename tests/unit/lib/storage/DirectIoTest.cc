@@ -0,0 +1,94 @@
+
+#include "PersistentVectorBlock.hh"
+#include "TestDirectory.hh"
+
+#include <fcntl.h>
+#include <gtest/gtest.h>
+#include <unistd.h>
+
+using namespace ::testing;
+
+namespace storage {
+using PersistentVector = v2::PersistentVector;
+
+namespace {
+constexpr std::size_t ELEMENTS_COUNT = 350u;
+
+auto generateElement(const std::size_t id) -> std::string
+{
+  return "element " + std::to_string(id);
+}
+
+const v2::Options DIRECT_IO{.directIo = true, .cachedDataBlocks = 2};
+} // namespace
+
+TEST(Unit_Storage_DirectIo, ReadWrite)
+{
+  const auto path = createEmptyDirectory("directIoDir");
+
+  {
+    PersistentVector vec(path, DIRECT_IO);
+    for (std::size_t id = 0; id < ELEMENTS_COUNT; ++id)
+    {
+      vec.push_back(generateElement(id));
+      ASSERT_EQ(generateElement(id), vec.at(id));
+    }
+  }
+
+  PersistentVector vec(path, DIRECT_IO);
+  ASSERT_EQ(ELEMENTS_COUNT, vec.size());
+
+  // Going back and forth between the data blocks evicts them from the cache.
+  for (const auto id : {0u, 150u, 250u, 340u, 1u, 151u, 349u, 99u})
+  {
+    ASSERT_EQ(generateElement(id), vec.at(id));
+  }
+
+  vec.erase(10);
+  vec.erase(ELEMENTS_COUNT - 2);
+  ASSERT_EQ(ELEMENTS_COUNT - 2, vec.size());
+  ASSERT_EQ(generateElement(11), vec.at(10));
+  ASSERT_EQ(generateElement(ELEMENTS_COUNT - 3), vec.at(ELEMENTS_COUNT - 4));
+
+  vec.push_back(generateElement(ELEMENTS_COUNT));
+  ASSERT_EQ(generateElement(ELEMENTS_COUNT), vec.at(ELEMENTS_COUNT - 2));
+}
+
+TEST(Unit_Storage_DirectIo, SameLayout)
+{
+  const auto directPath   = createEmptyDirectory("directIoDir");
+  const auto bufferedPath = createEmptyDirectory("bufferedIoDir");
+
+  PersistentVector direct(directPath, DIRECT_IO);
+  PersistentVector buffered(bufferedPath);
+  for (std::size_t id = 0; id < ELEMENTS_COUNT; ++id)
+  {
+    direct.push_back(generateElement(id));
+    buffered.push_back(generateElement(id));
+  }
+
+  const auto exportSlots = [](const PersistentVector &vec, const std::string &name) {
+    const FileDescriptor out(name, O_WRONLY | O_CREAT | O_TRUNC);
+    vec.export_to(out.get(), 0, vec.size(), v2::Format::SLOTS);
+
+    std::ifstream in(name, std::ios::binary);
+    return std::string(std::istreambuf_iterator<char>(in), {});
+  };
+
+  const auto slots = exportSlots(direct, "directIo.slots");
+  ASSERT_EQ(ELEMENTS_COUNT * 4096u, slots.size());
+  ASSERT_EQ(exportSlots(buffered, "bufferedIo.slots"), slots);
+}
+
+TEST(Unit_Storage_DirectIo, OversizedElement)
+{
+  const auto path = createEmptyDirectory("directIoDir");
+
+  PersistentVector vec(path, DIRECT_IO);
+  ASSERT_THROW(vec.push_back(std::string(4096, 'x')), std::invalid_argument);
+  ASSERT_EQ(0u, vec.size());
+
+  vec.push_back(std::string(4096 - sizeof(std::size_t), 'x'));
+  ASSERT_EQ(4096 - sizeof(std::size_t), vec.at(0).size());
+}
+} // namespace storage
@@ -0,0 +1,123 @@
+
+#include "Engine.hh"
+#include "PersistentVector.hh"
+#include "TestDirectory.hh"
+
+#include <fstream>
+#include <gtest/gtest.h>
+
+using namespace ::testing;
+
+namespace storage {
+
+namespace {
+constexpr std::size_t ELEMENTS_COUNT = 150u;
+
+auto generateElement(const std::size_t id) -> std::string
+{
+  return "element " + std::to_string(id);
+}
+
+auto readFile(const std::filesystem::path &path) -> std::string
+{
+  std::ifstream in(path);
+  return std::string(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+}
+
+void fill(Engine &engine)
+{
+  for (std::size_t id = 0; id < ELEMENTS_COUNT; ++id)
+  {
+    engine.push_back(generateElement(id));
+  }
+  engine.erase(0);
+}
+
+void expectContent(const Engine &engine)
+{
+  ASSERT_EQ(ELEMENTS_COUNT - 1u, engine.size());
+  for (std::size_t id = 0; id + 1 < ELEMENTS_COUNT; ++id)
+  {
+    ASSERT_EQ(generateElement(id + 1), engine.at(id));
+  }
+}
+} // namespace
+
+TEST(Unit_Storage_Engine, SelectedBackend)
+{
+  for (const auto backend : {Backend::V1, Backend::V2})
+  {
+    const auto path = createEmptyDirectory("engineDir");
+    ASSERT_FALSE(detectBackend(path));
+    {
+      const auto engine = openEngine(path, EngineOptions{.backend = backend});
+      ASSERT_EQ(backend, engine->backend());
+      fill(*engine);
+    }
+    ASSERT_EQ(std::string(backendName(backend)) + "\n", readFile(path / "FORMAT.txt"));
+
+    // The backend is then taken from the directory.
+    const auto engine = openEngine(path);
+    ASSERT_EQ(backend, engine->backend());
+    expectContent(*engine);
+
+    const auto other = (backend == Backend::V1 ? Backend::V2 : Backend::V1);
+    ASSERT_THROW(openEngine(path, EngineOptions{.backend = other}), std::invalid_argument);
+  }
+}
+
+TEST(Unit_Storage_Engine, DirectlyOpened)
+{
+  const auto v1Path = createEmptyDirectory("engineV1Dir");
+  {
+    v1::PersistentVector vec(v1Path);
+  }
+  ASSERT_EQ("v1\n", readFile(v1Path / "FORMAT.txt"));
+  ASSERT_EQ(Backend::V1, detectBackend(v1Path));
+
+  const auto v2Path = createEmptyDirectory("engineV2Dir");
+  {
+    v2::PersistentVector vec(v2Path);
+  }
+  ASSERT_EQ("v2\n", readFile(v2Path / "FORMAT.txt"));
+  ASSERT_EQ(Backend::V2, detectBackend(v2Path));
+  ASSERT_THROW(openEngine(v2Path, EngineOptions{.backend = Backend::V1}), std::invalid_argument);
+}
+
+TEST(Unit_Storage_Engine, UntaggedDirectories)
+{
+  // Vectors written before the tag existed.
+  const auto v1Path = createEmptyDirectory("engineV1Dir");
+  {
+    v1::PersistentVector vec(v1Path);
+    vec.push_back("v1 element");
+  }
+  std::filesystem::remove(v1Path / "FORMAT.txt");
+  ASSERT_EQ(Backend::V1, detectBackend(v1Path));
+
+  const auto v2Path = createEmptyDirectory("engineV2Dir");
+  {
+    v2::PersistentVector vec(v2Path);
+    vec.push_back("v2 element");
+  }
+  std::filesystem::remove(v2Path / "FORMAT.txt");
+  ASSERT_EQ(Backend::V2, detectBackend(v2Path));
+
+  // Opening a directory tags it, unless it is read-only.
+  {
+    const auto engine = openEngine(
+      v2Path, EngineOptions{.v2 = v2::Options{.mode = v2::OpenMode::READ_ONLY}});
+    ASSERT_EQ("v2 element", engine->at(0));
+  }
+  ASSERT_FALSE(std::filesystem::exists(v2Path / "FORMAT.txt"));
+
+  const auto engine = openEngine(v1Path);
+  ASSERT_EQ(Backend::V1, engine->backend());
+  ASSERT_EQ("v1 element", engine->at(0));
+  ASSERT_EQ("v1\n", readFile(v1Path / "FORMAT.txt"));
+
+  std::ofstream(v2Path / "FORMAT.txt") << "v9\n";
+  ASSERT_THROW(detectBackend(v2Path), std::runtime_error);
+}
+
+} // namespace storage
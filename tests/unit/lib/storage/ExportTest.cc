@@ -0,0 +1,137 @@
+
+#include "PersistentVectorBlock.hh"
+#include "TestDirectory.hh"
+
+#include <fcntl.h>
+#include <gtest/gtest.h>
+#include <unistd.h>
+
+using namespace ::testing;
+
+namespace storage {
+using PersistentVector = v2::PersistentVector;
+
+namespace {
+constexpr std::size_t ELEMENTS_COUNT = 250u;
+
+auto createVector(const std::string &name) -> std::filesystem::path
+{
+  const auto dataDir = createEmptyDirectory(name);
+
+  PersistentVector vec(dataDir);
+  for (std::size_t id = 0; id < ELEMENTS_COUNT; ++id)
+  {
+    vec.push_back("element " + std::to_string(id));
+  }
+
+  return dataDir;
+}
+
+auto exportToFile(const PersistentVector &vec,
+                  const std::size_t first,
+                  const std::size_t last,
+                  const v2::Format &format) -> std::string
+{
+  const std::filesystem::path file("export.out");
+  const auto fd = ::open(file.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  EXPECT_GE(fd, 0);
+  vec.export_to(fd, first, last, format);
+  ::close(fd);
+
+  std::ifstream in(file, std::ios_base::binary);
+  return std::string(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+}
+} // namespace
+
+TEST(Unit_Storage_Export, Newline)
+{
+  const auto path = createVector("exportDir");
+  PersistentVector vec(path);
+
+  std::string expected;
+  for (std::size_t id = 95; id < 210; ++id)
+  {
+    expected += "element " + std::to_string(id) + "\n";
+  }
+
+  ASSERT_EQ(expected, exportToFile(vec, 95, 210, v2::Format::NEWLINE));
+  ASSERT_EQ("", exportToFile(vec, 12, 12, v2::Format::NEWLINE));
+}
+
+TEST(Unit_Storage_Export, LengthPrefixedFromCache)
+{
+  const auto path = createVector("exportDir");
+  PersistentVector vec(path);
+  ASSERT_EQ("element 150", vec.at(150));
+
+  std::string expected;
+  for (std::size_t id = 140; id < ELEMENTS_COUNT; ++id)
+  {
+    const auto element = "element " + std::to_string(id);
+    const auto size    = element.size();
+    expected.append(reinterpret_cast<const char *>(&size), sizeof(size));
+    expected += element;
+  }
+
+  ASSERT_EQ(expected, exportToFile(vec, 140, ELEMENTS_COUNT, v2::Format::LENGTH_PREFIXED));
+}
+
+TEST(Unit_Storage_Export, SlotsRoundTrip)
+{
+  const auto path = createVector("exportDir");
+
+  {
+    PersistentVector vec(path);
+    const auto content = exportToFile(vec, 0, ELEMENTS_COUNT, v2::Format::SLOTS);
+    ASSERT_EQ(ELEMENTS_COUNT * 4096u, content.size());
+  }
+
+  std::filesystem::path copyDir("exportCopyDir");
+  std::filesystem::remove_all(copyDir);
+  std::filesystem::create_directory(copyDir);
+
+  PersistentVector copy(copyDir);
+  copy.import("export.out", v2::Format::SLOTS);
+
+  ASSERT_EQ(ELEMENTS_COUNT, copy.size());
+  ASSERT_EQ("element 0", copy.at(0));
+  ASSERT_EQ("element 123", copy.at(123));
+  ASSERT_EQ("element 249", copy.at(249));
+}
+
+TEST(Unit_Storage_Export, SlotsToPipe)
+{
+  const auto path = createVector("exportDir");
+  PersistentVector vec(path);
+
+  int fds[2];
+  ASSERT_EQ(0, ::pipe(fds));
+
+  // Fits in the default pipe buffer.
+  vec.export_to(fds[1], 10, 12, v2::Format::SLOTS);
+  ::close(fds[1]);
+
+  std::string content(2 * 4096, '\0');
+  std::size_t read = 0;
+  while (read < content.size())
+  {
+    const auto count = ::read(fds[0], content.data() + read, content.size() - read);
+    ASSERT_GT(count, 0);
+    read += static_cast<std::size_t>(count);
+  }
+  ::close(fds[0]);
+
+  ASSERT_EQ("element 10", content.substr(sizeof(std::size_t), 10));
+  ASSERT_EQ("element 11", content.substr(4096 + sizeof(std::size_t), 10));
+}
+
+TEST(Unit_Storage_Export, OutOfRange)
+{
+  const auto path = createVector("exportDir");
+  PersistentVector vec(path);
+
+  ASSERT_THROW(vec.export_to(1, 0, ELEMENTS_COUNT + 1, v2::Format::NEWLINE), std::out_of_range);
+  ASSERT_THROW(vec.export_to(1, 20, 10, v2::Format::NEWLINE), std::out_of_range);
+}
+
+} // namespace storage
@@ -0,0 +1,150 @@
+
+#include "HashIndex.hh"
+#include "PersistentVectorBlock.hh"
+#include "TestDirectory.hh"
+
+#include <gtest/gtest.h>
+
+using namespace ::testing;
+
+namespace storage {
+using PersistentVector = v2::PersistentVector;
+
+namespace {
+constexpr std::size_t ELEMENTS_COUNT = 250u;
+
+auto generateElement(const std::size_t id) -> std::string
+{
+  return "element " + std::to_string(id);
+}
+
+const v2::Options HASH_INDEX{.hashIndex = true};
+} // namespace
+
+TEST(Unit_Storage_HashIndex, IndexOf)
+{
+  const auto path = createEmptyDirectory("hashIndexDir");
+
+  PersistentVector vec(path, HASH_INDEX);
+  for (std::size_t id = 0; id < ELEMENTS_COUNT; ++id)
+  {
+    vec.push_back(generateElement(id % 200));
+  }
+
+  ASSERT_EQ(0u, vec.index_of(generateElement(0)));
+  ASSERT_EQ(150u, vec.index_of(generateElement(150)));
+  ASSERT_FALSE(vec.index_of(generateElement(200)));
+
+  // The positions follow the erased elements.
+  vec.erase(10);
+  vec.erase(0);
+  ASSERT_EQ(48u, vec.index_of(generateElement(50)));
+  ASSERT_EQ(198u, vec.index_of(generateElement(0)));
+  ASSERT_EQ(8u, vec.index_of(generateElement(9)));
+  ASSERT_EQ(208u, vec.index_of(generateElement(10)));
+}
+
+TEST(Unit_Storage_HashIndex, Reopen)
+{
+  const auto path = createEmptyDirectory("hashIndexDir");
+
+  {
+    PersistentVector vec(path, HASH_INDEX);
+    for (std::size_t id = 0; id < ELEMENTS_COUNT; ++id)
+    {
+      vec.push_back(generateElement(id));
+    }
+    vec.erase(5);
+  }
+
+  // Elements appended without the index make it stale: it is rebuilt.
+  {
+    PersistentVector vec(path);
+    vec.push_back(generateElement(ELEMENTS_COUNT));
+  }
+
+  PersistentVector vec(path, HASH_INDEX);
+  ASSERT_EQ(4u, vec.index_of(generateElement(4)));
+  ASSERT_EQ(5u, vec.index_of(generateElement(6)));
+  ASSERT_FALSE(vec.index_of(generateElement(5)));
+  ASSERT_EQ(ELEMENTS_COUNT - 1u, vec.index_of(generateElement(ELEMENTS_COUNT)));
+}
+
+TEST(Unit_Storage_HashIndex, ModifiedWithoutIndex)
+{
+  const auto path = createEmptyDirectory("hashIndexDir");
+
+  {
+    PersistentVector vec(path, HASH_INDEX);
+    vec.push_back("a");
+    vec.push_back("b");
+  }
+
+  // The length is unchanged, the content is not.
+  {
+    PersistentVector vec(path);
+    vec.erase(1);
+    vec.push_back("c");
+  }
+
+  PersistentVector vec(path, HASH_INDEX);
+  ASSERT_EQ(1u, vec.find("c"));
+  ASSERT_EQ(1u, vec.index_of("c"));
+  ASSERT_FALSE(vec.index_of("b"));
+}
+
+TEST(Unit_Storage_HashIndex, Compaction)
+{
+  const auto path = createEmptyDirectory("hashIndexDir") / "HASH_INDEX.log";
+
+  constexpr std::uint64_t HASHES_COUNT = 3000u;
+  {
+    v2::HashIndex index(path);
+    for (std::uint64_t hash = 0; hash < HASHES_COUNT; ++hash)
+    {
+      index.append(hash % 1000u);
+    }
+
+    // Erases the even elements below 2000 as the positions shift.
+    for (std::size_t position = 0; position < 1000u; ++position)
+    {
+      index.erase(position);
+    }
+    // Then enough elements for the log to be rewritten.
+    for (std::size_t position = 0; position < 700u; ++position)
+    {
+      index.erase(index.size() - 1u);
+    }
+
+    ASSERT_EQ(HASHES_COUNT - 1700u, index.size());
+    ASSERT_LT(std::filesystem::file_size(path), HASHES_COUNT * 16u);
+  }
+
+  const v2::HashIndex index(path);
+  ASSERT_EQ(HASHES_COUNT - 1700u, index.size());
+
+  // The remaining elements are the odd ones below 2000 then 2000 to 2299.
+  ASSERT_EQ((std::vector<std::size_t>{0u, 500u, 1001u}), index.positions(1u));
+  ASSERT_EQ((std::vector<std::size_t>{1000u}), index.positions(0u));
+  ASSERT_EQ((std::vector<std::size_t>{149u, 649u, 1299u}), index.positions(299u));
+  ASSERT_TRUE(index.positions(300u).empty());
+}
+
+TEST(Unit_Storage_HashIndex, TornRecord)
+{
+  const auto path = createEmptyDirectory("hashIndexDir") / "HASH_INDEX.log";
+
+  {
+    v2::HashIndex index(path);
+    index.append(std::vector<std::uint64_t>{1u, 2u, 3u});
+  }
+  std::filesystem::resize_file(path, std::filesystem::file_size(path) - 3u);
+
+  v2::HashIndex index(path);
+  ASSERT_EQ(2u, index.size());
+  ASSERT_EQ((std::vector<std::size_t>{1u}), index.positions(2u));
+
+  index.append(3u);
+  ASSERT_EQ((std::vector<std::size_t>{2u}), index.positions(3u));
+}
+} // namespace storage
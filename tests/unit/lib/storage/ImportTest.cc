@@ -0,0 +1,105 @@
+
+#include "PersistentVectorBlock.hh"
+#include "TestDirectory.hh"
+
+#include <gtest/gtest.h>
+
+using namespace ::testing;
+
+namespace storage {
+using PersistentVector = v2::PersistentVector;
+
+namespace {
+constexpr std::size_t RECORDS_COUNT = 1050u;
+
+auto generateRecord(const std::size_t id) -> std::string
+{
+  return "record " + std::to_string(id);
+}
+} // namespace
+
+TEST(Unit_Storage_Import, Newline)
+{
+  const auto path = createEmptyDirectory("importDir");
+
+  const std::filesystem::path file("import.txt");
+  {
+    std::ofstream out(file, std::ios_base::trunc);
+    for (std::size_t id = 0; id < RECORDS_COUNT; ++id)
+    {
+      out << generateRecord(id) << "\n";
+    }
+  }
+
+  {
+    PersistentVector vec(path);
+    vec.push_back("foo");
+
+    vec.import(file, v2::Format::NEWLINE, 4);
+
+    ASSERT_EQ(RECORDS_COUNT + 1, vec.size());
+    ASSERT_EQ("foo", vec.at(0));
+    ASSERT_EQ(generateRecord(0), vec.at(1));
+    ASSERT_EQ(generateRecord(99), vec.at(100));
+    ASSERT_EQ(generateRecord(RECORDS_COUNT - 1), vec.at(RECORDS_COUNT));
+
+    vec.push_back("bar");
+    ASSERT_EQ("bar", vec.at(RECORDS_COUNT + 1));
+  }
+
+  PersistentVector vec(path);
+
+  ASSERT_EQ(RECORDS_COUNT + 2, vec.size());
+  ASSERT_EQ("foo", vec.at(0));
+  ASSERT_EQ(generateRecord(500), vec.at(501));
+  ASSERT_EQ(generateRecord(RECORDS_COUNT - 1), vec.at(RECORDS_COUNT));
+  ASSERT_EQ("bar", vec.at(RECORDS_COUNT + 1));
+}
+
+TEST(Unit_Storage_Import, LengthPrefixed)
+{
+  const auto path = createEmptyDirectory("importDir");
+
+  const std::string binary("line\nwith\0zero", 14);
+  const std::filesystem::path file("import.bin");
+  {
+    std::ofstream out(file, std::ios_base::binary | std::ios_base::trunc);
+    for (std::size_t id = 0; id < RECORDS_COUNT; ++id)
+    {
+      const auto record = (id % 2 == 0 ? binary : generateRecord(id));
+      const auto size   = record.size();
+      out.write(reinterpret_cast<const char *>(&size), sizeof(size));
+      out.write(record.data(), record.size());
+    }
+  }
+
+  PersistentVector vec(path);
+  vec.import(file, v2::Format::LENGTH_PREFIXED);
+
+  ASSERT_EQ(RECORDS_COUNT, vec.size());
+  ASSERT_EQ(binary, vec.at(0));
+  ASSERT_EQ(generateRecord(1), vec.at(1));
+  ASSERT_EQ(binary, vec.at(RECORDS_COUNT - 2));
+  ASSERT_EQ(generateRecord(RECORDS_COUNT - 1), vec.at(RECORDS_COUNT - 1));
+}
+
+TEST(Unit_Storage_Import, OversizedRecord)
+{
+  const auto path = createEmptyDirectory("importDir");
+
+  const std::filesystem::path file("import.txt");
+  {
+    std::ofstream out(file, std::ios_base::trunc);
+    for (std::size_t id = 0; id < RECORDS_COUNT; ++id)
+    {
+      out << generateRecord(id) << "\n";
+    }
+    out << std::string(5000, 'a') << "\n";
+  }
+
+  PersistentVector vec(path);
+  ASSERT_THROW(vec.import(file, v2::Format::NEWLINE), std::invalid_argument);
+  ASSERT_EQ(0, vec.size());
+}
+
+} // namespace storage
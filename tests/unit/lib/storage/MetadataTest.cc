@@ -0,0 +1,142 @@
+
+#include "PersistentVectorBlock.hh"
+#include "TestDirectory.hh"
+
+#include <fstream>
+#include <gtest/gtest.h>
+
+using namespace ::testing;
+
+namespace storage {
+using PersistentVector = v2::PersistentVector;
+
+namespace {
+constexpr std::size_t ELEMENTS_COUNT = 250u;
+
+auto generateElement(const std::size_t id) -> std::string
+{
+  return "element " + std::to_string(id);
+}
+
+auto readFile(const std::filesystem::path &path) -> std::string
+{
+  std::ifstream in(path);
+  return std::string(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+}
+
+void fill(const std::filesystem::path &path)
+{
+  PersistentVector vec(path);
+  for (std::size_t id = 0; id < ELEMENTS_COUNT; ++id)
+  {
+    vec.push_back(generateElement(id));
+  }
+}
+} // namespace
+
+TEST(Unit_Storage_Metadata, NumberedDataBlocks)
+{
+  const auto path = createEmptyDirectory("metadataDir");
+  fill(path);
+
+  // Data blocks are named after their file id, which the index holds
+  // instead of their path.
+  ASSERT_TRUE(std::filesystem::exists(path / "0000000000.txt"));
+  ASSERT_TRUE(std::filesystem::exists(path / "0000000001.txt"));
+  ASSERT_TRUE(std::filesystem::exists(path / "0000000002.txt"));
+  ASSERT_EQ("0 100 0 0\n100 100 1 0\n200 100 2 0\n", readFile(path / "INDEX.txt"));
+
+  // Emptied data blocks are dropped, the other ones keep their file.
+  {
+    PersistentVector vec(path);
+    for (std::size_t id = 0; id < 100u; ++id)
+    {
+      vec.erase(100);
+    }
+    vec.push_back("last");
+
+    ASSERT_EQ(generateElement(99), vec.at(99));
+    ASSERT_EQ(generateElement(200), vec.at(100));
+    ASSERT_EQ("last", vec.at(ELEMENTS_COUNT - 100));
+  }
+  ASSERT_FALSE(std::filesystem::exists(path / "0000000001.txt"));
+  ASSERT_EQ("0 100 0 0\n100 100 2 0\n", readFile(path / "INDEX.txt"));
+}
+
+TEST(Unit_Storage_Metadata, UncommittedDataBlocks)
+{
+  const auto path = createEmptyDirectory("metadataDir");
+  fill(path);
+
+  // Left by a crash during a grow or an import.
+  std::ofstream(path / "0000000003.txt") << "uncommitted";
+  std::ofstream(path / "0000000042.txt") << "uncommitted";
+  {
+    const PersistentVector reader(path, v2::Options{.mode = v2::OpenMode::READ_ONLY});
+    ASSERT_EQ(ELEMENTS_COUNT, reader.size());
+  }
+  ASSERT_TRUE(std::filesystem::exists(path / "0000000042.txt"));
+
+  PersistentVector vec(path);
+  ASSERT_FALSE(std::filesystem::exists(path / "0000000003.txt"));
+  ASSERT_FALSE(std::filesystem::exists(path / "0000000042.txt"));
+  ASSERT_TRUE(std::filesystem::exists(path / "0000000002.txt"));
+  ASSERT_EQ(generateElement(ELEMENTS_COUNT - 1), vec.at(ELEMENTS_COUNT - 1));
+}
+
+TEST(Unit_Storage_Metadata, LegacyIndex)
+{
+  const auto path = createEmptyDirectory("metadataDir");
+  fill(path);
+
+  // Older vectors had random file names, stored in the index.
+  const std::vector<std::string> names{"k3x0a9qz.txt", "00000001.txt", "m2b7c4d1.txt"};
+  {
+    std::ofstream index(path / "INDEX.txt", std::ofstream::trunc);
+    for (std::size_t id = 0; id < names.size(); ++id)
+    {
+      std::filesystem::rename(path / ("000000000" + std::to_string(id) + ".txt"),
+                              path / names[id]);
+      index << id * 100u << " 100 " << path / names[id] << "\n";
+    }
+  }
+
+  ASSERT_THROW(PersistentVector(path, v2::Options{.mode = v2::OpenMode::READ_ONLY}),
+               std::runtime_error);
+
+  {
+    PersistentVector vec(path);
+    ASSERT_EQ(ELEMENTS_COUNT, vec.size());
+    for (std::size_t id = 0; id < ELEMENTS_COUNT; ++id)
+    {
+      ASSERT_EQ(generateElement(id), vec.at(id));
+    }
+    vec.push_back("upgraded");
+  }
+
+  for (const auto &name : names)
+  {
+    ASSERT_FALSE(std::filesystem::exists(path / name));
+  }
+  ASSERT_EQ("0 100 0 0\n100 100 1 0\n200 100 2 0\n", readFile(path / "INDEX.txt"));
+
+  const PersistentVector vec(path, v2::Options{.mode = v2::OpenMode::READ_ONLY});
+  ASSERT_EQ(ELEMENTS_COUNT + 1u, vec.size());
+  ASSERT_EQ(generateElement(150), vec.at(150));
+  ASSERT_EQ("upgraded", vec.at(ELEMENTS_COUNT));
+}
+
+TEST(Unit_Storage_Metadata, TooManyDirectories)
+{
+  const auto path = createEmptyDirectory("metadataDir");
+
+  std::vector<std::filesystem::path> directories;
+  for (std::size_t id = 0; id < 257u; ++id)
+  {
+    directories.push_back(path / std::to_string(id));
+  }
+
+  ASSERT_THROW(PersistentVector{directories}, std::invalid_argument);
+}
+
+} // namespace storage
@@ -0,0 +1,172 @@
+
+#include "Migration.hh"
+#include "PersistentVector.hh"
+#include "PersistentVectorBlock.hh"
+#include "TestDirectory.hh"
+
+#include <fstream>
+#include <gtest/gtest.h>
+
+using namespace ::testing;
+
+namespace storage {
+
+namespace {
+constexpr std::size_t ELEMENTS_COUNT = 250u;
+
+// Also removes the staging directory of a previous migration.
+auto createMigrationDirectory(const std::string &name) -> std::filesystem::path
+{
+  const auto path = createEmptyDirectory(name);
+  std::filesystem::remove_all(name + ".migration");
+  return path;
+}
+
+auto generateElement(const std::size_t id) -> std::string
+{
+  return "element " + std::to_string(id) + std::string(id % 50u, '.');
+}
+
+void createV1Vector(const std::filesystem::path &path, const std::size_t count)
+{
+  v1::PersistentVector vec(path);
+  for (std::size_t id = 0; id < count; ++id)
+  {
+    vec.push_back(generateElement(id));
+  }
+}
+
+void writeFile(const std::filesystem::path &path, const std::string &content)
+{
+  std::ofstream out(path, std::ofstream::trunc);
+  out << content;
+}
+} // namespace
+
+TEST(Unit_Storage_Migration, Convert)
+{
+  constexpr std::size_t COUNT = 12000u;
+
+  const auto path = createMigrationDirectory("migrationDir");
+  {
+    v1::PersistentVector vec(path);
+    for (std::size_t id = 0; id < COUNT; ++id)
+    {
+      vec.push_back(generateElement(id));
+    }
+    vec.push_back("");
+    vec.erase(1);
+  }
+
+  // The paths of the v1 index are relative to the working directory of the
+  // writer, which does not need to be the same.
+  const auto absolutePath = std::filesystem::absolute(path);
+  std::filesystem::current_path("/");
+  v2::migrate(absolutePath, {}, 4);
+  std::filesystem::current_path(std::filesystem::temp_directory_path());
+
+  ASSERT_FALSE(std::filesystem::exists("migrationDir.migration"));
+  ASSERT_FALSE(std::filesystem::exists(path / "MIGRATION.txt"));
+  for (const auto &entry : std::filesystem::directory_iterator(path))
+  {
+    ASSERT_TRUE(entry.is_regular_file()) << entry.path();
+  }
+
+  const v2::PersistentVector vec(path);
+  ASSERT_EQ(COUNT, vec.size());
+  ASSERT_EQ(generateElement(0), vec.at(0));
+  for (std::size_t id = 1; id + 1 < COUNT; ++id)
+  {
+    ASSERT_EQ(generateElement(id + 1), vec.at(id));
+  }
+  ASSERT_EQ("", vec.at(COUNT - 1));
+}
+
+TEST(Unit_Storage_Migration, Resume)
+{
+  const auto path = createMigrationDirectory("migrationDir");
+  createV1Vector(path, ELEMENTS_COUNT);
+
+  // State left by a crash during the migration: some elements were copied,
+  // an import was interrupted.
+  const std::filesystem::path staging("migrationDir.migration");
+  {
+    std::filesystem::create_directory(staging);
+    writeFile(staging / "MIGRATION.txt", std::to_string(ELEMENTS_COUNT) + "\n");
+
+    v2::PersistentVector vec(staging);
+    for (std::size_t id = 0; id < 120u; ++id)
+    {
+      vec.push_back(generateElement(id));
+    }
+    writeFile(staging / "0000000099.txt", "orphan");
+    writeFile(staging / "MIGRATION.batch", "batch");
+  }
+
+  v2::migrate(path);
+
+  ASSERT_FALSE(std::filesystem::exists(staging));
+  ASSERT_FALSE(std::filesystem::exists(path / "0000000099.txt"));
+  ASSERT_FALSE(std::filesystem::exists(path / "MIGRATION.batch"));
+
+  const v2::PersistentVector vec(path);
+  ASSERT_EQ(ELEMENTS_COUNT, vec.size());
+  for (std::size_t id = 0; id < ELEMENTS_COUNT; ++id)
+  {
+    ASSERT_EQ(generateElement(id), vec.at(id));
+  }
+}
+
+TEST(Unit_Storage_Migration, SourceChanged)
+{
+  const auto path = createMigrationDirectory("migrationDir");
+  createV1Vector(path, ELEMENTS_COUNT);
+
+  // A staging directory for another length of the v1 vector is discarded.
+  const std::filesystem::path staging("migrationDir.migration");
+  {
+    std::filesystem::create_directory(staging);
+    writeFile(staging / "MIGRATION.txt", "7\n");
+
+    v2::PersistentVector vec(staging);
+    for (std::size_t id = 0; id < 7u; ++id)
+    {
+      vec.push_back("stale");
+    }
+  }
+
+  v2::migrate(path, v2::Options{.codec = std::make_shared<LzCodec>()});
+
+  const v2::PersistentVector vec(path);
+  ASSERT_EQ(ELEMENTS_COUNT, vec.size());
+  for (std::size_t id = 0; id < ELEMENTS_COUNT; ++id)
+  {
+    ASSERT_EQ(generateElement(id), vec.at(id));
+  }
+}
+
+TEST(Unit_Storage_Migration, Switched)
+{
+  const auto path = createMigrationDirectory("migrationDir");
+  createV1Vector(path, ELEMENTS_COUNT);
+  v2::migrate(path);
+
+  // State left by a crash right after the directories were exchanged.
+  const std::filesystem::path staging("migrationDir.migration");
+  std::filesystem::create_directory(staging);
+  createV1Vector(staging, 10u);
+  writeFile(path / "MIGRATION.txt", std::to_string(ELEMENTS_COUNT) + "\n");
+
+  v2::migrate(path);
+
+  ASSERT_FALSE(std::filesystem::exists(staging));
+  ASSERT_FALSE(std::filesystem::exists(path / "MIGRATION.txt"));
+
+  const v2::PersistentVector vec(path);
+  ASSERT_EQ(ELEMENTS_COUNT, vec.size());
+  ASSERT_EQ(generateElement(ELEMENTS_COUNT - 1), vec.at(ELEMENTS_COUNT - 1));
+
+  ASSERT_THROW(v2::migrate(createMigrationDirectory("migrationDir")), std::runtime_error);
+}
+
+} // namespace storage
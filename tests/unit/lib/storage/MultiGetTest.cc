@@ -0,0 +1,86 @@
+#include "PersistentVectorBlock.hh"
+#include "TestDirectory.hh"
+
+#include <gtest/gtest.h>
+
+using namespace ::testing;
+
+namespace storage {
+using PersistentVector = v2::PersistentVector;
+
+namespace {
+constexpr std::size_t ELEMENTS_COUNT = 450u;
+
+auto generateElement(const std::size_t id) -> std::string
+{
+  return "element " + std::to_string(id);
+}
+
+void fill(const std::filesystem::path &path)
+{
+  PersistentVector vec(path);
+  for (std::size_t id = 0; id < ELEMENTS_COUNT; ++id)
+  {
+    vec.push_back(generateElement(id));
+  }
+  vec.erase(150);
+}
+
+// Scattered over all the data blocks, unsorted and with duplicates.
+const std::vector<std::size_t> INDICES = {448, 3, 210, 99, 100, 3, 301, 0, 149, 150, 448, 257};
+
+void expectMultiGet(const PersistentVector &vec)
+{
+  const auto values = vec.multi_get(INDICES);
+  ASSERT_EQ(INDICES.size(), values.size());
+  for (std::size_t id = 0; id < INDICES.size(); ++id)
+  {
+    const auto index = INDICES[id];
+    ASSERT_EQ(generateElement(index < 150 ? index : index + 1), values[id]);
+  }
+}
+} // namespace
+
+TEST(Unit_Storage_MultiGet, Uncached)
+{
+  const auto path = createEmptyDirectory("multiGetDir");
+  fill(path);
+
+  const PersistentVector vec(path);
+  expectMultiGet(vec);
+
+  // Cached data blocks are used as is.
+  expectMultiGet(vec);
+  ASSERT_TRUE(vec.multi_get({}).empty());
+
+  const std::vector<std::size_t> outOfRange = {1, ELEMENTS_COUNT - 1};
+  ASSERT_THROW(vec.multi_get(outOfRange), std::out_of_range);
+}
+
+TEST(Unit_Storage_MultiGet, CacheLimit)
+{
+  const auto path = createEmptyDirectory("multiGetDir");
+  fill(path);
+
+  // All the views stay valid, even when their data blocks do not fit in the
+  // cache together.
+  v2::Options options;
+  options.cachedDataBlocks = 1;
+  const PersistentVector vec(path, options);
+  expectMultiGet(vec);
+  ASSERT_EQ(generateElement(20), vec.at(20));
+  expectMultiGet(vec);
+}
+
+TEST(Unit_Storage_MultiGet, ReadOnly)
+{
+  const auto path = createEmptyDirectory("multiGetDir");
+  fill(path);
+
+  v2::Options options;
+  options.mode = v2::OpenMode::READ_ONLY;
+  const PersistentVector vec(path, options);
+  expectMultiGet(vec);
+}
+
+} // namespace storage
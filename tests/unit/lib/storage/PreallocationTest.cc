@@ -0,0 +1,133 @@
+
+#include "PersistentVectorBlock.hh"
+#include "TestDirectory.hh"
+
+#include <fstream>
+#include <gtest/gtest.h>
+
+using namespace ::testing;
+
+namespace storage {
+using PersistentVector = v2::PersistentVector;
+
+namespace {
+constexpr std::size_t ELEMENTS_COUNT  = 150u;
+constexpr std::size_t DATA_BLOCK_SIZE = 100u * 4096u;
+
+const v2::Options PREALLOCATION{.preallocatedDataBlocks = 1};
+
+auto generateElement(const std::size_t id) -> std::string
+{
+  return "element " + std::to_string(id);
+}
+
+auto dataBlockFile(const std::filesystem::path &path, const std::size_t fileId)
+  -> std::filesystem::path
+{
+  const auto name = std::to_string(fileId);
+  return path / (std::string(10u - name.size(), '0') + name + ".txt");
+}
+} // namespace
+
+TEST(Unit_Storage_Preallocation, WholeDataBlocks)
+{
+  const auto path = createEmptyDirectory("preallocationDir");
+  {
+    PersistentVector vec(path, PREALLOCATION);
+    for (std::size_t id = 0; id < ELEMENTS_COUNT; ++id)
+    {
+      vec.push_back(generateElement(id));
+    }
+
+    // The last data block is allocated as soon as it is created.
+    ASSERT_EQ(DATA_BLOCK_SIZE, std::filesystem::file_size(dataBlockFile(path, 1)));
+  }
+
+  // The zeros of the allocated slots are not taken for elements.
+  {
+    PersistentVector vec(path, PREALLOCATION);
+    ASSERT_EQ(ELEMENTS_COUNT, vec.size());
+    ASSERT_THROW(vec.at(ELEMENTS_COUNT), std::out_of_range);
+
+    vec.erase(ELEMENTS_COUNT - 1);
+    vec.push_back("last");
+  }
+
+  const PersistentVector vec(path, v2::Options{.mode = v2::OpenMode::READ_ONLY});
+  ASSERT_EQ(ELEMENTS_COUNT, vec.size());
+  for (std::size_t id = 0; id + 1 < ELEMENTS_COUNT; ++id)
+  {
+    ASSERT_EQ(generateElement(id), vec.at(id));
+  }
+  ASSERT_EQ("last", vec.at(ELEMENTS_COUNT - 1));
+  ASSERT_EQ(DATA_BLOCK_SIZE, std::filesystem::file_size(dataBlockFile(path, 1)));
+}
+
+TEST(Unit_Storage_Preallocation, Reserve)
+{
+  const auto path = createEmptyDirectory("preallocationDir");
+  {
+    PersistentVector vec(path);
+    vec.reserve(350u);
+
+    // Nothing is committed: the files are only allocated.
+    ASSERT_EQ(0u, vec.size());
+    for (std::size_t fileId = 0; fileId < 4u; ++fileId)
+    {
+      ASSERT_EQ(DATA_BLOCK_SIZE, std::filesystem::file_size(dataBlockFile(path, fileId)));
+    }
+    ASSERT_FALSE(std::filesystem::exists(dataBlockFile(path, 4)));
+
+    for (std::size_t id = 0; id < ELEMENTS_COUNT; ++id)
+    {
+      vec.push_back(generateElement(id));
+    }
+    ASSERT_EQ(generateElement(ELEMENTS_COUNT - 1), vec.at(ELEMENTS_COUNT - 1));
+    ASSERT_TRUE(std::filesystem::exists(dataBlockFile(path, 3)));
+  }
+
+  // Data blocks allocated ahead are removed with the vector.
+  ASSERT_FALSE(std::filesystem::exists(dataBlockFile(path, 2)));
+  ASSERT_FALSE(std::filesystem::exists(dataBlockFile(path, 3)));
+
+  PersistentVector vec(path);
+  ASSERT_EQ(ELEMENTS_COUNT, vec.size());
+
+  // Imported data blocks take their file ids.
+  vec.reserve(ELEMENTS_COUNT + 300u);
+  {
+    std::ofstream out("preallocation.in", std::ofstream::trunc);
+    for (std::size_t id = 0; id < 100u; ++id)
+    {
+      out << generateElement(ELEMENTS_COUNT + id) << "\n";
+    }
+  }
+  vec.import("preallocation.in", v2::Format::NEWLINE);
+  ASSERT_FALSE(std::filesystem::exists(dataBlockFile(path, 3)));
+  ASSERT_FALSE(std::filesystem::exists(dataBlockFile(path, 4)));
+
+  vec.push_back("last");
+  ASSERT_EQ(ELEMENTS_COUNT + 101u, vec.size());
+  ASSERT_EQ(generateElement(ELEMENTS_COUNT + 99u), vec.at(ELEMENTS_COUNT + 99u));
+  ASSERT_EQ("last", vec.at(ELEMENTS_COUNT + 100u));
+}
+
+TEST(Unit_Storage_Preallocation, Policy)
+{
+  const auto path = createEmptyDirectory("preallocationDir");
+  {
+    PersistentVector vec(path);
+    vec.push_back(generateElement(0));
+    ASSERT_EQ(4096u, std::filesystem::file_size(dataBlockFile(path, 0)));
+  }
+
+  PersistentVector vec(path, v2::Options{.preallocatedDataBlocks = 3});
+  vec.push_back(generateElement(1));
+  ASSERT_EQ(DATA_BLOCK_SIZE, std::filesystem::file_size(dataBlockFile(path, 0)));
+  ASSERT_EQ(DATA_BLOCK_SIZE, std::filesystem::file_size(dataBlockFile(path, 1)));
+  ASSERT_EQ(DATA_BLOCK_SIZE, std::filesystem::file_size(dataBlockFile(path, 2)));
+  ASSERT_FALSE(std::filesystem::exists(dataBlockFile(path, 3)));
+  ASSERT_EQ(2u, vec.size());
+}
+
+} // namespace storage
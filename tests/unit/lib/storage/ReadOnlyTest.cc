@@ -0,0 +1,142 @@
+
+#include "PersistentVectorBlock.hh"
+#include "TestDirectory.hh"
+
+#include <gtest/gtest.h>
+
+#include <fstream>
+
+using namespace ::testing;
+
+namespace storage {
+using PersistentVector = v2::PersistentVector;
+
+namespace {
+constexpr std::size_t ELEMENTS_COUNT = 250u;
+
+auto generateElement(const std::size_t id) -> std::string
+{
+  return "element " + std::to_string(id);
+}
+
+auto countOpenFiles() -> std::size_t
+{
+  std::size_t count = 0;
+  for ([[maybe_unused]] const auto &entry : std::filesystem::directory_iterator("/proc/self/fd"))
+  {
+    ++count;
+  }
+  return count;
+}
+
+auto countMappings(const std::filesystem::path &path) -> std::size_t
+{
+  const auto directory = std::filesystem::absolute(path).string();
+
+  std::ifstream maps("/proc/self/maps");
+  std::size_t count = 0;
+  std::string line;
+  while (std::getline(maps, line))
+  {
+    count += (line.find(directory) != std::string::npos ? 1u : 0u);
+  }
+  return count;
+}
+
+const v2::Options READ_ONLY{.mode = v2::OpenMode::READ_ONLY};
+} // namespace
+
+TEST(Unit_Storage_ReadOnly, SingleWriter)
+{
+  const auto path = createEmptyDirectory("readOnlyDir");
+
+  PersistentVector writer(path);
+  ASSERT_THROW(PersistentVector second(path), std::runtime_error);
+
+  PersistentVector reader(path, READ_ONLY);
+  ASSERT_THROW(reader.push_back("value"), std::logic_error);
+  ASSERT_THROW(reader.erase(0), std::logic_error);
+}
+
+TEST(Unit_Storage_ReadOnly, MissingVector)
+{
+  const auto path = createEmptyDirectory("readOnlyDir");
+
+  ASSERT_THROW(PersistentVector reader(path, READ_ONLY), std::runtime_error);
+}
+
+TEST(Unit_Storage_ReadOnly, Refresh)
+{
+  const auto path = createEmptyDirectory("readOnlyDir");
+
+  PersistentVector writer(path);
+  writer.push_back(generateElement(0));
+
+  PersistentVector reader(path, READ_ONLY);
+  ASSERT_EQ(1u, reader.size());
+  ASSERT_FALSE(reader.refresh());
+
+  for (std::size_t id = 1; id < ELEMENTS_COUNT; ++id)
+  {
+    writer.push_back(generateElement(id));
+  }
+
+  ASSERT_EQ(1u, reader.size());
+  ASSERT_TRUE(reader.refresh());
+  ASSERT_EQ(ELEMENTS_COUNT, reader.size());
+  for (std::size_t id = 0; id < ELEMENTS_COUNT; ++id)
+  {
+    ASSERT_EQ(generateElement(id), reader.at(id));
+  }
+
+  writer.erase(5);
+  ASSERT_TRUE(reader.refresh());
+  ASSERT_EQ(ELEMENTS_COUNT - 1, reader.size());
+  ASSERT_EQ(generateElement(4), reader.at(4));
+  ASSERT_EQ(generateElement(6), reader.at(5));
+  ASSERT_EQ(generateElement(ELEMENTS_COUNT - 1), reader.at(ELEMENTS_COUNT - 2));
+}
+
+TEST(Unit_Storage_ReadOnly, BoundedMappings)
+{
+  const auto path = createEmptyDirectory("readOnlyDir");
+
+  // 30 full data blocks, all mapped by the reader.
+  constexpr std::size_t elementsCount = 3050u;
+  {
+    PersistentVector writer(path);
+    for (std::size_t id = 0; id < elementsCount; ++id)
+    {
+      writer.push_back(generateElement(id));
+    }
+  }
+
+  const auto openFiles = countOpenFiles();
+  const PersistentVector reader(
+    path, v2::Options{.mode = v2::OpenMode::READ_ONLY, .cachedDataBlocks = 4});
+  for (std::size_t id = 0; id < elementsCount; ++id)
+  {
+    ASSERT_EQ(generateElement(id), reader.at(id));
+  }
+
+  // Mapped data blocks are evicted like loaded ones and hold no descriptor.
+  ASSERT_LE(countMappings(path), 4u);
+  ASSERT_LE(countOpenFiles(), openFiles + 2u);
+}
+
+TEST(Unit_Storage_ReadOnly, WaitForChanges)
+{
+  const auto path = createEmptyDirectory("readOnlyDir");
+
+  PersistentVector writer(path);
+  writer.push_back(generateElement(0));
+
+  PersistentVector reader(path, READ_ONLY);
+  ASSERT_FALSE(reader.waitForChanges(std::chrono::milliseconds(10)));
+
+  writer.push_back(generateElement(1));
+  ASSERT_TRUE(reader.waitForChanges(std::chrono::milliseconds(1000)));
+  ASSERT_EQ(2u, reader.size());
+  ASSERT_EQ(generateElement(1), reader.at(1));
+}
+} // namespace storage
@@ -0,0 +1,134 @@
+
+#include "PersistentVectorBlock.hh"
+#include "Search.hh"
+#include "TestDirectory.hh"
+
+#include <gtest/gtest.h>
+#include <random>
+
+using namespace ::testing;
+
+namespace storage {
+using PersistentVector = v2::PersistentVector;
+
+namespace {
+constexpr std::size_t ELEMENTS_COUNT = 450u;
+
+auto generateElement(const std::size_t id) -> std::string
+{
+  return "element " + std::to_string(id);
+}
+
+auto supportedLevels() -> std::vector<SimdLevel>
+{
+  std::vector<SimdLevel> levels{SimdLevel::SCALAR};
+  if (detectSimdLevel() != SimdLevel::SCALAR)
+  {
+    levels.push_back(SimdLevel::SSE42);
+  }
+  if (detectSimdLevel() == SimdLevel::AVX2)
+  {
+    levels.push_back(SimdLevel::AVX2);
+  }
+  return levels;
+}
+} // namespace
+
+TEST(Unit_Storage_Search, Kernels)
+{
+  std::mt19937 generator(42);
+  std::uniform_int_distribution<int> letter('a', 'c');
+
+  for (const auto level : supportedLevels())
+  {
+    for (std::size_t size = 0; size < 200u; ++size)
+    {
+      std::string haystack(size, '\0');
+      for (auto &c : haystack)
+      {
+        c = static_cast<char>(letter(generator));
+      }
+
+      for (std::size_t needleSize = 0; needleSize < 6u; ++needleSize)
+      {
+        const auto start  = size > needleSize ? generator() % (size - needleSize) : 0u;
+        const auto needle = haystack.substr(start, needleSize) + (size % 3 == 0 ? "d" : "");
+
+        ASSERT_EQ(std::string_view(haystack).find(needle),
+                  findBytes(haystack, needle, level))
+          << "size " << size << ", needle \"" << needle << "\"";
+      }
+
+      auto other = haystack;
+      ASSERT_TRUE(equalBytes(haystack.data(), other.data(), size, level));
+      if (size > 0u)
+      {
+        other[generator() % size] = 'z';
+        ASSERT_FALSE(equalBytes(haystack.data(), other.data(), size, level));
+      }
+    }
+  }
+}
+
+TEST(Unit_Storage_Search, FindAndCount)
+{
+  const auto path = createEmptyDirectory("searchDir");
+
+  PersistentVector vec(path);
+  for (std::size_t id = 0; id < ELEMENTS_COUNT; ++id)
+  {
+    vec.push_back(generateElement(id % 300));
+  }
+
+  ASSERT_EQ(0u, vec.find(generateElement(0)));
+  ASSERT_EQ(123u, vec.find(generateElement(123)));
+  ASSERT_EQ(299u, vec.find(generateElement(299)));
+  ASSERT_FALSE(vec.find("element"));
+  ASSERT_FALSE(vec.find(generateElement(300)));
+
+  ASSERT_EQ(2u, vec.count(generateElement(42)));
+  ASSERT_EQ(1u, vec.count(generateElement(200)));
+  ASSERT_EQ(0u, vec.count("missing"));
+
+  const auto index = vec.find_if([](const std::string_view element) {
+    return element.size() == 11u && element.back() == '7';
+  });
+  ASSERT_EQ(107u, index);
+}
+
+TEST(Unit_Storage_Search, PrefixAndSubstring)
+{
+  const auto path = createEmptyDirectory("searchDir");
+
+  {
+    PersistentVector vec(path);
+    for (std::size_t id = 0; id < ELEMENTS_COUNT; ++id)
+    {
+      vec.push_back(generateElement(id));
+    }
+  }
+
+  // Data blocks are read from disk, without being cached.
+  PersistentVector vec(path, v2::Options{.directIo = true});
+
+  std::vector<std::size_t> prefixes;
+  std::vector<std::size_t> substrings;
+  for (std::size_t id = 0; id < ELEMENTS_COUNT; ++id)
+  {
+    const auto element = generateElement(id);
+    if (element.rfind("element 4", 0) == 0u)
+    {
+      prefixes.push_back(id);
+    }
+    if (element.find("23") != std::string::npos)
+    {
+      substrings.push_back(id);
+    }
+  }
+
+  ASSERT_EQ(prefixes, vec.search("element 4", v2::SearchMode::PREFIX));
+  ASSERT_EQ(substrings, vec.search("23", v2::SearchMode::SUBSTRING));
+  ASSERT_EQ(ELEMENTS_COUNT, vec.search("", v2::SearchMode::SUBSTRING).size());
+  ASSERT_TRUE(vec.search("element 1000", v2::SearchMode::PREFIX).empty());
+}
+} // namespace storage
@@ -0,0 +1,132 @@
+
+#include "Client.hh"
+#include "Server.hh"
+#include "TestDirectory.hh"
+
+#include <cstring>
+#include <gtest/gtest.h>
+#include <thread>
+
+using namespace ::testing;
+
+namespace storage {
+
+namespace {
+constexpr std::size_t ELEMENTS_COUNT = 500u;
+
+auto generateElement(const std::size_t id) -> std::string
+{
+  return "element " + std::to_string(id);
+}
+
+// Runs a server for the vector in `directory` while it is in scope.
+class RunningServer
+{
+  public:
+  RunningServer(const std::filesystem::path &directory, const std::filesystem::path &socketPath)
+    : engine(openEngine(directory))
+    , server(*engine, socketPath)
+    , thread([this]() { this->server.run(); })
+  {}
+
+  ~RunningServer()
+  {
+    this->server.stop();
+    this->thread.join();
+  }
+
+  private:
+  std::unique_ptr<Engine> engine;
+  Server server;
+  std::thread thread;
+};
+} // namespace
+
+TEST(Unit_Storage_Server, Operations)
+{
+  const auto path       = createEmptyDirectory("serverDir");
+  const auto socketPath = std::filesystem::absolute("serverDir.sock");
+  {
+    RunningServer server(path, socketPath);
+    Client client(socketPath);
+
+    ASSERT_EQ(0u, client.size());
+    for (std::size_t id = 0; id < ELEMENTS_COUNT; ++id)
+    {
+      ASSERT_EQ(id, client.push_back(generateElement(id)));
+    }
+    ASSERT_EQ(std::string(), client.at(client.push_back("")));
+
+    client.erase(ELEMENTS_COUNT);
+    client.erase(0);
+    ASSERT_EQ(ELEMENTS_COUNT - 1u, client.size());
+    ASSERT_EQ(generateElement(1), client.at(0));
+
+    const auto values = client.scan(10, 20);
+    ASSERT_EQ(10u, values.size());
+    for (std::size_t id = 0; id < values.size(); ++id)
+    {
+      ASSERT_EQ(generateElement(id + 11), values[id]);
+    }
+    ASSERT_TRUE(client.scan(5, 5).empty());
+
+    // Failed requests do not close the connection.
+    ASSERT_THROW(client.at(ELEMENTS_COUNT), std::runtime_error);
+    ASSERT_THROW(client.erase(ELEMENTS_COUNT), std::runtime_error);
+    ASSERT_THROW(client.scan(20, 10), std::runtime_error);
+    ASSERT_THROW(client.scan(0, ELEMENTS_COUNT), std::runtime_error);
+    ASSERT_EQ(ELEMENTS_COUNT - 1u, client.size());
+  }
+  ASSERT_FALSE(std::filesystem::exists(socketPath));
+
+  // The changes were committed to the vector.
+  const auto engine = openEngine(path);
+  ASSERT_EQ(ELEMENTS_COUNT - 1u, engine->size());
+  ASSERT_EQ(generateElement(ELEMENTS_COUNT - 1u), engine->at(ELEMENTS_COUNT - 2u));
+}
+
+TEST(Unit_Storage_Server, Pipelining)
+{
+  const auto path       = createEmptyDirectory("serverDir");
+  const auto socketPath = std::filesystem::absolute("serverDir.sock");
+  RunningServer server(path, socketPath);
+
+  Client first(socketPath);
+  Client second(socketPath);
+
+  // Both clients queue their requests before reading any response, large
+  // enough to fill the buffers of the socket.
+  const std::string large(2000, 'x');
+  for (std::size_t id = 0; id < ELEMENTS_COUNT; ++id)
+  {
+    first.send(Opcode::PUSH_BACK, large + generateElement(id));
+    second.send(Opcode::SIZE);
+  }
+
+  std::uint64_t index;
+  for (std::size_t id = 0; id < ELEMENTS_COUNT; ++id)
+  {
+    const auto response = first.receive();
+    ASSERT_EQ(sizeof(index), response.size());
+    std::memcpy(&index, response.data(), sizeof(index));
+    ASSERT_EQ(id, index);
+  }
+  for (std::size_t id = 0; id < ELEMENTS_COUNT; ++id)
+  {
+    ASSERT_EQ(sizeof(index), second.receive().size());
+  }
+
+  ASSERT_EQ(ELEMENTS_COUNT, second.size());
+  const auto values = second.scan(0, ELEMENTS_COUNT);
+  ASSERT_EQ(ELEMENTS_COUNT, values.size());
+  ASSERT_EQ(large + generateElement(ELEMENTS_COUNT - 1u), values.back());
+
+  // Unknown requests fail without closing the connection.
+  first.send(static_cast<Opcode>(0));
+  first.send(Opcode::AT);
+  ASSERT_THROW(first.receive(), std::runtime_error);
+  ASSERT_THROW(first.receive(), std::runtime_error);
+  ASSERT_EQ(large + generateElement(0), first.at(0));
+}
+
+} // namespace storage
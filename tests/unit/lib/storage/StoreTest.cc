@@ -0,0 +1,281 @@
+
+#include "Store.hh"
+#include "TestDirectory.hh"
+
+#include <gtest/gtest.h>
+
+#include <csignal>
+#include <fstream>
+#include <sys/resource.h>
+
+using namespace ::testing;
+
+namespace storage {
+
+namespace {
+constexpr std::size_t VECTORS_COUNT  = 1000u;
+constexpr std::size_t ELEMENTS_COUNT = 10u;
+
+auto generateName(const std::size_t id) -> std::string
+{
+  return "vector-" + std::to_string(id);
+}
+
+auto generateElement(const std::size_t vectorId, const std::size_t id) -> std::string
+{
+  return "element " + std::to_string(vectorId) + "/" + std::to_string(id);
+}
+
+auto segmentsIn(const std::filesystem::path &path) -> std::vector<std::filesystem::path>
+{
+  std::vector<std::filesystem::path> segments;
+  for (const auto &entry : std::filesystem::directory_iterator(path))
+  {
+    segments.push_back(entry.path());
+  }
+  return segments;
+}
+} // namespace
+
+TEST(Unit_Storage_Store, ManyVectors)
+{
+  const auto path = createEmptyDirectory("storeDir");
+
+  {
+    Store store(path);
+
+    std::vector<StoreVector> vectors;
+    for (std::size_t id = 0; id < VECTORS_COUNT; ++id)
+    {
+      vectors.push_back(store.open(generateName(id)));
+    }
+
+    for (std::size_t element = 0; element < ELEMENTS_COUNT; ++element)
+    {
+      for (std::size_t id = 0; id < VECTORS_COUNT; ++id)
+      {
+        vectors[id].push_back(generateElement(id, element));
+      }
+    }
+
+    ASSERT_EQ(VECTORS_COUNT, store.vectorsCount());
+    ASSERT_EQ(ELEMENTS_COUNT, vectors[17].size());
+    ASSERT_EQ(generateElement(17, 3), vectors[17].at(3));
+
+    store.flush();
+    ASSERT_EQ(generateElement(999, 9), vectors[999].at(9));
+  }
+
+  // All the vectors share the same log.
+  ASSERT_EQ(1u, segmentsIn(path).size());
+
+  {
+    Store store(path);
+    ASSERT_EQ(VECTORS_COUNT, store.vectorsCount());
+    ASSERT_TRUE(store.contains(generateName(512)));
+    ASSERT_FALSE(store.contains("missing"));
+
+    auto vec = store.open(generateName(512));
+    ASSERT_EQ(ELEMENTS_COUNT, vec.size());
+    ASSERT_EQ(generateElement(512, 0), vec.at(0));
+    ASSERT_EQ(generateElement(512, 9), vec.at(9));
+
+    vec.erase(4);
+    ASSERT_EQ(ELEMENTS_COUNT - 1, vec.size());
+    ASSERT_EQ(generateElement(512, 5), vec.at(4));
+    ASSERT_THROW(vec.at(ELEMENTS_COUNT - 1), std::out_of_range);
+    ASSERT_THROW(vec.erase(ELEMENTS_COUNT - 1), std::out_of_range);
+  }
+
+  Store store(path);
+  const auto vec   = store.open(generateName(512));
+  const auto other = store.open(generateName(511));
+
+  ASSERT_EQ(ELEMENTS_COUNT - 1, vec.size());
+  ASSERT_EQ(generateElement(512, 5), vec.at(4));
+  ASSERT_EQ(ELEMENTS_COUNT, other.size());
+  ASSERT_EQ(generateElement(511, 4), other.at(4));
+}
+
+TEST(Unit_Storage_Store, LargeValues)
+{
+  const auto path = createEmptyDirectory("storeDir");
+
+  const std::string large(200000, 'l');
+  {
+    Store store(path);
+    auto vec = store.open("large");
+
+    vec.push_back("small");
+    vec.push_back(large);
+    vec.push_back("");
+
+    ASSERT_EQ(large, vec.at(1));
+  }
+
+  Store store(path);
+  const auto vec = store.open("large");
+
+  ASSERT_EQ(3u, vec.size());
+  ASSERT_EQ("small", vec.at(0));
+  ASSERT_EQ(large, vec.at(1));
+  ASSERT_EQ("", vec.at(2));
+}
+
+TEST(Unit_Storage_Store, TornTail)
+{
+  const auto path = createEmptyDirectory("storeDir");
+
+  {
+    Store store(path);
+    auto vec = store.open("torn");
+    vec.push_back("first");
+    vec.push_back("second");
+    store.flush();
+    vec.push_back("third");
+  }
+
+  const auto segments = segmentsIn(path);
+  ASSERT_EQ(1u, segments.size());
+  std::filesystem::resize_file(segments[0], std::filesystem::file_size(segments[0]) - 2u);
+
+  {
+    Store store(path);
+    auto vec = store.open("torn");
+
+    ASSERT_EQ(2u, vec.size());
+    ASSERT_EQ("second", vec.at(1));
+
+    vec.push_back("fourth");
+  }
+
+  Store store(path);
+  const auto vec = store.open("torn");
+
+  ASSERT_EQ(3u, vec.size());
+  ASSERT_EQ("first", vec.at(0));
+  ASSERT_EQ("fourth", vec.at(2));
+}
+
+TEST(Unit_Storage_Store, Compaction)
+{
+  const auto path = createEmptyDirectory("storeDir");
+
+  const std::string large(1u << 20, 'c');
+  {
+    Store store(path);
+    auto kept   = store.open("kept");
+    auto erased = store.open("erased");
+
+    kept.push_back("first");
+    for (std::size_t id = 0; id < 10u; ++id)
+    {
+      erased.push_back(large);
+    }
+    kept.push_back("second");
+    for (std::size_t id = 0; id < 9u; ++id)
+    {
+      erased.erase(0);
+    }
+    store.flush();
+    ASSERT_GT(std::filesystem::file_size(segmentsIn(path)[0]), 10u * large.size());
+
+    store.compact();
+    ASSERT_EQ(1u, segmentsIn(path).size());
+    ASSERT_LT(std::filesystem::file_size(segmentsIn(path)[0]), 2u * large.size());
+    ASSERT_EQ(2u, kept.size());
+    ASSERT_EQ("second", kept.at(1));
+    ASSERT_EQ(1u, erased.size());
+    ASSERT_EQ(large, erased.at(0));
+
+    kept.push_back("third");
+  }
+
+  ASSERT_EQ(1u, segmentsIn(path).size());
+
+  Store store(path);
+  ASSERT_EQ(2u, store.vectorsCount());
+  const auto kept   = store.open("kept");
+  const auto erased = store.open("erased");
+
+  ASSERT_EQ(3u, kept.size());
+  ASSERT_EQ("first", kept.at(0));
+  ASSERT_EQ("third", kept.at(2));
+  ASSERT_EQ(1u, erased.size());
+  ASSERT_EQ(large, erased.at(0));
+}
+
+TEST(Unit_Storage_Store, OversizeValue)
+{
+  const auto path = createEmptyDirectory("storeDir");
+
+  Store store(path);
+  auto vec = store.open("oversize");
+
+  // The size of a record is stored on 32 bits and it must fit in a segment.
+  const std::string oversize((64u << 20) + 1u, 'o');
+  ASSERT_THROW(vec.push_back(oversize), std::invalid_argument);
+  ASSERT_EQ(0u, vec.size());
+
+  vec.push_back("small");
+  ASSERT_EQ("small", vec.at(0));
+}
+
+TEST(Unit_Storage_Store, FailedFlush)
+{
+  const auto path = createEmptyDirectory("storeDir");
+
+  const std::string value(1000, 'f');
+  {
+    Store store(path);
+    auto vec = store.open("failed");
+    vec.push_back("first");
+    store.flush();
+    for (std::size_t id = 0; id < 10u; ++id)
+    {
+      vec.push_back(value);
+    }
+
+    // The segment cannot grow past a few records: the flush is only partially
+    // written.
+    const auto segment = segmentsIn(path)[0];
+    rlimit limit{};
+    ASSERT_EQ(0, ::getrlimit(RLIMIT_FSIZE, &limit));
+    const auto previousHandler = std::signal(SIGXFSZ, SIG_IGN);
+    rlimit lowered   = limit;
+    lowered.rlim_cur = std::filesystem::file_size(segment) + 2500u;
+    ASSERT_EQ(0, ::setrlimit(RLIMIT_FSIZE, &lowered));
+    ASSERT_THROW(store.flush(), std::runtime_error);
+    ASSERT_EQ(0, ::setrlimit(RLIMIT_FSIZE, &limit));
+    std::signal(SIGXFSZ, previousHandler);
+
+    store.flush();
+  }
+
+  Store store(path);
+  const auto vec = store.open("failed");
+  ASSERT_EQ(11u, vec.size());
+  ASSERT_EQ("first", vec.at(0));
+  ASSERT_EQ(value, vec.at(10));
+}
+
+TEST(Unit_Storage_Store, ForeignFiles)
+{
+  const auto path = createEmptyDirectory("storeDir");
+  {
+    Store store(path);
+    store.open("foreign").push_back("value");
+  }
+
+  // Only files named like segments are replayed or removed.
+  std::ofstream(path / "notes.log") << "not a segment\n";
+  std::ofstream(path / "notes.tmp") << "not a compaction\n";
+
+  Store store(path);
+  ASSERT_EQ("value", store.open("foreign").at(0));
+  store.compact();
+  ASSERT_TRUE(std::filesystem::exists(path / "notes.log"));
+  ASSERT_TRUE(std::filesystem::exists(path / "notes.tmp"));
+}
+
+} // namespace storage
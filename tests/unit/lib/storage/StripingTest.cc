@@ -0,0 +1,157 @@
+
+#include "PersistentVectorBlock.hh"
+#include "TestDirectory.hh"
+
+#include <gtest/gtest.h>
+
+using namespace ::testing;
+
+namespace storage {
+using PersistentVector = v2::PersistentVector;
+
+namespace {
+constexpr std::size_t ELEMENTS_COUNT = 1200u;
+
+auto createEmptyDirectories() -> std::vector<std::filesystem::path>
+{
+  std::vector<std::filesystem::path> directories;
+  for (const auto name : {"stripeDir0", "stripeDir1", "stripeDir2"})
+  {
+    directories.push_back(createEmptyDirectory(name));
+  }
+
+  return directories;
+}
+
+auto countDataBlocks(const std::filesystem::path &directory) -> std::size_t
+{
+  std::size_t count = 0;
+  for (const auto &entry : std::filesystem::directory_iterator(directory))
+  {
+    const auto name = entry.path().filename();
+    count += (name != "HEADER.txt" && name != "INDEX.txt" && name != "FORMAT.txt" ? 1u : 0u);
+  }
+  return count;
+}
+
+auto generateElement(const std::size_t id) -> std::string
+{
+  return "element " + std::to_string(id);
+}
+} // namespace
+
+TEST(Unit_Storage_Striping, RoundRobin)
+{
+  const auto directories = createEmptyDirectories();
+
+  {
+    PersistentVector vec(directories);
+    for (std::size_t id = 0; id < ELEMENTS_COUNT; ++id)
+    {
+      vec.push_back(generateElement(id));
+    }
+  }
+
+  for (const auto &directory : directories)
+  {
+    ASSERT_EQ(ELEMENTS_COUNT / 100u / directories.size(), countDataBlocks(directory));
+  }
+  ASSERT_TRUE(std::filesystem::exists(directories[0] / "HEADER.txt"));
+
+  // The metadata are found whatever the order of the directories.
+  const std::vector<std::filesystem::path> reordered{directories[2], directories[0],
+                                                     directories[1]};
+  PersistentVector vec(reordered);
+
+  ASSERT_EQ(ELEMENTS_COUNT, vec.size());
+  ASSERT_EQ(generateElement(0), vec.at(0));
+  ASSERT_EQ(generateElement(750), vec.at(750));
+
+  vec.erase(120);
+  vec.push_back("last");
+
+  ASSERT_EQ(generateElement(121), vec.at(120));
+  ASSERT_EQ("last", vec.at(ELEMENTS_COUNT - 1));
+  ASSERT_FALSE(std::filesystem::exists(directories[2] / "HEADER.txt"));
+}
+
+TEST(Unit_Storage_Striping, RelocatedDirectory)
+{
+  const auto directories = createEmptyDirectories();
+
+  {
+    PersistentVector vec(directories);
+    for (std::size_t id = 0; id < ELEMENTS_COUNT; ++id)
+    {
+      vec.push_back(generateElement(id));
+    }
+  }
+
+  std::filesystem::remove_all("stripeDir3");
+  std::filesystem::rename(directories[1], "stripeDir3");
+
+  PersistentVector vec({directories[0], "stripeDir3", directories[2]});
+
+  ASSERT_EQ(ELEMENTS_COUNT, vec.size());
+  ASSERT_EQ(generateElement(150), vec.at(150));
+  ASSERT_EQ(generateElement(1150), vec.at(1150));
+}
+
+TEST(Unit_Storage_Striping, FreeSpaceAndPrefetch)
+{
+  const auto directories = createEmptyDirectories();
+
+  const v2::Options options{.striping = v2::StripingPolicy::FREE_SPACE};
+  {
+    PersistentVector vec(directories, options);
+    for (std::size_t id = 0; id < ELEMENTS_COUNT; ++id)
+    {
+      vec.push_back(generateElement(id));
+    }
+  }
+
+  std::size_t dataBlocksCount = 0;
+  for (const auto &directory : directories)
+  {
+    dataBlocksCount += countDataBlocks(directory);
+  }
+  ASSERT_EQ(ELEMENTS_COUNT / 100u, dataBlocksCount);
+
+  PersistentVector vec(directories, options);
+  vec.prefetch(0, ELEMENTS_COUNT);
+
+  for (std::size_t id = 0; id < ELEMENTS_COUNT; id += 97)
+  {
+    ASSERT_EQ(generateElement(id), vec.at(id));
+  }
+
+  ASSERT_THROW(vec.prefetch(10, ELEMENTS_COUNT + 1), std::out_of_range);
+}
+
+TEST(Unit_Storage_Striping, PrefetchMissingDataBlock)
+{
+  const auto directories = createEmptyDirectories();
+  {
+    PersistentVector vec(directories);
+    for (std::size_t id = 0; id < ELEMENTS_COUNT; ++id)
+    {
+      vec.push_back(generateElement(id));
+    }
+  }
+
+  PersistentVector vec(directories);
+  for (const auto &directory : directories)
+  {
+    std::filesystem::remove(directory / "0000000003.txt");
+  }
+
+  // The error of a reader is reported by the caller.
+  ASSERT_THROW(vec.prefetch(0, ELEMENTS_COUNT), std::runtime_error);
+  ASSERT_THROW(vec.at(350), std::runtime_error);
+
+  vec.prefetch(400, ELEMENTS_COUNT);
+  ASSERT_EQ(generateElement(150), vec.at(150));
+  ASSERT_EQ(generateElement(1150), vec.at(1150));
+}
+
+} // namespace storage
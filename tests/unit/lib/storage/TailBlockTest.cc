@@ -0,0 +1,82 @@
+
+#include "PersistentVectorBlock.hh"
+#include "TestDirectory.hh"
+
+#include <gtest/gtest.h>
+
+using namespace ::testing;
+
+namespace storage {
+using PersistentVector = v2::PersistentVector;
+
+namespace {
+constexpr std::size_t ELEMENTS_COUNT = 250u;
+
+auto generateElement(const std::size_t id) -> std::string
+{
+  return "element " + std::to_string(id);
+}
+} // namespace
+
+TEST(Unit_Storage_TailBlock, ViewsSurviveAppends)
+{
+  const auto path = createEmptyDirectory("tailBlockDir");
+
+  PersistentVector vec(path);
+  vec.push_back(generateElement(0));
+  const auto first = vec.at(0);
+
+  // The last data block is appended to in place.
+  for (std::size_t id = 1; id < 100u; ++id)
+  {
+    vec.push_back(generateElement(id));
+    ASSERT_EQ(generateElement(id), vec.at(id));
+  }
+  ASSERT_EQ(generateElement(0), first);
+
+  // The full data block is then read like the other ones.
+  vec.push_back(generateElement(100));
+  ASSERT_EQ(generateElement(100), vec.at(100));
+  ASSERT_EQ(generateElement(0), vec.at(0));
+}
+
+TEST(Unit_Storage_TailBlock, PinnedInBoundedCache)
+{
+  const auto path = createEmptyDirectory("tailBlockDir");
+
+  PersistentVector vec(path, v2::Options{.cachedDataBlocks = 1});
+  for (std::size_t id = 0; id < ELEMENTS_COUNT; ++id)
+  {
+    vec.push_back(generateElement(id));
+  }
+
+  const auto last = vec.at(ELEMENTS_COUNT - 1);
+  ASSERT_EQ(generateElement(0), vec.at(0));
+  ASSERT_EQ(generateElement(100), vec.at(100));
+  ASSERT_EQ(generateElement(ELEMENTS_COUNT - 1), last);
+}
+
+TEST(Unit_Storage_TailBlock, ReopenAndErase)
+{
+  const auto path = createEmptyDirectory("tailBlockDir");
+
+  {
+    PersistentVector vec(path);
+    for (std::size_t id = 0; id < ELEMENTS_COUNT; ++id)
+    {
+      vec.push_back(generateElement(id));
+    }
+  }
+
+  PersistentVector vec(path);
+  vec.erase(ELEMENTS_COUNT - 10);
+  vec.push_back(generateElement(ELEMENTS_COUNT));
+
+  ASSERT_EQ(ELEMENTS_COUNT, vec.size());
+  ASSERT_EQ(generateElement(ELEMENTS_COUNT - 9), vec.at(ELEMENTS_COUNT - 10));
+  ASSERT_EQ(generateElement(ELEMENTS_COUNT), vec.at(ELEMENTS_COUNT - 1));
+
+  PersistentVector reader(path, v2::Options{.mode = v2::OpenMode::READ_ONLY});
+  ASSERT_EQ(generateElement(ELEMENTS_COUNT), reader.at(ELEMENTS_COUNT - 1));
+}
+} // namespace storage
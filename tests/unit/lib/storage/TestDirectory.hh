@@ -0,0 +1,23 @@
+
+#pragma once
+
+#include <gtest/gtest.h>
+
+#include <filesystem>
+#include <string>
+
+namespace storage {
+
+// Empties the directory `name` of the temporary directory, which becomes the
+// working directory: the other files written by the test land there too.
+inline auto createEmptyDirectory(const std::string &name) -> std::filesystem::path
+{
+  std::filesystem::current_path(std::filesystem::temp_directory_path());
+
+  std::filesystem::path directory(name);
+  std::filesystem::remove_all(directory);
+  EXPECT_TRUE(std::filesystem::create_directory(directory));
+  return directory;
+}
+
+} // namespace storage
@@ -0,0 +1,153 @@
+
+#include "PersistentVectorBlock.hh"
+#include "TestDirectory.hh"
+
+#include <fstream>
+#include <functional>
+#include <gtest/gtest.h>
+#include <thread>
+
+using namespace ::testing;
+
+namespace storage {
+using PersistentVector = v2::PersistentVector;
+
+namespace {
+constexpr std::size_t ELEMENTS_COUNT = 350u;
+
+auto generateElement(const std::size_t id) -> std::string
+{
+  return "element " + std::to_string(id);
+}
+
+auto dataBlockFileName(const std::size_t fileId) -> std::string
+{
+  const auto name = std::to_string(fileId);
+  return std::string(10u - name.size(), '0') + name + ".txt";
+}
+
+auto readFile(const std::filesystem::path &path) -> std::string
+{
+  std::ifstream in(path);
+  return std::string(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+}
+
+// Moves are committed by the operations of the vector: `operation` is
+// called until `done` holds.
+auto waitFor(const std::function<void()> &operation, const std::function<bool()> &done) -> bool
+{
+  const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+  while (!done())
+  {
+    if (std::chrono::steady_clock::now() > deadline)
+    {
+      return false;
+    }
+
+    operation();
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  return true;
+}
+} // namespace
+
+TEST(Unit_Storage_Tiering, ColdAndHotDataBlocks)
+{
+  const auto hot  = createEmptyDirectory("tieringHotDir");
+  const auto cold = std::filesystem::path("tieringColdDir");
+  std::filesystem::remove_all(cold);
+
+  const v2::Options options{.coldDirectory     = cold,
+                            .tieringInterval   = std::chrono::milliseconds(0),
+                            .promotionAccesses = 1};
+  {
+    PersistentVector vec(hot, options);
+    for (std::size_t id = 0; id < ELEMENTS_COUNT; ++id)
+    {
+      vec.push_back(generateElement(id));
+    }
+
+    // Only the last data block is read: the sealed ones move to the cold
+    // directory.
+    const auto readLast = [&vec] { vec.at(ELEMENTS_COUNT - 1); };
+    ASSERT_TRUE(waitFor(readLast, [&] {
+      return std::filesystem::exists(cold / dataBlockFileName(2))
+             && !std::filesystem::exists(hot / dataBlockFileName(0))
+             && !std::filesystem::exists(hot / dataBlockFileName(1))
+             && !std::filesystem::exists(hot / dataBlockFileName(2));
+    }));
+    ASSERT_TRUE(std::filesystem::exists(hot / dataBlockFileName(3)));
+    ASSERT_EQ("0 100 0 1\n100 100 1 1\n200 100 2 1\n300 100 3 0\n",
+              readFile(hot / "INDEX.txt"));
+
+    // A data block read again moves back.
+    const auto readFirst = [&vec] { vec.at(0); };
+    ASSERT_TRUE(waitFor(readFirst, [&] {
+      return std::filesystem::exists(hot / dataBlockFileName(0))
+             && !std::filesystem::exists(cold / dataBlockFileName(0));
+    }));
+    ASSERT_TRUE(readFile(hot / "INDEX.txt").starts_with("0 100 0 0\n"));
+
+    for (std::size_t id = 0; id < ELEMENTS_COUNT; ++id)
+    {
+      ASSERT_EQ(generateElement(id), vec.at(id));
+    }
+  }
+
+  // Copies left by an interrupted move are dropped, the index telling which
+  // one is current.
+  const auto index = readFile(hot / "INDEX.txt");
+  const auto stale = (index.find("100 100 1 1\n") != std::string::npos ? hot : cold);
+  std::ofstream(stale / dataBlockFileName(1)) << "stale";
+
+  {
+    PersistentVector vec(hot, v2::Options{.coldDirectory = cold});
+    ASSERT_FALSE(std::filesystem::exists(stale / dataBlockFileName(1)));
+    ASSERT_EQ(index, readFile(hot / "INDEX.txt"));
+    ASSERT_EQ(ELEMENTS_COUNT, vec.size());
+    ASSERT_EQ(generateElement(150), vec.at(150));
+  }
+
+  const PersistentVector reader(hot, v2::Options{.mode = v2::OpenMode::READ_ONLY,
+                                                 .coldDirectory = cold});
+  for (std::size_t id = 0; id < ELEMENTS_COUNT; ++id)
+  {
+    ASSERT_EQ(generateElement(id), reader.at(id));
+  }
+}
+
+TEST(Unit_Storage_Tiering, ErasedWhileMoving)
+{
+  const auto hot  = createEmptyDirectory("tieringHotDir");
+  const auto cold = std::filesystem::path("tieringColdDir");
+  std::filesystem::remove_all(cold);
+
+  PersistentVector vec(hot, v2::Options{.coldDirectory   = cold,
+                                        .tieringInterval = std::chrono::milliseconds(0)});
+  for (std::size_t id = 0; id < ELEMENTS_COUNT; ++id)
+  {
+    vec.push_back(generateElement(id));
+  }
+
+  // Erases rewrite the data blocks: copies of an older version are dropped.
+  for (std::size_t id = 0; id < 100u; ++id)
+  {
+    vec.erase(0);
+  }
+  const auto readLast = [&vec] { vec.at(vec.size() - 1); };
+  ASSERT_TRUE(waitFor(readLast, [&] {
+    return !std::filesystem::exists(hot / dataBlockFileName(1))
+           && !std::filesystem::exists(hot / dataBlockFileName(2))
+           && !std::filesystem::exists(hot / dataBlockFileName(0))
+           && !std::filesystem::exists(cold / dataBlockFileName(0));
+  }));
+  ASSERT_EQ("0 100 1 1\n100 100 2 1\n200 100 3 0\n", readFile(hot / "INDEX.txt"));
+
+  ASSERT_EQ(ELEMENTS_COUNT - 100u, vec.size());
+  for (std::size_t id = 0; id < vec.size(); ++id)
+  {
+    ASSERT_EQ(generateElement(id + 100u), vec.at(id));
+  }
+}
+
+} // namespace storage
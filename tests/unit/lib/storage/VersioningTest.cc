@@ -0,0 +1,152 @@
+
+#include "PersistentVectorBlock.hh"
+#include "TestDirectory.hh"
+
+#include <gtest/gtest.h>
+#include <string>
+#include <vector>
+
+using namespace ::testing;
+
+namespace storage {
+using PersistentVector = v2::PersistentVector;
+
+namespace {
+constexpr std::size_t ELEMENTS_COUNT = 250u;
+
+const v2::Options VERSIONING{.versioning = true};
+
+auto generateElement(const std::size_t id) -> std::string
+{
+  return "element " + std::to_string(id);
+}
+
+auto countDataBlockFiles(const std::filesystem::path &path) -> std::size_t
+{
+  std::size_t count = 0;
+  for (const auto &entry : std::filesystem::directory_iterator(path))
+  {
+    const auto name = entry.path().filename();
+    if (entry.path().extension() == ".txt" && name != "HEADER.txt" && name != "INDEX.txt"
+        && name != "FORMAT.txt")
+    {
+      ++count;
+    }
+  }
+  return count;
+}
+
+// Builds the vector while keeping a copy of every version.
+auto fill(PersistentVector &vec) -> std::vector<std::vector<std::string>>
+{
+  std::vector<std::vector<std::string>> snapshots{{}};
+  std::vector<std::string> model;
+  for (std::size_t id = 0; id < ELEMENTS_COUNT; ++id)
+  {
+    vec.push_back(generateElement(id));
+    model.push_back(generateElement(id));
+    snapshots.push_back(model);
+
+    if (id % 7u == 6u)
+    {
+      const auto position = (id * 31u) % model.size();
+      vec.erase(position);
+      model.erase(model.begin() + static_cast<std::ptrdiff_t>(position));
+      snapshots.push_back(model);
+    }
+  }
+  return snapshots;
+}
+
+void expectSnapshots(const PersistentVector &vec,
+                     const std::vector<std::vector<std::string>> &snapshots)
+{
+  ASSERT_EQ(snapshots.size() - 1, vec.version());
+  for (std::uint64_t version = 0; version < snapshots.size(); ++version)
+  {
+    const auto &snapshot = snapshots[version];
+    ASSERT_EQ(snapshot.size(), vec.size(version));
+    for (std::size_t index = 0; index < snapshot.size(); ++index)
+    {
+      ASSERT_EQ(snapshot[index], vec.at(index, version)) << "version " << version;
+    }
+    ASSERT_THROW(vec.at(snapshot.size(), version), std::out_of_range);
+  }
+  ASSERT_THROW(vec.size(snapshots.size()), std::out_of_range);
+}
+} // namespace
+
+TEST(Unit_Storage_Versioning, ReadOlderVersions)
+{
+  const auto path = createEmptyDirectory("versioningDir");
+
+  std::vector<std::vector<std::string>> snapshots;
+  {
+    PersistentVector vec(path, VERSIONING);
+    snapshots = fill(vec);
+    expectSnapshots(vec, snapshots);
+  }
+
+  // Versions are kept across runs and seen by readers.
+  {
+    PersistentVector vec(path, VERSIONING);
+    expectSnapshots(vec, snapshots);
+  }
+
+  const PersistentVector reader(path,
+                                v2::Options{.mode = v2::OpenMode::READ_ONLY, .versioning = true});
+  expectSnapshots(reader, snapshots);
+
+  const PersistentVector unversioned(path);
+  ASSERT_THROW(unversioned.at(0, 0), std::logic_error);
+}
+
+TEST(Unit_Storage_Versioning, Retention)
+{
+  const auto path = createEmptyDirectory("versioningDir");
+  {
+    PersistentVector vec(path, v2::Options{.versioning = true, .retainedVersions = 10});
+    const auto snapshots = fill(vec);
+    for (std::size_t id = 0; id < 10u; ++id)
+    {
+      vec.push_back(generateElement(ELEMENTS_COUNT + id));
+    }
+
+    // Files only used by the dropped versions are removed.
+    ASSERT_EQ(3u, countDataBlockFiles(path));
+    ASSERT_THROW(vec.size(snapshots.size() - 1), std::out_of_range);
+    ASSERT_EQ(snapshots.back().size() + 1u, vec.size(snapshots.size()));
+    ASSERT_EQ(snapshots.back()[0], vec.at(0, snapshots.size()));
+  }
+
+  // Versions whose files were removed are not read back with a longer
+  // retention.
+  {
+    PersistentVector vec(path, VERSIONING);
+    const auto before = vec.version();
+    ASSERT_THROW(vec.size(0u), std::out_of_range);
+    ASSERT_EQ(vec.size(), vec.size(before - 9u) + 9u);
+
+    const std::string first(vec.at(0));
+    vec.erase(0);
+    vec.erase(0);
+    ASSERT_EQ(5u, countDataBlockFiles(path));
+    ASSERT_EQ(first, vec.at(0, before));
+  }
+
+  // Opening the vector without versioning drops its history.
+  {
+    PersistentVector vec(path);
+    ASSERT_FALSE(std::filesystem::exists(path / "VERSIONS.log"));
+    ASSERT_EQ(3u, countDataBlockFiles(path));
+  }
+}
+
+TEST(Unit_Storage_Versioning, NotDeduplicated)
+{
+  const auto path = createEmptyDirectory("versioningDir");
+  ASSERT_THROW(PersistentVector(path, v2::Options{.versioning = true, .deduplication = true}),
+               std::invalid_argument);
+}
+
+} // namespace storage
@@ -0,0 +1,253 @@
+
+#include "PersistentVectorBlock.hh"
+#include "TestDirectory.hh"
+
+#include <fstream>
+#include <gtest/gtest.h>
+#include <optional>
+#include <string>
+#include <vector>
+
+using namespace ::testing;
+
+namespace storage {
+using PersistentVector = v2::PersistentVector;
+
+namespace {
+constexpr std::size_t ELEMENTS_COUNT = 150u;
+
+auto generateElement(const std::size_t id) -> std::string
+{
+  return "element " + std::to_string(id);
+}
+
+auto readFile(const std::filesystem::path &path) -> std::string
+{
+  std::ifstream in(path);
+  return std::string(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+}
+
+auto fill(const std::filesystem::path &path, const v2::Options &options = {})
+  -> std::vector<std::string>
+{
+  PersistentVector vec(path, options);
+  std::vector<std::string> model;
+  for (std::size_t id = 0; id < ELEMENTS_COUNT; ++id)
+  {
+    vec.push_back(generateElement(id));
+    model.push_back(generateElement(id));
+  }
+  return model;
+}
+
+// Erases from both data blocks and appends to a new one, `model` receiving
+// the same operations.
+auto makeBatch(std::vector<std::string> &model) -> v2::WriteBatch
+{
+  v2::WriteBatch batch;
+  const auto erase = [&](const std::size_t index) {
+    batch.erase(index);
+    model.erase(model.begin() + static_cast<std::ptrdiff_t>(index));
+  };
+  const auto append = [&](const std::string &value) {
+    batch.push_back(value);
+    model.push_back(value);
+  };
+
+  erase(0);
+  append("first");
+  erase(120);
+  erase(120);
+  for (std::size_t id = 0; id < 60u; ++id)
+  {
+    append("batched " + std::to_string(id));
+  }
+  erase(50);
+  return batch;
+}
+
+void expectContent(const PersistentVector &vec, const std::vector<std::string> &model)
+{
+  ASSERT_EQ(model.size(), vec.size());
+  for (std::size_t index = 0; index < model.size(); ++index)
+  {
+    ASSERT_EQ(model[index], vec.at(index));
+  }
+}
+
+// Puts back the header, the index, the logs and the data block files from
+// before the batch, as if the writer crashed right after logging it. Files
+// created by the batch are left in place.
+struct SavedState
+{
+  std::filesystem::path path{};
+  std::string header{};
+  std::string index{};
+  std::uintmax_t changesSize{};
+  std::uintmax_t hashIndexSize{};
+
+  explicit SavedState(const std::filesystem::path &path)
+    : path(path)
+    , header(readFile(path / "HEADER.txt"))
+    , index(readFile(path / "INDEX.txt"))
+    , changesSize(std::filesystem::file_size(path / "CHANGES.log"))
+    , hashIndexSize(std::filesystem::file_size(path / "HASH_INDEX.log"))
+  {
+    std::filesystem::remove_all("batchBackupDir");
+    std::filesystem::create_directory("batchBackupDir");
+    for (const auto &entry : std::filesystem::directory_iterator(path))
+    {
+      std::filesystem::create_hard_link(entry.path(), "batchBackupDir" / entry.path().filename());
+    }
+  }
+
+  void restore() const
+  {
+    std::ofstream(this->path / "HEADER.txt", std::ofstream::trunc) << this->header;
+    std::ofstream(this->path / "INDEX.txt", std::ofstream::trunc) << this->index;
+    std::filesystem::resize_file(this->path / "CHANGES.log", this->changesSize);
+    std::filesystem::resize_file(this->path / "HASH_INDEX.log", this->hashIndexSize);
+    for (const auto &entry : std::filesystem::directory_iterator("batchBackupDir"))
+    {
+      const auto target = this->path / entry.path().filename();
+      if (!std::filesystem::exists(target))
+      {
+        std::filesystem::create_hard_link(entry.path(), target);
+      }
+    }
+  }
+};
+} // namespace
+
+TEST(Unit_Storage_WriteBatch, Apply)
+{
+  const auto path = createEmptyDirectory("writeBatchDir");
+  auto model      = fill(path);
+  {
+    PersistentVector vec(path);
+    const auto lines = [&path] {
+      const auto header = readFile(path / "HEADER.txt");
+      return std::count(header.begin(), header.end(), '\n');
+    };
+    const auto before = lines();
+
+    vec.write(makeBatch(model));
+    expectContent(vec, model);
+
+    // The header is written once for the whole batch.
+    ASSERT_EQ(before + 1, lines());
+  }
+
+  PersistentVector vec(path);
+  expectContent(vec, model);
+
+  // Files replaced by erases are removed once the batch is applied.
+  std::size_t files = 0;
+  for (const auto &entry : std::filesystem::directory_iterator(path))
+  {
+    files += (entry.path().filename().string().starts_with("00") ? 1u : 0u);
+  }
+  ASSERT_EQ(3u, files);
+}
+
+TEST(Unit_Storage_WriteBatch, Invalid)
+{
+  const auto path  = createEmptyDirectory("writeBatchDir");
+  const auto model = fill(path);
+
+  PersistentVector vec(path);
+  v2::WriteBatch batch;
+  batch.push_back("appended");
+  batch.erase(ELEMENTS_COUNT + 1u);
+  ASSERT_THROW(vec.write(batch), std::out_of_range);
+  expectContent(vec, model);
+
+  batch.clear();
+  batch.push_back(std::string(5000u, 'a'));
+  ASSERT_THROW(vec.write(batch), std::invalid_argument);
+  expectContent(vec, model);
+
+  const auto dedupPath = createEmptyDirectory("writeBatchDedupDir");
+  PersistentVector dedup(dedupPath, v2::Options{.deduplication = true});
+  ASSERT_THROW(dedup.write(v2::WriteBatch{}), std::logic_error);
+}
+
+TEST(Unit_Storage_WriteBatch, FailedOperation)
+{
+  const auto path = createEmptyDirectory("writeBatchDir");
+  auto model      = fill(path);
+
+  {
+    // The erase gets file 2 and the last append grows to file 3, which
+    // cannot be created.
+    PersistentVector vec(path, v2::Options{.hashIndex = true});
+    std::filesystem::create_directory(path / "0000000003.txt");
+
+    v2::WriteBatch batch;
+    batch.erase(0);
+    for (std::size_t id = 0; id < 51u; ++id)
+    {
+      batch.push_back("appended " + std::to_string(id));
+    }
+    ASSERT_THROW(vec.write(batch), std::runtime_error);
+    expectContent(vec, model);
+    ASSERT_EQ(0u, vec.index_of(generateElement(0)));
+
+    // Later operations are persisted as usual.
+    std::filesystem::remove(path / "0000000003.txt");
+    vec.push_back("after");
+    vec.erase(1);
+    model.push_back("after");
+    model.erase(model.begin() + 1);
+  }
+
+  PersistentVector vec(path);
+  expectContent(vec, model);
+}
+
+TEST(Unit_Storage_WriteBatch, Recovery)
+{
+  const auto path     = createEmptyDirectory("writeBatchDir");
+  const auto options  = v2::Options{.changeFeed = true, .hashIndex = true};
+  const auto original = fill(path, options);
+
+  auto model = original;
+  std::optional<SavedState> saved;
+  {
+    PersistentVector vec(path, options);
+    saved.emplace(path);
+    vec.write(makeBatch(model));
+  }
+
+  // A logged batch is applied again, once.
+  saved->restore();
+  {
+    PersistentVector vec(path, options);
+    expectContent(vec, model);
+    ASSERT_EQ(original.size() + 65u, vec.sequence());
+    ASSERT_EQ(std::optional<std::size_t>(model.size() - 1), vec.index_of(model.back()));
+  }
+
+  // A batch which was not completely logged is not applied.
+  saved->restore();
+  const auto batchFile = path / "BATCH.log";
+  std::filesystem::resize_file(batchFile, std::filesystem::file_size(batchFile) - 1u);
+  {
+    PersistentVector vec(path, options);
+    expectContent(vec, original);
+    ASSERT_EQ(original.size(), vec.sequence());
+  }
+
+  // Neither is a batch followed by other operations.
+  model = original;
+  {
+    PersistentVector vec(path, options);
+    vec.write(makeBatch(model));
+    vec.push_back("after");
+    model.push_back("after");
+  }
+  PersistentVector vec(path, options);
+  expectContent(vec, model);
+}
+
+} // namespace storage